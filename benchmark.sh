@@ -0,0 +1,52 @@
+#!/bin/bash
+
+# Ensure the script stops on errors
+set -e
+
+# Usage: ./benchmark.sh [compiler|runtime] [output.json] [extra benchmark options...]
+SUITE=${1:-compiler}
+OUTPUT_FILE=${2:-benchmark_results.json}
+shift 2 || shift $#
+
+# Define paths
+BASE_DIR=$(pwd)
+SRC="$BASE_DIR/mlang_compile/src"
+BENCH_SRC="$SRC/benchmarks"
+RUNTIME_SRC="$SRC/runtime"
+
+if [ "$SUITE" = "compiler" ]; then
+    # Compile the front-end benchmark with optimizations
+    echo "Compiling compiler benchmark..."
+    g++ -O2 -pthread "$BENCH_SRC/compiler/main.cpp" "$BENCH_SRC/compiler/generator.cpp" "$BENCH_SRC/common/stats.cpp" \
+        "$SRC/lexical-analysis/lexer/lexer.cpp" "$SRC/lexical-analysis/errors/errors.cpp" "$SRC/lexical-analysis/errors/diagnostics.cpp" \
+        "$SRC/ast/ast-generation/ast.cpp" "$SRC/code-generation/codegen.cpp" "$SRC/code-generation/sourcemap.cpp" "$SRC/runtime/profile.cpp" \
+        "$SRC/code-generation/ir.cpp" "$SRC/code-generation/types.cpp" "$SRC/code-generation/builtins.cpp" "$SRC/code-generation/analysis.cpp" "$SRC/code-generation/inliner.cpp" "$SRC/code-generation/cse.cpp" "$SRC/code-generation/deadcode.cpp" \
+        -o "$BASE_DIR/compiler_benchmark"
+
+    # Run the lexer, parser and code generation on synthetic inputs
+    echo "Running compiler benchmark..."
+    "$BASE_DIR/compiler_benchmark" --output "$OUTPUT_FILE" "$@"
+elif [ "$SUITE" = "runtime" ]; then
+    # MLANG_PRECISION=float32 benchmarks float storage (runtime/precision.h); float32-accumulate also sums in float
+    case "${MLANG_PRECISION:-float64}" in
+        float64) PRECISION_FLAGS="" ;;
+        float32) PRECISION_FLAGS="-DMLANG_FLOAT32" ;;
+        float32-accumulate) PRECISION_FLAGS="-DMLANG_FLOAT32 -DMLANG_ACCUMULATE_FLOAT32" ;;
+        *) echo "Unknown MLANG_PRECISION: $MLANG_PRECISION (expected float64, float32 or float32-accumulate)"; exit 1 ;;
+    esac
+
+    # Compile the runtime kernel benchmark
+    echo "Compiling runtime benchmark..."
+    g++ -O3 -march=native -pthread $PRECISION_FLAGS "$BENCH_SRC/runtime/main.cpp" "$BENCH_SRC/runtime/reference.cpp" "$BENCH_SRC/common/stats.cpp" \
+        "$RUNTIME_SRC/runtime.cpp" "$RUNTIME_SRC/distributed.cpp" "$RUNTIME_SRC/parallel.cpp" "$RUNTIME_SRC/pool.cpp" "$RUNTIME_SRC/profile.cpp" \
+        -o "$BASE_DIR/runtime_benchmark"
+
+    # Run the kernels across sizes and thread counts
+    echo "Running runtime benchmark..."
+    "$BASE_DIR/runtime_benchmark" --output "$OUTPUT_FILE" "$@"
+else
+    echo "Unknown benchmark suite: $SUITE (expected compiler or runtime)"
+    exit 1
+fi
+
+echo "Benchmark completed successfully. Results are in $OUTPUT_FILE"
@@ -1,602 +1,805 @@
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <vector>
-#include <memory>
-#include <regex>
-
-// Token structure
-struct Token
-{
-    std::string type;
-    std::string value;
-    int line;
-    int column;
+#include "ast.h"
+#include <algorithm>
 
-    Token(const std::string &type, const std::string &value, int line, int column)
-        : type(type), value(value), line(line), column(column) {}
-};
+const Token endOfInput{TokenType::END_OF_FILE, "", 0, 0};
 
-// Function to read tokens from the lexer file
-std::vector<Token> readTokensFromFile(const std::string &fileName)
+// Stamps a freshly built node with the source position of its first token
+template <typename T>
+static std::unique_ptr<T> located(std::unique_ptr<T> node, const Token &token)
 {
-    std::vector<Token> tokens;
-    std::ifstream file(fileName);
+    node->line = token.line;
+    node->column = token.column;
+    return node;
+}
 
+TokenFileReader::TokenFileReader(const std::string &fileName, Diagnostics &diagnostics)
+    : file(fileName), diagnostics(diagnostics), fileId(diagnostics.addFile(fileName)),
+      tokenPattern(R"(<(\w+),\s*\"(.*?)\">\s*\[Line:\s*(\d+),\s*Column:\s*(-?\d+)\])")
+{
     if (!file.is_open())
     {
-        std::cerr << "Error opening file: " << fileName << std::endl;
-        return tokens;
+        diagnostics.error(fileId, DiagnosticCode::IO_ERROR, {0, 0, 0, 0}, "Error opening file");
     }
+}
 
+bool TokenFileReader::next(Token &token)
+{
     std::string line;
-    std::regex tokenPattern(R"(<(\w+),\s*\"(.*?)\">\s*\[Line:\s*(\d+),\s*Column:\s*(-?\d+)\])");
-
     while (std::getline(file, line))
     {
+        ++lineNumber;
         std::smatch match;
         if (std::regex_search(line, match, tokenPattern) && match.size() == 5)
         {
-            std::string type = match[1].str();
+            TokenType type = stringToTokenType(match[1].str());
             std::string value = match[2].str();
             int lineNum = std::stoi(match[3].str());
             int columnNum = std::stoi(match[4].str());
 
-            tokens.emplace_back(type, value, lineNum, columnNum);
-        }
-        else
-        {
-            std::cerr << "Error parsing token from line: " << line << std::endl;
+            token = {type, value, lineNum, columnNum};
+            ++count;
+            return true;
         }
+        diagnostics.error(fileId, DiagnosticCode::MALFORMED_TOKEN, {lineNumber, 1, lineNumber, static_cast<int32_t>(line.size()) + 1},
+                          "Error parsing token from line: " + line);
     }
+    return false;
+}
 
-    if (tokens.empty())
+bool TokenFileReader::reportCount()
+{
+    if (count == 0)
     {
-        std::cerr << "No tokens read from file: " << fileName << ". Please check the file format." << std::endl;
+        diagnostics.error(fileId, DiagnosticCode::MALFORMED_TOKEN, {0, 0, 0, 0}, "No tokens read from file. Please check the file format.");
+        return false;
     }
-    else
+    std::cout << "Successfully read " << count << " tokens." << std::endl;
+    return true;
+}
+
+// Function to read tokens from the lexer file
+std::vector<Token> readTokensFromFile(const std::string &fileName, Diagnostics &diagnostics)
+{
+    std::vector<Token> tokens;
+    TokenFileReader reader(fileName, diagnostics);
+    if (!reader.isOpen())
     {
-        std::cout << "Successfully read " << tokens.size() << " tokens." << std::endl;
+        return tokens;
     }
 
+    Token token;
+    while (reader.next(token))
+    {
+        tokens.push_back(token);
+    }
+    reader.reportCount();
     return tokens;
 }
 
-// Base class for all AST nodes
-class ASTNode
+namespace
 {
-public:
-    virtual ~ASTNode() = default;
-    virtual void print(int indentLevel = 0) const = 0; // For debugging with indentation
-};
 
-// Represents the overall program with a list of functions
-class ProgramNode : public ASTNode
-{
-public:
-    std::vector<std::unique_ptr<ASTNode>> functions;
-
-    void addFunction(std::unique_ptr<ASTNode> func)
+    int precedence(const Token &token)
     {
-        functions.push_back(std::move(func));
+        if (token.type != TokenType::OPERATOR)
+            return 0;
+        if (token.value == "+" || token.value == "-")
+            return 1;
+        if (token.value == "*" || token.value == "/")
+            return 2;
+        return 0;
     }
 
-    void print(int indentLevel = 0) const override
+    // Recursive-descent parser for statements and expressions inside function bodies
+    class BodyParser
     {
-        for (const auto &func : functions)
+    public:
+        // Tokens are copied out of the stream wherever they outlive the next advance()
+        explicit BodyParser(TokenStream &tokens) : tokens(tokens) {}
+
+        const Token &peek(size_t offset = 0)
         {
-            func->print(indentLevel);
+            return tokens.peek(offset);
         }
-    }
-};
 
-// Represents a function definition
-class FunctionNode : public ASTNode
-{
-public:
-    std::string name;
-    std::vector<std::pair<std::string, std::string>> parameters;
-    std::string returnType;
-    std::unique_ptr<ASTNode> body;
+        bool atEnd()
+        {
+            return tokens.atEnd();
+        }
 
-    FunctionNode(const std::string &name, const std::vector<std::pair<std::string, std::string>> &params, const std::string &returnType, std::unique_ptr<ASTNode> body)
-        : name(name), parameters(params), returnType(returnType), body(std::move(body)) {}
+        Token expect(const std::string &value, const std::string &context)
+        {
+            if (atEnd() || peek().value != value)
+            {
+                const Token &found = atEnd() && tokens.consumed() > 0 ? tokens.previous() : peek();
+                throw ParseException("Expected '" + value + "' " + context, found);
+            }
+            return tokens.next();
+        }
 
-    void print(int indentLevel = 0) const override
-    {
-        std::cout << std::string(indentLevel, ' ') << "FUNCTION_DEFINITION\n";
-        std::cout << std::string(indentLevel + 2, ' ') << "FUNCTION_NAME: " << name << "\n";
-        std::cout << std::string(indentLevel + 2, ' ') << "RETURN_TYPE: " << returnType << "\n";
-        std::cout << std::string(indentLevel + 2, ' ') << "PARAMETERS\n";
-        for (const auto &param : parameters)
+        std::unique_ptr<ASTNode> parseExpression(int minPrecedence = 1)
         {
-            std::cout << std::string(indentLevel + 4, ' ') << "PARAMETER: " << param.first << " (TYPE: " << param.second << ")\n";
+            auto left = parseUnary();
+            while (!atEnd() && precedence(peek()) >= minPrecedence)
+            {
+                Token opToken = tokens.next();
+                auto right = parseExpression(precedence(opToken) + 1);
+                left = located(std::make_unique<BinaryOperatorNode>(opToken.value, std::move(left), std::move(right)), opToken);
+            }
+            return left;
         }
-        if (body)
+
+        // Parses statements up to the closing '}' of the current block and consumes it
+        std::unique_ptr<BlockNode> parseBlock(const Token &opener)
         {
-            body->print(indentLevel + 2);
+            auto block = std::make_unique<BlockNode>();
+            while (true)
+            {
+                if (atEnd())
+                {
+                    throw ParseException("Mismatched braces detected in function body", opener);
+                }
+                if (peek().value == "}")
+                {
+                    tokens.advance();
+                    return block;
+                }
+                if (peek().value == ";")
+                {
+                    tokens.advance();
+                    continue;
+                }
+                block->addStatement(parseStatement());
+            }
         }
-    }
-};
 
-// Represents a block of statements (function body, etc.)
-class BlockNode : public ASTNode
-{
-public:
-    std::vector<std::unique_ptr<ASTNode>> statements;
+    private:
+        TokenStream &tokens;
 
-    void addStatement(std::unique_ptr<ASTNode> stmt)
-    {
-        statements.push_back(std::move(stmt));
-    }
+        std::unique_ptr<ASTNode> parseUnary()
+        {
+            Token token = peek();
+            if (token.type == TokenType::OPERATOR && token.value == "-")
+            {
+                tokens.advance();
+                // Fold the sign into numeric literals so "-1" stays a single value
+                if (peek().type == TokenType::LITERAL)
+                {
+                    return located(std::make_unique<LiteralNode>("-" + tokens.next().value), token);
+                }
+                return located(std::make_unique<UnaryOperatorNode>("-", parseUnary()), token);
+            }
+            return parsePostfix(parsePrimary());
+        }
 
-    void print(int indentLevel = 0) const override
-    {
-        std::cout << std::string(indentLevel, ' ') << "FUNCTION_BODY\n";
-        for (const auto &stmt : statements)
+        std::unique_ptr<ASTNode> parsePrimary()
+        {
+            if (atEnd())
+            {
+                throw ParseException("Unexpected end of input while parsing expression", tokens.previous());
+            }
+            Token token = tokens.next();
+            if (token.value == "(" && token.type == TokenType::DELIMITER)
+            {
+                auto inner = parseExpression();
+                expect(")", "to close parenthesized expression");
+                return inner;
+            }
+            if (token.value == "[" && token.type == TokenType::DELIMITER)
+            {
+                auto vector = located(std::make_unique<VectorLiteralNode>(), token);
+                while (peek().value != "]")
+                {
+                    vector->addElement(parseExpression());
+                    if (peek().value != ",")
+                        break;
+                    tokens.advance();
+                }
+                expect("]", "to close vector literal");
+                return vector;
+            }
+            if (token.type == TokenType::IDENTIFIER)
+            {
+                if (peek().value == "(")
+                {
+                    auto call = located(std::make_unique<FunctionCallNode>(token.value), token);
+                    for (auto &argument : parseArguments())
+                    {
+                        call->addArgument(std::move(argument));
+                    }
+                    return call;
+                }
+                return located(std::make_unique<LiteralNode>(token.value), token);
+            }
+            if (token.type == TokenType::LITERAL)
+                return located(std::make_unique<LiteralNode>(token.value), token);
+            // String literals arrive without their quotes
+            if (token.type == TokenType::STRING)
+                return located(std::make_unique<LiteralNode>("\"" + token.value + "\""), token);
+            throw ParseException("Expected expression but found '" + token.value + "'", token);
+        }
+
+        std::vector<std::unique_ptr<ASTNode>> parseArguments()
         {
-            stmt->print(indentLevel + 2);
+            std::vector<std::unique_ptr<ASTNode>> arguments;
+            expect("(", "before call arguments");
+            while (peek().value != ")")
+            {
+                arguments.push_back(parseExpression());
+                if (peek().value != ",")
+                    break;
+                tokens.advance();
+            }
+            expect(")", "after call arguments");
+            return arguments;
         }
-    }
-};
 
-// Represents a variable declaration
-class VariableDeclarationNode : public ASTNode
-{
-public:
-    std::string type;
-    std::string name;
-    std::unique_ptr<ASTNode> initializer;
+        std::unique_ptr<ASTNode> parsePostfix(std::unique_ptr<ASTNode> expression)
+        {
+            while (!atEnd())
+            {
+                Token token = peek();
+                if (token.value == "[" && token.type == TokenType::DELIMITER)
+                {
+                    tokens.advance();
+                    auto subscript = parseExpression();
+                    expect("]", "after index expression");
+                    expression = located(std::make_unique<IndexNode>(std::move(expression), std::move(subscript)), token);
+                }
+                else if (token.value == "." && token.type == TokenType::DELIMITER)
+                {
+                    tokens.advance();
+                    Token name = peek();
+                    if (name.type != TokenType::IDENTIFIER)
+                    {
+                        throw ParseException("Expected member name after '.'", name);
+                    }
+                    tokens.advance();
+                    if (peek().value == "(")
+                    {
+                        auto call = located(std::make_unique<MethodCallNode>(std::move(expression), name.value), name);
+                        for (auto &argument : parseArguments())
+                        {
+                            call->addArgument(std::move(argument));
+                        }
+                        expression = std::move(call);
+                    }
+                    else
+                    {
+                        expression = located(std::make_unique<MemberAccessNode>(std::move(expression), name.value), name);
+                    }
+                }
+                else
+                {
+                    break;
+                }
+            }
+            return expression;
+        }
 
-    VariableDeclarationNode(const std::string &type, const std::string &name, std::unique_ptr<ASTNode> initializer = nullptr)
-        : type(type), name(name), initializer(std::move(initializer)) {}
+        // Statements end with ';', which may be left out before a closing '}'
+        void endStatement(const std::string &kind)
+        {
+            if (peek().value == ";")
+            {
+                tokens.advance();
+                return;
+            }
+            if (peek().value != "}")
+            {
+                throw ParseException("Expected semicolon after " + kind, tokens.previous());
+            }
+        }
 
-    void print(int indentLevel = 0) const override
-    {
-        std::cout << std::string(indentLevel, ' ') << "VARIABLE_DECLARATION\n";
-        std::cout << std::string(indentLevel + 2, ' ') << "IDENTIFIER: " << name << " (TYPE: " << type << ")\n";
-        if (initializer)
+        std::string parseType()
         {
-            initializer->print(indentLevel + 2);
+            std::string type;
+            int nestedAngleBrackets = 0;
+            while (!atEnd())
+            {
+                const std::string &value = peek().value;
+                if (nestedAngleBrackets == 0 && (value == "=" || value == ";" || value == "}"))
+                    break;
+                if (value == "<")
+                    nestedAngleBrackets++;
+                else if (value == ">")
+                    nestedAngleBrackets--;
+                type += value;
+                tokens.advance();
+            }
+            return type;
         }
-    }
-};
 
-// Represents a function call
-class FunctionCallNode : public ASTNode
-{
-public:
-    std::string functionName;
-    std::vector<std::unique_ptr<ASTNode>> arguments;
+        std::unique_ptr<ASTNode> parseStatement()
+        {
+            Token token = peek();
+            if (token.type == TokenType::KEYWORD && token.value == "for")
+            {
+                return parseFor();
+            }
+            if (token.type == TokenType::KEYWORD && token.value == "return")
+            {
+                tokens.advance(); // Skip 'return'
+                std::unique_ptr<ASTNode> expr;
+                if (peek().value != ";")
+                {
+                    expr = parseExpression();
+                }
+                if (peek().value != ";")
+                {
+                    throw ParseException("Expected semicolon after return statement", tokens.previous());
+                }
+                tokens.advance(); // Skip the semicolon
+                return located(std::make_unique<ReturnNode>(std::move(expr)), token);
+            }
+            if (token.type == TokenType::KEYWORD)
+            {
+                throw ParseException("'" + token.value + "' statements are not supported", token);
+            }
 
-    FunctionCallNode(const std::string &functionName) : functionName(functionName) {}
+            // Declaration: name: Type [= expression];
+            if (token.type == TokenType::IDENTIFIER && peek(1).value == ":")
+            {
+                tokens.advance();
+                tokens.advance();
+                std::string type = parseType();
+                std::unique_ptr<ASTNode> initializer;
+                if (peek().value == "=")
+                {
+                    tokens.advance();
+                    initializer = parseExpression();
+                }
+                endStatement("declaration");
+                return located(std::make_unique<VariableDeclarationNode>(type, token.value, std::move(initializer)), token);
+            }
 
-    void addArgument(std::unique_ptr<ASTNode> arg)
-    {
-        arguments.push_back(std::move(arg));
-    }
+            auto target = parseUnary();
+            if (peek().type == TokenType::OPERATOR && peek().value == "=")
+            {
+                tokens.advance(); // Skip '='
+                std::unique_ptr<ASTNode> subscript;
+                auto *literal = dynamic_cast<LiteralNode *>(target.get());
+                auto *element = dynamic_cast<IndexNode *>(target.get());
+                if (element)
+                {
+                    literal = dynamic_cast<LiteralNode *>(element->base.get());
+                    subscript = std::move(element->index);
+                }
+                if (!literal)
+                {
+                    throw ParseException("Invalid assignment target", token);
+                }
+                auto expr = parseExpression();
+                endStatement("assignment");
+                return located(std::make_unique<AssignmentNode>(literal->value, std::move(expr), std::move(subscript)), token);
+            }
+            if (!dynamic_cast<FunctionCallNode *>(target.get()) && !dynamic_cast<MethodCallNode *>(target.get()))
+            {
+                throw ParseException("Expected assignment or call statement", token);
+            }
+            endStatement("call");
+            return target;
+        }
 
-    void print(int indentLevel = 0) const override
-    {
-        std::cout << std::string(indentLevel, ' ') << "FUNCTION_CALL: " << functionName << "\n";
-        if (!arguments.empty())
+        std::unique_ptr<ASTNode> parseFor()
         {
-            std::cout << std::string(indentLevel + 2, ' ') << "ARGUMENTS\n";
-            for (const auto &arg : arguments)
+            Token forToken = tokens.next(); // Skip 'for'
+            Token variable = peek();
+            if (variable.type != TokenType::IDENTIFIER)
             {
-                arg->print(indentLevel + 4);
+                throw ParseException("Expected loop variable after 'for'", variable);
             }
+            tokens.advance();
+            std::string loopVarType = "Int"; // Ranges are integral
+            expect("in", "after loop variable in 'for' loop");
+
+            auto rangeStart = parseExpression();
+            expect("to", "after range start expression in 'for' loop");
+            if (atEnd())
+            {
+                throw ParseException("Expected range end expression in 'for' loop but found end of input", tokens.previous());
+            }
+            auto rangeEnd = parseExpression();
+            Token opener = expect("{", "to open 'for' loop body");
+            auto loopBody = parseBlock(opener);
+            return located(std::make_unique<ForLoopNode>(variable.value, loopVarType, std::move(rangeStart), std::move(rangeEnd), std::move(loopBody)), forToken);
         }
-    }
-};
+    };
+}
 
-// Represents a literal value (like numbers or strings)
-class LiteralNode : public ASTNode
+BinaryASTWriter::BinaryASTWriter(std::ostream &out) : out(out), start(out.tellp())
 {
-public:
-    std::string value;
+    // Placeholders for the header and the ROOT node, rewritten by finish()
+    BinaryASTHeader header{};
+    BinaryASTNode root{};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(&root), sizeof(root));
+    intern("");
+}
 
-    LiteralNode(const std::string &value) : value(value) {}
+uint32_t BinaryASTWriter::intern(const std::string &value)
+{
+    if (value.empty() && !strings.empty())
+    {
+        return 0;
+    }
+    auto inserted = stringIds.emplace(value, static_cast<uint32_t>(strings.size()));
+    if (inserted.second)
+    {
+        strings.push_back(&inserted.first->first);
+    }
+    return inserted.first->second;
+}
 
-    void print(int indentLevel = 0) const override
+void BinaryASTWriter::begin(ASTKind kind, const std::string &value, const ASTNode *source)
+{
+    if (!open.empty())
     {
-        std::cout << std::string(indentLevel, ' ') << "LITERAL_VALUE: " << value << "\n";
+        ++nodes[open.back()].childCount;
     }
-};
+    BinaryASTNode node{};
+    node.kind = static_cast<uint16_t>(kind);
+    node.value = intern(value);
+    node.line = source ? source->line : 0;
+    node.column = source ? source->column : 0;
+    nodes.push_back(node);
+    open.push_back(nodes.size() - 1);
+}
 
-// Represents an assignment statement
-class AssignmentNode : public ASTNode
+void BinaryASTWriter::end()
 {
-public:
-    std::string variableName;
-    std::unique_ptr<ASTNode> expression;
+    open.pop_back();
+}
 
-    AssignmentNode(const std::string &variableName, std::unique_ptr<ASTNode> expression)
-        : variableName(variableName), expression(std::move(expression)) {}
+void BinaryASTWriter::leaf(ASTKind kind, const std::string &value, const ASTNode *source)
+{
+    begin(kind, value, source);
+    end();
+}
 
-    void print(int indentLevel = 0) const override
+// Emits the node and its subtree in the shape of the text dump printed by ASTNode::print
+void BinaryASTWriter::write(const ASTNode &node)
+{
+    if (auto *block = dynamic_cast<const BlockNode *>(&node))
     {
-        std::cout << std::string(indentLevel, ' ') << "ASSIGNMENT_EXPRESSION\n";
-        std::cout << std::string(indentLevel + 2, ' ') << "IDENTIFIER: " << variableName << "\n";
-        std::cout << std::string(indentLevel + 2, ' ') << "EXPRESSION\n";
-        if (expression)
+        begin(ASTKind::FUNCTION_BODY);
+        for (const auto &statement : block->statements)
         {
-            expression->print(indentLevel + 4);
+            write(*statement);
         }
+        end();
     }
-};
-
-class BinaryOperatorNode : public ASTNode
-{
-public:
-    std::string op;
-    std::unique_ptr<ASTNode> left;
-    std::unique_ptr<ASTNode> right;
-
-    BinaryOperatorNode(const std::string &op, std::unique_ptr<ASTNode> left, std::unique_ptr<ASTNode> right)
-        : op(op), left(std::move(left)), right(std::move(right)) {}
-
-    void print(int indentLevel = 0) const override
+    else if (auto *declaration = dynamic_cast<const VariableDeclarationNode *>(&node))
     {
-        std::cout << std::string(indentLevel, ' ') << "OPERATOR: " << op << "\n";
-        left->print(indentLevel + 2);
-        right->print(indentLevel + 2);
+        begin(ASTKind::VARIABLE_DECLARATION, "", &node);
+        leaf(ASTKind::IDENTIFIER, declaration->name + " (TYPE: " + declaration->type + ")");
+        if (declaration->initializer)
+        {
+            write(*declaration->initializer);
+        }
+        end();
     }
-};
-
-// Represents a range in a for loop
-class ForLoopNode : public ASTNode
-{
-public:
-    std::string loopVar;
-    std::string loopVarType;
-    std::unique_ptr<ASTNode> rangeStart;
-    std::unique_ptr<ASTNode> rangeEnd;
-    std::unique_ptr<ASTNode> body;
-
-    ForLoopNode(const std::string &loopVar, const std::string &loopVarType,
-                std::unique_ptr<ASTNode> rangeStart, std::unique_ptr<ASTNode> rangeEnd,
-                std::unique_ptr<ASTNode> body)
-        : loopVar(loopVar), loopVarType(loopVarType), rangeStart(std::move(rangeStart)),
-          rangeEnd(std::move(rangeEnd)), body(std::move(body)) {}
-
-    void print(int indentLevel = 0) const override
-    {
-        std::cout << std::string(indentLevel, ' ') << "FOR_LOOP\n";
-        std::cout << std::string(indentLevel + 2, ' ') << "LOOP_VARIABLE: " << loopVar << " (TYPE: " << loopVarType << ")\n";
-        std::cout << std::string(indentLevel + 2, ' ') << "RANGE_START: ";
-        rangeStart->print(0);
-        std::cout << std::string(indentLevel + 2, ' ') << "RANGE_END: ";
-        rangeEnd->print(0);
-        std::cout << std::string(indentLevel + 2, ' ') << "LOOP_BODY\n";
-        body->print(indentLevel + 4);
-    }
-};
-
-std::unique_ptr<ASTNode> parseExpression(const std::vector<Token> &tokens, size_t &index)
-{
-    // Ensure there are enough tokens to form an expression
-    if (index >= tokens.size())
+    else if (auto *call = dynamic_cast<const FunctionCallNode *>(&node))
     {
-        std::cerr << "Error: Unexpected end of tokens while parsing expression." << std::endl;
-        return nullptr;
+        begin(ASTKind::FUNCTION_CALL, call->functionName, &node);
+        if (!call->arguments.empty())
+        {
+            begin(ASTKind::ARGUMENTS);
+            for (const auto &argument : call->arguments)
+            {
+                write(*argument);
+            }
+            end();
+        }
+        end();
     }
-
-    // Start parsing with the left operand (should be a literal for now)
-    std::unique_ptr<ASTNode> left = std::make_unique<LiteralNode>(tokens[index].value);
-    ++index;
-
-    while (index < tokens.size() && tokens[index].type == "OPERATOR")
+    else if (auto *literal = dynamic_cast<const LiteralNode *>(&node))
     {
-        std::string op = tokens[index].value;
-        ++index;
-
-        // Ensure the right operand exists
-        if (index >= tokens.size())
+        leaf(ASTKind::LITERAL_VALUE, literal->value, &node);
+    }
+    else if (auto *assignment = dynamic_cast<const AssignmentNode *>(&node))
+    {
+        begin(ASTKind::ASSIGNMENT_EXPRESSION, "", &node);
+        leaf(ASTKind::IDENTIFIER, assignment->variableName);
+        if (assignment->index)
         {
-            std::cerr << "Error: Operator found but no right operand." << std::endl;
-            return nullptr;
+            begin(ASTKind::INDEX);
+            write(*assignment->index);
+            end();
         }
-
-        auto right = std::make_unique<LiteralNode>(tokens[index].value);
-        ++index;
-
-        // Create a binary operator node and update the left node
-        auto binaryOp = std::make_unique<BinaryOperatorNode>(op, std::move(left), std::move(right));
-        left = std::move(binaryOp);
+        begin(ASTKind::EXPRESSION);
+        if (assignment->expression)
+        {
+            write(*assignment->expression);
+        }
+        end();
+        end();
+    }
+    else if (auto *binary = dynamic_cast<const BinaryOperatorNode *>(&node))
+    {
+        begin(ASTKind::OPERATOR, binary->op, &node);
+        write(*binary->left);
+        write(*binary->right);
+        end();
+    }
+    else if (auto *unary = dynamic_cast<const UnaryOperatorNode *>(&node))
+    {
+        begin(ASTKind::UNARY_OPERATOR, unary->op, &node);
+        write(*unary->operand);
+        end();
+    }
+    else if (auto *element = dynamic_cast<const IndexNode *>(&node))
+    {
+        begin(ASTKind::INDEX_EXPRESSION, "", &node);
+        write(*element->base);
+        write(*element->index);
+        end();
+    }
+    else if (auto *member = dynamic_cast<const MemberAccessNode *>(&node))
+    {
+        begin(ASTKind::MEMBER_ACCESS, member->member, &node);
+        write(*member->object);
+        end();
+    }
+    else if (auto *method = dynamic_cast<const MethodCallNode *>(&node))
+    {
+        begin(ASTKind::METHOD_CALL, method->method, &node);
+        write(*method->object);
+        if (!method->arguments.empty())
+        {
+            begin(ASTKind::ARGUMENTS);
+            for (const auto &argument : method->arguments)
+            {
+                write(*argument);
+            }
+            end();
+        }
+        end();
+    }
+    else if (auto *vector = dynamic_cast<const VectorLiteralNode *>(&node))
+    {
+        begin(ASTKind::VECTOR_LITERAL, "", &node);
+        for (const auto &element : vector->elements)
+        {
+            write(*element);
+        }
+        end();
+    }
+    else if (auto *loop = dynamic_cast<const ForLoopNode *>(&node))
+    {
+        begin(ASTKind::FOR_LOOP, "", &node);
+        leaf(ASTKind::LOOP_VARIABLE, loop->loopVar + " (TYPE: " + loop->loopVarType + ")");
+        begin(ASTKind::RANGE_START);
+        write(*loop->rangeStart);
+        end();
+        begin(ASTKind::RANGE_END);
+        write(*loop->rangeEnd);
+        end();
+        begin(ASTKind::LOOP_BODY);
+        write(*loop->body);
+        end();
+        end();
+    }
+    else if (auto *result = dynamic_cast<const ReturnNode *>(&node))
+    {
+        begin(ASTKind::RETURN_STATEMENT, "", &node);
+        if (result->expression)
+        {
+            write(*result->expression);
+        }
+        end();
     }
-
-    return left;
 }
 
-class ReturnNode : public ASTNode
+void BinaryASTWriter::add(const FunctionNode &function)
 {
-public:
-    std::unique_ptr<ASTNode> expression;
+    begin(ASTKind::FUNCTION_DEFINITION, "", &function);
+    leaf(ASTKind::FUNCTION_NAME, function.name);
+    leaf(ASTKind::RETURN_TYPE, function.returnType);
+    begin(ASTKind::PARAMETERS);
+    for (const auto &parameter : function.parameters)
+    {
+        leaf(ASTKind::PARAMETER, parameter.first + " (TYPE: " + parameter.second + ")");
+    }
+    end();
+    if (function.body)
+    {
+        write(*function.body);
+    }
+    end();
 
-    ReturnNode(std::unique_ptr<ASTNode> expr) : expression(std::move(expr)) {}
+    out.write(reinterpret_cast<const char *>(nodes.data()), nodes.size() * sizeof(BinaryASTNode));
+    nodeCount += static_cast<uint32_t>(nodes.size());
+    ++functionCount;
+    nodes.clear();
+}
 
-    void print(int indentLevel = 0) const override
+bool BinaryASTWriter::finish()
+{
+    BinaryASTHeader header{};
+    std::copy(BINARY_AST_MAGIC, BINARY_AST_MAGIC + 4, header.magic);
+    header.version = BINARY_AST_VERSION;
+    header.nodeCount = nodeCount;
+    header.stringCount = static_cast<uint32_t>(strings.size());
+    header.stringsOffset = sizeof(BinaryASTHeader) + uint64_t(nodeCount) * sizeof(BinaryASTNode);
+
+    std::vector<uint32_t> offsets;
+    offsets.reserve(strings.size() + 1);
+    uint32_t offset = 0;
+    for (const std::string *value : strings)
     {
-        std::cout << std::string(indentLevel, ' ') << "RETURN_STATEMENT\n";
-        if (expression)
-        {
-            expression->print(indentLevel + 2);
-        }
+        offsets.push_back(offset);
+        offset += static_cast<uint32_t>(value->size());
     }
-};
+    offsets.push_back(offset);
+    out.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    for (const std::string *value : strings)
+    {
+        out.write(value->data(), value->size());
+    }
+    header.fileBytes = header.stringsOffset + offsets.size() * sizeof(uint32_t) + offset;
+
+    BinaryASTNode root{};
+    root.kind = static_cast<uint16_t>(ASTKind::ROOT);
+    root.childCount = functionCount;
+    std::streampos finished = out.tellp();
+    out.seekp(start);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(&root), sizeof(root));
+    out.seekp(finished);
+    return out.good();
+}
 
-class ParseException : public std::runtime_error
+TokenStream parserTokens(Lexer &lexer)
 {
-public:
-    ParseException(const std::string &message) : std::runtime_error(message) {}
-};
+    return TokenStream([&lexer]()
+                       {
+        Token token;
+        do
+        {
+            token = lexer.nextToken();
+        } while (token.type == TokenType::COMMENT);
+        return token; });
+}
 
-std::unique_ptr<ProgramNode> parseTokens(const std::vector<Token> &tokens)
+TokenStream parserTokens(TokenFileReader &reader)
 {
-    auto program = std::make_unique<ProgramNode>();
-    size_t index = 0;
-
-    while (index < tokens.size())
-    {
-        const Token &token = tokens[index];
-        if (token.type == "KEYWORD" && token.value == "fn")
+    return TokenStream([&reader]()
+                       {
+        Token token;
+        while (reader.next(token))
         {
-            std::string functionName = tokens[++index].value;
-            ++index; // skip '('
-            std::vector<std::pair<std::string, std::string>> parameters;
-            ++index; // skip '('
+            if (token.type != TokenType::COMMENT)
+                return token;
+        }
+        return endOfInput; });
+}
 
-            while (index < tokens.size() && tokens[index].value != ")")
-            {
-                std::string paramName = tokens[index++].value;
-                std::string paramType;
-                if (index < tokens.size() && tokens[index].value == ":")
-                {
-                    ++index; // skip ':'
-                    int nestedAngleBrackets = 0;
-                    while (index < tokens.size())
-                    {
-                        if (tokens[index].value == "<")
-                        {
-                            nestedAngleBrackets++;
-                        }
-                        else if (tokens[index].value == ">")
-                        {
-                            nestedAngleBrackets--;
-                        }
-                        else if (tokens[index].value == "," && nestedAngleBrackets == 0)
-                        {
-                            break;
-                        }
-                        else if (tokens[index].value == ")" && nestedAngleBrackets == 0)
-                        {
-                            break;
-                        }
-                        paramType += tokens[index].value;
-                        ++index;
-                    }
-                }
-                parameters.emplace_back(paramName, paramType);
-                if (tokens[index].value == ",")
-                    ++index;
-            }
-            ++index; // skip ')'
+std::unique_ptr<ASTNode> parseExpression(const std::vector<Token> &tokens, size_t &index)
+{
+    size_t position = index;
+    TokenStream stream([&]()
+                       { return position < tokens.size() ? tokens[position++] : endOfInput; });
+    auto expression = BodyParser(stream).parseExpression();
+    index += stream.consumed();
+    return expression;
+}
 
-            // Parse return type, only if the next token is '->'
-            std::string returnType;
-            if (tokens[index].value == "->")
-            {
-                ++index; // skip '->'
-                int nestedAngleBrackets = 0;
-                while (index < tokens.size())
-                {
-                    if (tokens[index].value == "<")
-                    {
-                        nestedAngleBrackets++;
-                    }
-                    else if (tokens[index].value == ">")
-                    {
-                        nestedAngleBrackets--;
-                        if (nestedAngleBrackets == 0)
-                        {
-                            returnType += tokens[index].value;
-                            ++index;
-                            break;
-                        }
-                    }
-                    else if (tokens[index].value == "{" && nestedAngleBrackets == 0)
-                    {
-                        break;
-                    }
-                    returnType += tokens[index].value;
-                    ++index;
-                }
-            }
+std::unique_ptr<FunctionNode> parseNextFunction(TokenStream &tokens)
+{
+    // Skip anything that is not a function
+    while (!tokens.atEnd() && !(tokens.peek().type == TokenType::KEYWORD && tokens.peek().value == "fn"))
+    {
+        tokens.advance();
+    }
+    if (tokens.atEnd())
+    {
+        return nullptr;
+    }
 
-            // Parse function body, starting with '{'
-            if (tokens[index].value == "{")
-                ++index; // skip '{'
-            auto body = std::make_unique<BlockNode>();
-            int braceCount = 1;
+    Token token = tokens.next(); // 'fn'
+    std::string functionName = tokens.next().value;
+    tokens.advance(); // skip '('
+    std::vector<std::pair<std::string, std::string>> parameters;
 
-            while (index < tokens.size())
+    while (!tokens.atEnd() && tokens.peek().value != ")")
+    {
+        std::string paramName = tokens.next().value;
+        std::string paramType;
+        if (tokens.peek().value == ":")
+        {
+            tokens.advance(); // skip ':'
+            int nestedAngleBrackets = 0;
+            while (!tokens.atEnd())
             {
-                const Token &currentToken = tokens[index];
-
-                if (currentToken.value == "{")
+                const std::string &value = tokens.peek().value;
+                if (value == "<")
                 {
-                    ++braceCount;
+                    nestedAngleBrackets++;
                 }
-                else if (currentToken.value == "}")
+                else if (value == ">")
                 {
-                    --braceCount;
-                    if (braceCount == 0)
-                    {
-                        ++index;
-                        break;
-                    }
+                    nestedAngleBrackets--;
                 }
-                else if (currentToken.type == "KEYWORD" && currentToken.value == "for")
+                else if (value == "," && nestedAngleBrackets == 0)
                 {
-                    ++index; // Skip 'for'
-                    std::string loopVar = tokens[index].value;
-                    std::string loopVarType = "Int"; // Assume Int for simplicity
-                    ++index;                         // Move past the variable
-                    ++index;                         // Skip 'in'
-
-                    auto rangeStart = parseExpression(tokens, index);
-
-                    // Check for the "to" keyword
-                    if (index >= tokens.size() || tokens[index].value != "to")
-                    {
-                        throw ParseException("Expected 'to' after range start expression in 'for' loop at line " +
-                                             std::to_string(tokens[index].line) + ", column " +
-                                             std::to_string(tokens[index].column) + ".");
-                    }
-                    ++index; // Skip 'to'
-
-                    // Check if rangeEnd is present after 'to'
-                    if (index >= tokens.size())
-                    {
-                        throw ParseException("Expected range end expression in 'for' loop but found end of input at line " +
-                                             std::to_string(tokens[index - 1].line) + ", column " +
-                                             std::to_string(tokens[index - 1].column) + ".");
-                    }
-                    auto rangeEnd = parseExpression(tokens, index);
-                    if (!rangeEnd)
-                    {
-                        throw ParseException("Expected range end expression in 'for' loop but found '" + tokens[index].value +
-                                             "' at line " + std::to_string(tokens[index].line) + ", column " +
-                                             std::to_string(tokens[index].column) + ".");
-                    }
-
-                    auto loopBody = std::make_unique<BlockNode>();
-                    if (index < tokens.size() && tokens[index].value == "{")
-                    {
-                        ++index; // Skip '{'
-                        int bodyBraceCount = 1;
-                        while (index < tokens.size() && bodyBraceCount > 0)
-                        {
-                            if (tokens[index].value == "{")
-                            {
-                                ++bodyBraceCount;
-                            }
-                            else if (tokens[index].value == "}")
-                            {
-                                --bodyBraceCount;
-                                if (bodyBraceCount == 0)
-                                {
-                                    break;
-                                }
-                            }
-                            else if (tokens[index].type == "IDENTIFIER")
-                            {
-                                std::string varName = tokens[index].value;
-                                if (index + 1 < tokens.size() && tokens[index + 1].value == "=")
-                                {
-                                    index += 2; // Skip '='
-                                    auto expr = parseExpression(tokens, index);
-                                    loopBody->addStatement(std::make_unique<AssignmentNode>(varName, std::move(expr)));
-                                }
-                            }
-                            if (bodyBraceCount > 0)
-                                ++index;
-                        }
-                    }
-                    body->addStatement(std::make_unique<ForLoopNode>(loopVar, loopVarType, std::move(rangeStart), std::move(rangeEnd), std::move(loopBody)));
+                    break;
                 }
-                else if (currentToken.type == "KEYWORD" && currentToken.value == "return")
+                else if (value == ")" && nestedAngleBrackets == 0)
                 {
-                    ++index; // Skip 'return'
-
-                    // Attempt to parse an expression following the 'return' keyword
-                    auto expr = parseExpression(tokens, index);
-                    body->addStatement(std::make_unique<ReturnNode>(std::move(expr)));
-
-                    // Check for semicolon after the return statement
-                    if (index < tokens.size() && tokens[index].value == ";")
-                    {
-                        ++index; // Skip the semicolon
-                    }
-                    else
-                    {
-                        throw ParseException("Expected semicolon after return statement at line " +
-                                             std::to_string(tokens[index - 1].line) + ", column " +
-                                             std::to_string(tokens[index - 1].column) + ".");
-                    }
+                    break;
                 }
+                paramType += value;
+                tokens.advance();
+            }
+        }
+        parameters.emplace_back(paramName, paramType);
+        if (tokens.peek().value == ",")
+            tokens.advance();
+    }
+    tokens.advance(); // skip ')'
 
-                else
+    // Parse return type, only if the next token is '->'
+    std::string returnType;
+    if (tokens.peek().value == "->")
+    {
+        tokens.advance(); // skip '->'
+        int nestedAngleBrackets = 0;
+        while (!tokens.atEnd())
+        {
+            const std::string &value = tokens.peek().value;
+            if (value == "<")
+            {
+                nestedAngleBrackets++;
+            }
+            else if (value == ">")
+            {
+                nestedAngleBrackets--;
+                if (nestedAngleBrackets == 0)
                 {
-                    ++index; // Move to next token
+                    returnType += value;
+                    tokens.advance();
+                    break;
                 }
             }
-
-            // Check for imbalance in braces
-            if (braceCount != 0)
+            else if (value == "{" && nestedAngleBrackets == 0)
             {
-                throw ParseException("Mismatched braces detected in function body.");
+                break;
             }
-
-            program->addFunction(std::make_unique<FunctionNode>(functionName, parameters, returnType, std::move(body)));
+            returnType += value;
+            tokens.advance();
         }
-
-        else
-        {
-            ++index; // Move to next token if it's not a function
-        }
-    }
-
-    return program;
-}
-
-int main(int argc, char *argv[])
-{
-    // Check if both input and output filenames are provided as arguments
-    if (argc < 3)
-    {
-        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file>" << std::endl;
-        return 1;
     }
 
-    // Get the input and output filenames from command-line arguments
-    std::string inputFileName = argv[1];
-    std::string outputFileName = argv[2];
-
-    // Read tokens from the input file
-    std::vector<Token> tokens = readTokensFromFile(inputFileName);
-    if (tokens.empty())
+    // Parse function body, starting with '{'; past the last token the error points at 'fn'
+    if (tokens.peek().value != "{")
     {
-        std::cerr << "No tokens found in the input file." << std::endl;
-        return 1;
+        throw ParseException("Expected '{' to open function body", tokens.peek().line > 0 ? tokens.peek() : token);
     }
+    tokens.advance(); // skip '{'
+    auto body = BodyParser(tokens).parseBlock(token);
 
-    // Parse the tokens to create an AST
-    std::unique_ptr<ProgramNode> ast = parseTokens(tokens);
+    return located(std::make_unique<FunctionNode>(functionName, parameters, returnType, std::move(body)), token);
+}
 
-    // Open the output file
-    std::ofstream outputFile(outputFileName);
-    if (!outputFile.is_open())
+std::unique_ptr<ProgramNode> parseTokens(TokenStream &tokens)
+{
+    auto program = std::make_unique<ProgramNode>();
+    while (auto function = parseNextFunction(tokens))
     {
-        std::cerr << "Failed to open output file: " << outputFileName << std::endl;
-        return 1;
+        program->addFunction(std::move(function));
     }
+    return program;
+}
 
-    // Redirect cout to the file
-    std::streambuf *coutbuf = std::cout.rdbuf();
-    std::cout.rdbuf(outputFile.rdbuf());
-
-    // Print the AST to the file
-    ast->print();
-
-    // Restore cout to its original buffer
-    std::cout.rdbuf(coutbuf);
-
-    // Close the output file
-    outputFile.close();
-
-    std::cout << "AST output has been saved to " << outputFileName << std::endl;
-
-    return 0;
-}
\ No newline at end of file
+std::unique_ptr<ProgramNode> parseTokens(const std::vector<Token> &allTokens)
+{
+    // Comments carry no meaning for the parser
+    size_t index = 0;
+    TokenStream tokens([&]()
+                       {
+        while (index < allTokens.size() && allTokens[index].type == TokenType::COMMENT)
+            ++index;
+        return index < allTokens.size() ? allTokens[index++] : endOfInput; });
+    return parseTokens(tokens);
+}
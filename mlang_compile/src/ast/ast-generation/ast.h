@@ -0,0 +1,461 @@
+#ifndef AST_H
+#define AST_H
+
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include "astformat.h"
+#include "../../lexical-analysis/lexer/lexer.h"
+#include "../../lexical-analysis/errors/diagnostics.h"
+
+// Base class for all AST nodes
+class ASTNode
+{
+public:
+    // Position of the node's first token in the MLang source; 0 when unknown
+    int line = 0;
+    int column = 0;
+
+    virtual ~ASTNode() = default;
+    virtual void print(int indentLevel = 0) const = 0; // For debugging with indentation
+
+    // Appended to statement lines of the dump so later stages can map back to the source
+    std::string location() const
+    {
+        if (line <= 0)
+            return "";
+        return " [Line: " + std::to_string(line) + ", Column: " + std::to_string(column) + "]";
+    }
+};
+
+// Represents the overall program with a list of functions
+class ProgramNode : public ASTNode
+{
+public:
+    std::vector<std::unique_ptr<ASTNode>> functions;
+
+    void addFunction(std::unique_ptr<ASTNode> func)
+    {
+        functions.push_back(std::move(func));
+    }
+
+    void print(int indentLevel = 0) const override
+    {
+        for (const auto &func : functions)
+        {
+            func->print(indentLevel);
+        }
+    }
+};
+
+// Represents a function definition
+class FunctionNode : public ASTNode
+{
+public:
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> parameters;
+    std::string returnType;
+    std::unique_ptr<ASTNode> body;
+
+    FunctionNode(const std::string &name, const std::vector<std::pair<std::string, std::string>> &params, const std::string &returnType, std::unique_ptr<ASTNode> body)
+        : name(name), parameters(params), returnType(returnType), body(std::move(body)) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "FUNCTION_DEFINITION" << location() << "\n";
+        std::cout << std::string(indentLevel + 2, ' ') << "FUNCTION_NAME: " << name << "\n";
+        std::cout << std::string(indentLevel + 2, ' ') << "RETURN_TYPE: " << returnType << "\n";
+        std::cout << std::string(indentLevel + 2, ' ') << "PARAMETERS\n";
+        for (const auto &param : parameters)
+        {
+            std::cout << std::string(indentLevel + 4, ' ') << "PARAMETER: " << param.first << " (TYPE: " << param.second << ")\n";
+        }
+        if (body)
+        {
+            body->print(indentLevel + 2);
+        }
+    }
+};
+
+// Represents a block of statements (function body, etc.)
+class BlockNode : public ASTNode
+{
+public:
+    std::vector<std::unique_ptr<ASTNode>> statements;
+
+    void addStatement(std::unique_ptr<ASTNode> stmt)
+    {
+        statements.push_back(std::move(stmt));
+    }
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "FUNCTION_BODY\n";
+        for (const auto &stmt : statements)
+        {
+            stmt->print(indentLevel + 2);
+        }
+    }
+};
+
+// Represents a variable declaration
+class VariableDeclarationNode : public ASTNode
+{
+public:
+    std::string type;
+    std::string name;
+    std::unique_ptr<ASTNode> initializer;
+
+    VariableDeclarationNode(const std::string &type, const std::string &name, std::unique_ptr<ASTNode> initializer = nullptr)
+        : type(type), name(name), initializer(std::move(initializer)) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "VARIABLE_DECLARATION" << location() << "\n";
+        std::cout << std::string(indentLevel + 2, ' ') << "IDENTIFIER: " << name << " (TYPE: " << type << ")\n";
+        if (initializer)
+        {
+            initializer->print(indentLevel + 2);
+        }
+    }
+};
+
+// Represents a function call
+class FunctionCallNode : public ASTNode
+{
+public:
+    std::string functionName;
+    std::vector<std::unique_ptr<ASTNode>> arguments;
+
+    FunctionCallNode(const std::string &functionName) : functionName(functionName) {}
+
+    void addArgument(std::unique_ptr<ASTNode> arg)
+    {
+        arguments.push_back(std::move(arg));
+    }
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "FUNCTION_CALL: " << functionName << location() << "\n";
+        if (!arguments.empty())
+        {
+            std::cout << std::string(indentLevel + 2, ' ') << "ARGUMENTS\n";
+            for (const auto &arg : arguments)
+            {
+                arg->print(indentLevel + 4);
+            }
+        }
+    }
+};
+
+// Represents a literal value (like numbers or strings)
+class LiteralNode : public ASTNode
+{
+public:
+    std::string value;
+
+    LiteralNode(const std::string &value) : value(value) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "LITERAL_VALUE: " << value << "\n";
+    }
+};
+
+// Represents an assignment statement; `index` is set for element stores such as `y[i] = ...`
+class AssignmentNode : public ASTNode
+{
+public:
+    std::string variableName;
+    std::unique_ptr<ASTNode> expression;
+    std::unique_ptr<ASTNode> index;
+
+    AssignmentNode(const std::string &variableName, std::unique_ptr<ASTNode> expression, std::unique_ptr<ASTNode> index = nullptr)
+        : variableName(variableName), expression(std::move(expression)), index(std::move(index)) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "ASSIGNMENT_EXPRESSION" << location() << "\n";
+        std::cout << std::string(indentLevel + 2, ' ') << "IDENTIFIER: " << variableName << "\n";
+        if (index)
+        {
+            std::cout << std::string(indentLevel + 2, ' ') << "INDEX\n";
+            index->print(indentLevel + 4);
+        }
+        std::cout << std::string(indentLevel + 2, ' ') << "EXPRESSION\n";
+        if (expression)
+        {
+            expression->print(indentLevel + 4);
+        }
+    }
+};
+
+class BinaryOperatorNode : public ASTNode
+{
+public:
+    std::string op;
+    std::unique_ptr<ASTNode> left;
+    std::unique_ptr<ASTNode> right;
+
+    BinaryOperatorNode(const std::string &op, std::unique_ptr<ASTNode> left, std::unique_ptr<ASTNode> right)
+        : op(op), left(std::move(left)), right(std::move(right)) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "OPERATOR: " << op << "\n";
+        left->print(indentLevel + 2);
+        right->print(indentLevel + 2);
+    }
+};
+
+class UnaryOperatorNode : public ASTNode
+{
+public:
+    std::string op;
+    std::unique_ptr<ASTNode> operand;
+
+    UnaryOperatorNode(const std::string &op, std::unique_ptr<ASTNode> operand)
+        : op(op), operand(std::move(operand)) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "UNARY_OPERATOR: " << op << "\n";
+        operand->print(indentLevel + 2);
+    }
+};
+
+// Represents element access such as `x[i]`
+class IndexNode : public ASTNode
+{
+public:
+    std::unique_ptr<ASTNode> base;
+    std::unique_ptr<ASTNode> index;
+
+    IndexNode(std::unique_ptr<ASTNode> base, std::unique_ptr<ASTNode> index)
+        : base(std::move(base)), index(std::move(index)) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "INDEX_EXPRESSION\n";
+        base->print(indentLevel + 2);
+        index->print(indentLevel + 2);
+    }
+};
+
+// Represents a field such as `data.rows`
+class MemberAccessNode : public ASTNode
+{
+public:
+    std::unique_ptr<ASTNode> object;
+    std::string member;
+
+    MemberAccessNode(std::unique_ptr<ASTNode> object, const std::string &member)
+        : object(std::move(object)), member(member) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "MEMBER_ACCESS: " << member << "\n";
+        object->print(indentLevel + 2);
+    }
+};
+
+// Represents a method call such as `data.transpose()`; the object is printed before the arguments
+class MethodCallNode : public ASTNode
+{
+public:
+    std::unique_ptr<ASTNode> object;
+    std::string method;
+    std::vector<std::unique_ptr<ASTNode>> arguments;
+
+    MethodCallNode(std::unique_ptr<ASTNode> object, const std::string &method)
+        : object(std::move(object)), method(method) {}
+
+    void addArgument(std::unique_ptr<ASTNode> arg)
+    {
+        arguments.push_back(std::move(arg));
+    }
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "METHOD_CALL: " << method << location() << "\n";
+        object->print(indentLevel + 2);
+        if (!arguments.empty())
+        {
+            std::cout << std::string(indentLevel + 2, ' ') << "ARGUMENTS\n";
+            for (const auto &arg : arguments)
+            {
+                arg->print(indentLevel + 4);
+            }
+        }
+    }
+};
+
+// Represents a vector literal such as `[1.0, 2.0, 3.0]`
+class VectorLiteralNode : public ASTNode
+{
+public:
+    std::vector<std::unique_ptr<ASTNode>> elements;
+
+    void addElement(std::unique_ptr<ASTNode> element)
+    {
+        elements.push_back(std::move(element));
+    }
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "VECTOR_LITERAL\n";
+        for (const auto &element : elements)
+        {
+            element->print(indentLevel + 2);
+        }
+    }
+};
+
+// Represents a range in a for loop
+class ForLoopNode : public ASTNode
+{
+public:
+    std::string loopVar;
+    std::string loopVarType;
+    std::unique_ptr<ASTNode> rangeStart;
+    std::unique_ptr<ASTNode> rangeEnd;
+    std::unique_ptr<ASTNode> body;
+
+    ForLoopNode(const std::string &loopVar, const std::string &loopVarType,
+                std::unique_ptr<ASTNode> rangeStart, std::unique_ptr<ASTNode> rangeEnd,
+                std::unique_ptr<ASTNode> body)
+        : loopVar(loopVar), loopVarType(loopVarType), rangeStart(std::move(rangeStart)),
+          rangeEnd(std::move(rangeEnd)), body(std::move(body)) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "FOR_LOOP" << location() << "\n";
+        std::cout << std::string(indentLevel + 2, ' ') << "LOOP_VARIABLE: " << loopVar << " (TYPE: " << loopVarType << ")\n";
+        printBound("RANGE_START", *rangeStart, indentLevel + 2);
+        printBound("RANGE_END", *rangeEnd, indentLevel + 2);
+        std::cout << std::string(indentLevel + 2, ' ') << "LOOP_BODY\n";
+        body->print(indentLevel + 4);
+    }
+
+private:
+    // A single literal stays on the RANGE line; compound bounds are nested below it
+    static void printBound(const char *label, const ASTNode &bound, int indentLevel)
+    {
+        std::cout << std::string(indentLevel, ' ') << label;
+        if (dynamic_cast<const LiteralNode *>(&bound))
+        {
+            std::cout << ": ";
+            bound.print(0);
+        }
+        else
+        {
+            std::cout << "\n";
+            bound.print(indentLevel + 2);
+        }
+    }
+};
+
+class ReturnNode : public ASTNode
+{
+public:
+    std::unique_ptr<ASTNode> expression;
+
+    ReturnNode(std::unique_ptr<ASTNode> expr) : expression(std::move(expr)) {}
+
+    void print(int indentLevel = 0) const override
+    {
+        std::cout << std::string(indentLevel, ' ') << "RETURN_STATEMENT" << location() << "\n";
+        if (expression)
+        {
+            expression->print(indentLevel + 2);
+        }
+    }
+};
+
+class ParseException : public std::runtime_error
+{
+public:
+    std::string message;
+    int line = 0;
+    int column = 0;
+
+    ParseException(const std::string &message) : std::runtime_error(message), message(message) {}
+    ParseException(const std::string &message, const Token &token)
+        : std::runtime_error(message + " at line " + std::to_string(token.line) + ", column " + std::to_string(token.column) + "."),
+          message(message), line(token.line), column(token.column) {}
+};
+
+// Reads the lexer's output file one token at a time; malformed lines are reported and skipped
+class TokenFileReader
+{
+public:
+    // Reports a file that cannot be opened
+    TokenFileReader(const std::string &fileName, Diagnostics &diagnostics);
+
+    bool isOpen() const { return file.is_open(); }
+    // False at the end of the file
+    bool next(Token &token);
+    size_t tokensRead() const { return count; }
+    // Reports a file without tokens, otherwise prints the count; false if there were none
+    bool reportCount();
+
+private:
+    std::ifstream file;
+    Diagnostics &diagnostics;
+    uint32_t fileId;
+    std::regex tokenPattern;
+    int lineNumber = 0;
+    size_t count = 0;
+};
+
+// Writes functions in the binary AST format (astformat.h) as they are parsed, so a program
+// never has to be held whole. The header and the string table are filled in by finish().
+class BinaryASTWriter
+{
+public:
+    // out must be seekable, e.g. a file or string stream
+    explicit BinaryASTWriter(std::ostream &out);
+
+    void add(const FunctionNode &function);
+    // False if writing failed
+    bool finish();
+
+private:
+    std::ostream &out;
+    std::streampos start;
+    // Nodes of the function being added, and the ones among them whose children are being written
+    std::vector<BinaryASTNode> nodes;
+    std::vector<size_t> open;
+    std::unordered_map<std::string, uint32_t> stringIds;
+    std::vector<const std::string *> strings;
+    uint32_t nodeCount = 1;
+    uint32_t functionCount = 0;
+
+    uint32_t intern(const std::string &value);
+    void begin(ASTKind kind, const std::string &value = "", const ASTNode *source = nullptr);
+    void end();
+    void leaf(ASTKind kind, const std::string &value = "", const ASTNode *source = nullptr);
+    void write(const ASTNode &node);
+};
+
+// Function to read tokens from the lexer file
+std::vector<Token> readTokensFromFile(const std::string &fileName, Diagnostics &diagnostics);
+
+// Comment-free token streams for the parser, pulled from the lexer or a token file as parsing proceeds
+TokenStream parserTokens(Lexer &lexer);
+TokenStream parserTokens(TokenFileReader &reader);
+
+// Parses a full expression (precedence climbing over + - * /) starting at tokens[index]
+std::unique_ptr<ASTNode> parseExpression(const std::vector<Token> &tokens, size_t &index);
+// Parses the next top-level function, skipping other tokens before it; null at the end of input.
+// Taking a program one function at a time keeps only that function's tokens and AST in memory.
+std::unique_ptr<FunctionNode> parseNextFunction(TokenStream &tokens);
+std::unique_ptr<ProgramNode> parseTokens(TokenStream &tokens);
+std::unique_ptr<ProgramNode> parseTokens(const std::vector<Token> &tokens);
+
+#endif
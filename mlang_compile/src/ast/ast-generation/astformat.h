@@ -0,0 +1,91 @@
+#ifndef AST_FORMAT_H
+#define AST_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary AST format, written by the parser (BinaryASTWriter in ast.cpp) and mapped by code
+// generation (parseBinaryAST in ir.cpp). It holds the same tree as the indented text dump,
+// without the dump's re-parsing, so string literals may contain any character.
+//
+// All fields are little-endian. The file is a 32-byte header followed by nodeCount node
+// records in pre-order, and then the string table at stringsOffset. Node 0 is the ROOT, and
+// each node's childCount children follow it, each one with its own subtree. The string table
+// holds stringCount + 1 u32 offsets, then the UTF-8 bytes of every string, with string i
+// occupying bytes [offset[i], offset[i + 1]). String 0 is empty.
+
+const char BINARY_AST_MAGIC[4] = {'M', 'L', 'A', 'B'};
+const uint32_t BINARY_AST_VERSION = 1;
+
+struct BinaryASTHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t stringCount;
+    uint64_t stringsOffset;
+    // Total size, so a truncated file is rejected
+    uint64_t fileBytes;
+};
+
+struct BinaryASTNode
+{
+    uint16_t kind;
+    uint16_t reserved;
+    // String table index of the node's value
+    uint32_t value;
+    uint32_t childCount;
+    // Source position of the node's first token; 0 for nodes without one
+    int32_t line;
+    int32_t column;
+};
+
+static_assert(sizeof(BinaryASTHeader) == 32, "binary AST header layout");
+static_assert(sizeof(BinaryASTNode) == 20, "binary AST node layout");
+
+// Node kinds; the names are the node types of the text dump. New kinds go at the end.
+enum class ASTKind : uint16_t
+{
+    ROOT,
+    FUNCTION_DEFINITION,
+    FUNCTION_NAME,
+    RETURN_TYPE,
+    PARAMETERS,
+    PARAMETER,
+    FUNCTION_BODY,
+    VARIABLE_DECLARATION,
+    IDENTIFIER,
+    FUNCTION_CALL,
+    ARGUMENTS,
+    LITERAL_VALUE,
+    ASSIGNMENT_EXPRESSION,
+    INDEX,
+    EXPRESSION,
+    OPERATOR,
+    UNARY_OPERATOR,
+    INDEX_EXPRESSION,
+    MEMBER_ACCESS,
+    METHOD_CALL,
+    VECTOR_LITERAL,
+    FOR_LOOP,
+    LOOP_VARIABLE,
+    RANGE_START,
+    RANGE_END,
+    LOOP_BODY,
+    RETURN_STATEMENT,
+    COUNT
+};
+
+inline const char *astKindName(ASTKind kind)
+{
+    static const char *const names[] = {
+        "ROOT", "FUNCTION_DEFINITION", "FUNCTION_NAME", "RETURN_TYPE", "PARAMETERS", "PARAMETER",
+        "FUNCTION_BODY", "VARIABLE_DECLARATION", "IDENTIFIER", "FUNCTION_CALL", "ARGUMENTS",
+        "LITERAL_VALUE", "ASSIGNMENT_EXPRESSION", "INDEX", "EXPRESSION", "OPERATOR", "UNARY_OPERATOR",
+        "INDEX_EXPRESSION", "MEMBER_ACCESS", "METHOD_CALL", "VECTOR_LITERAL", "FOR_LOOP",
+        "LOOP_VARIABLE", "RANGE_START", "RANGE_END", "LOOP_BODY", "RETURN_STATEMENT"};
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(ASTKind::COUNT), "a name per kind");
+    return names[static_cast<size_t>(kind)];
+}
+
+#endif
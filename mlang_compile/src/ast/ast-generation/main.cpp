@@ -0,0 +1,140 @@
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include "ast.h"
+
+int main(int argc, char *argv[])
+{
+    // Check if both input and output filenames are provided as arguments
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file>"
+                  << " [--source-name NAME] [--diagnostics-format text|json|sarif] [--max-errors N] [--binary FILE]" << std::endl;
+        return 1;
+    }
+
+    // Get the input and output filenames from command-line arguments
+    std::string inputFileName = argv[1];
+    std::string outputFileName = argv[2];
+    std::string sourceName = inputFileName;
+    // Optional second output in the binary AST format, which code generation reads without re-parsing text
+    std::string binaryFileName;
+    DiagnosticFormat format = DiagnosticFormat::TEXT;
+    Diagnostics diagnostics;
+
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (option == "--source-name")
+            sourceName = argv[i + 1];
+        else if (option == "--binary")
+            binaryFileName = argv[i + 1];
+        else if (option == "--max-errors")
+            diagnostics.setMaxPerFile(std::stoul(argv[i + 1]));
+        else if (option != "--diagnostics-format" || !Diagnostics::parseFormat(argv[i + 1], format))
+        {
+            std::cerr << "Unknown option: " << option << " " << argv[i + 1] << std::endl;
+            return 1;
+        }
+    }
+
+    TokenFileReader reader(inputFileName, diagnostics);
+    if (!reader.isOpen())
+    {
+        diagnostics.flush(std::cerr, format);
+        return 1;
+    }
+
+    // Functions are parsed and printed one at a time as tokens are read, so memory stays
+    // bounded by the largest function. They go to temporary files that replace the outputs
+    // only once the whole program has parsed.
+    std::string partialFileName = outputFileName + ".partial";
+    std::string partialBinaryName = binaryFileName + ".partial";
+    std::ofstream outputFile(partialFileName);
+    if (!outputFile.is_open())
+    {
+        std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+        return 1;
+    }
+    std::ofstream binaryFile;
+    if (!binaryFileName.empty())
+    {
+        binaryFile.open(partialBinaryName, std::ios::binary);
+        if (!binaryFile.is_open())
+        {
+            outputFile.close();
+            std::remove(partialFileName.c_str());
+            std::cerr << "Failed to open output file: " << binaryFileName << std::endl;
+            return 1;
+        }
+    }
+    std::unique_ptr<BinaryASTWriter> binary = binaryFileName.empty() ? nullptr : std::make_unique<BinaryASTWriter>(binaryFile);
+    auto discardOutputs = [&]()
+    {
+        outputFile.close();
+        std::remove(partialFileName.c_str());
+        if (binary)
+        {
+            binaryFile.close();
+            std::remove(partialBinaryName.c_str());
+        }
+    };
+
+    // Redirect cout to the file
+    std::streambuf *coutbuf = std::cout.rdbuf();
+    std::cout.rdbuf(outputFile.rdbuf());
+
+    // Parse the tokens to create an AST; parse errors are located in the original source
+    TokenStream tokens = parserTokens(reader);
+    try
+    {
+        while (auto function = parseNextFunction(tokens))
+        {
+            function->print();
+            if (binary)
+                binary->add(*function);
+        }
+    }
+    catch (const ParseException &e)
+    {
+        std::cout.rdbuf(coutbuf);
+        discardOutputs();
+        diagnostics.error(diagnostics.addFile(sourceName), DiagnosticCode::PARSE_ERROR,
+                          {e.line, e.column, e.line, e.column + 1}, e.message);
+        diagnostics.flush(std::cerr, format);
+        return 1;
+    }
+
+    // Restore cout to its original buffer
+    std::cout.rdbuf(coutbuf);
+
+    if (!reader.reportCount())
+    {
+        discardOutputs();
+        diagnostics.flush(std::cerr, format);
+        return 1;
+    }
+    if (binary && !binary->finish())
+    {
+        discardOutputs();
+        std::cerr << "Failed to write output file: " << binaryFileName << std::endl;
+        return 1;
+    }
+
+    // Close the output files
+    outputFile.close();
+    binaryFile.close();
+
+    if (std::rename(partialFileName.c_str(), outputFileName.c_str()) != 0 ||
+        (binary && std::rename(partialBinaryName.c_str(), binaryFileName.c_str()) != 0))
+    {
+        discardOutputs();
+        std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+        return 1;
+    }
+
+    std::cout << "AST output has been saved to " << outputFileName << std::endl;
+
+    diagnostics.flush(std::cerr, format);
+    return 0;
+}
\ No newline at end of file
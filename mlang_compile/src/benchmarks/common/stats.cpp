@@ -0,0 +1,224 @@
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+double studentT95(size_t degreesOfFreedom)
+{
+    static const double table[] = {
+        0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+    if (degreesOfFreedom == 0)
+        return 0.0;
+    if (degreesOfFreedom <= 30)
+        return table[degreesOfFreedom];
+    if (degreesOfFreedom <= 60)
+        return 2.000;
+    if (degreesOfFreedom <= 120)
+        return 1.980;
+    return 1.960;
+}
+
+SampleStats summarize(const std::vector<double> &samples)
+{
+    SampleStats stats;
+    stats.count = samples.size();
+    if (samples.empty())
+        return stats;
+
+    double sum = 0.0;
+    for (double sample : samples)
+    {
+        sum += sample;
+    }
+    stats.mean = sum / samples.size();
+    stats.min = *std::min_element(samples.begin(), samples.end());
+    stats.max = *std::max_element(samples.begin(), samples.end());
+
+    if (samples.size() > 1)
+    {
+        double squares = 0.0;
+        for (double sample : samples)
+        {
+            squares += (sample - stats.mean) * (sample - stats.mean);
+        }
+        stats.stddev = std::sqrt(squares / (samples.size() - 1));
+    }
+
+    double halfWidth = studentT95(samples.size() - 1) * stats.stddev / std::sqrt(static_cast<double>(samples.size()));
+    stats.ciLow = stats.mean - halfWidth;
+    stats.ciHigh = stats.mean + halfWidth;
+    return stats;
+}
+
+void JsonWriter::newline()
+{
+    out << "\n"
+        << std::string(firstInScope.size() * 2, ' ');
+}
+
+void JsonWriter::separator()
+{
+    if (afterKey)
+    {
+        afterKey = false;
+        return;
+    }
+    if (!firstInScope.empty())
+    {
+        if (!firstInScope.back())
+            out << ",";
+        firstInScope.back() = false;
+        newline();
+    }
+}
+
+void JsonWriter::beginObject()
+{
+    separator();
+    out << "{";
+    firstInScope.push_back(true);
+}
+
+void JsonWriter::endObject()
+{
+    bool empty = firstInScope.back();
+    firstInScope.pop_back();
+    if (!empty)
+        newline();
+    out << "}";
+    if (firstInScope.empty())
+        out << "\n";
+}
+
+void JsonWriter::beginArray()
+{
+    separator();
+    out << "[";
+    firstInScope.push_back(true);
+}
+
+void JsonWriter::endArray()
+{
+    bool empty = firstInScope.back();
+    firstInScope.pop_back();
+    if (!empty)
+        newline();
+    out << "]";
+}
+
+void JsonWriter::key(const std::string &name)
+{
+    separator();
+    quoted(name);
+    out << ": ";
+    afterKey = true;
+}
+
+void JsonWriter::value(const std::string &text)
+{
+    separator();
+    quoted(text);
+}
+
+void JsonWriter::quoted(const std::string &text)
+{
+    out << '"';
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"':
+            out << "\\\"";
+            break;
+        case '\\':
+            out << "\\\\";
+            break;
+        case '\n':
+            out << "\\n";
+            break;
+        case '\t':
+            out << "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                std::ostringstream escaped;
+                escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+                out << escaped.str();
+            }
+            else
+            {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+void JsonWriter::value(const char *text)
+{
+    value(std::string(text));
+}
+
+void JsonWriter::value(double number)
+{
+    separator();
+    if (!std::isfinite(number))
+    {
+        out << "null";
+        return;
+    }
+    std::ostringstream formatted;
+    formatted << std::setprecision(9) << number;
+    out << formatted.str();
+}
+
+void JsonWriter::value(long long number)
+{
+    separator();
+    out << number;
+}
+
+void JsonWriter::value(bool flag)
+{
+    separator();
+    out << (flag ? "true" : "false");
+}
+
+void JsonWriter::stats(const SampleStats &stats)
+{
+    beginObject();
+    key("mean");
+    value(stats.mean);
+    key("stddev");
+    value(stats.stddev);
+    key("min");
+    value(stats.min);
+    key("max");
+    value(stats.max);
+    key("ci95");
+    beginArray();
+    value(stats.ciLow);
+    value(stats.ciHigh);
+    endArray();
+    key("samples");
+    value(stats.count);
+    endObject();
+}
+
+std::vector<std::string> splitList(const std::string &list, char delim)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, delim))
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
@@ -0,0 +1,106 @@
+#ifndef BENCH_STATS_H
+#define BENCH_STATS_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Summary of repeated timing samples with a 95% confidence interval on the mean
+struct SampleStats
+{
+    size_t count = 0;
+    double mean = 0.0;
+    double stddev = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double ciLow = 0.0;
+    double ciHigh = 0.0;
+};
+
+SampleStats summarize(const std::vector<double> &samples);
+
+// Two-sided 95% critical value of Student's t distribution
+double studentT95(size_t degreesOfFreedom);
+
+// Runs fn warmup + iterations times and returns the wall time of each measured run in seconds
+template <typename Fn>
+std::vector<double> timeIterations(int warmup, int iterations, Fn &&fn)
+{
+    for (int i = 0; i < warmup; ++i)
+    {
+        fn();
+    }
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double>(end - start).count());
+    }
+    return samples;
+}
+
+// The same, with setup() run untimed before every call, e.g. to give a pass that rewrites its
+// input a fresh copy each time
+template <typename Setup, typename Fn>
+std::vector<double> timeIterations(int warmup, int iterations, Setup &&setup, Fn &&fn)
+{
+    for (int i = 0; i < warmup; ++i)
+    {
+        setup();
+        fn();
+    }
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; ++i)
+    {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double>(end - start).count());
+    }
+    return samples;
+}
+
+// Minimal streaming JSON writer; takes care of commas and indentation
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::ostream &out) : out(out) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const std::string &name);
+
+    void value(const std::string &text);
+    void value(const char *text);
+    void value(double number);
+    void value(long long number);
+    void value(int number) { value(static_cast<long long>(number)); }
+    void value(size_t number) { value(static_cast<long long>(number)); }
+    void value(bool flag);
+
+    // Writes {"mean", "stddev", "min", "max", "ci95": [low, high], "samples"}
+    void stats(const SampleStats &stats);
+
+private:
+    std::ostream &out;
+    std::vector<bool> firstInScope;
+    bool afterKey = false;
+
+    void separator();
+    void newline();
+    void quoted(const std::string &text);
+};
+
+std::vector<std::string> splitList(const std::string &list, char delim = ',');
+
+#endif
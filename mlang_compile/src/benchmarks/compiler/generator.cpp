@@ -0,0 +1,192 @@
+#include "generator.h"
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+std::vector<SourceShape> defaultShapes()
+{
+    std::vector<SourceShape> shapes(5);
+
+    shapes[0].name = "mixed";
+
+    shapes[1].name = "deep_nesting";
+    shapes[1].nestingDepth = 24;
+    shapes[1].linesPerFunction = 200;
+
+    shapes[2].name = "long_identifiers";
+    shapes[2].identifierLength = 64;
+
+    shapes[3].name = "many_functions";
+    shapes[3].nestingDepth = 1;
+    shapes[3].linesPerFunction = 8;
+
+    shapes[4].name = "heavy_comments";
+    shapes[4].commentRatio = 0.6;
+
+    return shapes;
+}
+
+namespace
+{
+class SourceBuilder
+{
+public:
+    SourceBuilder(const SourceShape &shape, unsigned seed) : shape(shape), rng(seed) {}
+
+    std::string build(size_t lines)
+    {
+        int functionIndex = 0;
+        while (lineCount < lines)
+        {
+            size_t remaining = lines - lineCount;
+            size_t budget = std::max<size_t>(std::min<size_t>(shape.linesPerFunction, remaining), 6);
+            emitFunction(functionIndex++, budget);
+        }
+        return out.str();
+    }
+
+private:
+    const SourceShape &shape;
+    std::mt19937 rng;
+    std::ostringstream out;
+    size_t lineCount = 0;
+    std::vector<std::string> locals;
+    std::vector<std::string> params;
+
+    bool chance(double probability)
+    {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < probability;
+    }
+
+    int pick(int count)
+    {
+        return std::uniform_int_distribution<int>(0, count - 1)(rng);
+    }
+
+    std::string identifier(const std::string &base, int index)
+    {
+        static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+        std::string name = base + "_" + std::to_string(index);
+        while (static_cast<int>(name.size()) < shape.identifierLength)
+        {
+            name += alphabet[pick(sizeof(alphabet) - 1)];
+        }
+        return name;
+    }
+
+    void line(int depth, const std::string &text)
+    {
+        out << std::string(depth * 4, ' ') << text << "\n";
+        ++lineCount;
+    }
+
+    std::string comment()
+    {
+        static const char *phrases[] = {
+            "// Gradient step over the current batch",
+            "// Accumulate the loss for this sample",
+            "// Matrix multiplication of features and weights",
+            "// TODO: revisit the learning rate schedule",
+            "// Normalize the intermediate result before the update"};
+        return phrases[pick(5)];
+    }
+
+    std::string operand()
+    {
+        if (chance(0.25))
+        {
+            return std::to_string(pick(100)) + "." + std::to_string(pick(10));
+        }
+        if (chance(0.3))
+        {
+            return params[pick(params.size())];
+        }
+        return locals[pick(locals.size())];
+    }
+
+    std::string expression()
+    {
+        static const char *operators[] = {"+", "-", "*", "/"};
+        std::string expr = operand();
+        int terms = 1 + pick(3);
+        for (int i = 0; i < terms; ++i)
+        {
+            expr += std::string(" ") + operators[pick(4)] + " " + operand();
+        }
+        return expr;
+    }
+
+    std::string statement()
+    {
+        std::string text = locals[pick(locals.size())] + " = " + expression() + ";";
+        if (chance(shape.commentRatio / 2))
+        {
+            text += "  " + comment();
+        }
+        return text;
+    }
+
+    // Emits a loop nest of the configured depth; returns once `budget` lines are used
+    void emitLoopNest(int depth, size_t budget)
+    {
+        int nesting = std::max(1, std::min<int>(shape.nestingDepth, static_cast<int>(budget / 2) - 1));
+        for (int level = 0; level < nesting; ++level)
+        {
+            line(depth + level, "for " + identifier("i", level) + " in 0 to " + params.back() + " {");
+        }
+        size_t statements = std::max<size_t>(1, budget - 2 * nesting);
+        for (size_t i = 0; i < statements; ++i)
+        {
+            if (chance(shape.commentRatio))
+                line(depth + nesting, comment());
+            else
+                line(depth + nesting, statement());
+        }
+        for (int level = nesting - 1; level >= 0; --level)
+        {
+            line(depth + level, "}");
+        }
+    }
+
+    void emitFunction(int index, size_t budget)
+    {
+        params = {identifier("alpha", index), identifier("beta", index), identifier("count", index)};
+        locals.clear();
+        for (int i = 0; i < 4; ++i)
+        {
+            locals.push_back(identifier("value", i));
+        }
+
+        size_t start = lineCount;
+        line(0, "fn " + identifier("compute", index) + "(" + params[0] + ": Float, " + params[1] +
+                    ": Vector<Float>, " + params[2] + ": Int) -> Float {");
+        for (const auto &local : locals)
+        {
+            if (lineCount - start + 3 >= budget)
+                break;
+            line(1, local + ": Float = " + std::to_string(pick(10)) + ".0;");
+        }
+
+        while (lineCount - start + 2 < budget)
+        {
+            size_t remaining = budget - (lineCount - start) - 2;
+            if (remaining < 3 || chance(shape.commentRatio))
+            {
+                line(1, remaining < 3 && !chance(shape.commentRatio) ? statement() : comment());
+                continue;
+            }
+            size_t nestLines = std::min<size_t>(remaining, 2 * shape.nestingDepth + 2 + pick(4));
+            emitLoopNest(1, nestLines);
+        }
+
+        line(1, "return " + locals[0] + " + " + params[0] + ";");
+        line(0, "}");
+    }
+};
+}
+
+std::string generateSource(const SourceShape &shape, size_t lines, unsigned seed)
+{
+    SourceBuilder builder(shape, seed);
+    return builder.build(lines);
+}
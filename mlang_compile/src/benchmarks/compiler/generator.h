@@ -0,0 +1,23 @@
+#ifndef BENCH_GENERATOR_H
+#define BENCH_GENERATOR_H
+
+#include <string>
+#include <vector>
+
+// Describes the shape of a synthetic MLang program
+struct SourceShape
+{
+    std::string name;
+    int nestingDepth = 2;      // depth of nested 'for' loops inside each function
+    int identifierLength = 8;  // minimum length of generated identifiers
+    int linesPerFunction = 40; // function size, controls how many functions a file holds
+    double commentRatio = 0.1; // fraction of lines that are comments
+};
+
+// The stock shapes: mixed, deep_nesting, long_identifiers, many_functions, heavy_comments
+std::vector<SourceShape> defaultShapes();
+
+// Produces a lexically and syntactically valid program of roughly `lines` lines
+std::string generateSource(const SourceShape &shape, size_t lines, unsigned seed);
+
+#endif
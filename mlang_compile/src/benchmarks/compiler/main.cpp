@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "generator.h"
+#include "../common/stats.h"
+#include "../../lexical-analysis/lexer/lexer.h"
+#include "../../ast/ast-generation/ast.h"
+#include "../../code-generation/codegen.h"
+#include "../../code-generation/cse.h"
+#include "../../code-generation/deadcode.h"
+#include "../../code-generation/inliner.h"
+
+struct BenchmarkOptions
+{
+    std::vector<size_t> sizes = {1000, 10000, 100000};
+    std::vector<std::string> shapes;
+    int iterations = 5;
+    int warmup = 1;
+    unsigned seed = 42;
+    std::string outputFile;
+    SourceShape custom;
+    bool hasCustom = false;
+};
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --sizes N,N,...        line counts to generate (default 1000,10000,100000; up to 10000000)\n"
+              << "  --shapes a,b,...       subset of: mixed, deep_nesting, long_identifiers, many_functions, heavy_comments\n"
+              << "  --iterations N         timed iterations per phase (default 5)\n"
+              << "  --warmup N             untimed warmup iterations (default 1)\n"
+              << "  --seed N               generator seed (default 42)\n"
+              << "  --nesting N            add a 'custom' shape with this loop nesting depth\n"
+              << "  --ident-len N          ... identifier length\n"
+              << "  --function-lines N     ... lines per function\n"
+              << "  --comment-ratio R      ... fraction of comment lines\n"
+              << "  --output FILE          write JSON to FILE instead of stdout\n";
+}
+
+static bool parseOptions(int argc, char *argv[], BenchmarkOptions &options)
+{
+    options.custom.name = "custom";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string next = argv[++i];
+        if (arg == "--sizes")
+        {
+            options.sizes.clear();
+            for (const auto &size : splitList(next))
+            {
+                options.sizes.push_back(std::stoull(size));
+            }
+        }
+        else if (arg == "--shapes")
+            options.shapes = splitList(next);
+        else if (arg == "--iterations")
+            options.iterations = std::max(1, std::stoi(next));
+        else if (arg == "--warmup")
+            options.warmup = std::max(0, std::stoi(next));
+        else if (arg == "--seed")
+            options.seed = static_cast<unsigned>(std::stoul(next));
+        else if (arg == "--output")
+            options.outputFile = next;
+        else if (arg == "--nesting")
+            options.custom.nestingDepth = std::stoi(next), options.hasCustom = true;
+        else if (arg == "--ident-len")
+            options.custom.identifierLength = std::stoi(next), options.hasCustom = true;
+        else if (arg == "--function-lines")
+            options.custom.linesPerFunction = std::stoi(next), options.hasCustom = true;
+        else if (arg == "--comment-ratio")
+            options.custom.commentRatio = std::stod(next), options.hasCustom = true;
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Per-iteration throughput derived from the timing samples
+static std::vector<double> rates(const std::vector<double> &seconds, double amount)
+{
+    std::vector<double> result;
+    for (double s : seconds)
+    {
+        result.push_back(s > 0.0 ? amount / s : 0.0);
+    }
+    return result;
+}
+
+static void writePhase(JsonWriter &json, const std::string &name, const std::vector<double> &seconds,
+                       size_t lines, size_t bytes)
+{
+    json.key(name);
+    json.beginObject();
+    json.key("seconds");
+    json.stats(summarize(seconds));
+    json.key("lines_per_second");
+    json.stats(summarize(rates(seconds, static_cast<double>(lines))));
+    json.key("megabytes_per_second");
+    json.stats(summarize(rates(seconds, bytes / 1e6)));
+    json.endObject();
+}
+
+static void runCase(JsonWriter &json, const SourceShape &shape, size_t lines, const BenchmarkOptions &options)
+{
+    std::string source = generateSource(shape, lines, options.seed);
+    size_t actualLines = std::count(source.begin(), source.end(), '\n');
+
+    // Each phase consumes the output of the previous one, produced once up front
+    Diagnostics diagnostics;
+    std::vector<Token> tokens = Lexer(source, shape.name, diagnostics).tokenize();
+    std::unique_ptr<ProgramNode> program = parseTokens(tokens);
+
+    auto dumpAST = [&program]()
+    {
+        std::ostringstream dump;
+        std::streambuf *coutbuf = std::cout.rdbuf(dump.rdbuf());
+        program->print();
+        std::cout.rdbuf(coutbuf);
+        return dump.str();
+    };
+    std::string astText = dumpAST();
+    auto writeBinaryAST = [&program]()
+    {
+        std::ostringstream binary;
+        BinaryASTWriter writer(binary);
+        for (const auto &function : program->functions)
+            writer.add(static_cast<const FunctionNode &>(*function));
+        writer.finish();
+        return binary.str();
+    };
+    std::string astBinary = writeBinaryAST();
+
+    auto lexSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                     { Lexer(source, shape.name, diagnostics).tokenize(); });
+    // Chunked lexing on every core must reproduce the sequential tokens exactly
+    std::vector<Token> parallelTokens = Lexer(source, shape.name, diagnostics).tokenizeParallel();
+    bool parallelMatches = std::equal(tokens.begin(), tokens.end(), parallelTokens.begin(), parallelTokens.end(),
+                                      [](const Token &a, const Token &b)
+                                      { return a.type == b.type && a.value == b.value && a.line == b.line && a.column == b.column; });
+    auto lexParallelSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                             { Lexer(source, shape.name, diagnostics).tokenizeParallel(); });
+    auto parseSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                       { parseTokens(tokens); });
+    // Lexing and parsing fused through a token stream, one function in memory at a time
+    size_t streamedFunctions = 0;
+    auto streamSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                        {
+        Lexer lexer(source, shape.name, diagnostics);
+        TokenStream stream = parserTokens(lexer);
+        streamedFunctions = 0;
+        while (parseNextFunction(stream))
+            ++streamedFunctions; });
+    auto dumpSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                      { dumpAST(); });
+    auto binaryWriteSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                             { writeBinaryAST(); });
+    // Reading the tree back from each format, as code generation does before generating
+    auto readSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                      {
+        std::istringstream input(astText);
+        delete parseASTFromStream(input); });
+    auto binaryReadSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                            { delete parseBinaryAST(astBinary.data(), astBinary.size()); });
+    // Inlining, CSE and dead code elimination over the whole program, as code generation runs them
+    // before generating, on the tree left after unreachable functions are dropped. The passes
+    // rewrite the tree, so every run gets a fresh copy of its input, made outside the timer; each
+    // pass's input is the previous pass's output.
+    IRNode *parsed = parseBinaryAST(astBinary.data(), astBinary.size());
+    removeUnreachableFunctions(parsed, DeadCodeOptions());
+    IRNode *inlined = cloneTree(parsed);
+    inlineFunctions(inlined, InlineOptions());
+    IRNode *shared = cloneTree(inlined);
+    eliminateCommonSubexpressions(shared);
+    IRNode *work = nullptr;
+    auto fresh = [&work](const IRNode *input)
+    {
+        return [&work, input]()
+        {
+            delete work;
+            work = cloneTree(input);
+        };
+    };
+    auto inlineSeconds = timeIterations(options.warmup, options.iterations, fresh(parsed), [&]()
+                                        { inlineFunctions(work, InlineOptions()); });
+    auto cseSeconds = timeIterations(options.warmup, options.iterations, fresh(inlined), [&]()
+                                     { eliminateCommonSubexpressions(work); });
+    auto dceSeconds = timeIterations(options.warmup, options.iterations, fresh(shared), [&]()
+                                     { eliminateDeadCode(work, DeadCodeOptions()); });
+    delete work;
+    delete parsed;
+    delete inlined;
+    delete shared;
+    size_t pythonBytes = 0;
+    auto codegenSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                         {
+        std::istringstream input(astText);
+        IRNode *root = parseASTFromStream(input);
+        ASTPythonGenerator generator;
+        pythonBytes = generator.generateProgram(root).size();
+        delete root; });
+    // What ships: the AST stage parses function by function into the binary AST, and code
+    // generation reads it back and runs its passes in code-generation/main.cpp's order
+    auto totalSeconds = timeIterations(options.warmup, options.iterations, [&]()
+                                       {
+        Lexer lexer(source, shape.name, diagnostics);
+        TokenStream stream = parserTokens(lexer);
+        std::ostringstream binary;
+        BinaryASTWriter writer(binary);
+        while (auto function = parseNextFunction(stream))
+            writer.add(*function);
+        writer.finish();
+        std::string bytes = binary.str();
+        IRNode *root = parseBinaryAST(bytes.data(), bytes.size());
+        removeUnreachableFunctions(root, DeadCodeOptions());
+        inlineFunctions(root, InlineOptions());
+        eliminateCommonSubexpressions(root);
+        eliminateDeadCode(root, DeadCodeOptions());
+        ASTPythonGenerator generator;
+        generator.generateProgram(root);
+        delete root; });
+
+    json.beginObject();
+    json.key("shape");
+    json.value(shape.name);
+    json.key("lines");
+    json.value(actualLines);
+    json.key("bytes");
+    json.value(source.size());
+    json.key("tokens");
+    json.value(tokens.size());
+    json.key("functions");
+    json.value(program->functions.size());
+    json.key("ast_bytes");
+    json.value(astText.size());
+    json.key("ast_binary_bytes");
+    json.value(astBinary.size());
+    json.key("python_bytes");
+    json.value(pythonBytes);
+    json.key("parallel_lex_matches");
+    json.value(parallelMatches);
+    json.key("streamed_functions_match");
+    json.value(streamedFunctions == program->functions.size());
+    json.key("phases");
+    json.beginObject();
+    writePhase(json, "lex", lexSeconds, actualLines, source.size());
+    writePhase(json, "lex_parallel", lexParallelSeconds, actualLines, source.size());
+    writePhase(json, "parse", parseSeconds, actualLines, source.size());
+    writePhase(json, "lex_parse_streaming", streamSeconds, actualLines, source.size());
+    writePhase(json, "ast_dump", dumpSeconds, actualLines, source.size());
+    writePhase(json, "ast_binary_write", binaryWriteSeconds, actualLines, source.size());
+    writePhase(json, "ast_read", readSeconds, actualLines, source.size());
+    writePhase(json, "ast_binary_read", binaryReadSeconds, actualLines, source.size());
+    writePhase(json, "inline", inlineSeconds, actualLines, source.size());
+    writePhase(json, "cse", cseSeconds, actualLines, source.size());
+    writePhase(json, "dce", dceSeconds, actualLines, source.size());
+    writePhase(json, "codegen", codegenSeconds, actualLines, source.size());
+    writePhase(json, "total", totalSeconds, actualLines, source.size());
+    json.endObject();
+    json.endObject();
+}
+
+int main(int argc, char *argv[])
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<SourceShape> shapes;
+    for (const auto &shape : defaultShapes())
+    {
+        if (options.shapes.empty() || std::find(options.shapes.begin(), options.shapes.end(), shape.name) != options.shapes.end())
+            shapes.push_back(shape);
+    }
+    if (options.hasCustom)
+        shapes.push_back(options.custom);
+
+    std::ofstream file;
+    if (!options.outputFile.empty())
+    {
+        file.open(options.outputFile);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to open output file: " << options.outputFile << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out = options.outputFile.empty() ? std::cout : file;
+
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("benchmark");
+    json.value("mlang_compiler_frontend");
+    json.key("iterations");
+    json.value(options.iterations);
+    json.key("warmup");
+    json.value(options.warmup);
+    json.key("seed");
+    json.value(static_cast<long long>(options.seed));
+    json.key("results");
+    json.beginArray();
+    for (const auto &shape : shapes)
+    {
+        for (size_t lines : options.sizes)
+        {
+            std::cerr << "Running " << shape.name << " at " << lines << " lines..." << std::endl;
+            try
+            {
+                runCase(json, shape, lines, options);
+            }
+            catch (const ParseException &e)
+            {
+                std::cerr << "Parse error in generated source: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+    }
+    json.endArray();
+    json.endObject();
+    return 0;
+}
@@ -0,0 +1,621 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "reference.h"
+#include "../common/stats.h"
+#include "../../runtime/distributed.h"
+#include "../../runtime/runtime.h"
+
+struct BenchmarkOptions
+{
+    std::vector<size_t> sizes = {256, 1024, 4096};
+    std::vector<size_t> gemmSizes = {128, 256, 512};
+    std::vector<int> threads;
+    std::vector<std::string> kernels;
+    size_t csvRows = 200000;
+    size_t csvCols = 16;
+    size_t sparseRows = 200000;
+    size_t sparseCols = 50000;
+    double density = 0.0005;
+    size_t trainRows = 100000;
+    size_t trainCols = 32;
+    int epochs = 20;
+    size_t batch = 64;
+    std::vector<size_t> processes = {2, 4};
+    int iterations = 5;
+    int warmup = 1;
+    // float storage rounds every element to 24 bits
+    double tolerance = sizeof(Real) == sizeof(float) ? 1e-3 : 1e-9;
+    std::string csvPath = "/tmp/mlang_runtime_benchmark.csv";
+    std::string outputFile;
+};
+
+// One benchmarked operation: the runtime kernel, its naive reference and how to compare them
+struct KernelCase
+{
+    std::string kernel = "";
+    std::string shape = "";
+    double flops = 0.0;
+    double bytes = 0.0;
+    std::function<void()> run = nullptr;
+    std::function<void()> reference = nullptr;
+    std::function<double()> error = nullptr;
+};
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --sizes N,N,...       square sizes for gemv, gemv_transposed and axpy (default 256,1024,4096)\n"
+              << "  --gemm-sizes N,...    square sizes for gemm (default 128,256,512)\n"
+              << "  --threads N,N,...     thread counts (default 1,2,4,... up to the hardware)\n"
+              << "  --kernels a,b,...     subset of: gemv, gemv_transposed, gemm, axpy, spmv, spmv_transposed,\n"
+              << "                        csv_load, csv_load_normalize, linear_regression_train, csv_stream_train,\n"
+              << "                        sgd_train, distributed_train\n"
+              << "  --csv-rows N --csv-cols N             CSV load shape (default 200000 x 16)\n"
+              << "  --sparse-rows N --sparse-cols N --density X   spmv shape and fraction of nonzeros (default 200000 x 50000, 0.0005)\n"
+              << "  --train-rows N --train-cols N         training shape (default 100000 x 32)\n"
+              << "  --epochs N            training epochs (default 20)\n"
+              << "  --batch N             sgd_train batch size (default 64)\n"
+              << "  --processes N,N,...   distributed_train worker processes, sharing the thread count (default 2,4)\n"
+              << "  --iterations N        timed iterations (default 5)\n"
+              << "  --warmup N            untimed warmup iterations (default 1)\n"
+              << "  --tolerance X         max relative error against the reference (default 1e-9, 1e-3 with -DMLANG_FLOAT32)\n"
+              << "  --csv-path FILE       scratch file for the CSV benchmark\n"
+              << "  --output FILE         write JSON to FILE instead of stdout\n";
+}
+
+static std::vector<size_t> parseSizes(const std::string &list)
+{
+    std::vector<size_t> sizes;
+    for (const auto &item : splitList(list))
+    {
+        sizes.push_back(std::stoull(item));
+    }
+    return sizes;
+}
+
+static bool parseOptions(int argc, char *argv[], BenchmarkOptions &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string next = argv[++i];
+        if (arg == "--sizes")
+            options.sizes = parseSizes(next);
+        else if (arg == "--gemm-sizes")
+            options.gemmSizes = parseSizes(next);
+        else if (arg == "--threads")
+        {
+            for (size_t threads : parseSizes(next))
+            {
+                options.threads.push_back(static_cast<int>(threads));
+            }
+        }
+        else if (arg == "--kernels")
+            options.kernels = splitList(next);
+        else if (arg == "--csv-rows")
+            options.csvRows = std::stoull(next);
+        else if (arg == "--csv-cols")
+            options.csvCols = std::stoull(next);
+        else if (arg == "--sparse-rows")
+            options.sparseRows = std::stoull(next);
+        else if (arg == "--sparse-cols")
+            options.sparseCols = std::stoull(next);
+        else if (arg == "--density")
+            options.density = std::stod(next);
+        else if (arg == "--train-rows")
+            options.trainRows = std::stoull(next);
+        else if (arg == "--train-cols")
+            options.trainCols = std::stoull(next);
+        else if (arg == "--epochs")
+            options.epochs = std::stoi(next);
+        else if (arg == "--batch")
+            options.batch = std::max(1, std::stoi(next));
+        else if (arg == "--processes")
+            options.processes = parseSizes(next);
+        else if (arg == "--iterations")
+            options.iterations = std::max(1, std::stoi(next));
+        else if (arg == "--warmup")
+            options.warmup = std::max(0, std::stoi(next));
+        else if (arg == "--tolerance")
+            options.tolerance = std::stod(next);
+        else if (arg == "--csv-path")
+            options.csvPath = next;
+        else if (arg == "--output")
+            options.outputFile = next;
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (options.threads.empty())
+    {
+        int hardware = std::max(1u, std::thread::hardware_concurrency());
+        for (int threads = 1; threads < hardware; threads *= 2)
+        {
+            options.threads.push_back(threads);
+        }
+        options.threads.push_back(hardware);
+    }
+    return true;
+}
+
+// Dense storage or the values of a SparseMatrix
+template <typename Values>
+static void fillRandom(Values &values, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    for (auto &value : values)
+    {
+        value = distribution(rng);
+    }
+}
+
+static std::string shapeOf(size_t rows, size_t cols)
+{
+    return std::to_string(rows) + "x" + std::to_string(cols);
+}
+
+// Writes table as CSV and returns the file size in bytes
+static long writeCSV(const Matrix &table, const std::string &path)
+{
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+        throw RuntimeError("Cannot write " + path);
+    for (size_t i = 0; i < table.rows; ++i)
+    {
+        for (size_t j = 0; j < table.cols; ++j)
+        {
+            std::fprintf(file, j + 1 < table.cols ? "%.17g," : "%.17g\n", table.at(i, j));
+        }
+    }
+    long bytes = std::ftell(file);
+    std::fclose(file);
+    return bytes;
+}
+
+// Builds the cases lazily so only the selected kernels allocate their inputs
+static void forEachCase(const BenchmarkOptions &options, const std::function<void(KernelCase &)> &visit)
+{
+    auto selected = [&](const std::string &kernel)
+    {
+        return options.kernels.empty() || std::find(options.kernels.begin(), options.kernels.end(), kernel) != options.kernels.end();
+    };
+    std::mt19937 rng(1234);
+
+    for (size_t n : options.sizes)
+    {
+        Matrix a(n, n);
+        Vector x(n), y, expected;
+        fillRandom(a.data, rng);
+        fillRandom(x.data, rng);
+
+        if (selected("gemv"))
+        {
+            KernelCase c{"gemv", shapeOf(n, n), 2.0 * n * n, sizeof(Real) * (n * n + 2.0 * n)};
+            c.run = [&]()
+            { gemv(a, x, y); };
+            c.reference = [&]()
+            { referenceGemv(a, x, expected); };
+            c.error = [&]()
+            { c.run(); c.reference(); return maxRelativeError(y.data, expected.data); };
+            visit(c);
+        }
+        if (selected("gemv_transposed"))
+        {
+            KernelCase c{"gemv_transposed", shapeOf(n, n), 2.0 * n * n, sizeof(Real) * (n * n + 2.0 * n)};
+            c.run = [&]()
+            { gemvTransposed(a, x, y); };
+            c.reference = [&]()
+            { referenceGemvTransposed(a, x, expected); };
+            c.error = [&]()
+            { c.run(); c.reference(); return maxRelativeError(y.data, expected.data); };
+            visit(c);
+        }
+        if (selected("axpy"))
+        {
+            // Vectors as long as the matrix so the case is bandwidth bound
+            Vector vx(n * n), vy(n * n);
+            fillRandom(vx.data, rng);
+            fillRandom(vy.data, rng);
+            Vector start = vy;
+            KernelCase c{"axpy", std::to_string(n * n), 2.0 * n * n, 3.0 * sizeof(Real) * n * n};
+            c.run = [&]()
+            { axpy(0.5, vx, vy); };
+            c.reference = [&]()
+            { referenceAxpy(0.5, vx, vy); };
+            c.error = [&]()
+            {
+                vy = start;
+                c.run();
+                Vector actual = vy;
+                vy = start;
+                c.reference();
+                return maxRelativeError(actual.data, vy.data);
+            };
+            visit(c);
+        }
+    }
+
+    if (selected("gemm"))
+    {
+        for (size_t n : options.gemmSizes)
+        {
+            Matrix a(n, n), b(n, n), c, expected;
+            fillRandom(a.data, rng);
+            fillRandom(b.data, rng);
+            KernelCase k{"gemm", shapeOf(n, n), 2.0 * n * n * n, 3.0 * sizeof(Real) * n * n};
+            k.run = [&]()
+            { gemm(a, b, c); };
+            k.reference = [&]()
+            { referenceGemm(a, b, expected); };
+            k.error = [&]()
+            { k.run(); k.reference(); return maxRelativeError(c.data, expected.data); };
+            visit(k);
+        }
+    }
+
+    if (selected("spmv") || selected("spmv_transposed"))
+    {
+        // The same number of nonzeros in every row, at distinct sorted random columns
+        size_t perRow = std::min(options.sparseCols, std::max<size_t>(1, static_cast<size_t>(options.sparseCols * options.density + 0.5)));
+        SparseMatrix a(options.sparseRows, options.sparseCols);
+        std::uniform_int_distribution<uint32_t> column(0, static_cast<uint32_t>(options.sparseCols - 1));
+        std::vector<uint32_t> row;
+        for (size_t i = 0; i < a.rows; ++i)
+        {
+            row.clear();
+            while (row.size() < perRow)
+            {
+                row.push_back(column(rng));
+                std::sort(row.begin(), row.end());
+                row.erase(std::unique(row.begin(), row.end()), row.end());
+            }
+            a.columns.insert(a.columns.end(), row.begin(), row.end());
+            a.rowStart[i + 1] = a.columns.size();
+        }
+        a.values.resize(a.columns.size());
+        fillRandom(a.values, rng);
+        Vector x(a.cols), xt(a.rows), y, expected;
+        fillRandom(x.data, rng);
+        fillRandom(xt.data, rng);
+        double nonzeros = static_cast<double>(a.nonzeros());
+        double matrixBytes = nonzeros * (sizeof(Real) + sizeof(uint32_t)) + (a.rows + 1.0) * sizeof(size_t);
+
+        if (selected("spmv"))
+        {
+            KernelCase c{"spmv", shapeOf(a.rows, a.cols) + "/" + std::to_string(a.nonzeros()), 2.0 * nonzeros,
+                         matrixBytes + sizeof(Real) * (a.cols + a.rows)};
+            c.run = [&]()
+            { spmv(a, x, y); };
+            c.reference = [&]()
+            { referenceSpmv(a, x, expected); };
+            c.error = [&]()
+            { c.run(); c.reference(); return maxRelativeError(y.data, expected.data); };
+            visit(c);
+        }
+        if (selected("spmv_transposed"))
+        {
+            KernelCase c{"spmv_transposed", shapeOf(a.rows, a.cols) + "/" + std::to_string(a.nonzeros()), 2.0 * nonzeros,
+                         matrixBytes + sizeof(Real) * (a.rows + a.cols)};
+            c.run = [&]()
+            { spmvTransposed(a, xt, y); };
+            c.reference = [&]()
+            { referenceSpmvTransposed(a, xt, expected); };
+            c.error = [&]()
+            { c.run(); c.reference(); return maxRelativeError(y.data, expected.data); };
+            visit(c);
+        }
+    }
+
+    if (selected("csv_load"))
+    {
+        Matrix table(options.csvRows, options.csvCols);
+        fillRandom(table.data, rng);
+        long bytes = writeCSV(table, options.csvPath);
+
+        Matrix loaded, expected;
+        KernelCase c{"csv_load", shapeOf(table.rows, table.cols), 0.0, static_cast<double>(bytes)};
+        c.run = [&]()
+        { loaded = loadCSV(options.csvPath); };
+        c.reference = [&]()
+        { expected = referenceLoadCSV(options.csvPath); };
+        c.error = [&]()
+        { c.run(); c.reference(); return maxRelativeError(loaded.data, expected.data); };
+        visit(c);
+        std::remove(options.csvPath.c_str());
+    }
+
+    if (selected("csv_load_normalize"))
+    {
+        // Stats gathered while parsing, then one fused pass; the reference loads, then makes three passes
+        Matrix table(options.csvRows, options.csvCols);
+        fillRandom(table.data, rng);
+        long bytes = writeCSV(table, options.csvPath);
+
+        Matrix loaded, expected;
+        KernelCase c{"csv_load_normalize", shapeOf(table.rows, table.cols), 4.0 * table.rows * table.cols,
+                     bytes + 2.0 * sizeof(Real) * table.rows * table.cols};
+        c.run = [&]()
+        {
+            loaded = loadCSV(options.csvPath, true);
+            normalize(loaded);
+        };
+        c.reference = [&]()
+        {
+            expected = referenceLoadCSV(options.csvPath);
+            referenceNormalize(expected);
+        };
+        c.error = [&]()
+        { c.run(); c.reference(); return maxRelativeError(loaded.data, expected.data); };
+        visit(c);
+        std::remove(options.csvPath.c_str());
+    }
+
+    if (selected("linear_regression_train"))
+    {
+        size_t rows = options.trainRows, cols = options.trainCols;
+        Matrix data(rows, cols);
+        Vector trueWeights(cols), labels;
+        fillRandom(data.data, rng);
+        fillRandom(trueWeights.data, rng);
+        referenceGemv(data, trueWeights, labels);
+
+        Vector weights, expected;
+        double epochs = options.epochs;
+        // Per epoch: A w and Aᵀ err (2 flops per element each) plus the vector updates
+        KernelCase c{"linear_regression_train", shapeOf(rows, cols) + "x" + std::to_string(options.epochs),
+                     epochs * (4.0 * rows * cols + 2.0 * rows + 2.0 * cols),
+                     epochs * sizeof(Real) * (2.0 * rows * cols + 3.0 * rows + 3.0 * cols)};
+        c.run = [&]()
+        { weights = linearRegressionTrain(data, labels, 0.1, options.epochs); };
+        c.reference = [&]()
+        { expected = referenceLinearRegressionTrain(data, labels, 0.1, options.epochs); };
+        c.error = [&]()
+        { c.run(); c.reference(); return maxRelativeError(weights.data, expected.data); };
+        visit(c);
+    }
+
+    if (selected("distributed_train"))
+    {
+        size_t rows = options.trainRows, cols = options.trainCols;
+        Matrix data(rows, cols);
+        Vector trueWeights(cols), labels;
+        fillRandom(data.data, rng);
+        fillRandom(trueWeights.data, rng);
+        referenceGemv(data, trueWeights, labels);
+
+        // The row shards of each worker process, summed by allreduce over both local transports
+        for (size_t processes : options.processes)
+        {
+            for (TransportKind transport : {TransportKind::SHARED_MEMORY, TransportKind::SOCKET})
+            {
+                DistributedOptions distributed;
+                distributed.processes = static_cast<int>(processes);
+                distributed.transport = transport;
+                Vector weights, expected;
+                double epochs = options.epochs;
+                KernelCase c{"distributed_train",
+                             shapeOf(rows, cols) + "x" + std::to_string(options.epochs) + " p" + std::to_string(processes) +
+                                 (transport == TransportKind::SOCKET ? " socket" : " shm"),
+                             epochs * (4.0 * rows * cols + 2.0 * rows + 2.0 * cols),
+                             epochs * sizeof(Real) * (2.0 * rows * cols + 3.0 * rows + 3.0 * cols)};
+                c.run = [&]()
+                { weights = linearRegressionTrain(data, labels, 0.1, options.epochs, distributed); };
+                c.reference = [&]()
+                { expected = referenceLinearRegressionTrain(data, labels, 0.1, options.epochs); };
+                c.error = [&]()
+                { c.run(); c.reference(); return maxRelativeError(weights.data, expected.data); };
+                visit(c);
+            }
+        }
+    }
+
+    if (selected("sgd_train"))
+    {
+        // One mini-batch epoch moves the weights about as far as many full-batch epochs
+        size_t rows = options.trainRows, cols = options.trainCols;
+        Matrix data(rows, cols);
+        Vector trueWeights(cols), labels;
+        fillRandom(data.data, rng);
+        fillRandom(trueWeights.data, rng);
+        referenceGemv(data, trueWeights, labels);
+
+        Vector weights, expected;
+        KernelCase c{"sgd_train", shapeOf(rows, cols) + "x1/" + std::to_string(options.batch), 4.0 * rows * cols,
+                     sizeof(Real) * (rows * cols + 2.0 * rows)};
+        c.run = [&]()
+        { weights = sgdTrain(data, labels, 0.05, 1, options.batch); };
+        c.reference = [&]()
+        { expected = referenceSgdTrain(data, labels, 0.05, 1, options.batch); };
+        c.error = [&]()
+        { c.run(); c.reference(); return maxRelativeError(weights.data, expected.data); };
+        visit(c);
+    }
+
+    if (selected("csv_stream_train"))
+    {
+        // Load plus training where the first epoch overlaps the load; one epoch shows the overlap best
+        Matrix table(options.csvRows, options.csvCols);
+        Vector trueWeights(table.cols), labels;
+        fillRandom(table.data, rng);
+        fillRandom(trueWeights.data, rng);
+        referenceGemv(table, trueWeights, labels);
+        long bytes = writeCSV(table, options.csvPath);
+
+        Vector weights, expected;
+        KernelCase c{"csv_stream_train", shapeOf(table.rows, table.cols) + "x1", 4.0 * table.rows * table.cols,
+                     static_cast<double>(bytes)};
+        c.run = [&]()
+        {
+            CSVStream stream(options.csvPath);
+            weights = linearRegressionTrain(stream, labels, 0.1, 1);
+        };
+        c.reference = [&]()
+        { expected = referenceLinearRegressionTrain(referenceLoadCSV(options.csvPath), labels, 0.1, 1); };
+        c.error = [&]()
+        { c.run(); c.reference(); return maxRelativeError(weights.data, expected.data); };
+        visit(c);
+        std::remove(options.csvPath.c_str());
+    }
+}
+
+static std::vector<double> perSecond(const std::vector<double> &seconds, double amount)
+{
+    std::vector<double> result;
+    for (double s : seconds)
+    {
+        result.push_back(s > 0.0 ? amount / s : 0.0);
+    }
+    return result;
+}
+
+static void writeRates(JsonWriter &json, const KernelCase &c, const std::vector<double> &seconds)
+{
+    json.key("seconds");
+    json.stats(summarize(seconds));
+    if (c.flops > 0.0)
+    {
+        json.key("gflops");
+        json.stats(summarize(perSecond(seconds, c.flops / 1e9)));
+    }
+    json.key("gbytes_per_second");
+    json.stats(summarize(perSecond(seconds, c.bytes / 1e9)));
+}
+
+int main(int argc, char *argv[])
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!options.outputFile.empty())
+    {
+        file.open(options.outputFile);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to open output file: " << options.outputFile << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out = options.outputFile.empty() ? std::cout : file;
+
+    bool allCorrect = true;
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("benchmark");
+    json.value("mlang_runtime_kernels");
+    json.key("precision");
+    json.value(sizeof(Real) == sizeof(float) ? "float32" : "float64");
+    json.key("hardware_threads");
+    json.value(static_cast<int>(std::thread::hardware_concurrency()));
+    json.key("iterations");
+    json.value(options.iterations);
+    json.key("warmup");
+    json.value(options.warmup);
+    json.key("results");
+    json.beginArray();
+
+    try
+    {
+        forEachCase(options, [&](KernelCase &c)
+                    {
+            std::cerr << "Running " << c.kernel << " " << c.shape << "..." << std::endl;
+            setThreadCount(options.threads.back());
+            double error = c.error();
+            bool correct = error <= options.tolerance;
+            allCorrect = allCorrect && correct;
+
+            auto referenceSeconds = timeIterations(options.warmup, options.iterations, c.reference);
+
+            json.beginObject();
+            json.key("kernel");
+            json.value(c.kernel);
+            json.key("shape");
+            json.value(c.shape);
+            json.key("flops");
+            json.value(c.flops);
+            json.key("bytes");
+            json.value(c.bytes);
+            json.key("correctness");
+            json.beginObject();
+            json.key("max_relative_error");
+            json.value(error);
+            json.key("tolerance");
+            json.value(options.tolerance);
+            json.key("ok");
+            json.value(correct);
+            json.endObject();
+            json.key("reference");
+            json.beginObject();
+            writeRates(json, c, referenceSeconds);
+            json.endObject();
+
+            json.key("threads");
+            json.beginArray();
+            double baseline = 0.0;
+            int baselineThreads = options.threads.front();
+            PoolStats before = poolStats();
+            for (int threads : options.threads)
+            {
+                setThreadCount(threads);
+                auto seconds = timeIterations(options.warmup, options.iterations, c.run);
+                double mean = summarize(seconds).mean;
+                if (baseline == 0.0)
+                    baseline = mean;
+
+                json.beginObject();
+                json.key("threads");
+                json.value(threads);
+                writeRates(json, c, seconds);
+                json.key("speedup_vs_reference");
+                json.value(summarize(referenceSeconds).mean / mean);
+                // Relative to the first (smallest) thread count: 1.0 means perfect linear scaling
+                json.key("scaling_efficiency");
+                json.value(baseline * baselineThreads / (mean * threads));
+                json.endObject();
+            }
+            json.endArray();
+
+            // Buffer allocations of the timed runs and how many the pool served from its caches
+            PoolStats after = poolStats();
+            uint64_t allocations = after.allocations - before.allocations;
+            json.key("pool");
+            json.beginObject();
+            json.key("allocations");
+            json.value(static_cast<long long>(allocations));
+            json.key("hit_rate");
+            json.value(allocations > 0 ? static_cast<double>(after.hits - before.hits) / allocations : 0.0);
+            json.key("peak_bytes");
+            json.value(static_cast<long long>(after.peakBytes));
+            json.endObject();
+            json.endObject(); });
+    }
+    catch (const RuntimeError &e)
+    {
+        std::cerr << "Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    json.endArray();
+    json.key("all_correct");
+    json.value(allCorrect);
+    json.endObject();
+    return allCorrect ? 0 : 2;
+}
@@ -0,0 +1,214 @@
+#include "reference.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+void referenceGemv(const Matrix &a, const Vector &x, Vector &y)
+{
+    y.data.assign(a.rows, 0.0);
+    for (size_t i = 0; i < a.rows; ++i)
+    {
+        for (size_t j = 0; j < a.cols; ++j)
+        {
+            y[i] += a.at(i, j) * x[j];
+        }
+    }
+}
+
+void referenceGemvTransposed(const Matrix &a, const Vector &x, Vector &y)
+{
+    y.data.assign(a.cols, 0.0);
+    for (size_t j = 0; j < a.cols; ++j)
+    {
+        for (size_t i = 0; i < a.rows; ++i)
+        {
+            y[j] += a.at(i, j) * x[i];
+        }
+    }
+}
+
+void referenceSpmv(const SparseMatrix &a, const Vector &x, Vector &y)
+{
+    y.data.assign(a.rows, 0.0);
+    for (size_t i = 0; i < a.rows; ++i)
+    {
+        double sum = 0.0;
+        for (size_t k = a.rowStart[i]; k < a.rowStart[i + 1]; ++k)
+        {
+            sum += a.values[k] * x[a.columns[k]];
+        }
+        y[i] = sum;
+    }
+}
+
+void referenceSpmvTransposed(const SparseMatrix &a, const Vector &x, Vector &y)
+{
+    std::vector<double> sums(a.cols, 0.0);
+    for (size_t i = 0; i < a.rows; ++i)
+    {
+        for (size_t k = a.rowStart[i]; k < a.rowStart[i + 1]; ++k)
+        {
+            sums[a.columns[k]] += a.values[k] * x[i];
+        }
+    }
+    y.data.assign(sums.begin(), sums.end());
+}
+
+void referenceGemm(const Matrix &a, const Matrix &b, Matrix &c)
+{
+    c = Matrix(a.rows, b.cols);
+    for (size_t i = 0; i < a.rows; ++i)
+    {
+        for (size_t j = 0; j < b.cols; ++j)
+        {
+            double sum = 0.0;
+            for (size_t k = 0; k < a.cols; ++k)
+            {
+                sum += a.at(i, k) * b.at(k, j);
+            }
+            c.at(i, j) = sum;
+        }
+    }
+}
+
+void referenceAxpy(double alpha, const Vector &x, Vector &y)
+{
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+Matrix referenceLoadCSV(const std::string &path)
+{
+    std::ifstream file(path);
+    std::vector<std::vector<double>> rows;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::stringstream stream(line);
+        std::string field;
+        std::vector<double> row;
+        while (std::getline(stream, field, ','))
+        {
+            row.push_back(std::stod(field));
+        }
+        if (!row.empty())
+            rows.push_back(row);
+    }
+
+    Matrix matrix(rows.size(), rows.empty() ? 0 : rows[0].size());
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        std::copy(rows[i].begin(), rows[i].end(), matrix.row(i));
+    }
+    return matrix;
+}
+
+void referenceNormalize(Matrix &data)
+{
+    std::vector<double> mean(data.cols, 0.0);
+    std::vector<double> variance(data.cols, 0.0);
+    for (size_t i = 0; i < data.rows; ++i)
+    {
+        for (size_t j = 0; j < data.cols; ++j)
+        {
+            mean[j] += data.at(i, j);
+        }
+    }
+    for (size_t j = 0; j < data.cols; ++j)
+    {
+        mean[j] /= data.rows > 0 ? data.rows : 1;
+    }
+    for (size_t i = 0; i < data.rows; ++i)
+    {
+        for (size_t j = 0; j < data.cols; ++j)
+        {
+            double deviation = data.at(i, j) - mean[j];
+            variance[j] += deviation * deviation;
+        }
+    }
+    for (size_t i = 0; i < data.rows; ++i)
+    {
+        for (size_t j = 0; j < data.cols; ++j)
+        {
+            double deviation = std::sqrt(variance[j] / data.rows);
+            data.at(i, j) = static_cast<Real>((data.at(i, j) - mean[j]) / (deviation > 0 ? deviation : 1.0));
+        }
+    }
+}
+
+Vector referenceLinearRegressionTrain(const Matrix &data, const Vector &labels, double learningRate, int epochs)
+{
+    Vector weights(data.cols);
+    Vector predictions;
+    Vector gradient;
+    for (int epoch = 0; epoch < epochs; ++epoch)
+    {
+        referenceGemv(data, weights, predictions);
+        for (size_t i = 0; i < predictions.size(); ++i)
+        {
+            predictions[i] -= labels[i];
+        }
+        referenceGemvTransposed(data, predictions, gradient);
+        for (size_t j = 0; j < weights.size(); ++j)
+        {
+            weights[j] -= learningRate * gradient[j] / data.rows;
+        }
+    }
+    return weights;
+}
+
+Vector referenceSgdTrain(const Matrix &data, const Vector &labels, double learningRate, int epochs, size_t batchSize)
+{
+    Vector weights(data.cols);
+    std::vector<size_t> order(data.rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 random(shuffleSeed());
+    std::vector<double> errors;
+    for (int epoch = 0; epoch < epochs; ++epoch)
+    {
+        std::shuffle(order.begin(), order.end(), random);
+        for (size_t start = 0; start < data.rows; start += batchSize)
+        {
+            size_t count = std::min(batchSize, data.rows - start);
+            errors.assign(count, 0.0);
+            for (size_t k = 0; k < count; ++k)
+            {
+                size_t i = order[start + k];
+                for (size_t j = 0; j < data.cols; ++j)
+                {
+                    errors[k] += data.at(i, j) * weights[j];
+                }
+                errors[k] -= labels[i];
+            }
+            for (size_t k = 0; k < count; ++k)
+            {
+                for (size_t j = 0; j < data.cols; ++j)
+                {
+                    weights[j] -= learningRate / count * errors[k] * data.at(order[start + k], j);
+                }
+            }
+        }
+    }
+    return weights;
+}
+
+double maxRelativeError(const PoolVector<Real> &actual, const PoolVector<Real> &expected)
+{
+    if (actual.size() != expected.size())
+        return std::numeric_limits<double>::infinity();
+
+    double scale = 1.0;
+    double error = 0.0;
+    for (size_t i = 0; i < actual.size(); ++i)
+    {
+        scale = std::max(scale, std::fabs(static_cast<double>(expected[i])));
+        error = std::max(error, std::fabs(static_cast<double>(actual[i]) - expected[i]));
+    }
+    return error / scale;
+}
@@ -0,0 +1,25 @@
+#ifndef BENCH_REFERENCE_H
+#define BENCH_REFERENCE_H
+
+#include <string>
+#include "../../runtime/runtime.h"
+
+// Straightforward single-threaded kernels used as the correctness and speed baseline
+
+void referenceGemv(const Matrix &a, const Vector &x, Vector &y);
+void referenceGemvTransposed(const Matrix &a, const Vector &x, Vector &y);
+void referenceGemm(const Matrix &a, const Matrix &b, Matrix &c);
+void referenceAxpy(double alpha, const Vector &x, Vector &y);
+void referenceSpmv(const SparseMatrix &a, const Vector &x, Vector &y);
+void referenceSpmvTransposed(const SparseMatrix &a, const Vector &x, Vector &y);
+Matrix referenceLoadCSV(const std::string &path);
+// Two passes for the column means and variances, then a third to standardize
+void referenceNormalize(Matrix &data);
+Vector referenceLinearRegressionTrain(const Matrix &data, const Vector &labels, double learningRate, int epochs);
+// Visits the rows in the same shuffled order as sgdTrain
+Vector referenceSgdTrain(const Matrix &data, const Vector &labels, double learningRate, int epochs, size_t batchSize);
+
+// max |actual - expected| scaled by the largest expected magnitude (at least 1)
+double maxRelativeError(const PoolVector<Real> &actual, const PoolVector<Real> &expected);
+
+#endif
@@ -0,0 +1,598 @@
+#include "analysis.h"
+#include "builtins.h"
+
+int countReferences(IRNode *node, const std::string &name)
+{
+    int count = 0;
+    visitTree(node, [&](IRNode *current)
+              {
+        if ((current->type == "LITERAL_VALUE" || current->type == "IDENTIFIER" || current->type == "LOOP_VARIABLE") &&
+            splitTypedName(current->value).first == name)
+            ++count; });
+    return count;
+}
+
+bool referencesAny(IRNode *node, const std::set<std::string> &names)
+{
+    bool found = false;
+    visitTree(node, [&](IRNode *current)
+              {
+        if (current->type == "LITERAL_VALUE" && names.count(current->value))
+            found = true; });
+    return found;
+}
+
+bool isHotLoop(const Profile *profile, const std::string &function, const std::string &loopVar, int line,
+               uint64_t minIterations, double minShare)
+{
+    if (!profile)
+        return false;
+    const ProfileRegion *region = profile->find(RegionKind::LOOP, function + "/" + loopVar, static_cast<uint32_t>(std::max(line, 0)));
+    uint64_t total = profile->totalNanoseconds();
+    if (!region || region->count == 0 || total == 0)
+        return false;
+    return region->iterations / region->count >= minIterations &&
+           static_cast<double>(region->nanoseconds) >= minShare * static_cast<double>(total);
+}
+
+namespace
+{
+    const std::set<std::string> PURE_METHODS = {"transpose"};
+
+    // Name of the variable an assignment or declaration stores into, empty for malformed nodes
+    std::string assignedName(IRNode *assignment)
+    {
+        if (assignment->type == "VARIABLE_DECLARATION")
+            return assignment->children.empty() ? "" : splitTypedName(assignment->children[0]->value).first;
+        IRNode *target = findChild(assignment, "IDENTIFIER");
+        return target ? target->value : "";
+    }
+
+    IRNode *assignedValue(IRNode *assignment)
+    {
+        if (assignment->type == "VARIABLE_DECLARATION")
+            return assignment->children.size() > 1 ? assignment->children[1] : nullptr;
+        IRNode *value = findChild(assignment, "EXPRESSION");
+        return value && !value->children.empty() ? value->children[0] : nullptr;
+    }
+
+    IRNode *storeIndex(IRNode *assignment)
+    {
+        IRNode *index = findChild(assignment, "INDEX");
+        return index && !index->children.empty() ? index->children[0] : nullptr;
+    }
+
+    bool isName(IRNode *node, const std::string &name)
+    {
+        return node && node->type == "LITERAL_VALUE" && node->value == name;
+    }
+
+}
+
+IRNode *reductionOperand(IRNode *assignment, const std::string &name, std::string &op)
+{
+    IRNode *value = assignedValue(assignment);
+    if (!value)
+        return nullptr;
+    if (value->type == "FUNCTION_CALL" && (value->value == "min" || value->value == "max"))
+    {
+        IRNode *arguments = findChild(value, "ARGUMENTS");
+        if (!arguments || arguments->children.size() != 2)
+            return nullptr;
+        op = value->value;
+        IRNode *first = arguments->children[0];
+        IRNode *second = arguments->children[1];
+        if (isName(first, name) && countReferences(second, name) == 0)
+            return second;
+        if (isName(second, name) && countReferences(first, name) == 0)
+            return first;
+        return nullptr;
+    }
+    if (value->type != "OPERATOR" || value->children.size() != 2)
+        return nullptr;
+    op = value->value;
+    if (op != "+" && op != "-" && op != "*")
+        return nullptr;
+    IRNode *left = value->children[0];
+    IRNode *right = value->children[1];
+    if (isName(left, name) && countReferences(right, name) == 0)
+        return right;
+    if (op != "-" && isName(right, name) && countReferences(left, name) == 0)
+        return left;
+    return nullptr;
+}
+
+bool isDotProductTerm(IRNode *term, const std::string &variable)
+{
+    if (!term || term->type != "OPERATOR" || term->value != "*" || term->children.size() != 2)
+        return false;
+    for (auto factor : term->children)
+    {
+        if (factor->type != "INDEX_EXPRESSION" || factor->children.size() != 2 || !isName(factor->children[1], variable))
+            return false;
+    }
+    return true;
+}
+
+namespace
+{
+    IRNode *unwrapped(IRNode *node)
+    {
+        while (node && node->type == "EXPRESSION" && node->children.size() == 1)
+            node = node->children[0];
+        return node;
+    }
+
+    bool isArithmetic(ValueKind kind)
+    {
+        return kind == ValueKind::INT || kind == ValueKind::FLOAT;
+    }
+
+    // alpha * x or x * alpha for a scalar alpha and a Vector x
+    bool scaledVector(IRNode *node, const ProgramTypes &types, const Scope &scope, IRNode *&alpha, IRNode *&x)
+    {
+        node = unwrapped(node);
+        if (!node || node->type != "OPERATOR" || node->value != "*" || node->children.size() != 2)
+            return false;
+        IRNode *left = node->children[0];
+        IRNode *right = node->children[1];
+        ValueKind leftKind = types.infer(left, scope);
+        ValueKind rightKind = types.infer(right, scope);
+        if (isArithmetic(leftKind) && rightKind == ValueKind::VECTOR)
+        {
+            alpha = left;
+            x = right;
+            return true;
+        }
+        if (leftKind == ValueKind::VECTOR && isArithmetic(rightKind))
+        {
+            alpha = right;
+            x = left;
+            return true;
+        }
+        return false;
+    }
+
+    // True if a value of name can outlive the expression that reads it: stored under another
+    // name, returned, passed to a user function or held by a transpose that is. consumed says
+    // whether the parent of node only reads the value (operators, indexing, built-ins).
+    bool escapes(IRNode *node, const std::string &name, bool consumed)
+    {
+        if (!node)
+            return false;
+        const std::string &type = node->type;
+        if (type == "LITERAL_VALUE")
+            return !consumed && node->value == name;
+        bool reads = type == "OPERATOR" || type == "UNARY_OPERATOR" || type == "INDEX_EXPRESSION" ||
+                     type == "MEMBER_ACCESS" || type == "INDEX" || (type == "FUNCTION_CALL" && findBuiltin(node->value));
+        if (type == "METHOD_CALL" || type == "ARGUMENTS" || type == "EXPRESSION")
+            reads = consumed;
+        for (auto child : node->children)
+        {
+            if (escapes(child, name, reads))
+                return true;
+        }
+        return false;
+    }
+}
+
+bool matchInPlaceUpdate(IRNode *assignment, const ProgramTypes &types, const Scope &scope, InPlaceUpdate &update)
+{
+    std::string target = assignedName(assignment);
+    IRNode *value = unwrapped(assignedValue(assignment));
+    auto declared = scope.find(target);
+    if (target.empty() || storeIndex(assignment) || !value || value->type != "OPERATOR" || value->children.size() != 2 ||
+        declared == scope.end() || (declared->second != ValueKind::VECTOR && declared->second != ValueKind::MATRIX))
+        return false;
+    const std::string &op = value->value;
+    IRNode *left = unwrapped(value->children[0]);
+    IRNode *right = unwrapped(value->children[1]);
+    ValueKind leftKind = types.infer(left, scope);
+    ValueKind rightKind = types.infer(right, scope);
+    bool disjoint = countReferences(value, target) == 0;
+    update = InPlaceUpdate();
+
+    bool sparse = leftKind == ValueKind::SPARSE_MATRIX;
+    if (op == "*" && (leftKind == ValueKind::MATRIX || sparse) && rightKind == ValueKind::VECTOR && disjoint)
+    {
+        bool transposed = left->type == "METHOD_CALL" && left->value == "transpose" && !left->children.empty();
+        if (sparse)
+            update.kernel = transposed ? UpdateKernel::SPMV_TRANSPOSED : UpdateKernel::SPMV;
+        else
+            update.kernel = transposed ? UpdateKernel::GEMV_TRANSPOSED : UpdateKernel::GEMV;
+        update.first = transposed ? left->children[0] : left;
+        update.second = right;
+        return true;
+    }
+    // A transposed factor would be materialized first, which saves nothing
+    if (op == "*" && leftKind == ValueKind::MATRIX && rightKind == ValueKind::MATRIX && disjoint &&
+        left->type != "METHOD_CALL" && right->type != "METHOD_CALL")
+    {
+        update.kernel = UpdateKernel::GEMM;
+        update.first = left;
+        update.second = right;
+        return true;
+    }
+    if (declared->second != ValueKind::VECTOR)
+        return false;
+    if (op == "*" && scaledVector(value, types, scope, update.alpha, update.first))
+    {
+        update.kernel = UpdateKernel::SCALE;
+        return true;
+    }
+    // x / alpha is computed as (1 / alpha) x by the value form too
+    if (op == "/" && leftKind == ValueKind::VECTOR && isArithmetic(rightKind))
+    {
+        update.kernel = UpdateKernel::SCALE;
+        update.alpha = right;
+        update.first = left;
+        update.reciprocal = true;
+        return true;
+    }
+    if ((op != "+" && op != "-") || leftKind != ValueKind::VECTOR || rightKind != ValueKind::VECTOR)
+        return false;
+    // target = target ± alpha x and target = target ± x accumulate into the target
+    IRNode *addend = isName(left, target) ? right : (op == "+" && isName(right, target) ? left : nullptr);
+    if (addend)
+    {
+        update.kernel = UpdateKernel::AXPY;
+        update.negate = op == "-";
+        if (!scaledVector(addend, types, scope, update.alpha, update.first))
+            update.first = addend;
+        return true;
+    }
+    update.kernel = op == "+" ? UpdateKernel::ADD : UpdateKernel::SUBTRACT;
+    update.first = left;
+    update.second = right;
+    return true;
+}
+
+std::set<std::string> reusableBuffers(IRNode *function, IRNode *loop, const Scope &scope)
+{
+    std::set<std::string> buffers;
+    IRNode *body = forLoopParts(loop).body;
+    std::vector<IRNode *> statements = blockStatements(body);
+    std::set<std::string> candidates;
+    for (auto statement : statements)
+    {
+        if (statement->type == "ASSIGNMENT_EXPRESSION" && !storeIndex(statement))
+            candidates.insert(assignedName(statement));
+    }
+
+    for (const auto &name : candidates)
+    {
+        auto declared = scope.find(name);
+        if (declared == scope.end() || (declared->second != ValueKind::VECTOR && declared->second != ValueKind::MATRIX))
+            continue;
+        if (countReferences(function, name) != countReferences(body, name))
+            continue;
+        // The first statement that mentions the name must overwrite it without reading it
+        IRNode *first = nullptr;
+        for (auto statement : statements)
+        {
+            if (countReferences(statement, name) > 0)
+            {
+                first = statement;
+                break;
+            }
+        }
+        if (!first || first->type != "ASSIGNMENT_EXPRESSION" || assignedName(first) != name || storeIndex(first) ||
+            countReferences(assignedValue(first), name) > 0)
+            continue;
+
+        // Every value the name holds is a fresh operator result, and none of them is shared
+        bool fresh = true;
+        visitTree(body, [&](IRNode *node)
+                  {
+            if (node->type == "VARIABLE_DECLARATION" && !node->children.empty() &&
+                splitTypedName(node->children[0]->value).first == name)
+                fresh = false;
+            if (node->type == "FOR_LOOP" && forLoopParts(node).variable == name)
+                fresh = false;
+            if (node->type != "ASSIGNMENT_EXPRESSION" || assignedName(node) != name || storeIndex(node))
+                return;
+            IRNode *value = unwrapped(assignedValue(node));
+            if (!value || (value->type != "OPERATOR" && value->type != "UNARY_OPERATOR"))
+                fresh = false; });
+        if (fresh && !escapes(body, name, false))
+            buffers.insert(name);
+    }
+    return buffers;
+}
+
+LoopAnalyzer::LoopAnalyzer(const ProgramTypes &types) : types(types)
+{
+    for (const auto &signature : types.functions())
+    {
+        pure.insert(signature.name);
+    }
+
+    // Start from "everything is pure" and remove offenders until nothing changes, which settles recursion
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (const auto &signature : types.functions())
+        {
+            if (!pure.count(signature.name))
+                continue;
+            std::string offender;
+            bool storesIntoParameter = false;
+            visitTree(signature.definition, [&](IRNode *node)
+                      {
+                if (node->type != "ASSIGNMENT_EXPRESSION" || !findChild(node, "INDEX"))
+                    return;
+                for (const auto &parameter : signature.parameters)
+                {
+                    if (parameter.first == assignedName(node))
+                        storesIntoParameter = true;
+                } });
+            if (storesIntoParameter || !callsArePure(signature.definition, offender))
+            {
+                pure.erase(signature.name);
+                changed = true;
+            }
+        }
+    }
+}
+
+bool LoopAnalyzer::callsArePure(IRNode *node, std::string &offender) const
+{
+    visitTree(node, [&](IRNode *current)
+              {
+        if (!offender.empty())
+            return;
+        if (current->type == "FUNCTION_CALL")
+        {
+            const Builtin *builtin = findBuiltin(current->value);
+            if (builtin ? !builtin->pure : !pure.count(current->value))
+                offender = current->value;
+        }
+        else if (current->type == "METHOD_CALL" && !PURE_METHODS.count(current->value))
+            offender = current->value; });
+    return offender.empty();
+}
+
+LoopAnalysis LoopAnalyzer::analyze(IRNode *function, IRNode *loop, const Scope &scope) const
+{
+    LoopAnalysis result;
+    ForLoopParts parts = forLoopParts(loop);
+    result.variable = parts.variable;
+    if (parts.start && parts.end && parts.start->type == "LITERAL_VALUE" && parts.end->type == "LITERAL_VALUE" &&
+        !isIdentifierNode(parts.start) && !isIdentifierNode(parts.end))
+    {
+        try
+        {
+            result.tripCount = std::max(0LL, std::stoll(parts.end->value) - std::stoll(parts.start->value));
+        }
+        catch (const std::exception &)
+        {
+            // Float bounds keep the trip count unknown
+        }
+    }
+    auto sequential = [&result](const std::string &reason)
+    {
+        result.kind = LoopKind::SEQUENTIAL;
+        result.reductions.clear();
+        result.privates.clear();
+        result.vectorizable = false;
+        result.reason = reason;
+        return result;
+    };
+    if (!parts.body || parts.variable.empty())
+        return sequential("malformed loop");
+
+    std::string offender;
+    if (!callsArePure(parts.body, offender))
+        return sequential("calls '" + offender + "', which has side effects");
+
+    // Names the body writes: element stores per array, whole assignments per variable
+    std::map<std::string, std::vector<IRNode *>> elementStores;
+    std::map<std::string, std::vector<IRNode *>> assignments;
+    std::set<std::string> blockLocals;
+    bool returns = false;
+    visitTree(parts.body, [&](IRNode *node)
+              {
+        if (node->type == "RETURN_STATEMENT")
+            returns = true;
+        else if (node->type == "FOR_LOOP" || (node->type == "FUNCTION_CALL" && !findBuiltin(node->value)))
+            result.irregular = true;
+        if (node->type == "FOR_LOOP")
+            blockLocals.insert(forLoopParts(node).variable);
+        else if (node->type == "VARIABLE_DECLARATION" && !node->children.empty())
+            blockLocals.insert(splitTypedName(node->children[0]->value).first);
+        else if (node->type == "ASSIGNMENT_EXPRESSION")
+        {
+            std::string name = assignedName(node);
+            if (findChild(node, "INDEX"))
+                elementStores[name].push_back(node);
+            else
+                assignments[name].push_back(node);
+        } });
+    if (returns)
+        return sequential("returns from inside the loop");
+    if (assignments.count(parts.variable) || elementStores.count(parts.variable))
+        return sequential("assigns its loop variable");
+
+    for (const auto &store : elementStores)
+    {
+        const std::string &array = store.first;
+        if (assignments.count(array) || blockLocals.count(array))
+            return sequential("replaces array '" + array + "' while storing into it");
+        int indexedReads = 0;
+        visitTree(parts.body, [&](IRNode *node)
+                  {
+            if (node->type == "INDEX_EXPRESSION" && node->children.size() == 2 && isName(node->children[0], array) &&
+                isName(node->children[1], parts.variable))
+                ++indexedReads; });
+        for (auto assignment : store.second)
+        {
+            if (!isName(storeIndex(assignment), parts.variable))
+                return sequential("stores into '" + array + "' at an index other than '" + parts.variable + "'");
+        }
+        if (countReferences(parts.body, array) != indexedReads + static_cast<int>(store.second.size()))
+            return sequential("reads '" + array + "' at other indices than the one it stores");
+    }
+
+    IRNode *functionBody = findChild(function, "FUNCTION_BODY");
+    std::vector<IRNode *> statements = blockStatements(parts.body);
+    for (const auto &assigned : assignments)
+    {
+        const std::string &name = assigned.first;
+        if (blockLocals.count(name))
+            continue;
+
+        auto kind = scope.find(name);
+        ValueKind valueKind = kind == scope.end() ? ValueKind::UNKNOWN : kind->second;
+        std::string op;
+        std::string firstOp;
+        bool isReduction = valueKind == ValueKind::INT || valueKind == ValueKind::FLOAT;
+        for (auto assignment : assigned.second)
+        {
+            isReduction = isReduction && reductionOperand(assignment, name, op) && (firstOp.empty() || op == firstOp);
+            firstOp = op;
+        }
+        if (isReduction && countReferences(parts.body, name) == 2 * static_cast<int>(assigned.second.size()))
+        {
+            result.reductions.push_back({name, firstOp, valueKind});
+            continue;
+        }
+
+        if (countReferences(functionBody, name) != countReferences(parts.body, name))
+            return sequential("'" + name + "' is carried across iterations or used after the loop");
+        IRNode *first = nullptr;
+        for (auto statement : statements)
+        {
+            if (countReferences(statement, name) > 0)
+            {
+                first = statement;
+                break;
+            }
+        }
+        if (!first || first->type != "ASSIGNMENT_EXPRESSION" || findChild(first, "INDEX") || assignedName(first) != name ||
+            countReferences(assignedValue(first), name) > 0)
+            return sequential("'" + name + "' is read before it is assigned in an iteration");
+        result.privates.push_back(name);
+    }
+
+    result.kind = result.reductions.empty() ? LoopKind::INDEPENDENT : LoopKind::REDUCTION;
+    result.vectorizable = checkVectorizable(parts.body, parts.variable, scope);
+    if (result.vectorizable)
+    {
+        // np.sum over a loop-invariant operand would add it once instead of once per iteration
+        std::set<std::string> varying = {parts.variable};
+        for (auto statement : statements)
+        {
+            IRNode *value = assignedValue(statement);
+            std::string name = assignedName(statement);
+            bool reduction = false;
+            for (const auto &candidate : result.reductions)
+            {
+                std::string op;
+                if (candidate.variable == name)
+                    reduction = !referencesAny(reductionOperand(statement, name, op), varying);
+            }
+            if (reduction)
+                result.vectorizable = false;
+            else if (value && referencesAny(value, varying))
+                varying.insert(name);
+        }
+    }
+    if (result.vectorizable && result.kind == LoopKind::REDUCTION)
+    {
+        result.reductionKernel = true;
+        for (auto statement : statements)
+        {
+            bool isReductionStatement = false;
+            for (const auto &reduction : result.reductions)
+            {
+                isReductionStatement = isReductionStatement ||
+                                       (statement->type == "ASSIGNMENT_EXPRESSION" && assignedName(statement) == reduction.variable);
+            }
+            result.reductionKernel = result.reductionKernel && isReductionStatement;
+        }
+    }
+    return result;
+}
+
+bool LoopAnalyzer::checkVectorizable(IRNode *node, const std::string &variable, const Scope &scope) const
+{
+    const std::string &type = node->type;
+    if (type == "LOOP_BODY" || type == "FUNCTION_BODY" || type == "EXPRESSION")
+    {
+        for (auto child : node->children)
+        {
+            if (!checkVectorizable(child, variable, scope))
+                return false;
+        }
+        return true;
+    }
+    if (type == "ASSIGNMENT_EXPRESSION")
+    {
+        IRNode *index = storeIndex(node);
+        IRNode *value = assignedValue(node);
+        auto target = scope.find(assignedName(node));
+        if (!value || target == scope.end())
+            return false;
+        if (index)
+            return target->second == ValueKind::VECTOR && checkVectorizable(value, variable, scope);
+        std::string op;
+        IRNode *operand = reductionOperand(node, assignedName(node), op);
+        // min and max have no element-wise form, only the reduction one
+        if (operand && (op == "min" || op == "max"))
+            return isScalar(target->second) && checkVectorizable(operand, variable, scope);
+        return isScalar(target->second) && checkVectorizable(value, variable, scope);
+    }
+    if (type == "VARIABLE_DECLARATION")
+    {
+        if (node->children.size() != 2)
+            return false;
+        auto typed = splitTypedName(node->children[0]->value);
+        return isScalar(parseValueKind(typed.second)) && checkVectorizable(node->children[1], variable, scope);
+    }
+    if (type == "OPERATOR")
+        return node->children.size() == 2 && checkVectorizable(node->children[0], variable, scope) &&
+               checkVectorizable(node->children[1], variable, scope);
+    if (type == "UNARY_OPERATOR")
+        return node->children.size() == 1 && checkVectorizable(node->children[0], variable, scope);
+    if (type == "INDEX_EXPRESSION")
+    {
+        if (node->children.size() != 2 || !isName(node->children[1], variable) || !isIdentifierNode(node->children[0]))
+            return false;
+        auto base = scope.find(node->children[0]->value);
+        return base != scope.end() && base->second == ValueKind::VECTOR;
+    }
+    if (type == "LITERAL_VALUE")
+    {
+        if (!isIdentifierNode(node))
+            return !node->value.empty() && node->value[0] != '"';
+        auto kind = scope.find(node->value);
+        return node->value == variable || (kind != scope.end() && (kind->second == ValueKind::INT || kind->second == ValueKind::FLOAT));
+    }
+    return false;
+}
+
+bool LoopAnalyzer::shouldParallelize(const LoopAnalysis &loop, const ParallelOptions &options, const Profile *profile,
+                                     const std::string &function, int line) const
+{
+    if (!options.enabled || loop.kind == LoopKind::SEQUENTIAL)
+        return false;
+    if (loop.tripCount >= 0 && loop.tripCount < options.minTripCount)
+        return false;
+    // With measurements available only loops that actually dominated the run are worth the overhead
+    return !profile || isHotLoop(profile, function, loop.variable, line, static_cast<uint64_t>(options.minTripCount));
+}
+
+bool LoopAnalyzer::useDynamicSchedule(const LoopAnalysis &loop, const ParallelOptions &options) const
+{
+    if (options.schedule != ScheduleChoice::AUTO)
+        return options.schedule == ScheduleChoice::DYNAMIC;
+    return loop.irregular;
+}
+
+bool LoopAnalyzer::shouldVectorize(const LoopAnalysis &loop, const ParallelOptions &options) const
+{
+    if (!options.vectorize || !loop.vectorizable || loop.kind == LoopKind::SEQUENTIAL)
+        return false;
+    return loop.tripCount < 0 || loop.tripCount >= options.minVectorTrip;
+}
@@ -0,0 +1,152 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include "ir.h"
+#include "types.h"
+#include "../runtime/profile.h"
+
+enum class LoopKind
+{
+    // Iterations depend on each other (or might); keep the loop as written
+    SEQUENTIAL,
+    // Iterations touch disjoint data and can run in any order
+    INDEPENDENT,
+    // Independent apart from scalar accumulations that can be combined per chunk
+    REDUCTION
+};
+
+// s = s op e, or s = min(s, e) / max(s, e), where s is read and written nowhere else in the loop
+struct Reduction
+{
+    std::string variable;
+    // "+", "-", "*", "min" or "max"; partials of "-" are combined with "+"
+    std::string op;
+    ValueKind kind = ValueKind::FLOAT;
+};
+
+struct LoopAnalysis
+{
+    LoopKind kind = LoopKind::SEQUENTIAL;
+    std::string variable;
+    std::vector<Reduction> reductions;
+    // Function locals assigned before any read in every iteration; each thread needs its own copy
+    std::vector<std::string> privates;
+    // Straight-line element-wise arithmetic on x[i] that maps onto whole-array operations
+    bool vectorizable = false;
+    // Vectorizable and made only of reduction statements, so each becomes one reduction kernel call
+    bool reductionKernel = false;
+    // Calls or nested loops make iteration cost uneven, which favours dynamic scheduling
+    bool irregular = false;
+    // Iteration count when both bounds are literals, otherwise -1
+    long long tripCount = -1;
+    // Why the loop is sequential
+    std::string reason;
+};
+
+enum class ScheduleChoice
+{
+    AUTO,
+    STATIC,
+    DYNAMIC
+};
+
+// Command line settings of the parallelizer (--parallel, --schedule, --min-parallel-trip)
+struct ParallelOptions
+{
+    bool enabled = true;
+    ScheduleChoice schedule = ScheduleChoice::AUTO;
+    // Loops with fewer literal iterations stay sequential; also the smallest range worth splitting at run time
+    long long minTripCount = 1024;
+    // Element-wise loops become array operations or reduction kernels (--vectorize)
+    bool vectorize = true;
+    // Shorter literal loops are cheaper to run as written than to set up a kernel call for
+    long long minVectorTrip = 16;
+};
+
+// A loop is hot if it ran at least minIterations per entry and took minShare of the run time
+bool isHotLoop(const Profile *profile, const std::string &function, const std::string &loopVar, int line,
+               uint64_t minIterations = 1024, double minShare = 0.05);
+
+// Number of identifier uses of name below node, including assignment targets
+int countReferences(IRNode *node, const std::string &name);
+// True if the expression mentions any of the names
+bool referencesAny(IRNode *node, const std::set<std::string> &names);
+// Operand e of a reduction statement "name = name op e" (or "name = min(name, e)"), nullptr otherwise
+IRNode *reductionOperand(IRNode *assignment, const std::string &name, std::string &op);
+// x[i] * y[i] for loop variable i, the term of a dot product
+bool isDotProductTerm(IRNode *term, const std::string &variable);
+
+// Runtime kernel that computes an array assignment into the target's existing storage
+enum class UpdateKernel
+{
+    // target = A x
+    GEMV,
+    // target = A.transpose() x
+    GEMV_TRANSPOSED,
+    // target = A B
+    GEMM,
+    // target = S x and target = S.transpose() x for a sparse S
+    SPMV,
+    SPMV_TRANSPOSED,
+    // target = alpha x
+    SCALE,
+    // target = x + y and target = x - y
+    ADD,
+    SUBTRACT,
+    // target = target + alpha x
+    AXPY
+};
+
+// Destination-passing form of "target = value" for a Vector or Matrix target
+struct InPlaceUpdate
+{
+    UpdateKernel kernel = UpdateKernel::ADD;
+    // Operands in the order of the runtime kernel; alpha is nullptr for 1
+    IRNode *alpha = nullptr;
+    IRNode *first = nullptr;
+    IRNode *second = nullptr;
+    // alpha enters as -alpha (target = target - alpha x) or 1 / alpha (target = x / alpha)
+    bool negate = false;
+    bool reciprocal = false;
+};
+
+// Matches a whole-array assignment, or a declaration with a value, onto a kernel that writes
+// into the target. Products are not matched when the target is also an operand, since they
+// write the result while still reading their operands; the element-wise kernels read each
+// element before writing it.
+bool matchInPlaceUpdate(IRNode *assignment, const ProgramTypes &types, const Scope &scope, InPlaceUpdate &update);
+// Vector and Matrix locals of function that may keep one buffer across the iterations of
+// loop: private to the loop (overwritten before any read in every iteration, unused after
+// it), only assigned fresh operator results, and only read by operators, indexing and
+// built-ins, so no other name or caller ever holds the same array.
+std::set<std::string> reusableBuffers(IRNode *function, IRNode *loop, const Scope &scope);
+
+// Dependence test for the for loops of one program. Arrays may only be stored at
+// the loop variable (a[i] = ...) and then only read at that same index; every
+// other scalar written in the body must be a reduction or a private. Calls are
+// allowed only to functions that perform no I/O and store into no parameter.
+class LoopAnalyzer
+{
+public:
+    explicit LoopAnalyzer(const ProgramTypes &types);
+
+    LoopAnalysis analyze(IRNode *function, IRNode *loop, const Scope &scope) const;
+    bool isPure(const std::string &function) const { return pure.count(function) > 0; }
+    // Applies the options, and the profile when one is loaded, to an analyzed loop
+    bool shouldParallelize(const LoopAnalysis &loop, const ParallelOptions &options, const Profile *profile,
+                           const std::string &function, int line) const;
+    bool useDynamicSchedule(const LoopAnalysis &loop, const ParallelOptions &options) const;
+    bool shouldVectorize(const LoopAnalysis &loop, const ParallelOptions &options) const;
+
+private:
+    const ProgramTypes &types;
+    std::set<std::string> pure;
+
+    bool callsArePure(IRNode *node, std::string &offender) const;
+    bool checkVectorizable(IRNode *node, const std::string &variable, const Scope &scope) const;
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "builtins.h"
+
+namespace
+{
+    const Builtin BUILTINS[] = {
+        {"load_data", "loadCSV", ValueKind::MATRIX, false},
+        {"load_labels", "loadLabels", ValueKind::VECTOR, false},
+        {"load_sparse", "loadSparse", ValueKind::SPARSE_MATRIX, false},
+        {"sgd_train", "sgdTrain", ValueKind::VECTOR, true},
+        {"hogwild_train", "hogwildTrain", ValueKind::VECTOR, true},
+        {"save_model", "saveModel", ValueKind::VOID, false},
+        {"load_model", "loadModel", ValueKind::VECTOR, false},
+        {"print", "print", ValueKind::VOID, false},
+        {"min", "minimum", ValueKind::FLOAT, true},
+        {"max", "maximum", ValueKind::FLOAT, true},
+    };
+}
+
+const Builtin *findBuiltin(const std::string &name)
+{
+    for (const auto &builtin : BUILTINS)
+    {
+        if (name == builtin.name)
+            return &builtin;
+    }
+    return nullptr;
+}
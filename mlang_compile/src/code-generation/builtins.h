@@ -0,0 +1,21 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <string>
+#include "types.h"
+
+// Functions every MLang program can call without defining them
+struct Builtin
+{
+    const char *name;
+    // Function of the native runtime (runtime/runtime.h) that implements it
+    const char *runtimeName;
+    ValueKind result;
+    // False if the call performs I/O, so it must stay in program order
+    bool pure;
+};
+
+// Returns nullptr if the name is not a built-in
+const Builtin *findBuiltin(const std::string &name);
+
+#endif
@@ -0,0 +1,770 @@
+#include "codegen.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <set>
+
+std::string ASTPythonGenerator::getIndent()
+{
+    return std::string(indentLevel * 4, ' ');
+}
+
+std::string ASTPythonGenerator::simplifyExpression(const std::string &expr)
+{
+    // Simple optimizations
+    if (expr == "0 + 0")
+        return "0";
+    if (expr == "a + 0" || expr == "0 + a")
+        return "a";
+    if (expr == "a * 1" || expr == "1 * a")
+        return "a";
+    if (expr == "a * 0" || expr == "0 * a")
+        return "0";
+
+    // Constant folding
+    std::istringstream iss(expr);
+    std::string token;
+    std::vector<std::string> tokens;
+
+    while (iss >> token)
+    {
+        tokens.push_back(token);
+    }
+
+    if (tokens.size() == 3 && (tokens[1] == "+" || tokens[1] == "-" || tokens[1] == "*" || tokens[1] == "/"))
+    {
+        try
+        {
+            // Only whole integer literals; stoi would read "1.5" as 1. MLang division is real division.
+            size_t lhsEnd = 0;
+            size_t rhsEnd = 0;
+            int lhs = std::stoi(tokens[0], &lhsEnd);
+            int rhs = std::stoi(tokens[2], &rhsEnd);
+            if (lhsEnd != tokens[0].size() || rhsEnd != tokens[2].size())
+                return expr;
+            if (tokens[1] == "+")
+                return std::to_string(lhs + rhs);
+            if (tokens[1] == "-")
+                return std::to_string(lhs - rhs);
+            if (tokens[1] == "*")
+                return std::to_string(lhs * rhs);
+        }
+        catch (const std::exception &)
+        {
+            // Non-integer expressions are skipped
+        }
+    }
+
+    return expr; // Return the original if no optimization is applied
+}
+
+void ASTPythonGenerator::setDiagnostics(Diagnostics *sink, uint32_t file)
+{
+    diagnostics = sink;
+    sourceFile = file;
+}
+
+std::string ASTPythonGenerator::locate(IRNode *node)
+{
+    return locationTag(node->line, node->column);
+}
+
+std::string ASTPythonGenerator::resolveLocations(const std::string &code)
+{
+    return resolveLocationTags(code, sourceMap, lineComments ? "  # " : "");
+}
+
+std::string ASTPythonGenerator::defineRegion(RegionKind kind, IRNode *node, const std::string &name)
+{
+    std::string region = "_mlang_r" + std::to_string(regions.size());
+    regions.push_back(region + " = _mlang_region(" + std::to_string(static_cast<int>(kind)) + ", " +
+                      std::to_string(std::max(node->line, 0)) + ", \"" + name + "\")\n");
+    return region;
+}
+
+std::string ASTPythonGenerator::instrumentationPrelude()
+{
+    // Writes the same "MLPF" file as the native runtime (runtime/profile.h)
+    std::ostringstream python;
+    python << "import atexit as _mlang_atexit\n"
+           << "import os as _mlang_os\n"
+           << "import struct as _mlang_struct\n"
+           << "from time import perf_counter_ns as _mlang_clock\n\n"
+           << "# [kind, line, name, count, iterations, nanoseconds, bytes] per instrumented region\n"
+           << "_mlang_regions = []\n\n"
+           << "def _mlang_region(kind, line, name):\n"
+           << "    region = [kind, line, name, 0, 0, 0, 0]\n"
+           << "    _mlang_regions.append(region)\n"
+           << "    return region\n\n"
+           << "def _mlang_write_profile():\n"
+           << "    path = _mlang_os.environ.get(\"MLANG_PROFILE\", \"mlang.profile\")\n"
+           << "    with open(path, \"wb\") as out:\n"
+           << "        out.write(b\"MLPF\" + _mlang_struct.pack(\"<II\", 1, len(_mlang_regions)))\n"
+           << "        for kind, line, name, count, iterations, nanoseconds, nbytes in _mlang_regions:\n"
+           << "            encoded = name.encode()\n"
+           << "            out.write(_mlang_struct.pack(\"<BIH\", kind, line, len(encoded)) + encoded)\n"
+           << "            out.write(_mlang_struct.pack(\"<QQQQ\", count, iterations, nanoseconds, nbytes))\n\n"
+           << "_mlang_atexit.register(_mlang_write_profile)\n\n";
+    for (const auto &region : regions)
+    {
+        python << region;
+    }
+    python << "\n";
+    return python.str();
+}
+
+std::string ASTPythonGenerator::parallelPrelude()
+{
+    std::ostringstream python;
+    if (usesNumpy)
+    {
+        python << "import numpy as np\n";
+    }
+    if (usesThreads)
+    {
+        // Threads only overlap where the loop body releases the GIL (NumPy kernels, I/O)
+        python << "import concurrent.futures as _mlang_futures\n"
+               << "import os as _mlang_os\n\n"
+               << "_mlang_threads = _mlang_os.cpu_count() or 1\n"
+               << "_mlang_pool = _mlang_futures.ThreadPoolExecutor(_mlang_threads)\n\n"
+               << "def _mlang_parallel(body, lo, hi, chunks, grain):\n"
+               << "    # Runs body(begin, end) over consecutive chunks of range(lo, hi); results come back in chunk order\n"
+               << "    count = max(1, min(chunks, (hi - lo) // max(grain, 1)))\n"
+               << "    if count == 1:\n"
+               << "        return [body(lo, hi)]\n"
+               << "    size = -(-(hi - lo) // count)\n"
+               << "    return list(_mlang_pool.map(lambda begin: body(begin, min(begin + size, hi)), range(lo, hi, size)))\n";
+    }
+    if (usesBuffers)
+    {
+        // Same value as the Python operator; results of array operands go into out when it already fits them
+        python << "import operator as _mlang_operator\n\n"
+               << "_mlang_operators = {np.add: _mlang_operator.add, np.subtract: _mlang_operator.sub,\n"
+               << "                    np.multiply: _mlang_operator.mul, np.true_divide: _mlang_operator.truediv}\n\n"
+               << "def _mlang_into(ufunc, a, b, out):\n"
+               << "    operands = (type(a), type(b))\n"
+               << "    if isinstance(out, np.ndarray) and np.ndarray in operands and list not in operands:\n"
+               << "        if out.shape == np.broadcast(a, b).shape and out.dtype == np.result_type(a, b):\n"
+               << "            return ufunc(a, b, out=out)\n"
+               << "    return _mlang_operators[ufunc](a, b)\n";
+    }
+    if (usesNumpy || usesThreads)
+    {
+        python << "\n";
+    }
+    return python.str();
+}
+
+std::string ASTPythonGenerator::generateProgram(IRNode *root)
+{
+    sourceMap.entries.clear();
+    regions.clear();
+    loopCounter = 0;
+    usesNumpy = false;
+    usesThreads = false;
+    usesBuffers = false;
+    buffers.clear();
+    types = std::make_unique<ProgramTypes>(root);
+    analyzer = std::make_unique<LoopAnalyzer>(*types);
+    std::string pythonCode;
+    for (auto child : root->children)
+    {
+        if (child->type == "FUNCTION_DEFINITION")
+        {
+            pythonCode += generatePython(child);
+            pythonCode += "\n";
+        }
+    }
+    if (instrument)
+    {
+        pythonCode = instrumentationPrelude() + pythonCode;
+    }
+    pythonCode = parallelPrelude() + pythonCode;
+    return resolveLocations(pythonCode);
+}
+
+bool ASTPythonGenerator::isHotLoop(const std::string &function, const std::string &loopVar, int line,
+                                   uint64_t minIterations, double minShare) const
+{
+    return ::isHotLoop(profile, function, loopVar, line, minIterations, minShare);
+}
+
+void ASTPythonGenerator::reportProfile(size_t limit)
+{
+    if (!profile || !diagnostics)
+        return;
+    std::vector<const ProfileRegion *> hottest;
+    for (const auto &region : profile->regions)
+    {
+        if (region.count > 0)
+            hottest.push_back(&region);
+    }
+    std::sort(hottest.begin(), hottest.end(), [](const ProfileRegion *a, const ProfileRegion *b)
+              { return a->nanoseconds > b->nanoseconds; });
+
+    double total = static_cast<double>(std::max<uint64_t>(profile->totalNanoseconds(), 1));
+    for (size_t i = 0; i < hottest.size() && i < limit; ++i)
+    {
+        const ProfileRegion &region = *hottest[i];
+        std::ostringstream message;
+        message << (region.kind == RegionKind::LOOP ? "loop " : "fn ") << region.name << ": "
+                << static_cast<int>(100.0 * region.nanoseconds / total + 0.5) << "% of run time, "
+                << region.count << (region.kind == RegionKind::LOOP ? " entries, " : " calls, ")
+                << region.iterations << " iterations, " << region.bytes << " bytes";
+        int line = static_cast<int>(region.line);
+        diagnostics->report(sourceFile, Severity::NOTE, DiagnosticCode::PROFILE, {line, 1, line, 1}, message.str());
+    }
+}
+
+std::string ASTPythonGenerator::generatePython(IRNode *node)
+{
+    if (!node)
+        return "";
+    std::ostringstream python;
+
+    if (node->type == "FUNCTION_DEFINITION")
+    {
+        python << generateFunctionDefinition(node);
+        indentLevel = 0;
+    }
+    else if (node->type == "FOR_LOOP")
+    {
+        python << generateForLoop(node);
+    }
+    else if (node->type == "ASSIGNMENT_EXPRESSION")
+    {
+        python << generateAssignment(node);
+    }
+    else if (node->type == "RETURN_STATEMENT")
+    {
+        python << generateReturnStatement(node);
+    }
+    else if (node->type == "VARIABLE_DECLARATION")
+    {
+        python << generateDeclaration(node);
+    }
+    else if (node->type == "FUNCTION_CALL" || node->type == "METHOD_CALL")
+    {
+        python << generateCallStatement(node);
+    }
+    else
+    {
+        for (auto child : node->children)
+        {
+            python << generatePython(child);
+        }
+    }
+
+    return python.str();
+}
+
+std::string ASTPythonGenerator::generateFunctionDefinition(IRNode *node)
+{
+    std::ostringstream python;
+    std::string funcName, returnType;
+    std::vector<std::string> params;
+
+    for (auto child : node->children)
+    {
+        if (child->type == "FUNCTION_NAME")
+        {
+            funcName = child->value;
+        }
+        else if (child->type == "RETURN_TYPE")
+        {
+            returnType = child->value;
+            std::transform(returnType.begin(), returnType.end(), returnType.begin(),
+                           [](unsigned char c)
+                           { return std::tolower(c); });
+        }
+        else if (child->type == "PARAMETERS")
+        {
+            for (auto param : child->children)
+            {
+                std::string paramName = param->value;
+                std::string paramType = "";
+                size_t typePos = paramName.find(" (TYPE:");
+                if (typePos != std::string::npos)
+                {
+                    paramType = paramName.substr(typePos + 7);
+                    paramName = paramName.substr(0, typePos);
+                    if (!paramType.empty() && paramType.back() == ')')
+                    {
+                        paramType.pop_back();
+                    }
+                    std::transform(paramType.begin(), paramType.end(), paramType.begin(),
+                                   [](unsigned char c)
+                                   { return std::tolower(c); });
+                    params.push_back(paramName + ": " + paramType);
+                }
+                else
+                {
+                    params.push_back(paramName);
+                }
+            }
+        }
+    }
+
+    python << locate(node) << getIndent() << "def " << funcName << "(" << join(params, ", ") << ")"
+           << (returnType.empty() ? "" : " -> " + returnType) << ":\n";
+    indentLevel++;
+    currentFunction = funcName;
+    currentDefinition = node;
+    scope = types ? types->locals(node) : Scope();
+    std::string region;
+    if (instrument)
+    {
+        region = defineRegion(RegionKind::FUNCTION, node, funcName);
+        python << getIndent() << "_mlang_start = _mlang_clock()\n";
+        python << getIndent() << "try:\n";
+        indentLevel++;
+    }
+
+    std::string body;
+    for (auto child : node->children)
+    {
+        if (child->type == "FUNCTION_BODY")
+        {
+            body += generatePython(child);
+        }
+    }
+    if (body.empty() && !instrument)
+        body = getIndent() + "pass\n";
+    python << body;
+
+    if (instrument)
+    {
+        if (body.empty())
+            python << getIndent() << "pass\n";
+        indentLevel--;
+        python << locate(node) << getIndent() << "finally:\n";
+        python << getIndent() << "    " << region << "[3] += 1\n";
+        python << getIndent() << "    " << region << "[5] += _mlang_clock() - _mlang_start\n";
+    }
+    indentLevel--;
+    return python.str();
+}
+
+std::string ASTPythonGenerator::generateForLoop(IRNode *node)
+{
+    std::ostringstream python;
+    ForLoopParts parts = forLoopParts(node);
+    if (parts.variable.empty() || !parts.start || !parts.end)
+    {
+        if (diagnostics)
+        {
+            diagnostics->report(sourceFile, Severity::WARNING, DiagnosticCode::MALFORMED_AST,
+                                {node->line, node->column, node->line, node->column + 3},
+                                "Dropping 'for' loop with a missing loop variable or range");
+        }
+        return "";
+    }
+    std::string loopVar = parts.variable;
+    std::string rangeStart = generateExpression(parts.start);
+    std::string rangeEnd = generateExpression(parts.end);
+
+    LoopAnalysis analysis;
+    bool vectorized = false;
+    bool parallelLoop = false;
+    if (analyzer && currentDefinition && parallelDepth == 0)
+    {
+        analysis = analyzer->analyze(currentDefinition, node, scope);
+        vectorized = analyzer->shouldVectorize(analysis, parallel);
+        parallelLoop = !vectorized && analyzer->shouldParallelize(analysis, parallel, profile, currentFunction, node->line);
+    }
+
+    std::string region;
+    std::string start;
+    if (instrument)
+    {
+        // Iterations are counted once per entry from the range, not per iteration
+        region = defineRegion(RegionKind::LOOP, node, currentFunction + "/" + loopVar);
+        start = "_mlang_start" + region.substr(std::string("_mlang_r").size());
+        python << locate(node) << getIndent() << start << " = _mlang_clock()\n";
+        python << getIndent() << region << "[3] += 1\n";
+        python << getIndent() << region << "[4] += len(range(" << rangeStart << ", " << rangeEnd << "))\n";
+        python << getIndent() << "try:\n";
+        indentLevel++;
+    }
+
+    if (vectorized)
+    {
+        python << generateVectorizedLoop(node, parts, analysis, rangeStart, rangeEnd);
+    }
+    else if (parallelLoop)
+    {
+        python << generateThreadedLoop(node, parts, analysis, rangeStart, rangeEnd);
+    }
+    else
+    {
+        // Buffers start out empty; the first iteration allocates them and later ones write into them
+        std::set<std::string> reused;
+        if (currentDefinition && parallelDepth == 0)
+        {
+            for (const auto &buffer : reusableBuffers(currentDefinition, node, scope))
+            {
+                if (buffers.insert(buffer).second)
+                {
+                    reused.insert(buffer);
+                    python << locate(node) << getIndent() << buffer << " = None\n";
+                }
+            }
+        }
+        python << locate(node) << getIndent() << "for " << loopVar << " in range(" << rangeStart << ", " << rangeEnd << "):\n";
+        indentLevel++;
+        python << generateLoopBody(parts.body);
+        indentLevel--;
+        for (const auto &buffer : reused)
+        {
+            buffers.erase(buffer);
+        }
+    }
+
+    if (instrument)
+    {
+        indentLevel--;
+        python << locate(node) << getIndent() << "finally:\n";
+        python << getIndent() << "    " << region << "[5] += _mlang_clock() - " << start << "\n";
+    }
+    return python.str();
+}
+
+std::string ASTPythonGenerator::generateLoopBody(IRNode *body)
+{
+    std::string python;
+    for (auto statement : blockStatements(body))
+    {
+        python += generatePython(statement);
+    }
+    return python.empty() ? getIndent() + "pass\n" : python;
+}
+
+std::string ASTPythonGenerator::generateVectorizedLoop(IRNode *node, const ForLoopParts &parts, const LoopAnalysis &analysis,
+                                                       const std::string &lower, const std::string &upper)
+{
+    std::ostringstream python;
+    std::string suffix = std::to_string(loopCounter++);
+    usesNumpy = true;
+
+    // Bounds are evaluated once, as range() would
+    VectorLoop loop{parts.variable, lower, upper, {}};
+    if (!isIdentifierNode(parts.start) && parts.start->type != "LITERAL_VALUE")
+    {
+        loop.lower = "_mlang_lo" + suffix;
+        python << locate(node) << getIndent() << loop.lower << " = " << lower << "\n";
+    }
+    if (!isIdentifierNode(parts.end) && parts.end->type != "LITERAL_VALUE")
+    {
+        loop.upper = "_mlang_hi" + suffix;
+        python << getIndent() << loop.upper << " = " << upper << "\n";
+    }
+
+    for (auto statement : blockStatements(parts.body))
+    {
+        if (findChild(statement, "INDEX"))
+            loop.stored.insert(findChild(statement, "IDENTIFIER")->value);
+    }
+
+    // Statements whose value changes per iteration become arrays; loop-invariant ones stay scalars
+    std::set<std::string> varying = {parts.variable};
+    for (auto statement : blockStatements(parts.body))
+    {
+        bool declaration = statement->type == "VARIABLE_DECLARATION";
+        std::string name = declaration ? splitTypedName(statement->children[0]->value).first
+                                       : findChild(statement, "IDENTIFIER")->value;
+        IRNode *value = declaration ? statement->children[1] : findChild(statement, "EXPRESSION")->children[0];
+        const Reduction *reduction = nullptr;
+        for (const auto &candidate : analysis.reductions)
+        {
+            if (candidate.variable == name)
+                reduction = &candidate;
+        }
+
+        python << locate(statement) << getIndent();
+        vectorLoop = &loop;
+        if (reduction)
+        {
+            std::string op;
+            IRNode *operand = reductionOperand(statement, name, op);
+            std::string kernel;
+            if (op == "min" || op == "max")
+                kernel = "np." + op + "(" + generateExpression(operand) + ")";
+            else if (op == "*")
+                kernel = "np.prod(" + generateExpression(operand) + ")";
+            else if (isDotProductTerm(operand, parts.variable))
+                kernel = "np.dot(" + generateExpression(operand->children[0]) + ", " + generateExpression(operand->children[1]) + ")";
+            else
+                kernel = "np.sum(" + generateExpression(operand) + ")";
+            // np.min and np.max reject empty ranges, which leave the accumulator unchanged
+            if (op == "min" || op == "max")
+                python << name << " = " << op << "(" << name << ", " << kernel << ") if " << loop.upper << " > " << loop.lower
+                       << " else " << name << "\n";
+            else
+                python << name << " = " << name << " " << op << " " << kernel << "\n";
+        }
+        else if (findChild(statement, "INDEX"))
+        {
+            std::string slice = name + "[" + loop.lower + ":" + loop.upper + "]";
+            if (referencesAny(value, varying))
+                python << slice << " = " << generateExpression(value) << "\n";
+            else
+                python << slice << " = np.full(len(range(" << loop.lower << ", " << loop.upper << ")), " << generateExpression(value) << ")\n";
+        }
+        else
+        {
+            python << name << " = " << generateExpression(value) << "\n";
+            if (referencesAny(value, varying))
+                varying.insert(name);
+        }
+        vectorLoop = nullptr;
+    }
+    return python.str();
+}
+
+std::string ASTPythonGenerator::generateThreadedLoop(IRNode *node, const ForLoopParts &parts, const LoopAnalysis &analysis,
+                                                     const std::string &lower, const std::string &upper)
+{
+    std::ostringstream python;
+    std::string suffix = std::to_string(loopCounter++);
+    std::string helper = "_mlang_loop" + suffix;
+    usesThreads = true;
+
+    // The chunk body is a nested function: privates and partial sums become its locals,
+    // element stores still reach the enclosing function's arrays
+    python << locate(node) << getIndent() << "def " << helper << "(_mlang_lo, _mlang_hi):\n";
+    indentLevel++;
+    std::vector<std::string> results;
+    for (const auto &reduction : analysis.reductions)
+    {
+        std::string identity = reduction.op == "*" ? "1" : "0";
+        if (reduction.kind == ValueKind::FLOAT)
+            identity += ".0";
+        if (reduction.op == "min" || reduction.op == "max")
+            identity = reduction.op == "min" ? "float(\"inf\")" : "-float(\"inf\")";
+        python << getIndent() << reduction.variable << " = " << identity << "\n";
+        results.push_back(reduction.variable);
+    }
+    python << getIndent() << "for " << parts.variable << " in range(_mlang_lo, _mlang_hi):\n";
+    indentLevel++;
+    parallelDepth++;
+    python << generateLoopBody(parts.body);
+    parallelDepth--;
+    indentLevel--;
+    if (!results.empty())
+    {
+        python << getIndent() << "return " << join(results, ", ") << "\n";
+    }
+    indentLevel--;
+
+    bool dynamic = analyzer->useDynamicSchedule(analysis, parallel);
+    std::string call = "_mlang_parallel(" + helper + ", " + lower + ", " + upper + ", " +
+                       (dynamic ? "_mlang_threads * 8" : "_mlang_threads") + ", " +
+                       std::to_string(std::max(1LL, parallel.minTripCount / 2)) + ")";
+    if (results.empty())
+    {
+        python << getIndent() << call << "\n";
+        return python.str();
+    }
+
+    // Partials are combined in chunk order, so the result does not depend on thread timing
+    std::string partial = "_mlang_partial" + suffix;
+    python << getIndent() << "for " << partial << " in " << call << ":\n";
+    for (size_t i = 0; i < analysis.reductions.size(); ++i)
+    {
+        const Reduction &reduction = analysis.reductions[i];
+        std::string value = results.size() == 1 ? partial : partial + "[" + std::to_string(i) + "]";
+        if (reduction.op == "min" || reduction.op == "max")
+            python << getIndent() << "    " << reduction.variable << " = " << reduction.op << "(" << reduction.variable << ", " << value << ")\n";
+        else
+            python << getIndent() << "    " << reduction.variable << " = " << reduction.variable << " "
+                   << (reduction.op == "*" ? "*" : "+") << " " << value << "\n";
+    }
+    return python.str();
+}
+
+namespace
+{
+    int precedence(const IRNode *node)
+    {
+        if (node->type != "OPERATOR")
+            return node->type == "UNARY_OPERATOR" ? 3 : 4;
+        return node->value == "*" || node->value == "/" ? 2 : 1;
+    }
+}
+
+std::string ASTPythonGenerator::generateArguments(IRNode *node)
+{
+    std::vector<std::string> arguments;
+    IRNode *list = findChild(node, "ARGUMENTS");
+    if (list)
+    {
+        for (auto argument : list->children)
+        {
+            arguments.push_back(generateExpression(argument));
+        }
+    }
+    return "(" + join(arguments, ", ") + ")";
+}
+
+std::string ASTPythonGenerator::generateExpression(IRNode *node)
+{
+    std::ostringstream expression;
+    if (node->type == "EXPRESSION")
+    {
+        for (auto child : node->children)
+        {
+            expression << generateExpression(child);
+        }
+    }
+    else if (node->type == "OPERATOR")
+    {
+        if (node->children.size() == 2)
+        {
+            std::string left = generateExpression(node->children[0]);
+            std::string right = generateExpression(node->children[1]);
+            // Operators are left-associative, so an equal-precedence right operand keeps its parentheses
+            if (precedence(node->children[0]) < precedence(node))
+                left = "(" + left + ")";
+            if (precedence(node->children[1]) <= precedence(node) && node->children[1]->type == "OPERATOR")
+                right = "(" + right + ")";
+            expression << simplifyExpression(left + " " + node->value + " " + right);
+        }
+    }
+    else if (node->type == "UNARY_OPERATOR" && !node->children.empty())
+    {
+        std::string operand = generateExpression(node->children[0]);
+        expression << node->value << (node->children[0]->type == "OPERATOR" ? "(" + operand + ")" : operand);
+    }
+    else if (vectorLoop && node->type == "LITERAL_VALUE" && node->value == vectorLoop->variable)
+    {
+        expression << "np.arange(" << vectorLoop->lower << ", " << vectorLoop->upper << ")";
+    }
+    else if (vectorLoop && node->type == "INDEX_EXPRESSION" && node->children.size() == 2)
+    {
+        // Lists and arrays alike: slice the iteration range, then view it as an array. A temporary
+        // holding a view of an array the body stores into would see the later store, so copy those.
+        std::string base = generateExpression(node->children[0]);
+        expression << (vectorLoop->stored.count(base) ? "np.array(" : "np.asarray(") << base << "[" << vectorLoop->lower << ":"
+                   << vectorLoop->upper << "])";
+    }
+    else if (node->type == "INDEX_EXPRESSION" && node->children.size() == 2)
+    {
+        expression << generateExpression(node->children[0]) << "[" << generateExpression(node->children[1]) << "]";
+    }
+    else if (node->type == "MEMBER_ACCESS" && !node->children.empty())
+    {
+        expression << generateExpression(node->children[0]) << "." << node->value;
+    }
+    else if (node->type == "METHOD_CALL" && !node->children.empty())
+    {
+        expression << generateExpression(node->children[0]) << "." << node->value << generateArguments(node);
+    }
+    else if (node->type == "FUNCTION_CALL")
+    {
+        expression << node->value << generateArguments(node);
+    }
+    else if (node->type == "VECTOR_LITERAL")
+    {
+        std::vector<std::string> elements;
+        for (auto child : node->children)
+        {
+            elements.push_back(generateExpression(child));
+        }
+        expression << "[" << join(elements, ", ") << "]";
+    }
+    else if (node->type == "LITERAL_VALUE" || node->type == "IDENTIFIER")
+    {
+        expression << node->value;
+    }
+    return expression.str();
+}
+
+std::string ASTPythonGenerator::generateAssignment(IRNode *node)
+{
+    std::ostringstream python;
+    std::string variable;
+    std::string value;
+
+    for (auto child : node->children)
+    {
+        if (child->type == "IDENTIFIER")
+        {
+            variable = child->value;
+        }
+        if (child->type == "INDEX" && !child->children.empty())
+        {
+            variable += "[" + generateExpression(child->children[0]) + "]";
+        }
+        if (child->type == "EXPRESSION")
+        {
+            value = generateExpression(child);
+        }
+    }
+
+    static const std::map<std::string, std::string> UFUNCS = {
+        {"+", "np.add"}, {"-", "np.subtract"}, {"*", "np.multiply"}, {"/", "np.true_divide"}};
+    IRNode *expression = findChild(node, "EXPRESSION");
+    IRNode *operation = expression && expression->children.size() == 1 ? expression->children[0] : nullptr;
+    // A SciPy sparse operand makes "*" a matrix product, which has no out= form
+    if (buffers.count(variable) && parallelDepth == 0 && operation && operation->type == "OPERATOR" &&
+        operation->children.size() == 2 && UFUNCS.count(operation->value) &&
+        types->infer(operation->children[0], scope) != ValueKind::SPARSE_MATRIX &&
+        types->infer(operation->children[1], scope) != ValueKind::SPARSE_MATRIX)
+    {
+        usesNumpy = true;
+        usesBuffers = true;
+        value = "_mlang_into(" + UFUNCS.at(operation->value) + ", " + generateExpression(operation->children[0]) + ", " +
+                generateExpression(operation->children[1]) + ", " + variable + ")";
+    }
+
+    if (!variable.empty() && !value.empty())
+    {
+        python << locate(node) << getIndent() << variable << " = " << simplifyExpression(value) << "\n";
+    }
+
+    return python.str();
+}
+
+std::string ASTPythonGenerator::generateReturnStatement(IRNode *node)
+{
+    std::ostringstream python;
+    if (node->children.empty())
+    {
+        python << locate(node) << getIndent() << "return\n";
+        return python.str();
+    }
+    std::string expr = generateExpression(node->children[0]);
+    python << locate(node) << getIndent() << "return " << simplifyExpression(expr) << "\n";
+    return python.str();
+}
+
+std::string ASTPythonGenerator::generateDeclaration(IRNode *node)
+{
+    std::ostringstream python;
+    if (node->children.empty())
+        return "";
+    std::string name = splitTypedName(node->children[0]->value).first;
+    std::string value = node->children.size() > 1 ? simplifyExpression(generateExpression(node->children[1])) : "None";
+    python << locate(node) << getIndent() << name << " = " << value << "\n";
+    return python.str();
+}
+
+std::string ASTPythonGenerator::generateCallStatement(IRNode *node)
+{
+    std::ostringstream python;
+    python << locate(node) << getIndent() << generateExpression(node) << "\n";
+    return python.str();
+}
+
+std::string ASTPythonGenerator::join(const std::vector<std::string> &vec, const std::string &delim)
+{
+    std::ostringstream result;
+    for (size_t i = 0; i < vec.size(); ++i)
+    {
+        if (i > 0)
+            result << delim;
+        result << vec[i];
+    }
+    return result.str();
+}
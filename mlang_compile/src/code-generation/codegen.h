@@ -0,0 +1,98 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "analysis.h"
+#include "ir.h"
+#include "sourcemap.h"
+#include "../runtime/profile.h"
+#include "../lexical-analysis/errors/diagnostics.h"
+
+class ASTPythonGenerator
+{
+private:
+    int indentLevel = 0;
+    Diagnostics *diagnostics = nullptr;
+    uint32_t sourceFile = 0;
+    bool lineComments = false;
+    SourceMap sourceMap;
+    bool instrument = false;
+    const Profile *profile = nullptr;
+    std::string currentFunction;
+    // Module-level region definitions of the instrumented program, one per fn and for
+    std::vector<std::string> regions;
+    ParallelOptions parallel;
+    std::unique_ptr<ProgramTypes> types;
+    std::unique_ptr<LoopAnalyzer> analyzer;
+    IRNode *currentDefinition = nullptr;
+    Scope scope;
+    // Loops nested in a parallel loop stay sequential; the chunk already runs on a pool thread
+    int parallelDepth = 0;
+    int loopCounter = 0;
+    bool usesNumpy = false;
+    bool usesThreads = false;
+    bool usesBuffers = false;
+    // Arrays of the enclosing sequential loops that keep one buffer across iterations (see reusableBuffers)
+    std::set<std::string> buffers;
+    // Set while a loop body is rewritten into whole-array NumPy operations
+    struct VectorLoop
+    {
+        std::string variable;
+        std::string lower;
+        std::string upper;
+        // Arrays the body stores into; reading one must copy the slice, not view it
+        std::set<std::string> stored;
+    };
+    const VectorLoop *vectorLoop = nullptr;
+    std::string getIndent();
+    std::string simplifyExpression(const std::string &expr);
+    // Tags the start of a generated statement with the node's source position;
+    // generateProgram strips the tags and turns them into the line table
+    std::string locate(IRNode *node);
+    std::string resolveLocations(const std::string &code);
+    std::string defineRegion(RegionKind kind, IRNode *node, const std::string &name);
+    std::string instrumentationPrelude();
+    std::string parallelPrelude();
+    std::string generateLoopBody(IRNode *body);
+    std::string generateVectorizedLoop(IRNode *node, const ForLoopParts &parts, const LoopAnalysis &analysis,
+                                       const std::string &lower, const std::string &upper);
+    std::string generateThreadedLoop(IRNode *node, const ForLoopParts &parts, const LoopAnalysis &analysis,
+                                     const std::string &lower, const std::string &upper);
+    std::string generateArguments(IRNode *node);
+
+public:
+    // Warnings about constructs the generator has to drop are reported here
+    void setDiagnostics(Diagnostics *sink, uint32_t file);
+    // Appends "# line N" to every generated line that starts an MLang statement
+    void setLineComments(bool enabled) { lineComments = enabled; }
+    void setSourceName(const std::string &name) { sourceMap.sourceName = name; }
+    // Line table of the last generateProgram call
+    const SourceMap &getSourceMap() const { return sourceMap; }
+    // Counts calls, loop iterations and time of every fn and for, written to $MLANG_PROFILE at exit
+    void setInstrumentation(bool enabled) { instrument = enabled; }
+    // Lowers independent and reduction loops to NumPy array operations or chunks on a thread pool
+    void setParallelOptions(const ParallelOptions &options) { parallel = options; }
+    // Profile of an earlier instrumented run; guides hot-loop decisions (see isHotLoop)
+    void setProfile(const Profile *data) { profile = data; }
+    // A loop is hot if it ran at least minIterations per entry and took minShare of the run time
+    bool isHotLoop(const std::string &function, const std::string &loopVar, int line,
+                   uint64_t minIterations = 1024, double minShare = 0.05) const;
+    // Notes the hottest functions and loops of the loaded profile in the diagnostics
+    void reportProfile(size_t limit = 5);
+    std::string generateProgram(IRNode *root);
+    std::string generatePython(IRNode *node);
+    std::string generateFunctionDefinition(IRNode *node);
+    std::string generateForLoop(IRNode *node);
+    std::string generateExpression(IRNode *node);
+    std::string generateAssignment(IRNode *node);
+    std::string generateReturnStatement(IRNode *node);
+    std::string generateDeclaration(IRNode *node);
+    std::string generateCallStatement(IRNode *node);
+    std::string join(const std::vector<std::string> &vec, const std::string &delim);
+};
+
+#endif
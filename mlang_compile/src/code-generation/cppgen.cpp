@@ -0,0 +1,657 @@
+#include "cppgen.h"
+#include "builtins.h"
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+namespace
+{
+    const std::set<std::string> CPP_KEYWORDS = {
+        "and", "asm", "auto", "bool", "break", "case", "catch", "char", "class", "const", "continue",
+        "default", "delete", "do", "double", "else", "enum", "explicit", "extern", "false", "float",
+        "for", "friend", "goto", "if", "inline", "int", "long", "namespace", "new", "not", "nullptr",
+        "operator", "or", "private", "protected", "public", "register", "return", "short", "signed",
+        "sizeof", "static", "struct", "switch", "template", "this", "throw", "true", "try", "typedef",
+        "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "while", "xor"};
+
+    int precedence(const IRNode *node)
+    {
+        if (node->type != "OPERATOR")
+            return node->type == "UNARY_OPERATOR" ? 3 : 4;
+        return node->value == "*" || node->value == "/" ? 2 : 1;
+    }
+
+    std::string identity(const Reduction &reduction)
+    {
+        std::string type = cppTypeName(reduction.kind);
+        if (reduction.op == "min")
+            return reduction.kind == ValueKind::FLOAT ? "std::numeric_limits<double>::infinity()" : "std::numeric_limits<" + type + ">::max()";
+        if (reduction.op == "max")
+            return reduction.kind == ValueKind::FLOAT ? "-std::numeric_limits<double>::infinity()" : "std::numeric_limits<" + type + ">::lowest()";
+        std::string value = reduction.op == "*" ? "1" : "0";
+        return reduction.kind == ValueKind::FLOAT ? value + ".0" : value;
+    }
+
+    // Folds a partial result into the accumulator; "-" partials already carry their sign
+    std::string combine(const Reduction &reduction, const std::string &accumulator, const std::string &partial)
+    {
+        if (reduction.op == "min" || reduction.op == "max")
+            return accumulator + " = ::" + (reduction.op == "min" ? "minimum" : "maximum") + "(" + accumulator + ", " + partial + ")";
+        return accumulator + " = " + accumulator + " " + (reduction.op == "*" ? "*" : "+") + " " + partial;
+    }
+}
+
+void ASTCppGenerator::setDiagnostics(Diagnostics *sink, uint32_t file)
+{
+    diagnostics = sink;
+    sourceFile = file;
+}
+
+std::string ASTCppGenerator::getIndent()
+{
+    return std::string(indentLevel * 4, ' ');
+}
+
+void ASTCppGenerator::typeError(const std::string &message)
+{
+    if (!diagnostics)
+        return;
+    int line = currentStatement ? currentStatement->line : 0;
+    int column = currentStatement ? currentStatement->column : 0;
+    diagnostics->error(sourceFile, DiagnosticCode::TYPE_ERROR, {line, column, line, column}, message);
+}
+
+std::string ASTCppGenerator::name(const std::string &identifier)
+{
+    return CPP_KEYWORDS.count(identifier) ? identifier + "_" : identifier;
+}
+
+std::string ASTCppGenerator::generateProgram(IRNode *root)
+{
+    sourceMap.entries.clear();
+    loopCounter = 0;
+    types = std::make_unique<ProgramTypes>(root);
+    analyzer = std::make_unique<LoopAnalyzer>(*types);
+    loadStats = false;
+    visitTree(root, [&](IRNode *node)
+              { loadStats = loadStats || (node->type == "METHOD_CALL" && node->value == "normalize"); });
+
+    std::ostringstream cpp;
+    // The runtime and this file must agree on the storage type (runtime/precision.h)
+    if (precision.float32)
+        cpp << "#ifndef MLANG_FLOAT32\n#error \"generated with --float32: build with -DMLANG_FLOAT32\"\n#endif\n";
+    if (precision.accumulateFloat32)
+        cpp << "#ifndef MLANG_ACCUMULATE_FLOAT32\n#error \"generated with --accumulate float32: build with -DMLANG_ACCUMULATE_FLOAT32\"\n#endif\n";
+    cpp << "#include \"runtime.h\"\n";
+    bool fixedShapes = false;
+    for (const auto &function : types->functions())
+    {
+        fixedShapes = fixedShapes || !function.resultShape.empty() || !types->shapes(function.definition).empty();
+    }
+    if (fixedShapes)
+        cpp << "#include \"fixed.h\"\n";
+    if (instrument)
+        cpp << "#include \"profile.h\"\n#include <cstdlib>\n";
+    cpp << "#include <limits>\n#include <string>\n#include <vector>\n\nnamespace mlang\n{\n";
+
+    std::string definitions;
+    for (const auto &function : types->functions())
+    {
+        cpp << signature(function, findChild(function.definition, "FUNCTION_BODY")) << ";\n";
+        definitions += "\n" + generateFunction(function);
+    }
+    cpp << definitions << "}\n";
+
+    if (const FunctionSignature *entry = types->function("main"))
+    {
+        cpp << "\nint main()\n{\n";
+        if (instrument)
+        {
+            cpp << "    const char *profilePath = std::getenv(\"MLANG_PROFILE\");\n"
+                << "    enableProfiling(profilePath ? profilePath : \"mlang.profile\");\n";
+        }
+        if (entry->result == ValueKind::INT)
+            cpp << "    return static_cast<int>(mlang::main());\n";
+        else
+            cpp << "    mlang::main();\n    return 0;\n";
+        cpp << "}\n";
+    }
+    return resolveLocationTags(cpp.str(), sourceMap, lineComments ? "  // " : "");
+}
+
+std::string ASTCppGenerator::signature(const FunctionSignature &function, IRNode *body)
+{
+    // Arrays are passed by reference; one the callee replaces is copied, one it stores into is shared as in MLang
+    std::set<std::string> replaced;
+    std::set<std::string> stored;
+    visitTree(body, [&](IRNode *node)
+              {
+        // Normalizing in place writes through to the caller's Dataset
+        if (node->type == "METHOD_CALL" && node->value == "normalize" && !node->children.empty() &&
+            isIdentifierNode(node->children[0]))
+            stored.insert(node->children[0]->value);
+        if (node->type != "ASSIGNMENT_EXPRESSION")
+            return;
+        IRNode *target = findChild(node, "IDENTIFIER");
+        if (target)
+            (findChild(node, "INDEX") ? stored : replaced).insert(target->value); });
+
+    Shapes declared = types->shapes(function.definition);
+    std::vector<std::string> parameters;
+    for (const auto &parameter : function.parameters)
+    {
+        std::string type = cppTypeName(parameter.second, declared[parameter.first]);
+        if ((isArray(parameter.second) || parameter.second == ValueKind::SPARSE_MATRIX || parameter.second == ValueKind::STRING) &&
+            !replaced.count(parameter.first))
+            type = stored.count(parameter.first) ? type + " &" : "const " + type + " &";
+        else
+            type += " ";
+        parameters.push_back(type + name(parameter.first));
+    }
+    std::string parameterList;
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        parameterList += (i > 0 ? ", " : "") + parameters[i];
+    }
+    return cppTypeName(function.result, function.resultShape) + " " + name(function.name) + "(" + parameterList + ")";
+}
+
+std::string ASTCppGenerator::generateFunction(const FunctionSignature &function)
+{
+    std::ostringstream cpp;
+    IRNode *node = function.definition;
+    IRNode *body = findChild(node, "FUNCTION_BODY");
+    currentDefinition = node;
+    currentFunction = function.name;
+    currentStatement = node;
+    scope = types->locals(node);
+    shapes = types->shapes(node);
+    checkShape(findChild(node, "RETURN_TYPE") ? findChild(node, "RETURN_TYPE")->value : "");
+    if (IRNode *parameters = findChild(node, "PARAMETERS"))
+    {
+        for (auto parameter : parameters->children)
+        {
+            checkShape(splitTypedName(parameter->value).second);
+        }
+    }
+
+    cpp << locationTag(node->line, node->column) << signature(function, body) << "\n{\n";
+    indentLevel = 1;
+    if (instrument)
+    {
+        cpp << getIndent() << "static RegionCounters *mlangRegion = profileRegion(RegionKind::FUNCTION, \""
+            << function.name << "\", " << std::max(node->line, 0) << ");\n";
+        cpp << getIndent() << "ProfileScope mlangScope(mlangRegion);\n";
+    }
+
+    sharedNames.clear();
+    loopAssignments.clear();
+    loopDeclarations.clear();
+    hoistedDeclarations.clear();
+    std::map<std::string, int> declarations;
+    visitTree(body, [&](IRNode *statement)
+              {
+        if (statement->type == "VARIABLE_DECLARATION" && !statement->children.empty())
+            ++declarations[splitTypedName(statement->children[0]->value).first]; });
+    visitTree(body, [&](IRNode *loop)
+              {
+        if (loop->type == "FOR_LOOP")
+            visitTree(forLoopParts(loop).body, [&](IRNode *statement)
+                      {
+                if (statement->type == "ASSIGNMENT_EXPRESSION")
+                    loopAssignments.insert(statement);
+                else if (statement->type == "VARIABLE_DECLARATION" && statement->children.size() > 1 &&
+                         declarations[splitTypedName(statement->children[0]->value).first] == 1)
+                    loopDeclarations.insert(statement); }); });
+    std::string block = generateBlock(body);
+    for (const auto &hoisted : hoistedDeclarations)
+    {
+        cpp << getIndent() << cppTypeName(scope[hoisted]) << " " << name(hoisted) << "{};\n";
+    }
+
+    // Variables introduced by assignment are hoisted; declared ones and loop variables are defined where they
+    // appear, and privates of parallel loops only inside the chunk body
+    std::set<std::string> defined;
+    for (const auto &parameter : function.parameters)
+    {
+        defined.insert(parameter.first);
+    }
+    visitTree(body, [&](IRNode *statement)
+              {
+        if (statement->type == "VARIABLE_DECLARATION" && !statement->children.empty())
+            defined.insert(splitTypedName(statement->children[0]->value).first);
+        else if (statement->type == "FOR_LOOP")
+            defined.insert(forLoopParts(statement).variable); });
+    visitTree(body, [&](IRNode *statement)
+              {
+        if (statement->type != "ASSIGNMENT_EXPRESSION" || findChild(statement, "INDEX"))
+            return;
+        IRNode *target = findChild(statement, "IDENTIFIER");
+        if (!target || !sharedNames.count(target->value) || !defined.insert(target->value).second)
+            return;
+        currentStatement = statement;
+        ValueKind kind = scope[target->value];
+        if (kind == ValueKind::UNKNOWN || kind == ValueKind::VOID)
+            typeError("Cannot infer the type of '" + target->value + "'");
+        else
+            cpp << getIndent() << cppTypeName(kind) << " " << name(target->value) << "{};\n"; });
+
+    cpp << block;
+    indentLevel = 0;
+    cpp << "}\n";
+    return cpp.str();
+}
+
+std::string ASTCppGenerator::generateBlock(IRNode *block)
+{
+    std::string cpp;
+    for (auto statement : blockStatements(block))
+    {
+        cpp += generateStatement(statement);
+    }
+    return cpp;
+}
+
+std::string ASTCppGenerator::generateStatement(IRNode *node)
+{
+    std::ostringstream cpp;
+    currentStatement = node;
+    std::string location = locationTag(node->line, node->column);
+    if (node->type == "FOR_LOOP")
+    {
+        return generateForLoop(node);
+    }
+    if (node->type == "VARIABLE_DECLARATION" && !node->children.empty())
+    {
+        auto typed = splitTypedName(node->children[0]->value);
+        ValueKind kind = scope[typed.first];
+        if (kind == ValueKind::UNKNOWN || kind == ValueKind::VOID)
+            typeError("Cannot infer the type of '" + typed.first + "'");
+        checkShape(typed.second);
+        InPlaceUpdate update;
+        if (loopDeclarations.count(node) && parallelDepth == 0 && (kind == ValueKind::VECTOR || kind == ValueKind::MATRIX) &&
+            shapes[typed.first].empty())
+        {
+            // Defined before the function's code, so the loop refills one buffer instead of allocating
+            hoistedDeclarations.insert(typed.first);
+            if (matchInPlaceUpdate(node, *types, scope, update))
+                cpp << location << getIndent() << generateInPlace(update, name(typed.first)) << ";\n";
+            else
+                cpp << location << getIndent() << name(typed.first) << " = "
+                    << generateValue(node->children[1], typed.first) << ";\n";
+            return cpp.str();
+        }
+        cpp << location << getIndent() << cppTypeName(kind, shapes[typed.first]) << " " << name(typed.first);
+        if (node->children.size() > 1)
+            cpp << " = " << generateValue(node->children[1], typed.first) << ";\n";
+        else
+            cpp << "{};\n";
+    }
+    else if (node->type == "ASSIGNMENT_EXPRESSION")
+    {
+        IRNode *target = findChild(node, "IDENTIFIER");
+        IRNode *index = findChild(node, "INDEX");
+        IRNode *value = findChild(node, "EXPRESSION");
+        if (!target || !value || value->children.empty())
+            return "";
+        if (parallelDepth == 0)
+            sharedNames.insert(target->value);
+        auto shape = shapes.find(target->value);
+        InPlaceUpdate update;
+        if (!index && loopAssignments.count(node) && (shape == shapes.end() || shape->second.empty()) &&
+            matchInPlaceUpdate(node, *types, scope, update))
+        {
+            cpp << location << getIndent() << generateInPlace(update, name(target->value)) << ";\n";
+            return cpp.str();
+        }
+        cpp << location << getIndent() << name(target->value);
+        if (index && !index->children.empty())
+            cpp << "[" << generateExpression(index->children[0]) << "]";
+        cpp << " = " << (index ? generateExpression(value->children[0]) : generateValue(value->children[0], target->value)) << ";\n";
+    }
+    else if (node->type == "RETURN_STATEMENT")
+    {
+        cpp << location << getIndent() << "return";
+        if (!node->children.empty())
+            cpp << " " << generateExpression(node->children[0]);
+        cpp << ";\n";
+    }
+    else if (node->type == "FUNCTION_CALL" || node->type == "METHOD_CALL")
+    {
+        cpp << location << getIndent() << generateExpression(node) << ";\n";
+    }
+    return cpp.str();
+}
+
+std::string ASTCppGenerator::generateForLoop(IRNode *node)
+{
+    std::ostringstream cpp;
+    ForLoopParts parts = forLoopParts(node);
+    if (parts.variable.empty() || !parts.start || !parts.end)
+    {
+        typeError("'for' loop without a loop variable or range");
+        return "";
+    }
+    std::string lower = generateExpression(parts.start);
+    std::string upper = generateExpression(parts.end);
+    std::string suffix = std::to_string(loopCounter++);
+    std::string location = locationTag(node->line, node->column);
+
+    LoopAnalysis analysis;
+    bool parallelLoop = false;
+    bool kernels = false;
+    if (parallelDepth == 0)
+    {
+        analysis = analyzer->analyze(currentDefinition, node, scope);
+        parallelLoop = analyzer->shouldParallelize(analysis, parallel, profile, currentFunction, node->line);
+        kernels = analysis.reductionKernel && analyzer->shouldVectorize(analysis, parallel);
+    }
+
+    if (!instrument && !parallelLoop && !kernels)
+    {
+        cpp << location << getIndent() << "for (long long " << name(parts.variable) << " = " << lower << ", mlangEnd" << suffix
+            << " = " << upper << "; " << name(parts.variable) << " < mlangEnd" << suffix << "; ++" << name(parts.variable) << ")\n";
+        cpp << getIndent() << "{\n";
+        indentLevel++;
+        cpp << generateBlock(parts.body);
+        indentLevel--;
+        cpp << getIndent() << "}\n";
+        return cpp.str();
+    }
+
+    // Bounds are evaluated once, as in the sequential loop
+    std::string begin = "mlangBegin" + suffix;
+    std::string end = "mlangEnd" + suffix;
+    cpp << location << getIndent() << "{\n";
+    indentLevel++;
+    cpp << getIndent() << "const long long " << begin << " = " << lower << ", " << end << " = " << upper << ";\n";
+    if (instrument)
+    {
+        cpp << getIndent() << "static RegionCounters *mlangRegion" << suffix << " = profileRegion(RegionKind::LOOP, \""
+            << currentFunction << "/" << parts.variable << "\", " << std::max(node->line, 0) << ");\n";
+        cpp << getIndent() << "ProfileScope mlangScope" << suffix << "(mlangRegion" << suffix << ", " << end << " > " << begin
+            << " ? " << end << " - " << begin << " : 0);\n";
+    }
+    if (parallelLoop)
+    {
+        cpp << generateParallelLoop(node, parts, analysis, begin, end, suffix, kernels);
+    }
+    else if (kernels)
+    {
+        for (auto statement : blockStatements(parts.body))
+        {
+            const Reduction *reduction = nullptr;
+            for (const auto &candidate : analysis.reductions)
+            {
+                if (candidate.variable == findChild(statement, "IDENTIFIER")->value)
+                    reduction = &candidate;
+            }
+            std::string op;
+            IRNode *operand = reductionOperand(statement, reduction->variable, op);
+            std::string kernel = reductionKernel(*reduction, operand, parts.variable, begin, end);
+            cpp << locationTag(statement->line, statement->column) << getIndent()
+                << (op == "-" ? name(reduction->variable) + " = " + name(reduction->variable) + " - " + kernel
+                              : combine(*reduction, name(reduction->variable), kernel))
+                << ";\n";
+        }
+    }
+    else
+    {
+        cpp << getIndent() << "for (long long " << name(parts.variable) << " = " << begin << "; " << name(parts.variable)
+            << " < " << end << "; ++" << name(parts.variable) << ")\n";
+        cpp << getIndent() << "{\n";
+        indentLevel++;
+        cpp << generateBlock(parts.body);
+        indentLevel--;
+        cpp << getIndent() << "}\n";
+    }
+    indentLevel--;
+    cpp << getIndent() << "}\n";
+    return cpp.str();
+}
+
+std::string ASTCppGenerator::generateParallelLoop(IRNode *node, const ForLoopParts &parts, const LoopAnalysis &analysis,
+                                                  const std::string &lower, const std::string &upper,
+                                                  const std::string &suffix, bool kernels)
+{
+    std::ostringstream cpp;
+    std::string plan = "mlangPlan" + suffix;
+    std::string schedule = analyzer->useDynamicSchedule(analysis, parallel) ? "Schedule::DYNAMIC" : "Schedule::STATIC";
+    // A chunk never holds less than half the parallel threshold, so short ranges run inline as one chunk
+    cpp << getIndent() << "RangePlan " << plan << "(" << lower << ", " << upper << ", " << schedule << ", "
+        << std::max(1LL, parallel.minTripCount / 2) << ");\n";
+    for (const auto &reduction : analysis.reductions)
+    {
+        cpp << getIndent() << "std::vector<" << cppTypeName(reduction.kind) << "> mlangPartials" << suffix << "_" << reduction.variable
+            << "(" << plan << ".chunks(), " << identity(reduction) << ");\n";
+    }
+
+    cpp << getIndent() << plan << ".run([&](size_t mlangChunk, long long mlangChunkBegin, long long mlangChunkEnd)\n";
+    cpp << getIndent() << "{\n";
+    indentLevel++;
+    for (const auto &reduction : analysis.reductions)
+    {
+        cpp << getIndent() << cppTypeName(reduction.kind) << " " << name(reduction.variable) << " = " << identity(reduction) << ";\n";
+    }
+    for (const auto &variable : analysis.privates)
+    {
+        cpp << getIndent() << cppTypeName(scope[variable]) << " " << name(variable) << "{};\n";
+    }
+    if (kernels)
+    {
+        // Each chunk's partial is one tree-ordered kernel call per reduction statement
+        parallelDepth++;
+        for (auto statement : blockStatements(parts.body))
+        {
+            std::string variable = findChild(statement, "IDENTIFIER")->value;
+            const Reduction *reduction = nullptr;
+            for (const auto &candidate : analysis.reductions)
+            {
+                if (candidate.variable == variable)
+                    reduction = &candidate;
+            }
+            std::string op;
+            IRNode *operand = reductionOperand(statement, variable, op);
+            std::string kernel = reductionKernel(*reduction, operand, parts.variable, "mlangChunkBegin", "mlangChunkEnd");
+            cpp << locationTag(statement->line, statement->column) << getIndent()
+                << combine(*reduction, name(variable), op == "-" ? "-" + kernel : kernel) << ";\n";
+        }
+        parallelDepth--;
+    }
+    else
+    {
+        cpp << locationTag(node->line, node->column) << getIndent() << "for (long long " << name(parts.variable)
+            << " = mlangChunkBegin; " << name(parts.variable) << " < mlangChunkEnd; ++" << name(parts.variable) << ")\n";
+        cpp << getIndent() << "{\n";
+        indentLevel++;
+        parallelDepth++;
+        cpp << generateBlock(parts.body);
+        parallelDepth--;
+        indentLevel--;
+        cpp << getIndent() << "}\n";
+    }
+    for (const auto &reduction : analysis.reductions)
+    {
+        cpp << getIndent() << "mlangPartials" << suffix << "_" << reduction.variable << "[mlangChunk] = " << name(reduction.variable) << ";\n";
+    }
+    indentLevel--;
+    cpp << getIndent() << "});\n";
+
+    // Partials are combined in chunk order, so the result does not depend on thread timing
+    for (const auto &reduction : analysis.reductions)
+    {
+        cpp << getIndent() << "for (" << cppTypeName(reduction.kind) << " mlangPartial : mlangPartials" << suffix << "_"
+            << reduction.variable << ")\n";
+        cpp << getIndent() << "{\n";
+        cpp << getIndent() << "    " << combine(reduction, name(reduction.variable), "mlangPartial") << ";\n";
+        cpp << getIndent() << "}\n";
+    }
+    return cpp.str();
+}
+
+std::string ASTCppGenerator::reductionKernel(const Reduction &reduction, IRNode *operand, const std::string &variable,
+                                             const std::string &lower, const std::string &upper)
+{
+    std::string kernel = "reduceSum";
+    if (reduction.op == "*")
+        kernel = "reduceProduct";
+    else if (reduction.op == "min" || reduction.op == "max")
+        kernel = reduction.op == "min" ? "reduceMin" : "reduceMax";
+    // The term is converted to the accumulator's type so that Int and Float operands reduce alike
+    std::string type = precision.float32 && reduction.kind == ValueKind::FLOAT ? "Accumulator" : cppTypeName(reduction.kind);
+    return "::" + kernel + "(" + lower + ", " + upper + ", [&](long long " + name(variable) + ") { return static_cast<" +
+           type + ">(" + generateExpression(operand) + "); })";
+}
+
+std::string ASTCppGenerator::generateInPlace(const InPlaceUpdate &update, const std::string &target)
+{
+    std::string first = generateExpression(update.first);
+    switch (update.kernel)
+    {
+    case UpdateKernel::GEMV:
+        return "::gemv(" + first + ", " + generateExpression(update.second) + ", " + target + ")";
+    case UpdateKernel::GEMV_TRANSPOSED:
+        return "::gemvTransposed(" + first + ", " + generateExpression(update.second) + ", " + target + ")";
+    case UpdateKernel::SPMV:
+        return "::spmv(" + first + ", " + generateExpression(update.second) + ", " + target + ")";
+    case UpdateKernel::SPMV_TRANSPOSED:
+        return "::spmvTransposed(" + first + ", " + generateExpression(update.second) + ", " + target + ")";
+    case UpdateKernel::GEMM:
+        return "::gemm(" + first + ", " + generateExpression(update.second) + ", " + target + ")";
+    case UpdateKernel::ADD:
+        return "::add(" + first + ", " + generateExpression(update.second) + ", " + target + ")";
+    case UpdateKernel::SUBTRACT:
+        return "::subtract(" + first + ", " + generateExpression(update.second) + ", " + target + ")";
+    default:
+        break;
+    }
+    std::string alpha = update.alpha ? generateExpression(update.alpha) : "1.0";
+    if (update.alpha && (update.alpha->type == "OPERATOR" || update.alpha->type == "UNARY_OPERATOR") &&
+        (update.negate || update.reciprocal))
+        alpha = "(" + alpha + ")";
+    if (update.reciprocal)
+        alpha = "1.0 / " + alpha;
+    if (update.negate)
+        alpha = "-" + alpha;
+    return std::string(update.kernel == UpdateKernel::SCALE ? "::scale(" : "::axpy(") + alpha + ", " + first + ", " + target + ")";
+}
+
+void ASTCppGenerator::checkShape(const std::string &type)
+{
+    if (hasDimensionList(type) && parseStaticShape(type).empty())
+        typeError("Invalid static shape in '" + type + "'; expected Vector<Float, N> or Matrix<Float, R, C> with positive extents");
+}
+
+std::string ASTCppGenerator::generateValue(IRNode *value, const std::string &variable)
+{
+    auto shape = shapes.find(variable);
+    IRNode *literal = value->type == "EXPRESSION" && !value->children.empty() ? value->children[0] : value;
+    if (shape == shapes.end() || shape->second.size() != 1 || literal->type != "VECTOR_LITERAL")
+        return generateExpression(value);
+    if (literal->children.size() != shape->second[0])
+        typeError("'" + variable + "' is a Vector<Float, " + std::to_string(shape->second[0]) + "> but is given " +
+                  std::to_string(literal->children.size()) + " elements");
+    return cppTypeName(ValueKind::VECTOR, shape->second) + "{" + generateElements(literal) + "}";
+}
+
+std::string ASTCppGenerator::generateElements(IRNode *literal)
+{
+    std::string elements;
+    for (size_t i = 0; i < literal->children.size(); ++i)
+    {
+        std::string element = generateExpression(literal->children[i]);
+        if (isIdentifierNode(literal->children[i]) || literal->children[i]->type != "LITERAL_VALUE")
+            element = "static_cast<Real>(" + element + ")";
+        elements += (i > 0 ? ", " : "") + element;
+    }
+    return elements;
+}
+
+std::string ASTCppGenerator::generateArguments(IRNode *node)
+{
+    std::string arguments;
+    IRNode *list = findChild(node, "ARGUMENTS");
+    if (list)
+    {
+        for (size_t i = 0; i < list->children.size(); ++i)
+        {
+            arguments += (i > 0 ? ", " : "") + generateExpression(list->children[i]);
+        }
+    }
+    return "(" + arguments + ")";
+}
+
+std::string ASTCppGenerator::generateExpression(IRNode *node)
+{
+    const std::string &type = node->type;
+    if (type == "EXPRESSION")
+        return node->children.empty() ? "" : generateExpression(node->children[0]);
+    if (type == "OPERATOR" && node->children.size() == 2)
+    {
+        std::string left = generateExpression(node->children[0]);
+        std::string right = generateExpression(node->children[1]);
+        if (precedence(node->children[0]) < precedence(node))
+            left = "(" + left + ")";
+        if (precedence(node->children[1]) <= precedence(node) && node->children[1]->type == "OPERATOR")
+            right = "(" + right + ")";
+        // MLang division is always real division, as in the Python backend
+        if (node->value == "/" && kindOf(node->children[0]) == ValueKind::INT && kindOf(node->children[1]) == ValueKind::INT)
+            left = "static_cast<double>(" + left + ")";
+        return left + " " + node->value + " " + right;
+    }
+    if (type == "UNARY_OPERATOR" && !node->children.empty())
+    {
+        std::string operand = generateExpression(node->children[0]);
+        return node->value + (node->children[0]->type == "OPERATOR" ? "(" + operand + ")" : operand);
+    }
+    if (type == "INDEX_EXPRESSION" && node->children.size() == 2)
+    {
+        if (kindOf(node->children[0]) != ValueKind::VECTOR)
+            typeError("Only Vector elements can be indexed in native code");
+        std::string element = generateExpression(node->children[0]) + "[" + generateExpression(node->children[1]) + "]";
+        return precision.float32 ? "static_cast<Accumulator>(" + element + ")" : element;
+    }
+    if (type == "MEMBER_ACCESS" && !node->children.empty())
+    {
+        if (node->value != "rows" && node->value != "cols")
+            typeError("Unknown member '" + node->value + "'");
+        return "static_cast<long long>(" + generateExpression(node->children[0]) + "." + node->value + ")";
+    }
+    if (type == "METHOD_CALL" && !node->children.empty())
+    {
+        IRNode *object = node->children[0];
+        auto shape = shapes.find(object->value);
+        if (node->value == "normalize" &&
+            (kindOf(object) != ValueKind::MATRIX || (shape != shapes.end() && !shape->second.empty())))
+            typeError("normalize() needs a dense Dataset or Matrix without static extents");
+        else if (node->value != "transpose" && node->value != "normalize")
+            typeError("Unknown method '" + node->value + "'");
+        return "::" + node->value + "(" + generateExpression(node->children[0]) + ")";
+    }
+    if (type == "FUNCTION_CALL")
+    {
+        // Qualified, so argument-dependent lookup cannot pick a runtime function of the same name
+        if (types->function(node->value))
+            return "mlang::" + name(node->value) + generateArguments(node);
+        if (node->value == "load_data" && loadStats)
+        {
+            std::string arguments = generateArguments(node);
+            return "::loadCSV" + arguments.substr(0, arguments.size() - 1) + ", true)";
+        }
+        if (const Builtin *builtin = findBuiltin(node->value))
+            return std::string("::") + builtin->runtimeName + generateArguments(node);
+        typeError("Call to undefined function '" + node->value + "'");
+        return name(node->value) + generateArguments(node);
+    }
+    if (type == "VECTOR_LITERAL")
+        return "Vector{" + generateElements(node) + "}";
+    if (type == "LITERAL_VALUE" && isIdentifierNode(node))
+    {
+        if (!scope.count(node->value))
+            typeError("'" + node->value + "' is not defined");
+        if (parallelDepth == 0)
+            sharedNames.insert(node->value);
+        return name(node->value);
+    }
+    return node->value;
+}
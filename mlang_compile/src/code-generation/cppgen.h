@@ -0,0 +1,107 @@
+#ifndef CPPGEN_H
+#define CPPGEN_H
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "analysis.h"
+#include "ir.h"
+#include "sourcemap.h"
+#include "types.h"
+#include "../lexical-analysis/errors/diagnostics.h"
+
+// Storage and accumulation precision the generated code is built for (runtime/precision.h)
+struct PrecisionOptions
+{
+    // Vector and Matrix elements are float; requires -DMLANG_FLOAT32
+    bool float32 = false;
+    // Element arithmetic and reduction kernels run in float too; requires -DMLANG_ACCUMULATE_FLOAT32
+    bool accumulateFloat32 = false;
+};
+
+// Native backend: translates the AST into C++ against the runtime library
+// (runtime/runtime.h). Functions live in namespace mlang; a program with a main
+// function also gets a C main that calls it. Independent and reduction loops
+// (see LoopAnalyzer) run on the runtime thread pool through RangePlan, with one
+// partial per chunk for each reduction, combined in chunk order. Loops made only
+// of element-wise reductions become tree-ordered SIMD reduction kernel calls.
+// Values declared with static extents (Vector<Float, 3>) become FixedVector and
+// FixedMatrix stack objects whose kernels are unrolled at compile time. Inside loops,
+// whole-array assignments call destination-passing kernels on the target, so the
+// steady state of a training loop reuses its buffers instead of allocating.
+class ASTCppGenerator
+{
+private:
+    int indentLevel = 0;
+    Diagnostics *diagnostics = nullptr;
+    uint32_t sourceFile = 0;
+    bool lineComments = false;
+    bool instrument = false;
+    const Profile *profile = nullptr;
+    ParallelOptions parallel;
+    PrecisionOptions precision;
+    SourceMap sourceMap;
+    std::unique_ptr<ProgramTypes> types;
+    std::unique_ptr<LoopAnalyzer> analyzer;
+    IRNode *currentDefinition = nullptr;
+    IRNode *currentStatement = nullptr;
+    std::string currentFunction;
+    Scope scope;
+    Shapes shapes;
+    int parallelDepth = 0;
+    // Names the function uses outside parallel loop bodies; only these need a function-level definition
+    std::set<std::string> sharedNames;
+    // Assignments inside a loop body; whole-array ones are written into the target's storage where a kernel allows
+    std::set<IRNode *> loopAssignments;
+    // Array declarations with a value inside a loop body, of names declared once in the function;
+    // outside parallel loops they are defined before the loop and refilled in place every iteration
+    std::set<IRNode *> loopDeclarations;
+    std::set<std::string> hoistedDeclarations;
+    int loopCounter = 0;
+    // The program calls normalize(), so load_data gathers column stats while parsing
+    bool loadStats = false;
+
+    std::string getIndent();
+    void typeError(const std::string &message);
+    std::string name(const std::string &identifier);
+    ValueKind kindOf(IRNode *expression) { return types->infer(expression, scope); }
+    std::string signature(const FunctionSignature &function, IRNode *body);
+    std::string generateFunction(const FunctionSignature &function);
+    std::string generateStatement(IRNode *node);
+    std::string generateBlock(IRNode *block);
+    std::string generateForLoop(IRNode *node);
+    std::string generateParallelLoop(IRNode *node, const ForLoopParts &parts, const LoopAnalysis &analysis,
+                                     const std::string &lower, const std::string &upper, const std::string &suffix,
+                                     bool kernels);
+    // Call of the runtime kernel (runtime/reduce.h) that folds operand over [lower, upper)
+    std::string reductionKernel(const Reduction &reduction, IRNode *operand, const std::string &variable,
+                                const std::string &lower, const std::string &upper);
+    // Destination-passing kernel call for an assignment matched by matchInPlaceUpdate
+    std::string generateInPlace(const InPlaceUpdate &update, const std::string &target);
+    // Reports a dimension list parseStaticShape rejects
+    void checkShape(const std::string &type);
+    // A vector literal stored into a variable of static shape is built in place, without a heap Vector
+    std::string generateValue(IRNode *value, const std::string &variable);
+    // Comma-separated elements of a vector literal, each converted to double
+    std::string generateElements(IRNode *literal);
+    std::string generateArguments(IRNode *node);
+    std::string generateExpression(IRNode *node);
+
+public:
+    // Type errors (undefined names, values the runtime has no type for) are reported here
+    void setDiagnostics(Diagnostics *sink, uint32_t file);
+    // Appends "// line N" to every generated line that starts an MLang statement
+    void setLineComments(bool enabled) { lineComments = enabled; }
+    void setSourceName(const std::string &name) { sourceMap.sourceName = name; }
+    const SourceMap &getSourceMap() const { return sourceMap; }
+    // Wraps functions and loops in ProfileScope regions and enables the recorder in main
+    void setInstrumentation(bool enabled) { instrument = enabled; }
+    void setProfile(const Profile *data) { profile = data; }
+    void setParallelOptions(const ParallelOptions &options) { parallel = options; }
+    // With float32 storage, elements read from arrays are widened to Accumulator before any arithmetic
+    void setPrecision(const PrecisionOptions &options) { precision = options; }
+    std::string generateProgram(IRNode *root);
+};
+
+#endif
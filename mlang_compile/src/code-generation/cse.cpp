@@ -0,0 +1,348 @@
+#include "cse.h"
+#include "builtins.h"
+#include "types.h"
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+
+namespace
+{
+    // MLang spelling of an array kind, for the declaration of a temporary
+    std::string typeName(ValueKind kind)
+    {
+        if (kind == ValueKind::VECTOR)
+            return "Vector<Float>";
+        return kind == ValueKind::MATRIX ? "Matrix<Float>" : "SparseMatrix";
+    }
+
+    size_t treeSize(const IRNode *node)
+    {
+        size_t size = 1;
+        for (auto child : node->children)
+        {
+            size += treeSize(child);
+        }
+        return size;
+    }
+
+    // Calls that may store into their arguments: program functions, and methods other than transpose
+    bool callsProgram(IRNode *statement)
+    {
+        bool calls = false;
+        visitTree(statement, [&](IRNode *node)
+                  { calls = calls || (node->type == "FUNCTION_CALL" && !findBuiltin(node->value)); });
+        return calls;
+    }
+
+    std::vector<std::string> mutatedObjects(IRNode *statement)
+    {
+        std::vector<std::string> objects;
+        visitTree(statement, [&](IRNode *node)
+                  {
+                      if (node->type == "METHOD_CALL" && node->value != "transpose" && !node->children.empty() &&
+                          isIdentifierNode(node->children[0]))
+                          objects.push_back(node->children[0]->value); });
+        return objects;
+    }
+
+    // Variables a statement assigns, loop bodies included
+    std::vector<std::string> assignedNames(IRNode *statement)
+    {
+        std::vector<std::string> names;
+        visitTree(statement, [&](IRNode *node)
+                  {
+                      if (node->type == "VARIABLE_DECLARATION" && !node->children.empty())
+                          names.push_back(splitTypedName(node->children[0]->value).first);
+                      else if (node->type == "ASSIGNMENT_EXPRESSION" && findChild(node, "IDENTIFIER"))
+                          names.push_back(findChild(node, "IDENTIFIER")->value);
+                      else if (node->type == "FOR_LOOP")
+                          names.push_back(forLoopParts(node).variable); });
+        return names;
+    }
+
+    class FunctionCSE
+    {
+    public:
+        FunctionCSE(const ProgramTypes &types, IRNode *function)
+            : types(types), scope(types.locals(function)), shapes(types.shapes(function))
+        {
+            visitTree(function, [&](IRNode *node)
+                      {
+                          if (node->type == "LITERAL_VALUE" || node->type == "IDENTIFIER" || node->type == "PARAMETER")
+                              taken.insert(splitTypedName(node->value).first); });
+        }
+
+        size_t replaced = 0;
+
+        // Blocks are independent; a loop body starts with nothing available
+        void run(IRNode *block)
+        {
+            while (IRNode *repeated = scan(block))
+            {
+                declareTemporary(block, repeated);
+            }
+            for (auto statement : block->children)
+            {
+                if (statement->type != "FOR_LOOP")
+                    continue;
+                IRNode *body = findChild(forLoopParts(statement).body, "FUNCTION_BODY");
+                if (body)
+                    run(body);
+            }
+        }
+
+    private:
+        struct Holder
+        {
+            std::string name;
+            int version;
+        };
+        struct Occurrence
+        {
+            size_t statement;
+            IRNode *node;
+        };
+
+        const ProgramTypes &types;
+        Scope scope;
+        Shapes shapes;
+        std::set<std::string> taken;
+        int temporaries = 0;
+
+        // State of one scan of a block
+        std::map<std::tuple<std::string, std::string, std::vector<int>>, int> numbers;
+        int nextNumber = 0;
+        std::map<std::string, int> versions;
+        int epoch = 0;
+        std::map<int, Holder> available;
+        // Variable -> {version, number of the value it was assigned}, so a name and the
+        // expression it holds get the same number
+        std::map<std::string, std::pair<int, int>> held;
+        std::map<int, std::vector<Occurrence>> occurrences;
+        // Value of every occurrence in the order recorded, so those inside a replaced subtree can be dropped
+        std::vector<int> recorded;
+        std::set<int> opaque;
+        // Statement of the first occurrence of what scan returned
+        size_t firstStatement = 0;
+
+        // Hash-consing: equal keys get equal numbers
+        int number(const std::string &type, const std::string &value, const std::vector<int> &operands)
+        {
+            auto inserted = numbers.insert({std::make_tuple(type, value, operands), nextNumber});
+            if (inserted.second)
+                ++nextNumber;
+            return inserted.first->second;
+        }
+
+        // A number equal to no other, for values that cannot be reused
+        int unique()
+        {
+            opaque.insert(nextNumber);
+            return nextNumber++;
+        }
+
+        // Numbers an expression bottom-up. A compound array expression that is not a whole
+        // right-hand side is replaced by its holder, or else recorded as an occurrence.
+        int visit(IRNode *&node, bool whole, size_t statement)
+        {
+            size_t mark = recorded.size();
+            std::vector<int> operands;
+            bool reusable = true;
+            for (auto &child : node->children)
+            {
+                int operand = visit(child, false, statement);
+                reusable = reusable && !opaque.count(operand);
+                operands.push_back(operand);
+            }
+
+            const std::string &type = node->type;
+            if (isIdentifierNode(node))
+            {
+                if (shapes.count(node->value))
+                    return unique();
+                auto value = held.find(node->value);
+                if (value != held.end() && value->second.first == versions[node->value])
+                    return value->second.second;
+                return number("VAR", node->value, {versions[node->value], epoch});
+            }
+            if ((type == "FUNCTION_CALL" && (!findBuiltin(node->value) || !findBuiltin(node->value)->pure)) ||
+                (type == "METHOD_CALL" && node->value != "transpose") || !reusable)
+                return unique();
+            int value = number(type, node->value, operands);
+
+            // A transpose costs nothing where it is used: NumPy returns a view and the native backend
+            // folds it into gemvTransposed, so only the products around it are worth keeping
+            bool compound = type == "OPERATOR" || type == "UNARY_OPERATOR" || type == "FUNCTION_CALL";
+            ValueKind kind = compound ? types.infer(node, scope) : ValueKind::UNKNOWN;
+            if (whole || !(isArray(kind) || kind == ValueKind::SPARSE_MATRIX))
+                return value;
+            auto holder = available.find(value);
+            if (holder != available.end() && versions[holder->second.name] == holder->second.version)
+            {
+                // The subexpressions go with the node; counting them would declare temporaries used once
+                while (recorded.size() > mark)
+                {
+                    occurrences[recorded.back()].pop_back();
+                    recorded.pop_back();
+                }
+                IRNode *name = new IRNode("LITERAL_VALUE", holder->second.name);
+                name->line = node->line;
+                name->column = node->column;
+                delete node;
+                node = name;
+                ++replaced;
+                return value;
+            }
+            occurrences[value].push_back({statement, node});
+            recorded.push_back(value);
+            return value;
+        }
+
+        // The right-hand side a plain assignment or declaration stores into a variable
+        IRNode **storedValue(IRNode *statement, std::string &target)
+        {
+            if (statement->type == "VARIABLE_DECLARATION" && statement->children.size() > 1)
+            {
+                target = splitTypedName(statement->children[0]->value).first;
+                return &statement->children[1];
+            }
+            IRNode *value = findChild(statement, "EXPRESSION");
+            if (statement->type != "ASSIGNMENT_EXPRESSION" || !value || value->children.empty())
+                return nullptr;
+            if (!findChild(statement, "INDEX") && findChild(statement, "IDENTIFIER"))
+                target = findChild(statement, "IDENTIFIER")->value;
+            return &value->children[0];
+        }
+
+        // Replaces what the block already holds; returns a repeated expression that needs a temporary
+        IRNode *scan(IRNode *block)
+        {
+            numbers.clear();
+            nextNumber = 0;
+            versions.clear();
+            epoch = 0;
+            available.clear();
+            held.clear();
+            occurrences.clear();
+            recorded.clear();
+            opaque.clear();
+
+            for (size_t i = 0; i < block->children.size(); ++i)
+            {
+                IRNode *statement = block->children[i];
+                if (statement->type == "FOR_LOOP" || callsProgram(statement))
+                {
+                    if (callsProgram(statement))
+                    {
+                        ++epoch;
+                        available.clear();
+                        held.clear();
+                    }
+                    for (const auto &name : assignedNames(statement))
+                    {
+                        ++versions[name];
+                    }
+                    for (const auto &name : mutatedObjects(statement))
+                    {
+                        ++versions[name];
+                    }
+                    continue;
+                }
+
+                std::string target;
+                IRNode **stored = storedValue(statement, target);
+                int storedNumber = -1;
+                for (auto &child : statement->children)
+                {
+                    // Targets and declared names are not reads
+                    if (child->type == "IDENTIFIER")
+                        continue;
+                    if (child->type == "EXPRESSION" && stored && !child->children.empty() && &child->children[0] == stored)
+                        storedNumber = visit(child->children[0], true, i);
+                    else if (&child == stored)
+                        storedNumber = visit(child, true, i);
+                    else
+                        visit(child, false, i);
+                }
+
+                for (const auto &name : assignedNames(statement))
+                {
+                    ++versions[name];
+                }
+                for (const auto &name : mutatedObjects(statement))
+                {
+                    ++versions[name];
+                }
+                if (!target.empty() && storedNumber >= 0 && !opaque.count(storedNumber))
+                {
+                    available[storedNumber] = {target, versions[target]};
+                    held[target] = {versions[target], storedNumber};
+                }
+            }
+
+            IRNode *best = nullptr;
+            size_t bestSize = 0;
+            for (auto &entry : occurrences)
+            {
+                if (entry.second.size() < 2)
+                    continue;
+                size_t size = treeSize(entry.second[0].node);
+                if (size > bestSize)
+                {
+                    best = entry.second[0].node;
+                    bestSize = size;
+                    firstStatement = entry.second[0].statement;
+                }
+            }
+            return best;
+        }
+
+        // Declares _cseN = expression before the statement of its first occurrence; the next
+        // scan then finds it held there
+        void declareTemporary(IRNode *block, IRNode *expression)
+        {
+            std::string name;
+            do
+            {
+                name = "_cse" + std::to_string(temporaries++);
+            } while (taken.count(name));
+            taken.insert(name);
+            ValueKind kind = types.infer(expression, scope);
+            scope[name] = kind;
+
+            IRNode *statement = block->children[firstStatement];
+            IRNode *declaration = new IRNode("VARIABLE_DECLARATION");
+            declaration->line = statement->line;
+            declaration->column = statement->column;
+            declaration->children.push_back(new IRNode("IDENTIFIER", name + " (TYPE: " + typeName(kind) + ")"));
+            declaration->children.push_back(cloneTree(expression));
+            block->children.insert(block->children.begin() + firstStatement, declaration);
+        }
+    };
+}
+
+size_t eliminateCommonSubexpressions(IRNode *root)
+{
+    if (!root)
+        return 0;
+    // Built on first use; most programs have many functions too small to bother with
+    std::unique_ptr<ProgramTypes> types;
+    size_t replaced = 0;
+    for (auto child : root->children)
+    {
+        IRNode *body = child->type == "FUNCTION_DEFINITION" ? findChild(child, "FUNCTION_BODY") : nullptr;
+        // Nothing can repeat in a body with fewer than two computations
+        size_t computations = 0;
+        visitTree(body, [&](IRNode *node)
+                  { computations += node->type == "OPERATOR" || node->type == "UNARY_OPERATOR" || node->type == "FUNCTION_CALL"; });
+        if (computations < 2)
+            continue;
+        if (!types)
+            types.reset(new ProgramTypes(root));
+        FunctionCSE cse(*types, child);
+        cse.run(body);
+        replaced += cse.replaced;
+    }
+    return replaced;
+}
@@ -0,0 +1,17 @@
+#ifndef CSE_H
+#define CSE_H
+
+#include "ir.h"
+
+// Common subexpression elimination within each block (a function body or a loop body).
+// Expressions get hash-consed value numbers, with a variable numbered by how often it has
+// been assigned so far, so an expression read after one of its operands changed is a new
+// value. A repeated Vector or Matrix expression that is part of a larger expression is then
+// computed once: it reads the variable an earlier statement assigned it to, or a _cseN
+// temporary declared before its first use. Statements that call program functions or
+// mutating methods end every match, since those may change arrays in place. Whole
+// right-hand sides are never replaced by a name, which would alias two arrays in Python.
+// Returns the number of expressions replaced.
+size_t eliminateCommonSubexpressions(IRNode *root);
+
+#endif
@@ -0,0 +1,207 @@
+#include "deadcode.h"
+#include "builtins.h"
+#include "inliner.h"
+#include <map>
+#include <set>
+
+namespace
+{
+    using Names = std::set<std::string>;
+
+    void addReads(IRNode *node, Names &live)
+    {
+        visitTree(node, [&](IRNode *child)
+                  {
+                      if (isIdentifierNode(child))
+                          live.insert(child->value); });
+    }
+
+    // Calls that print, load, store into their arguments or may do any of that: program
+    // functions, impure built-ins, and methods other than transpose
+    bool hasEffects(IRNode *node)
+    {
+        bool effects = false;
+        visitTree(node, [&](IRNode *child)
+                  {
+                      if (child->type == "FUNCTION_CALL")
+                      {
+                          const Builtin *builtin = findBuiltin(child->value);
+                          effects = effects || !builtin || !builtin->pure;
+                      }
+                      else if (child->type == "METHOD_CALL")
+                          effects = effects || child->value != "transpose"; });
+        return effects;
+    }
+
+    // Variable a whole-variable store writes; empty for element stores and other statements
+    std::string storedName(IRNode *statement)
+    {
+        if (statement->type == "VARIABLE_DECLARATION" && !statement->children.empty())
+            return splitTypedName(statement->children[0]->value).first;
+        IRNode *target = statement->type == "ASSIGNMENT_EXPRESSION" ? findChild(statement, "IDENTIFIER") : nullptr;
+        return target && !findChild(statement, "INDEX") ? target->value : "";
+    }
+
+    IRNode *loopStatements(IRNode *loop)
+    {
+        IRNode *body = forLoopParts(loop).body;
+        IRNode *inner = findChild(body, "FUNCTION_BODY");
+        return inner ? inner : body;
+    }
+
+    class FunctionDeadCode
+    {
+    public:
+        explicit FunctionDeadCode(DeadCodeStats &stats) : stats(stats) {}
+
+        // One backward pass over the function; true if it removed anything, since that can make
+        // the stores feeding the removed statements dead as well
+        bool run(IRNode *function)
+        {
+            references.clear();
+            visitTree(function, [&](IRNode *node)
+                      {
+                          if (isIdentifierNode(node) || node->type == "IDENTIFIER")
+                              ++references[splitTypedName(node->value).first]; });
+            size_t removed = stats.statements + stats.stores;
+            block(findChild(function, "FUNCTION_BODY"), {});
+            return stats.statements + stats.stores != removed;
+        }
+
+    private:
+        DeadCodeStats &stats;
+        // Occurrences of each name in the function, declarations included
+        std::map<std::string, size_t> references;
+
+        // Removes the dead statements of a block, given the variables live after it, and
+        // returns the variables live before it
+        Names block(IRNode *body, Names live)
+        {
+            if (!body)
+                return live;
+            std::vector<IRNode *> &statements = body->children;
+            for (size_t i = 0; i + 1 < statements.size(); ++i)
+            {
+                if (statements[i]->type != "RETURN_STATEMENT")
+                    continue;
+                for (size_t j = i + 1; j < statements.size(); ++j)
+                {
+                    delete statements[j];
+                }
+                stats.statements += statements.size() - i - 1;
+                statements.resize(i + 1);
+            }
+
+            for (size_t i = statements.size(); i-- > 0;)
+            {
+                IRNode *statement = statements[i];
+                if (statement->type == "RETURN_STATEMENT")
+                {
+                    live.clear();
+                    addReads(statement, live);
+                    continue;
+                }
+                if (statement->type == "FOR_LOOP")
+                {
+                    // A later iteration may read what this one stores, and the loop may not run at all
+                    addReads(statement, live);
+                    IRNode *inner = loopStatements(statement);
+                    block(inner, live);
+                    if (inner && inner->children.empty() && !hasEffects(statement))
+                    {
+                        remove(statements, i);
+                        ++stats.statements;
+                    }
+                    continue;
+                }
+
+                std::string name = storedName(statement);
+                bool store = statement->type == "VARIABLE_DECLARATION" || statement->type == "ASSIGNMENT_EXPRESSION";
+                bool dead = !hasEffects(statement);
+                if (statement->type == "VARIABLE_DECLARATION")
+                    dead = dead && !name.empty() && references[name] == 1;
+                else if (store)
+                    dead = dead && !name.empty() && !live.count(name);
+                if (dead)
+                {
+                    remove(statements, i);
+                    ++(store ? stats.stores : stats.statements);
+                    continue;
+                }
+
+                if (!name.empty())
+                    live.erase(name);
+                else if (store && findChild(statement, "IDENTIFIER"))
+                    live.insert(findChild(statement, "IDENTIFIER")->value);
+                addReads(statement, live);
+            }
+            return live;
+        }
+
+        void remove(std::vector<IRNode *> &statements, size_t index)
+        {
+            delete statements[index];
+            statements.erase(statements.begin() + index);
+        }
+    };
+}
+
+size_t removeUnreachableFunctions(IRNode *root, const DeadCodeOptions &options)
+{
+    if (!root || !options.enabled)
+        return 0;
+    CallGraph graph(root);
+    std::vector<IRNode *> pending;
+    for (const auto &name : options.entries.empty() ? std::vector<std::string>{"main"} : options.entries)
+    {
+        if (IRNode *entry = graph.definition(name))
+            pending.push_back(entry);
+    }
+    if (pending.empty())
+        return 0;
+
+    std::set<IRNode *> reachable(pending.begin(), pending.end());
+    while (!pending.empty())
+    {
+        IRNode *function = pending.back();
+        pending.pop_back();
+        for (auto callee : graph.callees(function))
+        {
+            if (reachable.insert(callee).second)
+                pending.push_back(callee);
+        }
+    }
+
+    size_t removed = 0;
+    std::vector<IRNode *> kept;
+    for (auto child : root->children)
+    {
+        if (child->type == "FUNCTION_DEFINITION" && !reachable.count(child))
+        {
+            delete child;
+            ++removed;
+        }
+        else
+            kept.push_back(child);
+    }
+    root->children = std::move(kept);
+    return removed;
+}
+
+DeadCodeStats eliminateDeadCode(IRNode *root, const DeadCodeOptions &options)
+{
+    DeadCodeStats stats;
+    if (!root || !options.enabled)
+        return stats;
+    stats.functions = removeUnreachableFunctions(root, options);
+    FunctionDeadCode pass(stats);
+    for (auto child : root->children)
+    {
+        if (child->type != "FUNCTION_DEFINITION")
+            continue;
+        while (pass.run(child))
+        {
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,37 @@
+#ifndef DEADCODE_H
+#define DEADCODE_H
+
+#include <string>
+#include <vector>
+#include "ir.h"
+
+// Command line settings of dead code elimination (--dce, --entry)
+struct DeadCodeOptions
+{
+    bool enabled = true;
+    // Functions the program starts from; empty means main. A program that defines none of them
+    // is a library and keeps all of its functions.
+    std::vector<std::string> entries;
+};
+
+struct DeadCodeStats
+{
+    size_t functions = 0;
+    // Statements after a return, expression statements without effects, and loops left empty
+    size_t statements = 0;
+    // Assignments and declarations of values that are never read
+    size_t stores = 0;
+};
+
+// Drops the functions that no entry point reaches through calls. Returns the number dropped.
+size_t removeUnreachableFunctions(IRNode *root, const DeadCodeOptions &options);
+
+// Drops unreachable functions, then, within each remaining function, statements after a return
+// and stores to variables that are not read before their next store or the function's end.
+// A variable read anywhere in a loop stays live through the whole loop. Only stores without
+// effects go: a right-hand side that calls a program function, an impure built-in or a method
+// other than transpose() keeps its statement, and so does every element store. A declaration
+// goes only with the variable's last use, since it gives the variable its type.
+DeadCodeStats eliminateDeadCode(IRNode *root, const DeadCodeOptions &options);
+
+#endif
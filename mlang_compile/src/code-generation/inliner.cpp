@@ -0,0 +1,315 @@
+#include "inliner.h"
+#include "builtins.h"
+#include "types.h"
+#include <algorithm>
+#include <set>
+
+namespace
+{
+    // Tarjan's algorithm; components come out after every component they call
+    class Components
+    {
+    public:
+        explicit Components(const std::map<IRNode *, std::vector<IRNode *>> &edges) : edges(edges) {}
+
+        std::vector<std::vector<IRNode *>> found;
+
+        void visit(IRNode *function)
+        {
+            if (index.count(function))
+                return;
+            index[function] = low[function] = next++;
+            stack.push_back(function);
+            onStack.insert(function);
+            for (IRNode *callee : edges.at(function))
+            {
+                if (!index.count(callee))
+                {
+                    visit(callee);
+                    low[function] = std::min(low[function], low[callee]);
+                }
+                else if (onStack.count(callee))
+                    low[function] = std::min(low[function], index[callee]);
+            }
+            if (low[function] != index[function])
+                return;
+            std::vector<IRNode *> component;
+            IRNode *member;
+            do
+            {
+                member = stack.back();
+                stack.pop_back();
+                onStack.erase(member);
+                component.push_back(member);
+            } while (member != function);
+            found.push_back(component);
+        }
+
+    private:
+        const std::map<IRNode *, std::vector<IRNode *>> &edges;
+        std::map<IRNode *, int> index;
+        std::map<IRNode *, int> low;
+        std::vector<IRNode *> stack;
+        std::set<IRNode *> onStack;
+        int next = 0;
+    };
+
+    size_t treeSize(const IRNode *node)
+    {
+        size_t size = 1;
+        for (auto child : node->children)
+        {
+            size += treeSize(child);
+        }
+        return size;
+    }
+
+    // Nodes the generators print without operators around them, so they need no parentheses anywhere
+    bool isPrimary(const IRNode *node)
+    {
+        if (node->type == "LITERAL_VALUE")
+            return node->value.empty() || node->value[0] != '-';
+        return node->type == "FUNCTION_CALL" || node->type == "INDEX_EXPRESSION" || node->type == "MEMBER_ACCESS" ||
+               node->type == "METHOD_CALL" || node->type == "VECTOR_LITERAL";
+    }
+
+    // Positions printed without parentheses around a compound operand: the operand of a unary
+    // operator and the object of an index, member access or method call
+    bool needsPrimary(const IRNode *parent, size_t index)
+    {
+        if (parent->type == "UNARY_OPERATOR")
+            return true;
+        return index == 0 && (parent->type == "INDEX_EXPRESSION" || parent->type == "MEMBER_ACCESS" || parent->type == "METHOD_CALL");
+    }
+
+    // True if evaluating the expression may do I/O or call back into the program
+    bool hasEffects(IRNode *expression)
+    {
+        bool effects = false;
+        visitTree(expression, [&](IRNode *node)
+                  {
+                      if (node->type == "METHOD_CALL" && node->value != "transpose")
+                          effects = true;
+                      else if (node->type == "FUNCTION_CALL")
+                      {
+                          const Builtin *builtin = findBuiltin(node->value);
+                          effects = effects || !builtin || !builtin->pure;
+                      } });
+        return effects;
+    }
+
+    // The expression of a body that is just "return expression;", or nullptr
+    IRNode *returnedExpression(IRNode *function)
+    {
+        std::vector<IRNode *> statements = blockStatements(findChild(function, "FUNCTION_BODY"));
+        if (statements.size() != 1 || statements[0]->type != "RETURN_STATEMENT" || statements[0]->children.size() != 1)
+            return nullptr;
+        return statements[0]->children[0];
+    }
+
+    class Inliner
+    {
+    public:
+        Inliner(IRNode *root, const InlineOptions &options) : graph(root), types(root), options(options) {}
+
+        size_t run()
+        {
+            for (IRNode *function : graph.bottomUp())
+            {
+                IRNode *body = findChild(function, "FUNCTION_BODY");
+                if (body && !graph.callees(function).empty())
+                    replaceCalls(body, types.locals(function));
+            }
+            return inlined;
+        }
+
+    private:
+        CallGraph graph;
+        ProgramTypes types;
+        InlineOptions options;
+        size_t inlined = 0;
+
+        // Post-order, so arguments are inlined before the call that takes them
+        void replaceCalls(IRNode *node, const Scope &scope)
+        {
+            for (size_t i = 0; i < node->children.size(); ++i)
+            {
+                IRNode *child = node->children[i];
+                replaceCalls(child, scope);
+                // A call statement has no value to substitute
+                if (child->type != "FUNCTION_CALL" || node->type == "FUNCTION_BODY")
+                    continue;
+                IRNode *expansion = expand(child, scope);
+                if (!expansion)
+                    continue;
+                if (needsPrimary(node, i) && !isPrimary(expansion))
+                {
+                    delete expansion;
+                    continue;
+                }
+                node->children[i] = expansion;
+                delete child;
+                ++inlined;
+            }
+        }
+
+        // The callee's returned expression with the call's arguments in place of the parameters,
+        // or nullptr if the call is not worth or not safe to inline
+        IRNode *expand(IRNode *call, const Scope &scope)
+        {
+            IRNode *callee = graph.definition(call->value);
+            const FunctionSignature *signature = types.function(call->value);
+            if (!callee || !signature || graph.isRecursive(callee))
+                return nullptr;
+            IRNode *returned = returnedExpression(callee);
+            if (!returned || signature->result == ValueKind::VOID || signature->result == ValueKind::UNKNOWN)
+                return nullptr;
+            // Statically shaped values convert between fixed and dynamic types at the call boundary
+            IRNode *returnType = findChild(callee, "RETURN_TYPE");
+            if (returnType && hasDimensionList(returnType->value))
+                return nullptr;
+            for (auto parameter : findChild(callee, "PARAMETERS") ? findChild(callee, "PARAMETERS")->children : std::vector<IRNode *>())
+            {
+                if (hasDimensionList(splitTypedName(parameter->value).second))
+                    return nullptr;
+            }
+
+            IRNode *argumentList = findChild(call, "ARGUMENTS");
+            std::vector<IRNode *> arguments = argumentList ? argumentList->children : std::vector<IRNode *>();
+            if (arguments.size() != signature->parameters.size())
+                return nullptr;
+            std::map<std::string, IRNode *> bound;
+            for (size_t i = 0; i < arguments.size(); ++i)
+            {
+                // Inlining drops the conversion a call makes from an Int argument to a Float parameter
+                ValueKind kind = signature->parameters[i].second;
+                if (kind == ValueKind::UNKNOWN || types.infer(arguments[i], scope) != kind || hasEffects(arguments[i]))
+                    return nullptr;
+                bound[signature->parameters[i].first] = arguments[i];
+            }
+
+            std::map<std::string, int> uses;
+            if (!checkUses(returned, nullptr, 0, bound, uses))
+                return nullptr;
+            long long growth = static_cast<long long>(treeSize(returned)) - static_cast<long long>(treeSize(call));
+            for (auto &argument : bound)
+            {
+                int count = uses[argument.first];
+                // Anything but a name or a constant is computed once, as the call computed it
+                if (argument.second->type != "LITERAL_VALUE" && count > 1)
+                    return nullptr;
+                growth += count * (static_cast<long long>(treeSize(argument.second)) - 1);
+            }
+            if (growth > options.maxGrowth)
+                return nullptr;
+
+            IRNode *expansion = substitute(returned, bound);
+            if (types.infer(expansion, scope) != signature->result)
+            {
+                delete expansion;
+                return nullptr;
+            }
+            expansion->line = call->line;
+            expansion->column = call->column;
+            return expansion;
+        }
+
+        // Counts parameter uses; false if the body names anything else or a compound argument
+        // would land where the generators do not parenthesize it
+        bool checkUses(IRNode *node, IRNode *parent, size_t index, const std::map<std::string, IRNode *> &bound,
+                       std::map<std::string, int> &uses)
+        {
+            if (isIdentifierNode(node))
+            {
+                auto argument = bound.find(node->value);
+                if (argument == bound.end())
+                    return false;
+                ++uses[node->value];
+                return !parent || !needsPrimary(parent, index) || isPrimary(argument->second);
+            }
+            for (size_t i = 0; i < node->children.size(); ++i)
+            {
+                if (!checkUses(node->children[i], node, i, bound, uses))
+                    return false;
+            }
+            return true;
+        }
+
+        IRNode *substitute(const IRNode *node, const std::map<std::string, IRNode *> &bound)
+        {
+            if (isIdentifierNode(node))
+                return cloneTree(bound.at(node->value));
+            IRNode *copy = new IRNode(node->type, node->value);
+            copy->line = node->line;
+            copy->column = node->column;
+            for (auto child : node->children)
+            {
+                copy->children.push_back(substitute(child, bound));
+            }
+            return copy;
+        }
+    };
+}
+
+CallGraph::CallGraph(IRNode *root)
+{
+    std::vector<IRNode *> functions;
+    for (auto child : root->children)
+    {
+        if (child->type != "FUNCTION_DEFINITION")
+            continue;
+        functions.push_back(child);
+        IRNode *name = findChild(child, "FUNCTION_NAME");
+        byName[name ? name->value : ""] = child;
+    }
+    for (IRNode *function : functions)
+    {
+        std::vector<IRNode *> &calls = edges[function];
+        visitTree(findChild(function, "FUNCTION_BODY"), [&](IRNode *node)
+                  {
+                      IRNode *callee = node->type == "FUNCTION_CALL" ? definition(node->value) : nullptr;
+                      if (callee && std::find(calls.begin(), calls.end(), callee) == calls.end())
+                          calls.push_back(callee); });
+    }
+
+    Components components(edges);
+    for (IRNode *function : functions)
+    {
+        components.visit(function);
+    }
+    for (auto &component : components.found)
+    {
+        for (IRNode *function : component)
+        {
+            const std::vector<IRNode *> &calls = edges[function];
+            recursive[function] = component.size() > 1 || std::find(calls.begin(), calls.end(), function) != calls.end();
+            order.push_back(function);
+        }
+    }
+}
+
+IRNode *CallGraph::definition(const std::string &name) const
+{
+    auto it = byName.find(name);
+    return it == byName.end() ? nullptr : it->second;
+}
+
+const std::vector<IRNode *> &CallGraph::callees(IRNode *function) const
+{
+    static const std::vector<IRNode *> none;
+    auto it = edges.find(function);
+    return it == edges.end() ? none : it->second;
+}
+
+bool CallGraph::isRecursive(IRNode *function) const
+{
+    auto it = recursive.find(function);
+    return it != recursive.end() && it->second;
+}
+
+size_t inlineFunctions(IRNode *root, const InlineOptions &options)
+{
+    if (!root || !options.enabled)
+        return 0;
+    return Inliner(root, options).run();
+}
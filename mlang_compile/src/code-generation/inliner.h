@@ -0,0 +1,44 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+// Command line settings of the inliner (--inline, --inline-limit)
+struct InlineOptions
+{
+    bool enabled = true;
+    // Most nodes an inlined call may add to its caller beyond the call it replaces
+    int maxGrowth = 16;
+};
+
+// Calls between the functions of a program; calls to built-ins and undefined functions have no edge
+class CallGraph
+{
+public:
+    explicit CallGraph(IRNode *root);
+
+    // Definitions in callee-before-caller order; functions on a cycle come out together, in any order
+    const std::vector<IRNode *> &bottomUp() const { return order; }
+    // Definition of a function, or nullptr; the last one wins, as in ProgramTypes
+    IRNode *definition(const std::string &name) const;
+    const std::vector<IRNode *> &callees(IRNode *function) const;
+    // Calls itself, directly or through other functions
+    bool isRecursive(IRNode *function) const;
+
+private:
+    std::map<std::string, IRNode *> byName;
+    std::map<IRNode *, std::vector<IRNode *>> edges;
+    std::map<IRNode *, bool> recursive;
+    std::vector<IRNode *> order;
+};
+
+// Replaces calls to small non-recursive functions whose body is a single return by the returned
+// expression, with the arguments substituted for the parameters. Callers see their callees
+// already inlined. Calls whose argument or result kinds differ from the signature, and
+// arguments that would be evaluated more than once, are left alone. Returns the calls replaced.
+size_t inlineFunctions(IRNode *root, const InlineOptions &options);
+
+#endif
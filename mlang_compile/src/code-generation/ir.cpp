@@ -0,0 +1,288 @@
+#include "ir.h"
+#include "../ast/ast-generation/astformat.h"
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <stack>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Read-only mapping of a whole file
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string &filename)
+        {
+            int fd = open(filename.c_str(), O_RDONLY);
+            struct stat status;
+            if (fd < 0 || fstat(fd, &status) != 0)
+            {
+                if (fd >= 0)
+                    close(fd);
+                throw std::runtime_error("Cannot open binary AST " + filename);
+            }
+            size = static_cast<size_t>(status.st_size);
+            void *mapped = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            close(fd);
+            if (mapped == MAP_FAILED)
+                throw std::runtime_error("Cannot map binary AST " + filename);
+            data = static_cast<const char *>(mapped);
+        }
+        ~MappedFile() { munmap(const_cast<char *>(data), size); }
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *data = nullptr;
+        size_t size = 0;
+    };
+
+    template <typename T>
+    T readAt(const char *data, uint64_t offset)
+    {
+        T value;
+        std::memcpy(&value, data + offset, sizeof(T));
+        return value;
+    }
+}
+
+IRNode *parseASTFromFile(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        return nullptr;
+    }
+
+    char magic[sizeof(BINARY_AST_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    if (file.gcount() == sizeof(magic) && std::memcmp(magic, BINARY_AST_MAGIC, sizeof(magic)) == 0)
+    {
+        file.close();
+        MappedFile mapped(filename);
+        return parseBinaryAST(mapped.data, mapped.size);
+    }
+
+    file.clear();
+    file.seekg(0);
+    IRNode *root = parseASTFromStream(file);
+    file.close();
+    return root;
+}
+
+IRNode *parseBinaryAST(const char *data, size_t size)
+{
+    if (size < sizeof(BinaryASTHeader))
+        throw std::runtime_error("Binary AST is truncated");
+    auto header = readAt<BinaryASTHeader>(data, 0);
+    if (std::memcmp(header.magic, BINARY_AST_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error("Not a binary AST");
+    if (header.version != BINARY_AST_VERSION)
+        throw std::runtime_error("Unsupported binary AST version " + std::to_string(header.version));
+    uint64_t offsetsEnd = header.stringsOffset + (uint64_t(header.stringCount) + 1) * sizeof(uint32_t);
+    if (header.fileBytes != size || header.nodeCount == 0 || header.stringCount == 0 ||
+        header.stringsOffset != sizeof(BinaryASTHeader) + uint64_t(header.nodeCount) * sizeof(BinaryASTNode) || offsetsEnd > size)
+        throw std::runtime_error("Binary AST is truncated or corrupt");
+
+    // String table offsets must rise and stay inside the file
+    const char *characters = data + offsetsEnd;
+    uint64_t characterBytes = size - offsetsEnd;
+    auto stringAt = [&](uint32_t index)
+    {
+        if (index >= header.stringCount)
+            throw std::runtime_error("Binary AST string index out of range");
+        uint32_t begin = readAt<uint32_t>(data, header.stringsOffset + uint64_t(index) * sizeof(uint32_t));
+        uint32_t end = readAt<uint32_t>(data, header.stringsOffset + (uint64_t(index) + 1) * sizeof(uint32_t));
+        if (begin > end || end > characterBytes)
+            throw std::runtime_error("Binary AST string table is corrupt");
+        return std::string(characters + begin, end - begin);
+    };
+
+    // Pre-order walk: each open node keeps the number of children still to come
+    std::unique_ptr<IRNode> root;
+    std::vector<std::pair<IRNode *, uint32_t>> open;
+    for (uint32_t i = 0; i < header.nodeCount; ++i)
+    {
+        auto record = readAt<BinaryASTNode>(data, sizeof(BinaryASTHeader) + uint64_t(i) * sizeof(BinaryASTNode));
+        if (record.kind >= static_cast<uint16_t>(ASTKind::COUNT))
+            throw std::runtime_error("Unknown binary AST node kind " + std::to_string(record.kind));
+        if ((i == 0) != (record.kind == static_cast<uint16_t>(ASTKind::ROOT)) || (i > 0 && open.empty()))
+            throw std::runtime_error("Binary AST node " + std::to_string(i) + " is out of place");
+
+        IRNode *node = new IRNode(astKindName(static_cast<ASTKind>(record.kind)), stringAt(record.value));
+        node->line = record.line;
+        node->column = record.column;
+        if (i == 0)
+        {
+            root.reset(node);
+        }
+        else
+        {
+            open.back().first->children.push_back(node);
+            --open.back().second;
+        }
+        if (record.childCount > 0)
+            open.emplace_back(node, record.childCount);
+        while (!open.empty() && open.back().second == 0)
+            open.pop_back();
+    }
+    if (!open.empty())
+        throw std::runtime_error("Binary AST ends inside a node");
+    return root.release();
+}
+
+IRNode *parseASTFromStream(std::istream &input)
+{
+    std::stack<IRNode *> nodeStack;
+    IRNode *root = new IRNode("ROOT");
+    nodeStack.push(root);
+
+    std::string line;
+    int prevIndent = -1;
+
+    while (std::getline(input, line))
+    {
+        if (line.empty())
+            continue;
+
+        size_t spaces = 0;
+        while (spaces < line.length() && line[spaces] == ' ')
+        {
+            spaces++;
+        }
+        int indent = static_cast<int>(spaces / 2);
+
+        line = line.substr(line.find_first_not_of(" \t"));
+        if (line.empty())
+            continue;
+
+        // Statement lines end with the source position of the MLang statement
+        int sourceLine = 0;
+        int sourceColumn = 0;
+        size_t locationPos = line.rfind(" [Line: ");
+        if (locationPos != std::string::npos && line.back() == ']' &&
+            std::sscanf(line.c_str() + locationPos, " [Line: %d, Column: %d]", &sourceLine, &sourceColumn) == 2)
+        {
+            line.erase(locationPos);
+        }
+
+        size_t colonPos = line.find(':');
+        IRNode *newNode;
+        if (colonPos != std::string::npos)
+        {
+            newNode = new IRNode(line.substr(0, colonPos), line.substr(std::min(line.size(), colonPos + 2)));
+        }
+        else
+        {
+            newNode = new IRNode(line);
+        }
+        newNode->line = sourceLine;
+        newNode->column = sourceColumn;
+
+        // Literal range bounds are printed inline ("RANGE_START: LITERAL_VALUE: 0"); give them a child node
+        // so that literal and compound bounds look the same to the generators
+        if ((newNode->type == "RANGE_START" || newNode->type == "RANGE_END") && !newNode->value.empty())
+        {
+            std::string bound = newNode->value;
+            size_t boundColon = bound.find(':');
+            newNode->value.clear();
+            if (boundColon != std::string::npos)
+                newNode->children.push_back(new IRNode(bound.substr(0, boundColon), bound.substr(std::min(bound.size(), boundColon + 2))));
+        }
+
+        while (indent <= prevIndent && !nodeStack.empty())
+        {
+            nodeStack.pop();
+            prevIndent--;
+        }
+
+        if (!nodeStack.empty())
+        {
+            nodeStack.top()->children.push_back(newNode);
+        }
+        nodeStack.push(newNode);
+        prevIndent = indent;
+    }
+
+    return root;
+}
+
+IRNode *cloneTree(const IRNode *node)
+{
+    IRNode *copy = new IRNode(node->type, node->value);
+    copy->line = node->line;
+    copy->column = node->column;
+    copy->children.reserve(node->children.size());
+    for (auto child : node->children)
+    {
+        copy->children.push_back(cloneTree(child));
+    }
+    return copy;
+}
+
+IRNode *findChild(IRNode *node, const std::string &type)
+{
+    if (!node)
+        return nullptr;
+    for (auto child : node->children)
+    {
+        if (child->type == type)
+            return child;
+    }
+    return nullptr;
+}
+
+std::pair<std::string, std::string> splitTypedName(const std::string &value)
+{
+    size_t typePos = value.find(" (TYPE:");
+    if (typePos == std::string::npos)
+        return {value, ""};
+    std::string type = value.substr(typePos + 7);
+    if (!type.empty() && type.back() == ')')
+        type.pop_back();
+    size_t first = type.find_first_not_of(' ');
+    return {value.substr(0, typePos), first == std::string::npos ? "" : type.substr(first)};
+}
+
+bool isIdentifierNode(const IRNode *node)
+{
+    if (!node || node->type != "LITERAL_VALUE" || node->value.empty())
+        return false;
+    unsigned char first = static_cast<unsigned char>(node->value[0]);
+    return std::isalpha(first) || first == '_';
+}
+
+std::vector<IRNode *> blockStatements(IRNode *block)
+{
+    if (!block)
+        return {};
+    if (block->type == "LOOP_BODY")
+    {
+        IRNode *inner = findChild(block, "FUNCTION_BODY");
+        return inner ? inner->children : block->children;
+    }
+    return block->children;
+}
+
+ForLoopParts forLoopParts(IRNode *loop)
+{
+    ForLoopParts parts;
+    for (auto child : loop->children)
+    {
+        if (child->type == "LOOP_VARIABLE")
+            parts.variable = splitTypedName(child->value).first;
+        else if (child->type == "RANGE_START" && !child->children.empty())
+            parts.start = child->children[0];
+        else if (child->type == "RANGE_END" && !child->children.empty())
+            parts.end = child->children[0];
+        else if (child->type == "LOOP_BODY")
+            parts.body = child;
+    }
+    return parts;
+}
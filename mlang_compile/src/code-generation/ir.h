@@ -0,0 +1,71 @@
+#ifndef IR_H
+#define IR_H
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Generic tree read back from the parser's indented AST dump. `type` is the text
+// before the first ':' of a line and `value` the text after it.
+class IRNode
+{
+public:
+    std::string type;
+    std::string value;
+    std::vector<IRNode *> children;
+    // MLang source position from the dump's "[Line: N, Column: M]" suffix; 0 when absent
+    int line = 0;
+    int column = 0;
+
+    IRNode(const std::string &t, const std::string &v = "") : type(t), value(v) {}
+    ~IRNode()
+    {
+        for (auto child : children)
+        {
+            delete child;
+        }
+    }
+};
+
+// Reads either AST format, told apart by the binary format's magic; null if the file cannot be
+// opened. Throws std::runtime_error for a malformed binary AST.
+IRNode *parseASTFromFile(const std::string &filename);
+IRNode *parseASTFromStream(std::istream &input);
+// Builds the tree from a binary AST (ast/ast-generation/astformat.h) held in memory
+IRNode *parseBinaryAST(const char *data, size_t size);
+
+// Deep copy of a subtree, source positions included
+IRNode *cloneTree(const IRNode *node);
+// First direct child with the given type, or nullptr
+IRNode *findChild(IRNode *node, const std::string &type);
+// Splits "name (TYPE: T)" into {"name", "T"}; the type is empty when absent
+std::pair<std::string, std::string> splitTypedName(const std::string &value);
+// True for a LITERAL_VALUE that names a variable rather than holding a number or string
+bool isIdentifierNode(const IRNode *node);
+// Statements of a FUNCTION_BODY, or of a LOOP_BODY through its nested FUNCTION_BODY
+std::vector<IRNode *> blockStatements(IRNode *block);
+
+struct ForLoopParts
+{
+    std::string variable;
+    IRNode *start = nullptr;
+    IRNode *end = nullptr;
+    IRNode *body = nullptr;
+};
+ForLoopParts forLoopParts(IRNode *loop);
+
+// Calls visit(node) for the node and all of its descendants in pre-order
+template <typename Visitor>
+void visitTree(IRNode *node, Visitor &&visit)
+{
+    if (!node)
+        return;
+    visit(node);
+    for (auto child : node->children)
+    {
+        visitTree(child, visit);
+    }
+}
+
+#endif
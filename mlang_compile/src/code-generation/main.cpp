@@ -1,401 +1,217 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <vector>
-#include <sstream>
-#include <unordered_map>
-#include <stack>
-#include <algorithm>
+#include "codegen.h"
+#include "cppgen.h"
+#include "cse.h"
+#include "deadcode.h"
+#include "inliner.h"
 
-class ASTNode
-{
-public:
-    std::string type;
-    std::string value;
-    std::vector<ASTNode *> children;
-
-    ASTNode(const std::string &t, const std::string &v = "") : type(t), value(v) {}
-    ~ASTNode()
-    {
-        for (auto child : children)
-        {
-            delete child;
-        }
-    }
-};
-
-class ASTPythonGenerator
+int main(int argc, char *argv[])
 {
-private:
-    int indentLevel = 0;
-    std::string getIndent()
-    {
-        return std::string(indentLevel * 4, ' ');
-    }
-
-    std::string simplifyExpression(const std::string &expr)
+    if (argc < 3)
     {
-        // Simple optimizations
-        if (expr == "0 + 0")
-            return "0";
-        if (expr == "a + 0" || expr == "0 + a")
-            return "a";
-        if (expr == "a * 1" || expr == "1 * a")
-            return "a";
-        if (expr == "a * 0" || expr == "0 * a")
-            return "0";
-
-        // Constant folding
-        std::istringstream iss(expr);
-        std::string token;
-        std::vector<std::string> tokens;
-
-        while (iss >> token)
-        {
-            tokens.push_back(token);
-        }
-
-        if (tokens.size() == 3 && (tokens[1] == "+" || tokens[1] == "-" || tokens[1] == "*" || tokens[1] == "/"))
-        {
-            try
-            {
-                int lhs = std::stoi(tokens[0]);
-                int rhs = std::stoi(tokens[2]);
-                if (tokens[1] == "+")
-                    return std::to_string(lhs + rhs);
-                if (tokens[1] == "-")
-                    return std::to_string(lhs - rhs);
-                if (tokens[1] == "*")
-                    return std::to_string(lhs * rhs);
-                if (tokens[1] == "/" && rhs != 0)
-                    return std::to_string(lhs / rhs);
-            }
-            catch (const std::exception &)
-            {
-                // Non-integer expressions are skipped
-            }
-        }
-
-        return expr; // Return the original if no optimization is applied
+        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file>"
+                  << " [--source-name NAME] [--diagnostics-format text|json|sarif] [--max-errors N]"
+                  << " [--line-comments] [--source-map FILE] [--instrument] [--profile-use FILE]"
+                  << " [--backend python|cpp] [--parallel on|off] [--vectorize on|off] [--schedule auto|static|dynamic]"
+                  << " [--min-parallel-trip N] [--float32] [--accumulate float32|float64]"
+                  << " [--inline on|off] [--inline-limit N] [--cse on|off] [--dce on|off] [--entry NAME]..." << std::endl;
+        return 1;
     }
 
-public:
-    std::string generatePython(ASTNode *node)
-    {
-        if (!node)
-            return "";
-        std::ostringstream python;
-
-        if (node->type == "FUNCTION_DEFINITION")
-        {
-            python << generateFunctionDefinition(node);
-            indentLevel = 0;
-        }
-        else if (node->type == "FOR_LOOP")
-        {
-            python << generateForLoop(node);
-        }
-        else if (node->type == "ASSIGNMENT_EXPRESSION")
-        {
-            python << generateAssignment(node);
+    std::string inputFile = argv[1];
+    std::string outputFile = argv[2];
+    std::string sourceName = inputFile;
+    std::string sourceMapFile;
+    std::string profileFile;
+    bool lineComments = false;
+    bool instrument = false;
+    std::string backend = "python";
+    ParallelOptions parallel;
+    PrecisionOptions precision;
+    InlineOptions inlining;
+    bool cse = true;
+    DeadCodeOptions deadCode;
+    DiagnosticFormat format = DiagnosticFormat::TEXT;
+    Diagnostics diagnostics;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (option == "--line-comments")
+        {
+            lineComments = true;
+            continue;
         }
-        else if (node->type == "RETURN_STATEMENT")
+        if (option == "--instrument")
         {
-            python << generateReturnStatement(node);
+            instrument = true;
+            continue;
         }
-        else
+        if (option == "--float32")
         {
-            for (auto child : node->children)
-            {
-                python << generatePython(child);
-            }
+            precision.float32 = true;
+            continue;
         }
-
-        return python.str();
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--source-name")
+            sourceName = value;
+        else if (option == "--source-map")
+            sourceMapFile = value;
+        else if (option == "--profile-use")
+            profileFile = value;
+        else if (option == "--max-errors")
+            diagnostics.setMaxPerFile(std::stoul(value));
+        else if (option == "--backend" && (value == "python" || value == "cpp"))
+            backend = value;
+        else if (option == "--parallel" && (value == "on" || value == "off"))
+            parallel.enabled = value == "on";
+        else if (option == "--vectorize" && (value == "on" || value == "off"))
+            parallel.vectorize = value == "on";
+        else if (option == "--schedule" && (value == "auto" || value == "static" || value == "dynamic"))
+            parallel.schedule = value == "auto" ? ScheduleChoice::AUTO : value == "static" ? ScheduleChoice::STATIC : ScheduleChoice::DYNAMIC;
+        else if (option == "--min-parallel-trip")
+            parallel.minTripCount = std::max(1LL, std::stoll(value));
+        else if (option == "--accumulate" && (value == "float32" || value == "float64"))
+            precision.accumulateFloat32 = value == "float32";
+        else if (option == "--inline" && (value == "on" || value == "off"))
+            inlining.enabled = value == "on";
+        else if (option == "--inline-limit")
+            inlining.maxGrowth = std::stoi(value);
+        else if (option == "--cse" && (value == "on" || value == "off"))
+            cse = value == "on";
+        else if (option == "--dce" && (value == "on" || value == "off"))
+            deadCode.enabled = value == "on";
+        else if (option == "--entry")
+            deadCode.entries.push_back(value);
+        else if (option != "--diagnostics-format" || !Diagnostics::parseFormat(value, format))
+        {
+            std::cerr << "Unknown option: " << option << " " << value << std::endl;
+            return 1;
+        }
+    }
+
+    if (backend != "cpp" && precision.float32)
+    {
+        std::cerr << "--float32 sets the native runtime's storage and requires --backend cpp" << std::endl;
+        return 1;
     }
-
-    std::string generateFunctionDefinition(ASTNode *node)
+    if (precision.accumulateFloat32 && !precision.float32)
     {
-        std::ostringstream python;
-        std::string funcName, returnType;
-        std::vector<std::string> params;
-
-        for (auto child : node->children)
-        {
-            if (child->type == "FUNCTION_NAME")
-            {
-                funcName = child->value;
-            }
-            else if (child->type == "RETURN_TYPE")
-            {
-                returnType = child->value;
-                std::transform(returnType.begin(), returnType.end(), returnType.begin(),
-                               [](unsigned char c)
-                               { return std::tolower(c); });
-            }
-            else if (child->type == "PARAMETERS")
-            {
-                for (auto param : child->children)
-                {
-                    std::string paramName = param->value;
-                    std::string paramType = "";
-                    size_t typePos = paramName.find(" (TYPE:");
-                    if (typePos != std::string::npos)
-                    {
-                        paramType = paramName.substr(typePos + 7);
-                        paramName = paramName.substr(0, typePos);
-                        if (!paramType.empty() && paramType.back() == ')')
-                        {
-                            paramType.pop_back();
-                        }
-                        std::transform(paramType.begin(), paramType.end(), paramType.begin(),
-                                       [](unsigned char c)
-                                       { return std::tolower(c); });
-                        params.push_back(paramName + ": " + paramType);
-                    }
-                    else
-                    {
-                        params.push_back(paramName);
-                    }
-                }
-            }
-        }
-
-        python << getIndent() << "def " << funcName << "(" << join(params, ", ") << ") -> " << returnType << ":\n";
-        indentLevel++;
-        for (auto child : node->children)
-        {
-            if (child->type == "FUNCTION_BODY")
-            {
-                python << generatePython(child);
-            }
-        }
-        indentLevel--;
-        return python.str();
+        std::cerr << "--accumulate float32 requires --float32" << std::endl;
+        return 1;
     }
 
-    std::string generateForLoop(ASTNode *node)
+    IRNode *root = nullptr;
+    try
     {
-        std::ostringstream python;
-        std::string loopVar, rangeStart, rangeEnd;
-
-        for (auto child : node->children)
-        {
-            if (child->type == "LOOP_VARIABLE")
-            {
-                std::string fullVar = child->value;
-                size_t pos = fullVar.find(" (TYPE:");
-                loopVar = (pos != std::string::npos) ? fullVar.substr(0, pos) : fullVar;
-            }
-            else if (child->type == "RANGE_START")
-            {
-                rangeStart = child->value.find("LITERAL_VALUE") != std::string::npos ? child->value.substr(child->value.find(":") + 1) : (!child->children.empty() ? child->children[0]->value : "");
-            }
-            else if (child->type == "RANGE_END")
-            {
-                rangeEnd = child->value.find("LITERAL_VALUE") != std::string::npos ? child->value.substr(child->value.find(":") + 1) : (!child->children.empty() ? child->children[0]->value : "");
-            }
-        }
-
-        if (loopVar.empty() || rangeStart.empty() || rangeEnd.empty())
-        {
-            return "";
-        }
-
-        python << getIndent() << "for " << loopVar << " in range(" << rangeStart << ", " << rangeEnd << "):\n";
-        indentLevel++;
-
-        for (auto child : node->children)
-        {
-            if (child->type == "LOOP_BODY")
-            {
-                for (auto loopBodyChild : child->children)
-                {
-                    python << generatePython(loopBodyChild);
-                }
-            }
-        }
-
-        indentLevel--;
-        return python.str();
+        root = parseASTFromFile(inputFile);
     }
-
-    std::string generateExpression(ASTNode *node)
+    catch (const std::runtime_error &e)
     {
-        std::ostringstream expression;
-        if (node->type == "EXPRESSION")
-        {
-            for (auto child : node->children)
-            {
-                expression << generateExpression(child);
-            }
-        }
-        else if (node->type == "OPERATOR")
-        {
-            if (node->children.size() == 2)
-            {
-                std::string left = generateExpression(node->children[0]);
-                std::string right = generateExpression(node->children[1]);
-                expression << simplifyExpression(left + " " + node->value + " " + right);
-            }
-        }
-        else if (node->type == "LITERAL_VALUE" || node->type == "IDENTIFIER")
-        {
-            expression << node->value;
-        }
-        return expression.str();
+        diagnostics.error(diagnostics.addFile(inputFile), DiagnosticCode::MALFORMED_AST, {0, 0, 0, 0}, e.what());
+        diagnostics.flush(std::cerr, format);
+        return 1;
     }
-
-    std::string generateAssignment(ASTNode *node)
+    if (root == nullptr)
     {
-        std::ostringstream python;
-        std::string variable;
-        std::string value;
-
-        for (auto child : node->children)
-        {
-            if (child->type == "IDENTIFIER")
-            {
-                variable = child->value;
-            }
-            if (child->type == "EXPRESSION")
-            {
-                value = generateExpression(child);
-            }
-        }
-
-        if (!variable.empty() && !value.empty())
-        {
-            python << getIndent() << variable << " = " << simplifyExpression(value) << "\n";
-        }
-
-        return python.str();
+        diagnostics.error(diagnostics.addFile(inputFile), DiagnosticCode::IO_ERROR, {0, 0, 0, 0}, "Error opening file");
+        diagnostics.flush(std::cerr, format);
+        return 1;
     }
 
-    std::string generateReturnStatement(ASTNode *node)
-    {
-        std::ostringstream python;
-        std::string expr = generateExpression(node->children[0]);
-        python << getIndent() << "return " << simplifyExpression(expr) << "\n";
-        return python.str();
-    }
+    // Unused helpers cost the later passes nothing
+    removeUnreachableFunctions(root, deadCode);
+    // Instrumented builds keep every call, so the profile counts the functions the source calls
+    if (!instrument)
+        inlineFunctions(root, inlining);
+    // After inlining, which can make expressions of different calls equal
+    if (cse)
+        eliminateCommonSubexpressions(root);
+    // Last, so it also drops the functions inlining left uncalled and the stores CSE made redundant
+    eliminateDeadCode(root, deadCode);
 
-    std::string join(const std::vector<std::string> &vec, const std::string &delim)
+    uint32_t sourceId = diagnostics.addFile(sourceName);
+    Profile profile;
+    bool hasProfile = false;
+    if (!profileFile.empty())
     {
-        std::ostringstream result;
-        for (size_t i = 0; i < vec.size(); ++i)
+        try
+        {
+            profile = Profile::readFromFile(profileFile);
+            hasProfile = true;
+        }
+        catch (const std::exception &e)
         {
-            if (i > 0)
-                result << delim;
-            result << vec[i];
+            diagnostics.report(diagnostics.addFile(profileFile), Severity::WARNING, DiagnosticCode::PROFILE, {0, 0, 0, 0},
+                               std::string(e.what()) + "; building without profile data");
         }
-        return result.str();
     }
-};
 
-ASTNode *parseASTFromFile(const std::string &filename)
-{
-    std::ifstream file(filename);
-    if (!file.is_open())
+    std::string generatedCode;
+    SourceMap sourceMap;
+    if (backend == "cpp")
     {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return nullptr;
+        ASTCppGenerator generator;
+        generator.setDiagnostics(&diagnostics, sourceId);
+        generator.setSourceName(sourceName);
+        generator.setLineComments(lineComments);
+        generator.setInstrumentation(instrument);
+        generator.setParallelOptions(parallel);
+        generator.setPrecision(precision);
+        generator.setProfile(hasProfile ? &profile : nullptr);
+        generatedCode = generator.generateProgram(root);
+        sourceMap = generator.getSourceMap();
     }
-
-    std::stack<ASTNode *> nodeStack;
-    ASTNode *root = new ASTNode("ROOT");
-    nodeStack.push(root);
-
-    std::string line;
-    int prevIndent = -1;
-
-    while (std::getline(file, line))
+    else
     {
-        if (line.empty())
-            continue;
-
-        int indent = 0;
-        while (indent < line.length() && line[indent] == ' ')
+        ASTPythonGenerator generator;
+        generator.setDiagnostics(&diagnostics, sourceId);
+        generator.setSourceName(sourceName);
+        generator.setLineComments(lineComments);
+        generator.setInstrumentation(instrument);
+        generator.setParallelOptions(parallel);
+        if (hasProfile)
         {
-            indent++;
+            generator.setProfile(&profile);
+            generator.reportProfile();
         }
-        indent /= 2;
-
-        line = line.substr(line.find_first_not_of(" \t"));
-        if (line.empty())
-            continue;
-
-        size_t colonPos = line.find(':');
-        ASTNode *newNode;
-        if (colonPos != std::string::npos)
-        {
-            newNode = new ASTNode(line.substr(0, colonPos), line.substr(colonPos + 2));
-        }
-        else
-        {
-            newNode = new ASTNode(line);
-        }
-
-        while (indent <= prevIndent && !nodeStack.empty())
-        {
-            nodeStack.pop();
-            prevIndent--;
-        }
-
-        if (!nodeStack.empty())
-        {
-            nodeStack.top()->children.push_back(newNode);
-        }
-        nodeStack.push(newNode);
-        prevIndent = indent;
+        generatedCode = generator.generateProgram(root);
+        sourceMap = generator.getSourceMap();
     }
-
-    file.close();
-    return root;
-}
-
-int main(int argc, char *argv[])
-{
-    if (argc < 3)
-    {
-        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file>" << std::endl;
-        return 1;
-    }
-
-    std::string inputFile = argv[1];
-    std::string outputFile = argv[2];
-
-    ASTNode *root = parseASTFromFile(inputFile);
-    if (root == nullptr)
+    if (diagnostics.hasErrors())
     {
+        diagnostics.flush(std::cerr, format);
+        delete root;
         return 1;
     }
 
-    ASTPythonGenerator generator;
-    std::string pythonCode;
-
-    for (auto child : root->children)
-    {
-        if (child->type == "FUNCTION_DEFINITION")
-        {
-            pythonCode += generator.generatePython(child);
-            pythonCode += "\n";
-        }
-    }
-
     std::ofstream outputFileStream(outputFile);
     if (!outputFileStream.is_open())
     {
-        std::cerr << "Error: Could not open output file " << outputFile << std::endl;
+        diagnostics.error(diagnostics.addFile(outputFile), DiagnosticCode::IO_ERROR, {0, 0, 0, 0}, "Could not open output file");
+        diagnostics.flush(std::cerr, format);
         delete root;
         return 1;
     }
 
-    outputFileStream << pythonCode;
+    outputFileStream << generatedCode;
     outputFileStream.close();
 
-    std::cout << "Python code has been successfully written to " << outputFile << std::endl;
+    if (!sourceMapFile.empty() && !sourceMap.writeToFile(sourceMapFile))
+    {
+        diagnostics.error(diagnostics.addFile(sourceMapFile), DiagnosticCode::IO_ERROR, {0, 0, 0, 0}, "Could not write source map");
+    }
+
+    std::cout << (backend == "cpp" ? "C++" : "Python") << " code has been successfully written to " << outputFile << std::endl;
 
+    diagnostics.flush(std::cerr, format);
     delete root;
     return 0;
 }
@@ -0,0 +1,204 @@
+#include "sourcemap.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    const char MAGIC[] = "MLSM";
+    const uint64_t VERSION = 1;
+    const char LOCATION_BEGIN = '\x01';
+    const char LOCATION_END = '\x02';
+
+    void writeVarint(std::string &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    void writeSigned(std::string &out, int64_t value)
+    {
+        writeVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    uint64_t readVarint(const std::string &in, size_t &pos)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= in.size())
+            {
+                throw std::runtime_error("Truncated source map");
+            }
+            uint8_t byte = static_cast<uint8_t>(in[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return value;
+            }
+        }
+        throw std::runtime_error("Malformed varint in source map");
+    }
+
+    int64_t readSigned(const std::string &in, size_t &pos)
+    {
+        uint64_t value = readVarint(in, pos);
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+}
+
+void SourceMap::add(uint32_t generatedLine, uint32_t sourceLine, uint32_t sourceColumn)
+{
+    if (!entries.empty())
+    {
+        SourceMapEntry &last = entries.back();
+        if (last.sourceLine == sourceLine && last.sourceColumn == sourceColumn)
+            return;
+        if (last.generatedLine == generatedLine)
+        {
+            last.sourceLine = sourceLine;
+            last.sourceColumn = sourceColumn;
+            return;
+        }
+    }
+    entries.push_back({generatedLine, sourceLine, sourceColumn});
+}
+
+const SourceMapEntry *SourceMap::lookup(uint32_t generatedLine) const
+{
+    auto it = std::upper_bound(entries.begin(), entries.end(), generatedLine,
+                               [](uint32_t line, const SourceMapEntry &entry)
+                               { return line < entry.generatedLine; });
+    if (it == entries.begin())
+        return nullptr;
+    return &*(it - 1);
+}
+
+std::string SourceMap::encode() const
+{
+    std::string out(MAGIC, 4);
+    writeVarint(out, VERSION);
+    writeVarint(out, sourceName.size());
+    out += sourceName;
+    writeVarint(out, entries.size());
+
+    uint32_t previousGenerated = 0;
+    uint32_t previousSource = 0;
+    for (const auto &entry : entries)
+    {
+        writeVarint(out, entry.generatedLine - previousGenerated);
+        writeSigned(out, static_cast<int64_t>(entry.sourceLine) - previousSource);
+        writeVarint(out, entry.sourceColumn);
+        previousGenerated = entry.generatedLine;
+        previousSource = entry.sourceLine;
+    }
+    return out;
+}
+
+SourceMap SourceMap::decode(const std::string &bytes)
+{
+    if (bytes.compare(0, 4, MAGIC) != 0)
+    {
+        throw std::runtime_error("Not an MLang source map");
+    }
+    size_t pos = 4;
+    if (readVarint(bytes, pos) != VERSION)
+    {
+        throw std::runtime_error("Unsupported source map version");
+    }
+
+    SourceMap map;
+    uint64_t nameLength = readVarint(bytes, pos);
+    if (nameLength > bytes.size() - pos)
+    {
+        throw std::runtime_error("Truncated source map");
+    }
+    map.sourceName = bytes.substr(pos, nameLength);
+    pos += nameLength;
+
+    uint64_t count = readVarint(bytes, pos);
+    // Every entry takes at least three bytes, which bounds a corrupt count
+    if (count > (bytes.size() - pos) / 3)
+    {
+        throw std::runtime_error("Truncated source map");
+    }
+    map.entries.reserve(count);
+    int64_t generated = 0;
+    int64_t source = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        generated += readVarint(bytes, pos);
+        source += readSigned(bytes, pos);
+        uint32_t column = static_cast<uint32_t>(readVarint(bytes, pos));
+        map.entries.push_back({static_cast<uint32_t>(generated), static_cast<uint32_t>(source), column});
+    }
+    return map;
+}
+
+bool SourceMap::writeToFile(const std::string &filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::string bytes = encode();
+    file.write(bytes.data(), bytes.size());
+    return static_cast<bool>(file);
+}
+
+SourceMap SourceMap::readFromFile(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Error opening source map: " + filename);
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return decode(buffer.str());
+}
+
+std::string locationTag(int line, int column)
+{
+    if (line <= 0)
+        return "";
+    return LOCATION_BEGIN + std::to_string(line) + ":" + std::to_string(column) + LOCATION_END;
+}
+
+std::string resolveLocationTags(const std::string &code, SourceMap &map, const std::string &commentPrefix)
+{
+    std::string resolved;
+    resolved.reserve(code.size());
+    uint32_t generatedLine = 1;
+    size_t start = 0;
+    while (start < code.size())
+    {
+        size_t end = code.find('\n', start);
+        if (end == std::string::npos)
+            end = code.size();
+
+        std::string comment;
+        if (code[start] == LOCATION_BEGIN)
+        {
+            size_t close = code.find(LOCATION_END, start);
+            size_t colon = code.find(':', start);
+            uint32_t sourceLine = std::stoul(code.substr(start + 1, colon - start - 1));
+            uint32_t sourceColumn = std::stoul(code.substr(colon + 1, close - colon - 1));
+            map.add(generatedLine, sourceLine, sourceColumn);
+            if (!commentPrefix.empty())
+                comment = commentPrefix + "line " + std::to_string(sourceLine);
+            start = close + 1;
+        }
+        resolved.append(code, start, end - start);
+        resolved += comment;
+        if (end < code.size())
+            resolved += '\n';
+        start = end + 1;
+        ++generatedLine;
+    }
+    return resolved;
+}
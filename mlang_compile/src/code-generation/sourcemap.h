@@ -0,0 +1,50 @@
+#ifndef SOURCEMAP_H
+#define SOURCEMAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One generated line attributed to an MLang source position
+struct SourceMapEntry
+{
+    uint32_t generatedLine;
+    uint32_t sourceLine;
+    uint32_t sourceColumn;
+};
+
+// Line table from a generated file (Python or C++) back to the .mlang source.
+// Entries are sorted by generated line; a generated line without its own entry
+// belongs to the closest entry above it.
+//
+// Sidecar encoding (all integers are LEB128 varints, signed ones zigzag-encoded):
+//   "MLSM" version source-name-length source-name entry-count
+//   entry-count x (generated-line delta, signed source-line delta, source-column)
+class SourceMap
+{
+public:
+    std::string sourceName;
+    std::vector<SourceMapEntry> entries;
+
+    // Consecutive entries with the same source position are merged
+    void add(uint32_t generatedLine, uint32_t sourceLine, uint32_t sourceColumn);
+    // Returns nullptr if the generated line precedes every mapped line
+    const SourceMapEntry *lookup(uint32_t generatedLine) const;
+
+    std::string encode() const;
+    // Throws std::runtime_error on a truncated or foreign table
+    static SourceMap decode(const std::string &bytes);
+
+    bool writeToFile(const std::string &filename) const;
+    static SourceMap readFromFile(const std::string &filename);
+};
+
+// Generators prefix the first line of each statement they emit with a tag holding
+// the statement's MLang position, so the line table can be built once the final
+// line numbers are known. Returns "" for nodes without a position.
+std::string locationTag(int line, int column);
+// Strips the tags, records them in map and, if commentPrefix is not empty, ends
+// each tagged line with commentPrefix + "line N"
+std::string resolveLocationTags(const std::string &code, SourceMap &map, const std::string &commentPrefix);
+
+#endif
@@ -0,0 +1,316 @@
+#include "types.h"
+#include "builtins.h"
+#include <cctype>
+#include <sstream>
+
+ValueKind parseValueKind(const std::string &type)
+{
+    std::string base = type.substr(0, type.find('<'));
+    if (base.empty() || base == "Void")
+        return ValueKind::VOID;
+    if (base == "Int")
+        return ValueKind::INT;
+    if (base == "Float")
+        return ValueKind::FLOAT;
+    if (base == "Bool")
+        return ValueKind::BOOL;
+    if (base == "String")
+        return ValueKind::STRING;
+    if (base == "Vector")
+        return ValueKind::VECTOR;
+    if (base == "Matrix" || base == "Dataset")
+        return ValueKind::MATRIX;
+    if (base == "SparseMatrix" || base == "SparseDataset")
+        return ValueKind::SPARSE_MATRIX;
+    return ValueKind::UNKNOWN;
+}
+
+bool isScalar(ValueKind kind)
+{
+    return kind == ValueKind::INT || kind == ValueKind::FLOAT || kind == ValueKind::BOOL;
+}
+
+bool isArray(ValueKind kind)
+{
+    return kind == ValueKind::VECTOR || kind == ValueKind::MATRIX;
+}
+
+std::string cppTypeName(ValueKind kind)
+{
+    switch (kind)
+    {
+    case ValueKind::VOID:
+        return "void";
+    case ValueKind::INT:
+        return "long long";
+    case ValueKind::FLOAT:
+        return "double";
+    case ValueKind::BOOL:
+        return "bool";
+    case ValueKind::STRING:
+        return "std::string";
+    case ValueKind::VECTOR:
+        return "Vector";
+    case ValueKind::MATRIX:
+        return "Matrix";
+    case ValueKind::SPARSE_MATRIX:
+        return "SparseMatrix";
+    default:
+        return "auto";
+    }
+}
+
+StaticShape parseStaticShape(const std::string &type)
+{
+    ValueKind kind = parseValueKind(type);
+    size_t comma = type.find(',', type.find('<'));
+    size_t close = type.rfind('>');
+    if (!isArray(kind) || comma == std::string::npos || close == std::string::npos || close < comma)
+        return {};
+    StaticShape shape;
+    std::stringstream dimensions(type.substr(comma + 1, close - comma - 1));
+    std::string extent;
+    while (std::getline(dimensions, extent, ','))
+    {
+        size_t first = extent.find_first_not_of(' ');
+        size_t last = extent.find_last_not_of(' ');
+        if (first == std::string::npos)
+            return {};
+        extent = extent.substr(first, last - first + 1);
+        // Extents are positive literals; nine digits keeps them well inside size_t
+        if (extent.find_first_not_of("0123456789") != std::string::npos || extent.size() > 9 || std::stoul(extent) == 0)
+            return {};
+        shape.push_back(std::stoul(extent));
+    }
+    if (shape.size() != (kind == ValueKind::VECTOR ? 1u : 2u))
+        return {};
+    return shape;
+}
+
+bool hasDimensionList(const std::string &type)
+{
+    return type.find(',') != std::string::npos;
+}
+
+std::string cppTypeName(ValueKind kind, const StaticShape &shape)
+{
+    if (kind == ValueKind::VECTOR && shape.size() == 1)
+        return "FixedVector<" + std::to_string(shape[0]) + ">";
+    if (kind == ValueKind::MATRIX && shape.size() == 2)
+        return "FixedMatrix<" + std::to_string(shape[0]) + ", " + std::to_string(shape[1]) + ">";
+    return cppTypeName(kind);
+}
+
+ProgramTypes::ProgramTypes(IRNode *root)
+{
+    for (auto child : root->children)
+    {
+        if (child->type != "FUNCTION_DEFINITION")
+            continue;
+        FunctionSignature signature;
+        signature.definition = child;
+        for (auto part : child->children)
+        {
+            if (part->type == "FUNCTION_NAME")
+                signature.name = part->value;
+            else if (part->type == "RETURN_TYPE")
+            {
+                signature.result = parseValueKind(part->value);
+                signature.resultShape = parseStaticShape(part->value);
+            }
+            else if (part->type == "PARAMETERS")
+            {
+                for (auto parameter : part->children)
+                {
+                    auto typed = splitTypedName(parameter->value);
+                    signature.parameters.push_back({typed.first, parseValueKind(typed.second)});
+                }
+            }
+        }
+        byName[signature.name] = signatures.size();
+        signatures.push_back(signature);
+    }
+}
+
+const FunctionSignature *ProgramTypes::function(const std::string &name) const
+{
+    auto it = byName.find(name);
+    return it == byName.end() ? nullptr : &signatures[it->second];
+}
+
+Scope ProgramTypes::locals(IRNode *function) const
+{
+    Scope scope;
+    for (auto part : function->children)
+    {
+        if (part->type == "PARAMETERS")
+        {
+            for (auto parameter : part->children)
+            {
+                auto typed = splitTypedName(parameter->value);
+                scope[typed.first] = parseValueKind(typed.second);
+            }
+        }
+    }
+    // A variable may be assigned from one that is only typed further down; a few passes settle the chain
+    IRNode *body = findChild(function, "FUNCTION_BODY");
+    size_t unknown = scope.size() + 1;
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        collectLocals(body, scope);
+        size_t remaining = 0;
+        for (const auto &local : scope)
+        {
+            remaining += local.second == ValueKind::UNKNOWN;
+        }
+        if (remaining == 0 || remaining == unknown)
+            break;
+        unknown = remaining;
+    }
+    return scope;
+}
+
+Shapes ProgramTypes::shapes(IRNode *function) const
+{
+    Shapes result;
+    auto record = [&result](const std::string &value)
+    {
+        auto typed = splitTypedName(value);
+        StaticShape shape = parseStaticShape(typed.second);
+        if (!shape.empty())
+            result[typed.first] = shape;
+    };
+    if (IRNode *parameters = findChild(function, "PARAMETERS"))
+    {
+        for (auto parameter : parameters->children)
+        {
+            record(parameter->value);
+        }
+    }
+    visitTree(findChild(function, "FUNCTION_BODY"), [&](IRNode *node)
+              {
+        if (node->type == "VARIABLE_DECLARATION" && !node->children.empty())
+            record(node->children[0]->value); });
+    return result;
+}
+
+void ProgramTypes::collectLocals(IRNode *node, Scope &scope) const
+{
+    if (!node)
+        return;
+    if (node->type == "VARIABLE_DECLARATION" && !node->children.empty())
+    {
+        auto typed = splitTypedName(node->children[0]->value);
+        ValueKind kind = parseValueKind(typed.second);
+        if (kind == ValueKind::VOID && node->children.size() > 1)
+            kind = infer(node->children[1], scope);
+        scope[typed.first] = kind;
+        return;
+    }
+    if (node->type == "FOR_LOOP")
+    {
+        scope[forLoopParts(node).variable] = ValueKind::INT;
+    }
+    else if (node->type == "ASSIGNMENT_EXPRESSION" && !findChild(node, "INDEX"))
+    {
+        IRNode *target = findChild(node, "IDENTIFIER");
+        IRNode *value = findChild(node, "EXPRESSION");
+        if (target && value)
+        {
+            auto known = scope.find(target->value);
+            if (known == scope.end() || known->second == ValueKind::UNKNOWN)
+                scope[target->value] = infer(value, scope);
+        }
+        return;
+    }
+    for (auto child : node->children)
+    {
+        collectLocals(child, scope);
+    }
+}
+
+namespace
+{
+    ValueKind promote(ValueKind left, ValueKind right)
+    {
+        if (left == ValueKind::UNKNOWN || right == ValueKind::UNKNOWN)
+            return ValueKind::UNKNOWN;
+        return left == ValueKind::FLOAT || right == ValueKind::FLOAT ? ValueKind::FLOAT : ValueKind::INT;
+    }
+}
+
+ValueKind ProgramTypes::infer(IRNode *expression, const Scope &scope) const
+{
+    if (!expression)
+        return ValueKind::UNKNOWN;
+    const std::string &type = expression->type;
+    if (type == "EXPRESSION" || type == "RANGE_START" || type == "RANGE_END")
+        return expression->children.empty() ? ValueKind::UNKNOWN : infer(expression->children[0], scope);
+    if (type == "LITERAL_VALUE")
+    {
+        const std::string &value = expression->value;
+        if (value.empty())
+            return ValueKind::UNKNOWN;
+        if (value[0] == '"')
+            return ValueKind::STRING;
+        if (isIdentifierNode(expression))
+        {
+            auto it = scope.find(value);
+            return it == scope.end() ? ValueKind::UNKNOWN : it->second;
+        }
+        return value.find_first_of(".eE") == std::string::npos ? ValueKind::INT : ValueKind::FLOAT;
+    }
+    if (type == "UNARY_OPERATOR")
+        return expression->children.empty() ? ValueKind::UNKNOWN : infer(expression->children[0], scope);
+    if (type == "VECTOR_LITERAL")
+        return ValueKind::VECTOR;
+    if (type == "MEMBER_ACCESS")
+        return expression->value == "rows" || expression->value == "cols" ? ValueKind::INT : ValueKind::UNKNOWN;
+    if (type == "METHOD_CALL")
+    {
+        if (expression->value == "normalize")
+            return ValueKind::VOID;
+        if (expression->value != "transpose")
+            return ValueKind::UNKNOWN;
+        bool sparse = !expression->children.empty() && infer(expression->children[0], scope) == ValueKind::SPARSE_MATRIX;
+        return sparse ? ValueKind::SPARSE_MATRIX : ValueKind::MATRIX;
+    }
+    if (type == "INDEX_EXPRESSION" && !expression->children.empty())
+    {
+        ValueKind base = infer(expression->children[0], scope);
+        if (base == ValueKind::VECTOR)
+            return ValueKind::FLOAT;
+        return base == ValueKind::MATRIX ? ValueKind::VECTOR : ValueKind::UNKNOWN;
+    }
+    if (type == "FUNCTION_CALL")
+    {
+        if (const FunctionSignature *signature = function(expression->value))
+            return signature->result;
+        const Builtin *builtin = findBuiltin(expression->value);
+        return builtin ? builtin->result : ValueKind::UNKNOWN;
+    }
+    if (type != "OPERATOR" || expression->children.size() != 2)
+        return ValueKind::UNKNOWN;
+
+    ValueKind left = infer(expression->children[0], scope);
+    ValueKind right = infer(expression->children[1], scope);
+    const std::string &op = expression->value;
+    if (isScalar(left) && isScalar(right))
+        return op == "/" ? promote(ValueKind::FLOAT, right) : promote(left, right);
+    if (op == "*")
+    {
+        // Sparse matrices only multiply vectors (spmv)
+        if (left == ValueKind::SPARSE_MATRIX)
+            return right == ValueKind::VECTOR ? ValueKind::VECTOR : ValueKind::UNKNOWN;
+        if (left == ValueKind::MATRIX)
+            return right == ValueKind::VECTOR || right == ValueKind::MATRIX ? right : isScalar(right) ? ValueKind::MATRIX : ValueKind::UNKNOWN;
+        if (left == ValueKind::VECTOR && right == ValueKind::VECTOR)
+            return ValueKind::FLOAT;
+        if (isScalar(left) && isArray(right))
+            return right;
+        return isArray(left) && isScalar(right) ? left : ValueKind::UNKNOWN;
+    }
+    if (op == "/")
+        return isArray(left) && isScalar(right) ? left : ValueKind::UNKNOWN;
+    return left == right && isArray(left) ? left : ValueKind::UNKNOWN;
+}
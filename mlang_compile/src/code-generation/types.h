@@ -0,0 +1,78 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+// Value categories the code generators distinguish; Dataset and Matrix share one
+enum class ValueKind
+{
+    UNKNOWN,
+    VOID,
+    INT,
+    FLOAT,
+    BOOL,
+    STRING,
+    VECTOR,
+    MATRIX,
+    // SparseMatrix and SparseDataset, CSR storage in the native runtime
+    SPARSE_MATRIX
+};
+
+// Maps an MLang type as printed in the AST ("Int", "Vector<Float>", "Dataset", "") to its kind
+ValueKind parseValueKind(const std::string &type);
+bool isScalar(ValueKind kind);
+bool isArray(ValueKind kind);
+// C++ type of the native backend (runtime/runtime.h)
+std::string cppTypeName(ValueKind kind);
+
+// Extents from an optional dimension list, Vector<Float, 3> or Matrix<Float, 2, 3>; empty
+// when the extents are only known at run time or the list is malformed
+using StaticShape = std::vector<size_t>;
+StaticShape parseStaticShape(const std::string &type);
+// True if type has a dimension list, valid or not
+bool hasDimensionList(const std::string &type);
+// FixedVector<N> or FixedMatrix<R, C> (runtime/fixed.h) for a static shape, else cppTypeName(kind)
+std::string cppTypeName(ValueKind kind, const StaticShape &shape);
+
+struct FunctionSignature
+{
+    std::string name;
+    ValueKind result = ValueKind::VOID;
+    std::vector<std::pair<std::string, ValueKind>> parameters;
+    IRNode *definition = nullptr;
+    StaticShape resultShape;
+};
+
+using Scope = std::map<std::string, ValueKind>;
+// Variables declared with static extents; the rest are absent
+using Shapes = std::map<std::string, StaticShape>;
+
+// Signatures of a program's functions and the types of their local variables.
+// MLang lets a variable be introduced by plain assignment, so a local's type is
+// that of its declaration if it has one and otherwise that of the first value
+// assigned to it.
+class ProgramTypes
+{
+public:
+    explicit ProgramTypes(IRNode *root);
+
+    // Returns nullptr for built-ins and undefined functions
+    const FunctionSignature *function(const std::string &name) const;
+    const std::vector<FunctionSignature> &functions() const { return signatures; }
+    // Parameters, declarations, loop variables and assigned variables of a function
+    Scope locals(IRNode *function) const;
+    // Static extents of the parameters and declared variables of a function
+    Shapes shapes(IRNode *function) const;
+    ValueKind infer(IRNode *expression, const Scope &scope) const;
+
+private:
+    std::vector<FunctionSignature> signatures;
+    std::map<std::string, size_t> byName;
+
+    void collectLocals(IRNode *node, Scope &scope) const;
+};
+
+#endif
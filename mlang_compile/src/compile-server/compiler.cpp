@@ -0,0 +1,290 @@
+#include "compiler.h"
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include "../ast/ast-generation/ast.h"
+#include "../code-generation/codegen.h"
+#include "../code-generation/cse.h"
+#include "../code-generation/deadcode.h"
+
+namespace
+{
+void shiftLines(IRNode *tree, int offset)
+{
+    visitTree(tree, [&](IRNode *node)
+              {
+                  if (node->line > 0)
+                      node->line += offset; });
+}
+
+// [begin, end) token ranges of the top-level functions; each starts at an "fn" outside braces
+std::vector<std::pair<size_t, size_t>> functionRanges(const std::vector<Token> &tokens)
+{
+    std::vector<std::pair<size_t, size_t>> ranges;
+    int depth = 0;
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        const Token &token = tokens[i];
+        if (token.type == TokenType::KEYWORD && token.value == "fn" && depth == 0)
+        {
+            if (!ranges.empty())
+                ranges.back().second = i;
+            ranges.push_back({i, tokens.size()});
+        }
+        else if (token.type == TokenType::DELIMITER && token.value == "{")
+            ++depth;
+        else if (token.type == TokenType::DELIMITER && token.value == "}" && depth > 0)
+            --depth;
+    }
+    return ranges;
+}
+
+std::string functionKey(const std::vector<Token> &tokens, size_t begin, size_t end, int lineOffset)
+{
+    std::string key;
+    for (size_t i = begin; i < end; ++i)
+    {
+        key += static_cast<char>(tokens[i].type);
+        key += tokens[i].value;
+        key += '\x1f';
+        key += std::to_string(tokens[i].line - lineOffset);
+        key += ':';
+        key += std::to_string(tokens[i].column);
+        key += '\x1e';
+    }
+    return key;
+}
+
+// Parses one function's tokens and converts it to the tree code generation works on, going
+// through the binary AST like the pipeline does
+std::unique_ptr<IRNode> parseFunction(const std::vector<Token> &tokens, size_t begin, size_t end)
+{
+    const Token endOfInput{TokenType::END_OF_FILE, "", 0, 0};
+    size_t position = begin;
+    TokenStream stream([&]()
+                       { return position < end ? tokens[position++] : endOfInput; });
+    std::unique_ptr<FunctionNode> function = parseNextFunction(stream);
+    if (!function)
+        return nullptr;
+
+    std::stringstream binary;
+    BinaryASTWriter writer(binary);
+    writer.add(*function);
+    writer.finish();
+    std::string data = binary.str();
+    std::unique_ptr<IRNode> root(parseBinaryAST(data.data(), data.size()));
+    if (root->children.empty())
+        return nullptr;
+    std::unique_ptr<IRNode> tree(root->children[0]);
+    root->children.clear();
+    return tree;
+}
+}
+
+uint64_t hashText(const std::string &text, uint64_t hash)
+{
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    // A separator, so "ab" + "c" and "a" + "bc" differ
+    hash ^= 0xff;
+    return hash * 1099511628211ull;
+}
+
+bool IncrementalCompiler::refresh(const std::string &path, bool force)
+{
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        forget(path);
+        return false;
+    }
+    int64_t modified = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+    auto existing = files.find(path);
+    if (!force && existing != files.end() && existing->second.modified == modified &&
+        existing->second.size == static_cast<int64_t>(status.st_size))
+        return true;
+
+    std::ifstream input(path, std::ios::binary);
+    if (!input)
+    {
+        forget(path);
+        return false;
+    }
+    std::ostringstream text;
+    text << input.rdbuf();
+
+    SourceFile &file = files[path];
+    file.modified = modified;
+    file.size = static_cast<int64_t>(status.st_size);
+    if (!file.functions.empty() && file.text == text.str() && !file.parseFailed)
+        return true;
+    file.text = text.str();
+    file.built = false;
+    parseFunctions(path, file);
+    collectGarbage();
+    return true;
+}
+
+void IncrementalCompiler::parseFunctions(const std::string &path, SourceFile &file)
+{
+    file.frontEnd = Diagnostics();
+    file.parseFailed = false;
+    file.parsed = 0;
+    file.reused = 0;
+
+    std::vector<Token> tokens = Lexer(file.text, path, file.frontEnd).tokenize();
+    std::vector<Token> code;
+    code.reserve(tokens.size());
+    for (auto &token : tokens)
+    {
+        if (token.type != TokenType::COMMENT && token.type != TokenType::END_OF_FILE)
+            code.push_back(std::move(token));
+    }
+
+    std::vector<FunctionSlot> slots;
+    for (auto range : functionRanges(code))
+    {
+        FunctionSlot slot;
+        slot.lineOffset = code[range.first].line - 1;
+        std::string key = functionKey(code, range.first, range.second, slot.lineOffset);
+        auto cached = functions.find(key);
+        if (cached != functions.end())
+        {
+            slot.function = cached->second;
+            ++file.reused;
+        }
+        else
+        {
+            try
+            {
+                std::unique_ptr<IRNode> tree = parseFunction(code, range.first, range.second);
+                if (!tree)
+                    continue;
+                shiftLines(tree.get(), -slot.lineOffset);
+                auto function = std::make_shared<CachedFunction>();
+                function->tree = std::move(tree);
+                slot.function = function;
+                functions[key] = function;
+                ++file.parsed;
+            }
+            catch (const ParseException &e)
+            {
+                file.frontEnd.error(file.frontEnd.addFile(path), DiagnosticCode::PARSE_ERROR,
+                                    {e.line, e.column, e.line, e.column + 1}, e.message);
+                file.parseFailed = true;
+                break;
+            }
+        }
+        slots.push_back(slot);
+    }
+    file.functions = std::move(slots);
+}
+
+void IncrementalCompiler::forget(const std::string &path)
+{
+    if (files.erase(path) > 0)
+        collectGarbage();
+}
+
+void IncrementalCompiler::collectGarbage()
+{
+    for (auto it = functions.begin(); it != functions.end();)
+    {
+        if (it->second.use_count() == 1)
+            it = functions.erase(it);
+        else
+            ++it;
+    }
+}
+
+BuildResult IncrementalCompiler::build(const std::string &path)
+{
+    BuildResult result;
+    if (!refresh(path))
+    {
+        Diagnostics diagnostics;
+        diagnostics.error(diagnostics.addFile(path), DiagnosticCode::IO_ERROR, {0, 0, 0, 0}, "Error opening file");
+        result.diagnostics = diagnostics.render(options.format);
+        return result;
+    }
+    SourceFile &file = files[path];
+    if (file.built)
+    {
+        result = file.last;
+        result.parsed = 0;
+        result.reused = file.functions.size();
+        return result;
+    }
+    result.parsed = file.parsed;
+    result.reused = file.reused;
+
+    Diagnostics diagnostics;
+    diagnostics.merge(file.frontEnd);
+    if (!file.parseFailed)
+    {
+        std::unique_ptr<IRNode> root(new IRNode("ROOT"));
+        for (const auto &slot : file.functions)
+        {
+            IRNode *function = cloneTree(slot.function->tree.get());
+            shiftLines(function, slot.lineOffset);
+            root->children.push_back(function);
+        }
+        removeUnreachableFunctions(root.get(), options.deadCode);
+        inlineFunctions(root.get(), options.inlining);
+        if (options.cse)
+            eliminateCommonSubexpressions(root.get());
+        eliminateDeadCode(root.get(), options.deadCode);
+
+        uint32_t sourceId = diagnostics.addFile(path);
+        if (options.backend == "cpp")
+        {
+            ASTCppGenerator generator;
+            generator.setDiagnostics(&diagnostics, sourceId);
+            generator.setSourceName(path);
+            generator.setLineComments(options.lineComments);
+            generator.setParallelOptions(options.parallel);
+            generator.setPrecision(options.precision);
+            result.code = generator.generateProgram(root.get());
+        }
+        else
+        {
+            ASTPythonGenerator generator;
+            generator.setDiagnostics(&diagnostics, sourceId);
+            generator.setSourceName(path);
+            generator.setLineComments(options.lineComments);
+            generator.setParallelOptions(options.parallel);
+            result.code = generator.generateProgram(root.get());
+        }
+    }
+    result.ok = !diagnostics.hasErrors();
+    if (!result.ok)
+        result.code.clear();
+    result.diagnostics = diagnostics.render(options.format);
+    file.last = result;
+    file.built = true;
+    return result;
+}
+
+uint64_t IncrementalCompiler::programHash(const std::string &path)
+{
+    if (!refresh(path))
+        return 0;
+    const SourceFile &file = files[path];
+    if (file.parseFailed)
+        return 0;
+    uint64_t hash = hashText(std::to_string(file.functions.size()));
+    for (const auto &slot : file.functions)
+    {
+        visitTree(slot.function->tree.get(), [&](IRNode *node)
+                  {
+            hash = hashText(node->type, hash);
+            hash = hashText(node->value, hash);
+            hash = hashText(std::to_string(node->children.size()), hash);
+            if (options.lineComments)
+                hash = hashText(std::to_string(node->line + slot.lineOffset) + ":" + std::to_string(node->column), hash); });
+    }
+    return hash;
+}
@@ -0,0 +1,106 @@
+#ifndef COMPILE_SERVER_COMPILER_H
+#define COMPILE_SERVER_COMPILER_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../code-generation/analysis.h"
+#include "../code-generation/cppgen.h"
+#include "../code-generation/deadcode.h"
+#include "../code-generation/inliner.h"
+#include "../code-generation/ir.h"
+#include "../lexical-analysis/errors/diagnostics.h"
+
+// Code generation settings of mlangc; the same options as codegen_program
+struct CompileOptions
+{
+    std::string backend = "python";
+    ParallelOptions parallel;
+    PrecisionOptions precision;
+    InlineOptions inlining;
+    bool cse = true;
+    DeadCodeOptions deadCode;
+    bool lineComments = false;
+    DiagnosticFormat format = DiagnosticFormat::TEXT;
+};
+
+struct BuildResult
+{
+    bool ok = false;
+    std::string code;
+    // Rendered in CompileOptions::format
+    std::string diagnostics;
+    // Functions parsed for this build, and functions taken from the cache
+    size_t parsed = 0;
+    size_t reused = 0;
+};
+
+// FNV-1a over text, continuing from hash
+uint64_t hashText(const std::string &text, uint64_t hash = 14695981039346656037ull);
+
+// Lexer, parser and code generation in one process, keeping each source file's functions
+// between builds. A function is keyed by its tokens, with lines counted from the function's
+// first line, so editing one function re-parses only that function, even when the edit
+// moves the functions below it. Comments are not part of the key. The program-wide passes
+// (inlining, CSE, dead code elimination) and code generation run on every build, over the
+// cached trees.
+class IncrementalCompiler
+{
+public:
+    explicit IncrementalCompiler(const CompileOptions &options) : options(options) {}
+
+    // Lexes and parses the file again if it changed since it was read; force skips the
+    // modification time check. False if the file cannot be read, which also forgets it.
+    bool refresh(const std::string &path, bool force = false);
+    void forget(const std::string &path);
+    // Refreshes the file and generates its program. A file unchanged since its last build
+    // returns that build.
+    BuildResult build(const std::string &path);
+    // Hash of the file's parsed functions, which with the options decides the program generated.
+    // Lines count only with line comments. 0 if the file cannot be read or does not parse.
+    uint64_t programHash(const std::string &path);
+    const CompileOptions &compileOptions() const { return options; }
+
+    size_t fileCount() const { return files.size(); }
+    size_t functionCount() const { return functions.size(); }
+
+private:
+    // A parsed function with its lines counted from 1 at its first line
+    struct CachedFunction
+    {
+        std::unique_ptr<IRNode> tree;
+    };
+    struct FunctionSlot
+    {
+        std::shared_ptr<const CachedFunction> function;
+        // Added to the cached lines to get lines in the file
+        int lineOffset = 0;
+    };
+    struct SourceFile
+    {
+        int64_t modified = -1;
+        int64_t size = -1;
+        std::string text;
+        std::vector<FunctionSlot> functions;
+        // Lexer diagnostics and the parse error, if any
+        Diagnostics frontEnd;
+        bool parseFailed = false;
+        size_t parsed = 0;
+        size_t reused = 0;
+        bool built = false;
+        BuildResult last;
+    };
+
+    CompileOptions options;
+    std::map<std::string, SourceFile> files;
+    std::unordered_map<std::string, std::shared_ptr<const CachedFunction>> functions;
+
+    void parseFunctions(const std::string &path, SourceFile &file);
+    // Drops cached functions no file uses any more
+    void collectGarbage();
+};
+
+#endif
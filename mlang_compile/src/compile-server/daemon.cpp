@@ -0,0 +1,298 @@
+#include "daemon.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+// Writes all of text, retrying short writes; a client that went away just loses its answer
+void writeAll(int fd, const std::string &text)
+{
+    size_t written = 0;
+    while (written < text.size())
+    {
+        ssize_t n = send(fd, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        written += static_cast<size_t>(n);
+    }
+}
+
+bool isSource(const std::string &name)
+{
+    return name.size() > 6 && name.compare(name.size() - 6, 6, ".mlang") == 0;
+}
+
+std::string withDiagnostics(const std::string &status, const std::string &diagnostics)
+{
+    return status + " diagnostics=" + std::to_string(diagnostics.size()) + "\n" + diagnostics;
+}
+
+// Writes next to the output and renames, so readers never see a half-written program
+bool writeOutput(const std::string &path, const std::string &code)
+{
+    std::string partial = path + ".partial";
+    {
+        std::ofstream output(partial, std::ios::binary);
+        if (!output || !(output << code) || !output.flush())
+        {
+            std::remove(partial.c_str());
+            return false;
+        }
+    }
+    if (std::rename(partial.c_str(), path.c_str()) != 0)
+    {
+        std::remove(partial.c_str());
+        return false;
+    }
+    return true;
+}
+}
+
+CompileDaemon::CompileDaemon(IncrementalCompiler &compiler, const std::string &socketPath)
+    : compiler(compiler), socketPath(socketPath)
+{
+    int wake[2];
+    if (pipe(wake) != 0)
+        throw std::runtime_error("Cannot create the server's wake-up pipe");
+    wakeRead = wake[0];
+    wakeWrite = wake[1];
+}
+
+CompileDaemon::~CompileDaemon()
+{
+    for (auto &entry : connections)
+    {
+        ::close(entry.first);
+    }
+    if (listener >= 0)
+    {
+        ::close(listener);
+        unlink(socketPath.c_str());
+    }
+    if (notify >= 0)
+        ::close(notify);
+    ::close(wakeRead);
+    ::close(wakeWrite);
+}
+
+void CompileDaemon::stop()
+{
+    char byte = 0;
+    ssize_t ignored = write(wakeWrite, &byte, 1);
+    (void)ignored;
+}
+
+void CompileDaemon::watch(const std::string &directory)
+{
+    if (notify < 0)
+    {
+        notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notify < 0)
+            throw std::runtime_error("Cannot start inotify: " + std::string(std::strerror(errno)));
+    }
+    addWatch(directory);
+}
+
+void CompileDaemon::addWatch(const std::string &directory)
+{
+    int descriptor = inotify_add_watch(notify, directory.c_str(),
+                                       IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR);
+    if (descriptor < 0)
+        throw std::runtime_error("Cannot watch " + directory + ": " + std::strerror(errno));
+    watched[descriptor] = directory;
+
+    DIR *listing = opendir(directory.c_str());
+    if (!listing)
+        return;
+    std::vector<std::string> subdirectories;
+    while (dirent *entry = readdir(listing))
+    {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = directory + "/" + name;
+        if (entry->d_type == DT_DIR)
+            subdirectories.push_back(path);
+        else if (isSource(name))
+            compiler.refresh(path);
+    }
+    closedir(listing);
+    for (const auto &path : subdirectories)
+    {
+        addWatch(path);
+    }
+}
+
+void CompileDaemon::readEvents()
+{
+    alignas(inotify_event) char buffer[1 << 16];
+    for (;;)
+    {
+        ssize_t n = read(notify, buffer, sizeof(buffer));
+        if (n <= 0)
+            return;
+        for (char *next = buffer; next < buffer + n;)
+        {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(next);
+            next += sizeof(inotify_event) + event->len;
+            auto directory = watched.find(event->wd);
+            if (directory == watched.end())
+                continue;
+            if (event->mask & IN_IGNORED)
+            {
+                watched.erase(directory);
+                continue;
+            }
+            std::string name = event->len > 0 ? event->name : "";
+            std::string path = directory->second + "/" + name;
+            if (event->mask & IN_ISDIR)
+            {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    addWatch(path);
+            }
+            else if (isSource(name))
+            {
+                // Parse now, so the build the editor asks for next finds the functions ready
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                    compiler.forget(path);
+                else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                    compiler.refresh(path, true);
+            }
+        }
+    }
+}
+
+void CompileDaemon::listen()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Socket path too long: " + socketPath);
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+        throw std::runtime_error("Cannot create socket: " + std::string(std::strerror(errno)));
+    // A socket file left by an earlier server would make bind fail
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, 16) != 0)
+        throw std::runtime_error("Cannot listen on " + socketPath + ": " + std::strerror(errno));
+}
+
+bool CompileDaemon::receive(int client)
+{
+    Connection &connection = connections[client];
+    char buffer[4096];
+    ssize_t n = read(client, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+        return true;
+    if (n <= 0)
+        return false;
+    connection.input.append(buffer, static_cast<size_t>(n));
+    size_t newline;
+    while (!stopping && (newline = connection.input.find('\n')) != std::string::npos)
+    {
+        std::string request = connection.input.substr(0, newline);
+        connection.input.erase(0, newline + 1);
+        if (!request.empty() && request.back() == '\r')
+            request.pop_back();
+        if (!request.empty())
+            writeAll(client, answer(request));
+    }
+    return true;
+}
+
+std::string CompileDaemon::answer(const std::string &request)
+{
+    std::istringstream words(request);
+    std::vector<std::string> arguments;
+    for (std::string word; words >> word;)
+    {
+        arguments.push_back(word);
+    }
+
+    if (arguments.empty())
+        return withDiagnostics("error", "Empty request\n");
+    if (arguments[0] == "build" && arguments.size() == 3)
+    {
+        auto start = std::chrono::steady_clock::now();
+        BuildResult result = compiler.build(arguments[1]);
+        ++builds;
+        bool written = result.ok && writeOutput(arguments[2], result.code);
+        auto took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        std::string counts = " parsed=" + std::to_string(result.parsed) + " reused=" + std::to_string(result.reused) +
+                             " us=" + std::to_string(took.count());
+        if (result.ok && !written)
+            return withDiagnostics("error" + counts, "Could not write " + arguments[2] + "\n" + result.diagnostics);
+        return withDiagnostics((written ? "ok" : "error") + counts, result.diagnostics);
+    }
+    if (arguments[0] == "stats" && arguments.size() == 1)
+    {
+        return withDiagnostics("ok files=" + std::to_string(compiler.fileCount()) + " functions=" +
+                                   std::to_string(compiler.functionCount()) + " builds=" + std::to_string(builds),
+                               "");
+    }
+    if (arguments[0] == "shutdown" && arguments.size() == 1)
+    {
+        stopping = true;
+        return withDiagnostics("ok", "");
+    }
+    return withDiagnostics("error", "Unknown request: " + request + "\n");
+}
+
+void CompileDaemon::run()
+{
+    listen();
+    std::vector<pollfd> polled;
+    while (!stopping)
+    {
+        polled.assign({{wakeRead, POLLIN, 0}, {listener, POLLIN, 0}});
+        if (notify >= 0)
+            polled.push_back({notify, POLLIN, 0});
+        for (auto &entry : connections)
+        {
+            polled.push_back({entry.first, POLLIN, 0});
+        }
+
+        int ready = poll(polled.data(), polled.size(), -1);
+        if (ready < 0 && errno != EINTR)
+            throw std::runtime_error("poll failed: " + std::string(std::strerror(errno)));
+        if (ready <= 0)
+            continue;
+        if (polled[0].revents & POLLIN)
+            return;
+        for (size_t i = 1; i < polled.size() && !stopping; ++i)
+        {
+            if (!(polled[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            int fd = polled[i].fd;
+            if (fd == listener)
+            {
+                int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client >= 0)
+                    connections[client];
+            }
+            else if (fd == notify)
+                readEvents();
+            else if (!receive(fd))
+            {
+                ::close(fd);
+                connections.erase(fd);
+            }
+        }
+    }
+}
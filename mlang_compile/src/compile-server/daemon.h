@@ -0,0 +1,63 @@
+#ifndef COMPILE_SERVER_DAEMON_H
+#define COMPILE_SERVER_DAEMON_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include "compiler.h"
+
+// mlangc --server: answers build requests on a Unix socket from one warm IncrementalCompiler,
+// and re-parses watched .mlang files as soon as inotify reports them changed, so a build
+// after an edit only generates code.
+//
+// Requests are lines of space-separated words; paths are resolved against the server's
+// working directory, so clients send absolute ones:
+//   build SOURCE OUTPUT   compile SOURCE and write the program to OUTPUT
+//   stats                 files and functions held
+//   shutdown              stop the server
+// Every answer is one line, "ok ..." or "error ...", ending in "diagnostics=N", followed by
+// N bytes of rendered diagnostics. A build answer also carries "parsed=", "reused=" (functions)
+// and "us=" (microseconds the build took).
+class CompileDaemon
+{
+public:
+    CompileDaemon(IncrementalCompiler &compiler, const std::string &socketPath);
+    ~CompileDaemon();
+    CompileDaemon(const CompileDaemon &) = delete;
+    CompileDaemon &operator=(const CompileDaemon &) = delete;
+
+    // Watches a directory and its subdirectories, parsing the .mlang files in it now.
+    // Throws std::runtime_error if inotify cannot watch it.
+    void watch(const std::string &directory);
+    // Serves until a shutdown request or stop(). Throws std::runtime_error if the socket cannot be opened.
+    void run();
+    // Async-signal-safe, so a SIGINT handler can call it
+    void stop();
+
+private:
+    struct Connection
+    {
+        std::string input;
+    };
+
+    IncrementalCompiler &compiler;
+    std::string socketPath;
+    int listener = -1;
+    int notify = -1;
+    int wakeRead = -1;
+    int wakeWrite = -1;
+    bool stopping = false;
+    uint64_t builds = 0;
+    // inotify watch descriptor -> directory
+    std::map<int, std::string> watched;
+    std::map<int, Connection> connections;
+
+    void listen();
+    void addWatch(const std::string &directory);
+    void readEvents();
+    // False once the client has gone
+    bool receive(int client);
+    std::string answer(const std::string &request);
+};
+
+#endif
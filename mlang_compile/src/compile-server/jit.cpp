@@ -0,0 +1,340 @@
+#include "jit.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+std::string environment(const char *name)
+{
+    const char *value = std::getenv(name);
+    return value ? value : "";
+}
+
+std::string quote(const std::string &text)
+{
+    std::string quoted = "'";
+    for (char c : text)
+    {
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    }
+    return quoted + "'";
+}
+
+// Missing directories are created private to the user, as the cache holds code that gets loaded
+void makeDirectories(const std::string &path)
+{
+    for (size_t slash = path.find('/', 1);; slash = path.find('/', slash + 1))
+    {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0700) != 0 && errno != EEXIST)
+            throw std::runtime_error("Cannot create " + prefix + ": " + std::strerror(errno));
+        if (slash == std::string::npos)
+            return;
+    }
+}
+
+// Refuses a cache directory or object that another user could have written: loading it would
+// run their code
+void checkPrivate(const std::string &path)
+{
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        throw std::runtime_error("Cannot use " + path + ": " + std::strerror(errno));
+    if (status.st_uid != geteuid() || (status.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+        throw std::runtime_error("Refusing to use " + path + ": it is not owned by the current user or is writable by others");
+}
+
+std::vector<std::string> splitWords(const std::string &text)
+{
+    std::vector<std::string> words;
+    std::istringstream input(text);
+    for (std::string word; input >> word;)
+    {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// The file the shell runs for a program name: the name itself if it has a slash, else the
+// first executable of that name on $PATH; empty if there is none
+std::string findProgram(const std::string &name)
+{
+    if (name.find('/') != std::string::npos)
+        return name;
+    std::string path = environment("PATH");
+    for (size_t begin = 0; begin <= path.size();)
+    {
+        size_t end = std::min(path.find(':', begin), path.size());
+        std::string directory = end > begin ? path.substr(begin, end - begin) : ".";
+        std::string candidate = directory + "/" + name;
+        if (access(candidate.c_str(), X_OK) == 0)
+            return candidate;
+        begin = end + 1;
+    }
+    return "";
+}
+
+std::string fileStamp(const std::string &path)
+{
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        return path + " missing";
+    return path + " " + std::to_string(status.st_size) + " " + std::to_string(status.st_mtim.tv_sec) + "." +
+           std::to_string(status.st_mtim.tv_nsec);
+}
+
+// The CPU flags the kernels are compiled for with -march=native
+std::string cpuFeatures()
+{
+    utsname machine;
+    std::string features = uname(&machine) == 0 ? machine.machine : "";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    for (std::string line; std::getline(cpuinfo, line);)
+    {
+        if (line.compare(0, 5, "flags") == 0 || line.compare(0, 8, "Features") == 0)
+            return features + line.substr(line.find(':') + 1);
+    }
+    return features;
+}
+
+// Every setting that changes the generated C++
+std::string optionsKey(const CompileOptions &options)
+{
+    std::ostringstream key;
+    key << options.parallel.enabled << options.parallel.vectorize << static_cast<int>(options.parallel.schedule) << ' '
+        << options.parallel.minTripCount << ' ' << options.parallel.minVectorTrip << ' ' << options.precision.float32
+        << options.precision.accumulateFloat32 << options.inlining.enabled << ' ' << options.inlining.maxGrowth << ' '
+        << options.cse << options.lineComments << options.deadCode.enabled;
+    for (const auto &entry : options.deadCode.entries)
+    {
+        key << ' ' << entry;
+    }
+    return key.str();
+}
+
+// Runs a shell command and returns its exit status, with stdout and stderr in output
+int runCommand(const std::string &command, std::string &output)
+{
+    FILE *pipe = popen((command + " 2>&1").c_str(), "r");
+    if (!pipe)
+        throw std::runtime_error("Cannot run " + command);
+    char buffer[4096];
+    for (size_t n; (n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0;)
+    {
+        output.append(buffer, n);
+    }
+    int status = pclose(pipe);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+}
+
+NativeRunner::NativeRunner(IncrementalCompiler &compiler, JitOptions options)
+    : compiler(compiler), options(std::move(options))
+{
+    if (this->options.cacheDirectory.empty())
+    {
+        this->options.cacheDirectory = environment("MLANG_JIT_CACHE");
+        if (this->options.cacheDirectory.empty() && !environment("XDG_CACHE_HOME").empty())
+            this->options.cacheDirectory = environment("XDG_CACHE_HOME") + "/mlang";
+        // Without a home directory, a per-user directory; checkPrivate rejects one another user made first
+        if (this->options.cacheDirectory.empty())
+            this->options.cacheDirectory = environment("HOME").empty() ? "/tmp/mlang-" + std::to_string(geteuid())
+                                                                       : environment("HOME") + "/.cache/mlang";
+    }
+    if (this->options.runtimeDirectory.empty())
+        this->options.runtimeDirectory = environment("MLANG_RUNTIME");
+    if (this->options.runtimeDirectory.empty())
+        this->options.runtimeDirectory = "mlang_compile/src/runtime";
+    if (this->options.compiler.empty())
+        this->options.compiler = environment("CXX");
+    if (this->options.compiler.empty())
+        this->options.compiler = "g++";
+
+    // $CXX may be a command such as "ccache g++"; each word is one argument, and the files the
+    // words run are part of the cache key, so a compiler upgrade rebuilds
+    for (const auto &word : splitWords(this->options.compiler))
+    {
+        command += (command.empty() ? "" : " ") + quote(word);
+        std::string program = word[0] == '-' ? "" : findProgram(word);
+        compilerStamp += (program.empty() ? word : fileStamp(program)) + "\n";
+    }
+    if (command.empty())
+        throw std::runtime_error("No compiler to run: $CXX is blank");
+
+    const PrecisionOptions &precision = compiler.compileOptions().precision;
+    flags = "-std=c++17 -O3 -march=native -fPIC -pthread";
+    if (precision.float32)
+        flags += " -DMLANG_FLOAT32";
+    if (precision.accumulateFloat32)
+        flags += " -DMLANG_ACCUMULATE_FLOAT32";
+}
+
+std::string NativeRunner::cachePath(uint64_t key, const std::string &suffix) const
+{
+    std::ostringstream path;
+    path << options.cacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << suffix;
+    return path.str();
+}
+
+std::vector<std::string> NativeRunner::runtimeObjects(uint64_t key, const std::vector<std::string> &sources)
+{
+    std::string directory = cachePath(key, ".runtime");
+    std::vector<std::string> objects;
+    for (const auto &source : sources)
+    {
+        std::string name = source.substr(source.rfind('/') + 1);
+        objects.push_back(directory + "/" + name.substr(0, name.size() - 4) + ".o");
+    }
+    struct stat status;
+    if (stat(directory.c_str(), &status) == 0)
+        return objects;
+
+    // Build next to the cache entry and rename, so a concurrent run never links half the runtime
+    std::string building = directory + "." + std::to_string(getpid());
+    makeDirectories(building);
+    std::vector<std::string> outputs(sources.size());
+    std::vector<int> statuses(sources.size());
+    std::vector<std::thread> compiles;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        compiles.emplace_back([&, i]()
+                              {
+            std::string object = building + objects[i].substr(directory.size());
+            statuses[i] = runCommand(command + " " + flags + " -c " + quote(sources[i]) + " -o " + quote(object),
+                                     outputs[i]); });
+    }
+    for (auto &compile : compiles)
+    {
+        compile.join();
+    }
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        if (statuses[i] != 0)
+        {
+            std::string ignored;
+            runCommand("rm -rf " + quote(building), ignored);
+            throw std::runtime_error("Compiling the runtime failed: " + sources[i] + "\n" + outputs[i]);
+        }
+    }
+    if (rename(building.c_str(), directory.c_str()) != 0)
+    {
+        // Another run built it first
+        std::string ignored;
+        runCommand("rm -rf " + quote(building), ignored);
+    }
+    return objects;
+}
+
+NativeProgram NativeRunner::build(const std::string &source)
+{
+    uint64_t program = compiler.programHash(source);
+    if (program == 0)
+    {
+        BuildResult result = compiler.build(source);
+        throw std::runtime_error(result.diagnostics);
+    }
+
+    std::vector<std::string> sources;
+    std::vector<std::string> stamps;
+    if (DIR *listing = opendir(options.runtimeDirectory.c_str()))
+    {
+        while (dirent *entry = readdir(listing))
+        {
+            std::string name = entry->d_name;
+            bool isSource = name.size() > 4 && name.compare(name.size() - 4, 4, ".cpp") == 0;
+            if (isSource)
+                sources.push_back(options.runtimeDirectory + "/" + name);
+            if (isSource || (name.size() > 2 && name.compare(name.size() - 2, 2, ".h") == 0))
+                stamps.push_back(fileStamp(options.runtimeDirectory + "/" + name));
+        }
+        closedir(listing);
+    }
+    if (sources.empty() || access((options.runtimeDirectory + "/runtime.h").c_str(), R_OK) != 0)
+        throw std::runtime_error("Runtime sources not found in " + options.runtimeDirectory +
+                                 "; pass --runtime DIR or set MLANG_RUNTIME");
+    // readdir order is arbitrary, and the key must not depend on it
+    std::sort(sources.begin(), sources.end());
+    std::sort(stamps.begin(), stamps.end());
+
+    uint64_t runtimeKey = hashText(cpuFeatures());
+    runtimeKey = hashText(compilerStamp + flags, runtimeKey);
+    for (const auto &stamp : stamps)
+    {
+        runtimeKey = hashText(stamp, runtimeKey);
+    }
+    uint64_t key = hashText(optionsKey(compiler.compileOptions()), runtimeKey);
+    key = hashText(fileStamp("/proc/self/exe"), key);
+    key = hashText(std::to_string(program), key);
+
+    makeDirectories(options.cacheDirectory);
+    checkPrivate(options.cacheDirectory);
+    NativeProgram result;
+    result.library = cachePath(key, ".so");
+    if (access(result.library.c_str(), R_OK) == 0)
+    {
+        result.cached = true;
+        return result;
+    }
+
+    BuildResult generated = compiler.build(source);
+    if (!generated.ok)
+        throw std::runtime_error(generated.diagnostics);
+    result.diagnostics = generated.diagnostics;
+    // The C++ backend only writes a main for a program with fn main()
+    if (generated.code.find("\nint main()\n") == std::string::npos)
+        throw std::runtime_error(generated.diagnostics + "The program has no fn main() to run");
+
+    std::vector<std::string> objects = runtimeObjects(runtimeKey, sources);
+    std::string partial = result.library + "." + std::to_string(getpid());
+    std::string code = partial + ".cpp";
+    {
+        std::ofstream output(code);
+        if (!output || !(output << generated.code) || !output.flush())
+            throw std::runtime_error("Cannot write " + code);
+    }
+    std::string link = command + " " + flags + " -shared -Wl,-Bsymbolic -I " + quote(options.runtimeDirectory) + " " + quote(code);
+    for (const auto &object : objects)
+    {
+        link += " " + quote(object);
+    }
+    link += " -o " + quote(partial);
+    std::string output;
+    int status = runCommand(link, output);
+    std::remove(code.c_str());
+    if (status != 0 || rename(partial.c_str(), result.library.c_str()) != 0)
+    {
+        std::remove(partial.c_str());
+        throw std::runtime_error("Native build of " + source + " failed:\n" + output);
+    }
+    return result;
+}
+
+int NativeRunner::run(const std::string &library)
+{
+    size_t slash = library.rfind('/');
+    checkPrivate(slash == std::string::npos ? "." : library.substr(0, slash + 1));
+    checkPrivate(library);
+    // RTLD_LOCAL and -Bsymbolic keep the program's runtime apart from mlangc's own symbols
+    void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+        throw std::runtime_error(std::string("Cannot load ") + dlerror());
+    using Entry = int (*)();
+    Entry entry = reinterpret_cast<Entry>(dlsym(handle, "main"));
+    if (!entry)
+        throw std::runtime_error("The program has no fn main() to run");
+    return entry();
+}
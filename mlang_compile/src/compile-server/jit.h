@@ -0,0 +1,61 @@
+#ifndef COMPILE_SERVER_JIT_H
+#define COMPILE_SERVER_JIT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "compiler.h"
+
+struct JitOptions
+{
+    // Built programs and runtime objects; empty means $MLANG_JIT_CACHE, else
+    // $XDG_CACHE_HOME/mlang, else ~/.cache/mlang, else /tmp/mlang-UID. It must belong to the
+    // user and not be writable by others.
+    std::string cacheDirectory;
+    // runtime.h and the runtime sources; empty means $MLANG_RUNTIME, else mlang_compile/src/runtime
+    std::string runtimeDirectory;
+    // Command that compiles, e.g. "ccache g++"; empty means $CXX, else g++
+    std::string compiler;
+};
+
+struct NativeProgram
+{
+    // Shared object holding the program, its main and the runtime
+    std::string library;
+    // True if the object was already in the cache, so neither code generation nor the compiler ran
+    bool cached = false;
+    // Warnings of a program that was generated now
+    std::string diagnostics;
+};
+
+// mlangc --run: generates C++ for a program, compiles it into a shared object and calls its main
+// in this process. The object is cached under a hash of the program's functions, the code
+// generation options, the CPU's features, the compiler, the runtime sources and mlangc itself,
+// so running the same program again starts at once. The runtime is compiled once for each CPU,
+// compiler and precision, and linked into every program.
+class NativeRunner
+{
+public:
+    NativeRunner(IncrementalCompiler &compiler, JitOptions options);
+
+    // Finds the program's shared object in the cache or builds it. Throws std::runtime_error
+    // with the diagnostics or the compiler's output if the program cannot be built.
+    NativeProgram build(const std::string &source);
+    // Loads a shared object from build() and calls its main. Throws std::runtime_error if it
+    // cannot be loaded, has no main, or it or its directory is not private to the user.
+    static int run(const std::string &library);
+
+private:
+    IncrementalCompiler &compiler;
+    JitOptions options;
+    std::string flags;
+    // The compiler's words quoted for the shell, and the size and time of the files they run
+    std::string command;
+    std::string compilerStamp;
+
+    std::string cachePath(uint64_t key, const std::string &suffix) const;
+    // Runtime object files for the current flags, compiling them if needed
+    std::vector<std::string> runtimeObjects(uint64_t key, const std::vector<std::string> &sources);
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+#include "compiler.h"
+#include "daemon.h"
+#include "jit.h"
+
+namespace
+{
+CompileDaemon *running = nullptr;
+
+void stopDaemon(int)
+{
+    if (running)
+        running->stop();
+}
+
+void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <source_file> <output_file> [options]\n"
+              << "       " << program << " --server --socket PATH [--watch DIR]... [options]\n"
+              << "       " << program << " --client --socket PATH build <source_file> <output_file> | stats | shutdown\n"
+              << "       " << program << " --run <source_file> [--cache DIR] [--runtime DIR] [options]\n"
+              << "Options: [--backend python|cpp] [--diagnostics-format text|json|sarif] [--line-comments]"
+              << " [--parallel on|off] [--vectorize on|off] [--schedule auto|static|dynamic] [--min-parallel-trip N]"
+              << " [--float32] [--accumulate float32|float64] [--inline on|off] [--inline-limit N] [--cse on|off]"
+              << " [--dce on|off] [--entry NAME]..."
+              << std::endl;
+}
+
+std::string absolutePath(const std::string &path)
+{
+    if (!path.empty() && path[0] == '/')
+        return path;
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved))
+        return resolved;
+    char directory[PATH_MAX];
+    return getcwd(directory, sizeof(directory)) ? std::string(directory) + "/" + path : path;
+}
+
+// Sends one request and prints the answer: the status line on stdout, diagnostics on stderr
+int runClient(const std::string &socketPath, std::vector<std::string> request)
+{
+    if (!request.empty() && request[0] == "build")
+    {
+        for (size_t i = 1; i < request.size(); ++i)
+        {
+            request[i] = absolutePath(request[i]);
+        }
+    }
+    std::string line;
+    for (const auto &word : request)
+    {
+        line += (line.empty() ? "" : " ") + word;
+    }
+    line += "\n";
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socketPath.size() >= sizeof(address.sun_path) || fd < 0)
+    {
+        std::cerr << "Cannot connect to " << socketPath << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        send(fd, line.data(), line.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(line.size()))
+    {
+        std::cerr << "Cannot connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    std::string answer;
+    size_t expected = std::string::npos;
+    char buffer[4096];
+    while (expected == std::string::npos || answer.size() < expected)
+    {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0)
+            break;
+        answer.append(buffer, static_cast<size_t>(n));
+        size_t newline = answer.find('\n');
+        size_t count = answer.rfind(" diagnostics=", newline);
+        if (expected == std::string::npos && newline != std::string::npos && count != std::string::npos)
+            expected = newline + 1 + std::stoul(answer.substr(count + 13, newline - count - 13));
+    }
+    close(fd);
+    if (expected == std::string::npos || answer.size() < expected)
+    {
+        std::cerr << "Incomplete answer from " << socketPath << std::endl;
+        return 1;
+    }
+    size_t newline = answer.find('\n');
+    std::cout << answer.substr(0, newline) << std::endl;
+    std::cerr << answer.substr(newline + 1);
+    return answer.compare(0, 2, "ok") == 0 ? 0 : 1;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    bool server = false;
+    bool client = false;
+    bool run = false;
+    JitOptions jit;
+    std::string socketPath;
+    std::vector<std::string> watchDirectories;
+    std::vector<std::string> positional;
+    CompileOptions options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (client && !socketPath.empty())
+        {
+            positional.push_back(option);
+            continue;
+        }
+        if (option.compare(0, 2, "--") != 0)
+        {
+            positional.push_back(option);
+            continue;
+        }
+        if (option == "--server" || option == "--client" || option == "--run")
+        {
+            (option == "--server" ? server : option == "--client" ? client : run) = true;
+            continue;
+        }
+        if (option == "--line-comments")
+        {
+            options.lineComments = true;
+            continue;
+        }
+        if (option == "--float32")
+        {
+            options.precision.float32 = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--socket")
+            socketPath = value;
+        else if (option == "--watch")
+            watchDirectories.push_back(absolutePath(value));
+        else if (option == "--cache")
+            jit.cacheDirectory = absolutePath(value);
+        else if (option == "--runtime")
+            jit.runtimeDirectory = value;
+        else if (option == "--backend" && (value == "python" || value == "cpp"))
+            options.backend = value;
+        else if (option == "--parallel" && (value == "on" || value == "off"))
+            options.parallel.enabled = value == "on";
+        else if (option == "--vectorize" && (value == "on" || value == "off"))
+            options.parallel.vectorize = value == "on";
+        else if (option == "--schedule" && (value == "auto" || value == "static" || value == "dynamic"))
+            options.parallel.schedule = value == "auto" ? ScheduleChoice::AUTO : value == "static" ? ScheduleChoice::STATIC : ScheduleChoice::DYNAMIC;
+        else if (option == "--min-parallel-trip")
+            options.parallel.minTripCount = std::max(1LL, std::stoll(value));
+        else if (option == "--accumulate" && (value == "float32" || value == "float64"))
+            options.precision.accumulateFloat32 = value == "float32";
+        else if (option == "--inline" && (value == "on" || value == "off"))
+            options.inlining.enabled = value == "on";
+        else if (option == "--inline-limit")
+            options.inlining.maxGrowth = std::stoi(value);
+        else if (option == "--cse" && (value == "on" || value == "off"))
+            options.cse = value == "on";
+        else if (option == "--dce" && (value == "on" || value == "off"))
+            options.deadCode.enabled = value == "on";
+        else if (option == "--entry")
+            options.deadCode.entries.push_back(value);
+        else if (option != "--diagnostics-format" || !Diagnostics::parseFormat(value, options.format))
+        {
+            std::cerr << "Unknown option: " << option << " " << value << std::endl;
+            return 1;
+        }
+    }
+
+    if (run)
+        options.backend = "cpp";
+    if (options.backend != "cpp" && options.precision.float32)
+    {
+        std::cerr << "--float32 sets the native runtime's storage and requires --backend cpp" << std::endl;
+        return 1;
+    }
+    if (options.precision.accumulateFloat32 && !options.precision.float32)
+    {
+        std::cerr << "--accumulate float32 requires --float32" << std::endl;
+        return 1;
+    }
+
+    if (client)
+    {
+        if (socketPath.empty() || positional.empty())
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runClient(socketPath, positional);
+    }
+
+    IncrementalCompiler compiler(options);
+    if (run)
+    {
+        if (positional.size() != 1)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        try
+        {
+            NativeRunner runner(compiler, jit);
+            NativeProgram program = runner.build(positional[0]);
+            std::cerr << program.diagnostics;
+            if (!program.cached)
+                std::cerr << "Compiled " << positional[0] << " to " << program.library << std::endl;
+            return NativeRunner::run(program.library);
+        }
+        catch (const std::runtime_error &e)
+        {
+            // Diagnostics end in a newline, other errors do not
+            std::string message = e.what();
+            std::cerr << message << (message.empty() || message.back() != '\n' ? "\n" : "");
+            return 1;
+        }
+    }
+    if (server)
+    {
+        if (socketPath.empty() || !positional.empty())
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        try
+        {
+            CompileDaemon compileDaemon(compiler, socketPath);
+            for (const auto &directory : watchDirectories)
+            {
+                compileDaemon.watch(directory);
+            }
+            running = &compileDaemon;
+            std::signal(SIGINT, stopDaemon);
+            std::signal(SIGTERM, stopDaemon);
+            std::cerr << "Serving on " << socketPath << " with " << compiler.fileCount() << " files and "
+                      << compiler.functionCount() << " functions parsed" << std::endl;
+            compileDaemon.run();
+            running = nullptr;
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << "Server error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (positional.size() != 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    BuildResult result = compiler.build(positional[0]);
+    std::cerr << result.diagnostics;
+    if (!result.ok)
+        return 1;
+    std::ofstream output(positional[1]);
+    if (!output || !(output << result.code))
+    {
+        std::cerr << "Could not open output file: " << positional[1] << std::endl;
+        return 1;
+    }
+    std::cout << (options.backend == "cpp" ? "C++" : "Python") << " code has been successfully written to " << positional[1]
+              << std::endl;
+    return 0;
+}
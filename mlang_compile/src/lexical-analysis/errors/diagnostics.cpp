@@ -0,0 +1,208 @@
+#include "diagnostics.h"
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+const char* severityName(Severity severity) {
+    switch (severity) {
+        case Severity::ERROR: return "error";
+        case Severity::WARNING: return "warning";
+        case Severity::NOTE: return "note";
+    }
+    return "error";
+}
+
+std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size() + 2);
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    static const char hex[] = "0123456789abcdef";
+                    escaped += "\\u00";
+                    escaped += hex[(c >> 4) & 0xf];
+                    escaped += hex[c & 0xf];
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+}
+
+size_t Diagnostics::KeyHash::operator()(const Key& key) const {
+    uint64_t h = key.file;
+    h = h * 0x9E3779B97F4A7C15ull + key.message;
+    h = h * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.line);
+    h = h * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.column);
+    h = h * 0x9E3779B97F4A7C15ull + key.code;
+    return static_cast<size_t>(h ^ (h >> 29));
+}
+
+Diagnostics::Diagnostics(size_t maxPerFile) : maxPerFile(maxPerFile) {}
+
+uint32_t Diagnostics::addFile(const std::string& name) {
+    auto it = fileIds.find(name);
+    if (it != fileIds.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(files.size());
+    files.push_back(name);
+    fileIds.emplace(name, id);
+    keptPerFile.push_back(0);
+    suppressedPerFile.push_back(0);
+    return id;
+}
+
+uint32_t Diagnostics::intern(const std::string& message) {
+    auto it = messageIds.find(message);
+    if (it != messageIds.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(messages.size());
+    messages.push_back(message);
+    messageIds.emplace(message, id);
+    return id;
+}
+
+void Diagnostics::report(uint32_t file, Severity severity, DiagnosticCode code, SourceRange range, const std::string& message) {
+    uint32_t messageId = intern(message);
+    Key key{file, messageId, range.line, range.column, static_cast<uint16_t>(code)};
+    if (!seen.insert(key).second) return;
+
+    if (severity == Severity::ERROR) errors++;
+    if (keptPerFile[file] >= maxPerFile) {
+        suppressedPerFile[file]++;
+        return;
+    }
+    keptPerFile[file]++;
+    diagnostics.push_back({range, file, messageId, code, severity});
+}
+
+void Diagnostics::error(uint32_t file, DiagnosticCode code, SourceRange range, const std::string& message) {
+    report(file, Severity::ERROR, code, range, message);
+}
+
+void Diagnostics::merge(const Diagnostics& other) {
+    for (const auto& diagnostic : other.diagnostics) {
+        report(addFile(other.files[diagnostic.file]), diagnostic.severity, diagnostic.code,
+               diagnostic.range, other.messages[diagnostic.message]);
+    }
+    for (size_t file = 0; file < other.files.size(); ++file) {
+        suppressedPerFile[addFile(other.files[file])] += other.suppressedPerFile[file];
+    }
+}
+
+const char* Diagnostics::codeName(DiagnosticCode code) {
+    switch (code) {
+        case DiagnosticCode::UNEXPECTED_CHARACTER: return "MLANG001";
+        case DiagnosticCode::UNTERMINATED_STRING: return "MLANG002";
+        case DiagnosticCode::INVALID_NUMBER: return "MLANG003";
+        case DiagnosticCode::INVALID_IDENTIFIER: return "MLANG004";
+        case DiagnosticCode::MALFORMED_TOKEN: return "MLANG005";
+        case DiagnosticCode::PARSE_ERROR: return "MLANG006";
+        case DiagnosticCode::MALFORMED_AST: return "MLANG007";
+        case DiagnosticCode::TYPE_ERROR: return "MLANG008";
+        case DiagnosticCode::IO_ERROR: return "MLANG009";
+        case DiagnosticCode::PROFILE: return "MLANG010";
+    }
+    return "MLANG000";
+}
+
+bool Diagnostics::parseFormat(const std::string& name, DiagnosticFormat& format) {
+    if (name == "text") format = DiagnosticFormat::TEXT;
+    else if (name == "json") format = DiagnosticFormat::JSON;
+    else if (name == "sarif") format = DiagnosticFormat::SARIF;
+    else return false;
+    return true;
+}
+
+std::string Diagnostics::render(DiagnosticFormat format) const {
+    switch (format) {
+        case DiagnosticFormat::JSON: return renderJson();
+        case DiagnosticFormat::SARIF: return renderSarif();
+        case DiagnosticFormat::TEXT: break;
+    }
+    return renderText();
+}
+
+void Diagnostics::flush(std::ostream& out, DiagnosticFormat format) {
+    std::string text = render(format);
+    if (!text.empty()) {
+        out.write(text.data(), text.size());
+        out.flush();
+    }
+    diagnostics.clear();
+    seen.clear();
+    std::fill(keptPerFile.begin(), keptPerFile.end(), 0);
+    std::fill(suppressedPerFile.begin(), suppressedPerFile.end(), 0);
+}
+
+std::string Diagnostics::renderText() const {
+    std::ostringstream out;
+    for (const auto& d : diagnostics) {
+        out << files[d.file] << ":";
+        if (d.range.line > 0) out << d.range.line << ":" << d.range.column << ":";
+        out << " " << severityName(d.severity) << ": " << messages[d.message] << "\n";
+    }
+    for (size_t file = 0; file < files.size(); ++file) {
+        if (suppressedPerFile[file] > 0) {
+            out << files[file] << ": note: " << suppressedPerFile[file]
+                << " more diagnostics suppressed (limit " << maxPerFile << " per file)\n";
+        }
+    }
+    return out.str();
+}
+
+std::string Diagnostics::renderJson() const {
+    std::ostringstream out;
+    out << "{\n  \"diagnostics\": [";
+    for (size_t i = 0; i < diagnostics.size(); ++i) {
+        const auto& d = diagnostics[i];
+        out << (i ? ",\n    " : "\n    ")
+            << "{\"file\": \"" << escapeJson(files[d.file]) << "\", "
+            << "\"severity\": \"" << severityName(d.severity) << "\", "
+            << "\"code\": \"" << codeName(d.code) << "\", "
+            << "\"message\": \"" << escapeJson(messages[d.message]) << "\", "
+            << "\"range\": {\"start\": {\"line\": " << d.range.line << ", \"column\": " << d.range.column << "}, "
+            << "\"end\": {\"line\": " << d.range.endLine << ", \"column\": " << d.range.endColumn << "}}}";
+    }
+    out << (diagnostics.empty() ? "" : "\n  ") << "],\n  \"suppressed\": {";
+    bool first = true;
+    for (size_t file = 0; file < files.size(); ++file) {
+        if (suppressedPerFile[file] == 0) continue;
+        out << (first ? "" : ", ") << "\"" << escapeJson(files[file]) << "\": " << suppressedPerFile[file];
+        first = false;
+    }
+    out << "},\n  \"error_count\": " << errors << "\n}\n";
+    return out.str();
+}
+
+std::string Diagnostics::renderSarif() const {
+    std::ostringstream out;
+    out << "{\n  \"$schema\": \"https://json.schemastore.org/sarif-2.1.0.json\",\n"
+        << "  \"version\": \"2.1.0\",\n"
+        << "  \"runs\": [{\n"
+        << "    \"tool\": {\"driver\": {\"name\": \"mlang\", \"informationUri\": \"https://github.com/alok27a/MLang\"}},\n"
+        << "    \"results\": [";
+    for (size_t i = 0; i < diagnostics.size(); ++i) {
+        const auto& d = diagnostics[i];
+        out << (i ? ",\n      " : "\n      ")
+            << "{\"ruleId\": \"" << codeName(d.code) << "\", "
+            << "\"level\": \"" << severityName(d.severity) << "\", "
+            << "\"message\": {\"text\": \"" << escapeJson(messages[d.message]) << "\"}, "
+            << "\"locations\": [{\"physicalLocation\": {\"artifactLocation\": {\"uri\": \"" << escapeJson(files[d.file]) << "\"}";
+        if (d.range.line > 0) {
+            out << ", \"region\": {\"startLine\": " << d.range.line << ", \"startColumn\": " << d.range.column
+                << ", \"endLine\": " << d.range.endLine << ", \"endColumn\": " << d.range.endColumn << "}";
+        }
+        out << "}}]}";
+    }
+    out << (diagnostics.empty() ? "" : "\n    ") << "]\n  }]\n}\n";
+    return out.str();
+}
@@ -0,0 +1,113 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+enum class Severity : uint8_t {
+    ERROR,
+    WARNING,
+    NOTE
+};
+
+enum class DiagnosticCode : uint16_t {
+    UNEXPECTED_CHARACTER = 1,
+    UNTERMINATED_STRING,
+    INVALID_NUMBER,
+    INVALID_IDENTIFIER,
+    MALFORMED_TOKEN,
+    PARSE_ERROR,
+    MALFORMED_AST,
+    TYPE_ERROR,
+    IO_ERROR,
+    PROFILE
+};
+
+enum class DiagnosticFormat {
+    TEXT,
+    JSON,
+    SARIF
+};
+
+// Line 0 means the diagnostic has no source location
+struct SourceRange {
+    int32_t line;
+    int32_t column;
+    int32_t endLine;
+    int32_t endColumn;
+};
+
+// Compact record: the file name and message text live in interned tables
+struct Diagnostic {
+    SourceRange range;
+    uint32_t file;
+    uint32_t message;
+    DiagnosticCode code;
+    Severity severity;
+};
+
+// Collects diagnostics from every phase and renders them in one batched write.
+// Duplicates (same file, range, code and message) are dropped, and at most
+// maxPerFile records are kept per file; the rest are only counted.
+class Diagnostics {
+public:
+    explicit Diagnostics(size_t maxPerFile = 100);
+
+    uint32_t addFile(const std::string& name);
+    void report(uint32_t file, Severity severity, DiagnosticCode code, SourceRange range, const std::string& message);
+    void error(uint32_t file, DiagnosticCode code, SourceRange range, const std::string& message);
+    // Appends the records of another collector (e.g. one per lexing thread), preserving their order
+    void merge(const Diagnostics& other);
+
+    void setMaxPerFile(size_t limit) { maxPerFile = limit; }
+    size_t errorCount() const { return errors; }
+    bool hasErrors() const { return errors > 0; }
+    const std::vector<Diagnostic>& records() const { return diagnostics; }
+    const std::string& fileName(uint32_t file) const { return files[file]; }
+    const std::string& messageText(uint32_t message) const { return messages[message]; }
+
+    std::string render(DiagnosticFormat format) const;
+    // Writes everything collected so far with a single write and clears the buffer
+    void flush(std::ostream& out, DiagnosticFormat format);
+
+    static bool parseFormat(const std::string& name, DiagnosticFormat& format);
+    static const char* codeName(DiagnosticCode code);
+
+private:
+    struct Key {
+        uint32_t file;
+        uint32_t message;
+        int32_t line;
+        int32_t column;
+        uint16_t code;
+        bool operator==(const Key& other) const {
+            return file == other.file && message == other.message && line == other.line &&
+                   column == other.column && code == other.code;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    size_t maxPerFile;
+    size_t errors = 0;
+    std::vector<Diagnostic> diagnostics;
+    std::vector<std::string> files;
+    std::unordered_map<std::string, uint32_t> fileIds;
+    std::vector<size_t> keptPerFile;
+    std::vector<size_t> suppressedPerFile;
+    std::vector<std::string> messages;
+    std::unordered_map<std::string, uint32_t> messageIds;
+    std::unordered_set<Key, KeyHash> seen;
+
+    uint32_t intern(const std::string& message);
+    std::string renderText() const;
+    std::string renderJson() const;
+    std::string renderSarif() const;
+};
+
+#endif
@@ -1,9 +1,8 @@
 #include "errors.h"
-#include <iostream>
 #include <sstream>
 
-void LexerError::report(const std::string& filename, int line, int column, const std::string& message) {
-    std::cerr << filename << ":" << line << ":" << column << ": error: " << message << std::endl;
+void LexerError::report(Diagnostics& diagnostics, uint32_t file, DiagnosticCode code, SourceRange range, const std::string& message) {
+    diagnostics.error(file, code, range, message);
 }
 
 std::string LexerError::formatMessage(const std::string& message, const std::string& token) {
@@ -15,18 +14,28 @@ std::string LexerError::formatMessage(const std::string& message, const std::str
     return oss.str();
 }
 
-void LexerError::unexpectedCharacter(const std::string& filename, int line, int column, char c) {
-    report(filename, line, column, formatMessage("Unexpected character", std::string(1, c)));
+void LexerError::unexpectedCharacter(Diagnostics& diagnostics, uint32_t file, int line, int column, char c) {
+    std::string text(1, c);
+    unsigned char byte = static_cast<unsigned char>(c);
+    if (byte < 0x20 || byte >= 0x7f) {
+        // Keep binary junk readable in the rendered output
+        static const char hex[] = "0123456789abcdef";
+        text = std::string("\\x") + hex[byte >> 4] + hex[byte & 0xf];
+    }
+    report(diagnostics, file, DiagnosticCode::UNEXPECTED_CHARACTER, {line, column, line, column + 1},
+           formatMessage("Unexpected character", text));
 }
 
-void LexerError::unterminatedString(const std::string& filename, int line, int column) {
-    report(filename, line, column, "Unterminated string literal");
+void LexerError::unterminatedString(Diagnostics& diagnostics, uint32_t file, int line, int column, int endColumn) {
+    report(diagnostics, file, DiagnosticCode::UNTERMINATED_STRING, {line, column, line, endColumn}, "Unterminated string literal");
 }
 
-void LexerError::invalidNumber(const std::string& filename, int line, int column, const std::string& number) {
-    report(filename, line, column, formatMessage("Invalid number", number));
+void LexerError::invalidNumber(Diagnostics& diagnostics, uint32_t file, int line, int column, const std::string& number) {
+    report(diagnostics, file, DiagnosticCode::INVALID_NUMBER, {line, column, line, column + static_cast<int>(number.length())},
+           formatMessage("Invalid number", number));
 }
 
-void LexerError::invalidIdentifier(const std::string& filename, int line, int column, const std::string& identifier) {
-    report(filename, line, column, formatMessage("Invalid identifier", identifier));
-}
\ No newline at end of file
+void LexerError::invalidIdentifier(Diagnostics& diagnostics, uint32_t file, int line, int column, const std::string& identifier) {
+    report(diagnostics, file, DiagnosticCode::INVALID_IDENTIFIER, {line, column, line, column + static_cast<int>(identifier.length())},
+           formatMessage("Invalid identifier", identifier));
+}
@@ -2,17 +2,18 @@
 #define ERRORS_H
 
 #include <string>
+#include "diagnostics.h"
 
 class LexerError {
 public:
-    static void report(const std::string& filename, int line, int column, const std::string& message);
-    static void unexpectedCharacter(const std::string& filename, int line, int column, char c);
-    static void unterminatedString(const std::string& filename, int line, int column);
-    static void invalidNumber(const std::string& filename, int line, int column, const std::string& number);
-    static void invalidIdentifier(const std::string& filename, int line, int column, const std::string& identifier);
+    static void report(Diagnostics& diagnostics, uint32_t file, DiagnosticCode code, SourceRange range, const std::string& message);
+    static void unexpectedCharacter(Diagnostics& diagnostics, uint32_t file, int line, int column, char c);
+    static void unterminatedString(Diagnostics& diagnostics, uint32_t file, int line, int column, int endColumn);
+    static void invalidNumber(Diagnostics& diagnostics, uint32_t file, int line, int column, const std::string& number);
+    static void invalidIdentifier(Diagnostics& diagnostics, uint32_t file, int line, int column, const std::string& identifier);
 
 private:
     static std::string formatMessage(const std::string& message, const std::string& token);
 };
 
-#endif 
\ No newline at end of file
+#endif 
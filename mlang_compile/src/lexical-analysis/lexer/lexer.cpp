@@ -1,25 +1,130 @@
 #include "lexer.h"
 #include "../errors/errors.h"
+#include <algorithm>
 #include <cctype>
+#include <limits>
+#include <thread>
 
 const std::unordered_set<std::string> Lexer::keywords = {
     "dataset", "fn", "for", "in", "return", "if", "else", "while",
-    "Int", "Float", "Void","Vector", "Matrix","to","Dataset"
+    "Int", "Float", "Void","Vector", "Matrix","to","Dataset", "SparseMatrix", "SparseDataset"
 };
 
-Lexer::Lexer(const std::string& input) : input(input), position(0), line(1), column(1) {}
+Lexer::Lexer(const std::string& input, const std::string& filename, Diagnostics& diagnostics)
+    : input(input), position(0), line(1), column(1), diagnostics(diagnostics), file(diagnostics.addFile(filename)) {}
 
 std::vector<Token> Lexer::tokenize() {
     std::vector<Token> tokens;
-    while (!isAtEnd()) {
-        skipWhitespace();
-        if (isAtEnd()) break;
-        tokens.push_back(scanToken());
+    do {
+        tokens.push_back(nextToken());
+    } while (tokens.back().type != TokenType::END_OF_FILE);
+    return tokens;
+}
+
+Token Lexer::nextToken() {
+    skipWhitespace();
+    if (isAtEnd()) return createToken(TokenType::END_OF_FILE, "");
+    return scanToken();
+}
+
+std::vector<Token> Lexer::tokenizeParallel(unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    // A thread only pays for itself on a few hundred KiB of source
+    const size_t minimumChunk = 256 << 10;
+    size_t chunks = std::min<size_t>(threads, input.size() / minimumChunk);
+    if (chunks <= 1) return tokenize();
+
+    // Chunks begin at a newline. Strings and comments end before one, so each chunk lexes
+    // exactly as it would in sequence once its first line number is known.
+    std::vector<size_t> starts(chunks + 1, input.size());
+    starts[0] = 0;
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t newline = input.find('\n', std::max(starts[c - 1], input.size() * c / chunks));
+        starts[c] = newline == std::string::npos ? input.size() : newline;
     }
-    tokens.push_back(createToken(TokenType::END_OF_FILE, ""));
+    auto forEachChunk = [&](auto body) {
+        std::vector<std::thread> workers;
+        for (size_t c = 1; c < chunks; ++c) workers.emplace_back(body, c);
+        body(0);
+        for (auto& worker : workers) worker.join();
+    };
+
+    std::vector<int> firstLine(chunks + 1, 0);
+    forEachChunk([&](size_t c) {
+        firstLine[c + 1] = static_cast<int>(std::count(input.begin() + starts[c], input.begin() + starts[c + 1], '\n'));
+    });
+    firstLine[0] = line;
+    for (size_t c = 0; c < chunks; ++c) firstLine[c + 1] += firstLine[c];
+
+    // Each chunk reports into its own uncapped collector; merging in chunk order then applies
+    // the per-file cap and deduplication exactly as a sequential run would
+    std::vector<std::vector<Token>> parts(chunks);
+    std::vector<Diagnostics> collected(chunks, Diagnostics(std::numeric_limits<size_t>::max()));
+    const std::string filename = diagnostics.fileName(file);
+    forEachChunk([&](size_t c) {
+        Lexer chunk(input.substr(starts[c], starts[c + 1] - starts[c]), filename, collected[c]);
+        chunk.line = firstLine[c];
+        parts[c] = chunk.tokenize();
+        if (c + 1 < chunks) parts[c].pop_back();  // only the last chunk ends the file
+        if (c + 1 == chunks) {
+            line = chunk.line;
+            column = chunk.column;
+        }
+    });
+
+    std::vector<size_t> offsets(chunks + 1, 0);
+    for (size_t c = 0; c < chunks; ++c) offsets[c + 1] = offsets[c] + parts[c].size();
+    std::vector<Token> tokens(offsets[chunks]);
+    forEachChunk([&](size_t c) {
+        std::move(parts[c].begin(), parts[c].end(), tokens.begin() + offsets[c]);
+    });
+    for (const auto& chunkDiagnostics : collected) diagnostics.merge(chunkDiagnostics);
+    position = static_cast<int>(input.length());
     return tokens;
 }
 
+TokenStream::TokenStream(Source source, size_t lookahead)
+    : source(std::move(source)), ring(lookahead + 1), last{TokenType::END_OF_FILE, "", 0, 0} {}
+
+const Token& TokenStream::peek(size_t offset) {
+    if (offset >= ring.size()) {
+        // Deeper lookahead than planned: grow the window, keeping the buffered tokens in order
+        std::vector<Token> grown(offset + 1);
+        for (size_t i = 0; i < buffered; ++i) grown[i] = std::move(ring[(head + i) % ring.size()]);
+        ring = std::move(grown);
+        head = 0;
+    }
+    while (buffered <= offset) {
+        Token& slot = ring[(head + buffered) % ring.size()];
+        if (exhausted) {
+            // Repeat the final END_OF_FILE rather than calling the source again
+            slot = ring[(head + buffered + ring.size() - 1) % ring.size()];
+        } else {
+            slot = source();
+            exhausted = slot.type == TokenType::END_OF_FILE;
+        }
+        ++buffered;
+    }
+    return ring[(head + offset) % ring.size()];
+}
+
+void TokenStream::advance() {
+    peek();
+    if (ring[head].type == TokenType::END_OF_FILE) {
+        last = ring[head];
+        return;
+    }
+    last = std::move(ring[head]);
+    head = (head + 1) % ring.size();
+    --buffered;
+    ++count;
+}
+
+Token TokenStream::next() {
+    advance();
+    return last;
+}
+
 char Lexer::peekInput() {
     if (isAtEnd()) return '\0';
     return input[position];
@@ -67,7 +172,7 @@ Token Lexer::scanToken() {
             return createToken(TokenType::OPERATOR, "/");
         case '"': return scanString();
         case '@':
-            LexerError::unexpectedCharacter("input", line, column - 1, c);
+            LexerError::unexpectedCharacter(diagnostics, file, line, column - 1, c);
             return createToken(TokenType::UNKNOWN, std::string(1, c));
         default:
             if (std::isalpha(c) || c == '_') return scanIdentifierOrKeyword();
@@ -79,12 +184,12 @@ Token Lexer::scanToken() {
                     while (std::isalnum(peekInput()) || peekInput() == '_') {
                         invalidIdentifier += advance();
                     }
-                    LexerError::invalidIdentifier("input", line, column - invalidIdentifier.length(), invalidIdentifier);
+                    LexerError::invalidIdentifier(diagnostics, file, line, column - invalidIdentifier.length(), invalidIdentifier);
                     return createToken(TokenType::UNKNOWN, invalidIdentifier);
                 }
                 return numberToken;
             }
-            LexerError::unexpectedCharacter("input", line, column - 1, c);
+            LexerError::unexpectedCharacter(diagnostics, file, line, column - 1, c);
             return createToken(TokenType::UNKNOWN, std::string(1, c));
 
 
@@ -104,7 +209,7 @@ Token Lexer::scanIdentifierOrKeyword() {
     }
 
     if (!std::isalpha(value[0]) && value[0] != '_') {
-        LexerError::invalidIdentifier("input", line, column - value.length(), value);
+        LexerError::invalidIdentifier(diagnostics, file, line, column - value.length(), value);
         return createToken(TokenType::UNKNOWN, value);
     }
 
@@ -126,7 +231,7 @@ Token Lexer::scanNumber() {
                     value += advance();
                 }
                 // Log the error
-                LexerError::invalidNumber("input", line, startColumn, value);
+                LexerError::invalidNumber(diagnostics, file, line, startColumn, value);
                 return createToken(TokenType::UNKNOWN, value);
             }
             hasDecimalPoint = true;
@@ -137,7 +242,7 @@ Token Lexer::scanNumber() {
     // Check if the next character is a letter or underscore
     if (std::isalpha(peekInput()) || peekInput() == '_') {
         // Log the error for invalid identifier starting with a number
-        LexerError::invalidNumber("input", line, startColumn, value);
+        LexerError::invalidNumber(diagnostics, file, line, startColumn, value);
         return createToken(TokenType::UNKNOWN, value);
     }
 
@@ -154,12 +259,12 @@ Token Lexer::scanString() {
     }
 
     if (isAtEnd() || peekInput() == '\n') {
-        LexerError::unterminatedString("input", startLine, startColumn);
+        LexerError::unterminatedString(diagnostics, file, startLine, startColumn, column);
         return createToken(TokenType::UNKNOWN, value);
     }
 
     advance();  // Consume the closing "
-    return createToken(TokenType::LITERAL, value);
+    return createToken(TokenType::STRING, value);
 }
 
 void Lexer::skipWhitespace() {
@@ -189,6 +294,7 @@ std::string tokenTypeToString(TokenType type) {
         case TokenType::KEYWORD: return "KEYWORD";
         case TokenType::IDENTIFIER: return "IDENTIFIER";
         case TokenType::LITERAL: return "LITERAL";
+        case TokenType::STRING: return "STRING";
         case TokenType::OPERATOR: return "OPERATOR";
         case TokenType::DELIMITER: return "DELIMITER";
         case TokenType::COMMENT: return "COMMENT";
@@ -196,4 +302,16 @@ std::string tokenTypeToString(TokenType type) {
         case TokenType::END_OF_FILE: return "END_OF_FILE";
         default: return "UNKNOWN";
     }
+}
+
+TokenType stringToTokenType(const std::string& type) {
+    if (type == "KEYWORD") return TokenType::KEYWORD;
+    if (type == "IDENTIFIER") return TokenType::IDENTIFIER;
+    if (type == "LITERAL") return TokenType::LITERAL;
+    if (type == "STRING") return TokenType::STRING;
+    if (type == "OPERATOR") return TokenType::OPERATOR;
+    if (type == "DELIMITER") return TokenType::DELIMITER;
+    if (type == "COMMENT") return TokenType::COMMENT;
+    if (type == "END_OF_FILE") return TokenType::END_OF_FILE;
+    return TokenType::UNKNOWN;
 }
\ No newline at end of file
@@ -1,14 +1,17 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <unordered_set>
+#include "../errors/diagnostics.h"
 
 enum class TokenType {
     KEYWORD,
     IDENTIFIER,
-    LITERAL,
+    LITERAL,  // a number
+    STRING,   // a string constant, without its quotes
     OPERATOR,
     DELIMITER,
     COMMENT,
@@ -25,14 +28,21 @@ struct Token {
 
 class Lexer {
 public:
-    Lexer(const std::string& input);
+    Lexer(const std::string& input, const std::string& filename, Diagnostics& diagnostics);
     std::vector<Token> tokenize();
+    // Same tokens and diagnostics as tokenize(), with the input split at line starts and the
+    // chunks lexed on up to `threads` threads (0: one per core). Small inputs use one thread.
+    std::vector<Token> tokenizeParallel(unsigned threads = 0);
+    // Scans one token on demand; END_OF_FILE once the input is used up, and again on every later call
+    Token nextToken();
 
 private:
     std::string input;
     int position;
     int line;
     int column;
+    Diagnostics& diagnostics;
+    uint32_t file;
 
     char peekInput();
     char advance();
@@ -49,6 +59,36 @@ private:
     static const std::unordered_set<std::string> keywords;
 };
 
+// Tokens pulled from a source on demand into a small ring buffer, so a consumer such as the
+// parser holds its lookahead window rather than the whole token list, and starts before the
+// source is exhausted. The source returns END_OF_FILE last; the stream then repeats that token.
+class TokenStream {
+public:
+    using Source = std::function<Token()>;
+
+    // lookahead: how far past the current token peek() looks without growing the buffer
+    explicit TokenStream(Source source, size_t lookahead = 2);
+
+    // The token `offset` places ahead; the reference is valid until the next advance()
+    const Token& peek(size_t offset = 0);
+    bool atEnd() { return peek().type == TokenType::END_OF_FILE; }
+    void advance();
+    Token next();
+    // Last token consumed, where errors at the end of a construct are reported; END_OF_FILE at line 0 before the first
+    const Token& previous() const { return last; }
+    size_t consumed() const { return count; }
+
+private:
+    Source source;
+    std::vector<Token> ring;
+    size_t head = 0;
+    size_t buffered = 0;
+    bool exhausted = false;
+    Token last;
+    size_t count = 0;
+};
+
 std::string tokenTypeToString(TokenType type);
+TokenType stringToTokenType(const std::string& type);
 
 #endif 
\ No newline at end of file
@@ -7,11 +7,31 @@ using namespace std;
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <input_filename>" << endl;
+        cerr << "Usage: " << argv[0] << " <input_filename> [--diagnostics-format text|json|sarif] [--max-errors N] [--threads N]" << endl;
         return 1;
     }
 
     string filename = argv[1];
+    DiagnosticFormat format = DiagnosticFormat::TEXT;
+    Diagnostics diagnostics;
+    // 0 lexes large files on every core, 1 keeps lexing sequential
+    unsigned threads = 0;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--diagnostics-format" && Diagnostics::parseFormat(argv[i + 1], format)) continue;
+        if (option == "--max-errors") {
+            diagnostics.setMaxPerFile(stoul(argv[i + 1]));
+            continue;
+        }
+        if (option == "--threads") {
+            threads = stoul(argv[i + 1]);
+            continue;
+        }
+        cerr << "Unknown option: " << option << " " << argv[i + 1] << endl;
+        return 1;
+    }
+
     ifstream file(filename);
 
     if (!file.is_open()) {
@@ -23,12 +43,16 @@ int main(int argc, char* argv[]) {
     buffer << file.rdbuf();
     string input = buffer.str();
 
-    Lexer lexer(input);
-    vector<Token> tokens = lexer.tokenize();
+    Lexer lexer(input, filename, diagnostics);
+    vector<Token> tokens = lexer.tokenizeParallel(threads);
 
+    ostringstream output;
     for (const auto& token : tokens) {
-        cout << "<" << tokenTypeToString(token.type) << ", \"" << token.value << "\"> [Line: " << token.line << ", Column: " << token.column << "]" << endl;
+        output << "<" << tokenTypeToString(token.type) << ", \"" << token.value << "\"> [Line: " << token.line << ", Column: " << token.column << "]\n";
     }
+    cout << output.str();
+    cout.flush();
 
+    diagnostics.flush(cerr, format);
     return 0;
 }
@@ -0,0 +1,580 @@
+#include "distributed.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+// Below this many bytes an allreduce is latency bound and the tree's log2 p steps win
+const size_t TREE_BYTES = size_t(64) << 10;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<int>::is_always_lock_free,
+              "rings shared between processes need lock-free atomics");
+
+// Start of the shared mapping, before the rings
+struct SharedHeader
+{
+    alignas(64) std::atomic<int> aborted{0};
+};
+
+void checkPeer(const Transport &transport, int peer)
+{
+    if (peer != -1 && (peer < 0 || peer >= transport.size() || peer == transport.rank()))
+        throw RuntimeError("No process " + std::to_string(peer) + " to exchange with in a group of " +
+                           std::to_string(transport.size()));
+}
+
+void systemError(const std::string &what)
+{
+    throw RuntimeError(what + ": " + std::strerror(errno));
+}
+
+// Sum of a chunk a peer sent into the matching chunk of values
+void addInto(double *values, const std::vector<double> &incoming, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        values[i] += incoming[i];
+    }
+}
+
+void ringAllreduce(Transport &transport, double *values, size_t count)
+{
+    int size = transport.size();
+    int rank = transport.rank();
+    int right = (rank + 1) % size;
+    int left = (rank + size - 1) % size;
+    auto chunkBegin = [&](int chunk)
+    { return count * static_cast<size_t>(chunk) / size; };
+    auto chunkCount = [&](int chunk)
+    { return chunkBegin(chunk + 1) - chunkBegin(chunk); };
+    std::vector<double> incoming(count / size + 1);
+
+    // Reduce-scatter: after size - 1 steps this process holds the full sum of chunk rank + 1
+    for (int step = 0; step + 1 < size; ++step)
+    {
+        int sendChunk = (rank - step + size) % size;
+        int receiveChunk = (rank - step - 1 + 2 * size) % size;
+        transport.exchange(right, values + chunkBegin(sendChunk), chunkCount(sendChunk) * sizeof(double), left,
+                           incoming.data(), chunkCount(receiveChunk) * sizeof(double));
+        addInto(values + chunkBegin(receiveChunk), incoming, chunkCount(receiveChunk));
+    }
+    // Allgather: the summed chunks travel once around the ring
+    for (int step = 0; step + 1 < size; ++step)
+    {
+        int sendChunk = (rank + 1 - step + size) % size;
+        int receiveChunk = (rank - step + size) % size;
+        transport.exchange(right, values + chunkBegin(sendChunk), chunkCount(sendChunk) * sizeof(double), left,
+                           values + chunkBegin(receiveChunk), chunkCount(receiveChunk) * sizeof(double));
+    }
+}
+
+void treeAllreduce(Transport &transport, double *values, size_t count)
+{
+    int size = transport.size();
+    int rank = transport.rank();
+    size_t bytes = count * sizeof(double);
+    std::vector<double> incoming(count);
+
+    for (int mask = 1; mask < size; mask <<= 1)
+    {
+        if (rank & mask)
+        {
+            transport.exchange(rank - mask, values, bytes, -1, nullptr, 0);
+            break;
+        }
+        if (rank + mask < size)
+        {
+            transport.exchange(-1, nullptr, 0, rank + mask, incoming.data(), bytes);
+            addInto(values, incoming, count);
+        }
+    }
+    int top = 1;
+    while (top * 2 < size)
+    {
+        top *= 2;
+    }
+    for (int mask = top; mask >= 1; mask >>= 1)
+    {
+        if ((rank & (2 * mask - 1)) == 0 && rank + mask < size)
+            transport.exchange(rank + mask, values, bytes, -1, nullptr, 0);
+        else if ((rank & (2 * mask - 1)) == mask)
+            transport.exchange(-1, nullptr, 0, rank - mask, values, bytes);
+    }
+}
+
+std::vector<int> allowedCPUs()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Restricts the calling thread, and the pool threads it starts later, to its share of cpus
+void pinWorker(const std::vector<int> &cpus, int rank, int processes)
+{
+    if (cpus.size() < static_cast<size_t>(processes))
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = cpus.size() * rank / processes; i < cpus.size() * (rank + 1) / processes; ++i)
+    {
+        CPU_SET(cpus[i], &set);
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+// status is from waitpid, unless waitError holds the errno of a waitpid that failed
+std::string describeExit(int rank, int status, int waitError)
+{
+    if (waitError != 0)
+        return "Cannot wait for distributed worker " + std::to_string(rank) + ": " + std::strerror(waitError);
+    if (WIFSIGNALED(status))
+        return "Distributed worker " + std::to_string(rank) + " was killed by signal " + std::to_string(WTERMSIG(status));
+    return "Distributed worker " + std::to_string(rank) + " failed";
+}
+}
+
+StreamTransport::~StreamTransport()
+{
+    for (int fd : peers)
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+void StreamTransport::exchange(int to, const void *send, size_t sendBytes, int from, void *receive, size_t receiveBytes)
+{
+    checkPeer(*this, to);
+    checkPeer(*this, from);
+    const char *out = static_cast<const char *>(send);
+    char *in = static_cast<char *>(receive);
+    size_t sent = to < 0 ? sendBytes : 0;
+    size_t received = from < 0 ? receiveBytes : 0;
+    while (sent < sendBytes || received < receiveBytes)
+    {
+        pollfd waiting[2];
+        nfds_t count = 0;
+        if (sent < sendBytes)
+            waiting[count++] = {peers[to], POLLOUT, 0};
+        if (received < receiveBytes)
+            waiting[count++] = {peers[from], POLLIN, 0};
+        if (poll(waiting, count, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            systemError("poll");
+        }
+
+        if (sent < sendBytes)
+        {
+            ssize_t n = ::send(peers[to], out + sent, sendBytes - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n > 0)
+                sent += static_cast<size_t>(n);
+            else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                systemError("Sending to process " + std::to_string(to));
+        }
+        if (received < receiveBytes)
+        {
+            ssize_t n = recv(peers[from], in + received, receiveBytes - received, MSG_DONTWAIT);
+            if (n > 0)
+                received += static_cast<size_t>(n);
+            else if (n == 0)
+                throw RuntimeError("Process " + std::to_string(from) + " closed its connection");
+            else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                systemError("Receiving from process " + std::to_string(from));
+        }
+    }
+}
+
+SocketTransport::SocketTransport(int size) : ends(static_cast<size_t>(size) * size, -1)
+{
+    peers.assign(size, -1);
+    for (int i = 0; i < size; ++i)
+    {
+        for (int j = i + 1; j < size; ++j)
+        {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0)
+                systemError("socketpair");
+            ends[i * size + j] = pair[0];
+            ends[j * size + i] = pair[1];
+        }
+    }
+}
+
+SocketTransport::~SocketTransport()
+{
+    for (int fd : ends)
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+void SocketTransport::bind(int rank)
+{
+    int size = this->size();
+    self = rank;
+    for (int i = 0; i < size; ++i)
+    {
+        for (int j = 0; j < size; ++j)
+        {
+            int &fd = ends[i * size + j];
+            if (i == rank)
+                peers[j] = fd;
+            else if (fd >= 0)
+                close(fd);
+            fd = -1;
+        }
+    }
+}
+
+// Bytes written and read so far on separate cache lines; the data follows the header
+struct SharedMemoryTransport::Ring
+{
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+};
+
+SharedMemoryTransport::SharedMemoryTransport(int size, size_t ringBytes)
+    : count(size), ringBytes((std::max<size_t>(ringBytes, 4096) + 63) / 64 * 64)
+{
+    size_t rings = static_cast<size_t>(size) * size;
+    mappedBytes = sizeof(SharedHeader) + rings * (sizeof(Ring) + this->ringBytes);
+    mapping = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        systemError("Mapping " + std::to_string(mappedBytes) + " bytes of shared memory");
+    }
+    new (mapping) SharedHeader();
+    for (int from = 0; from < size; ++from)
+    {
+        for (int to = 0; to < size; ++to)
+        {
+            new (ring(from, to)) Ring();
+        }
+    }
+}
+
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+    if (mapping)
+        munmap(mapping, mappedBytes);
+}
+
+SharedMemoryTransport::Ring *SharedMemoryTransport::ring(int from, int to) const
+{
+    char *rings = static_cast<char *>(mapping) + sizeof(SharedHeader);
+    return reinterpret_cast<Ring *>(rings + (static_cast<size_t>(from) * count + to) * (sizeof(Ring) + ringBytes));
+}
+
+void SharedMemoryTransport::abort()
+{
+    static_cast<SharedHeader *>(mapping)->aborted.store(1, std::memory_order_release);
+}
+
+void SharedMemoryTransport::exchange(int to, const void *send, size_t sendBytes, int from, void *receive, size_t receiveBytes)
+{
+    checkPeer(*this, to);
+    checkPeer(*this, from);
+    const char *out = static_cast<const char *>(send);
+    char *in = static_cast<char *>(receive);
+    size_t sent = to < 0 ? sendBytes : 0;
+    size_t received = from < 0 ? receiveBytes : 0;
+    const SharedHeader *header = static_cast<const SharedHeader *>(mapping);
+    for (unsigned idle = 0; sent < sendBytes || received < receiveBytes;)
+    {
+        bool progress = false;
+        if (sent < sendBytes)
+        {
+            Ring *outgoing = ring(self, to);
+            uint64_t head = outgoing->head.load(std::memory_order_relaxed);
+            uint64_t tail = outgoing->tail.load(std::memory_order_acquire);
+            size_t n = std::min<size_t>(ringBytes - (head - tail), sendBytes - sent);
+            size_t offset = head % ringBytes;
+            size_t first = std::min(n, ringBytes - offset);
+            std::memcpy(outgoing->data() + offset, out + sent, first);
+            std::memcpy(outgoing->data(), out + sent + first, n - first);
+            outgoing->head.store(head + n, std::memory_order_release);
+            sent += n;
+            progress = progress || n > 0;
+        }
+        if (received < receiveBytes)
+        {
+            Ring *incoming = ring(from, self);
+            uint64_t tail = incoming->tail.load(std::memory_order_relaxed);
+            uint64_t head = incoming->head.load(std::memory_order_acquire);
+            size_t n = std::min<size_t>(head - tail, receiveBytes - received);
+            size_t offset = tail % ringBytes;
+            size_t first = std::min(n, ringBytes - offset);
+            std::memcpy(in + received, incoming->data() + offset, first);
+            std::memcpy(in + received + first, incoming->data(), n - first);
+            incoming->tail.store(tail + n, std::memory_order_release);
+            received += n;
+            progress = progress || n > 0;
+        }
+
+        if (progress)
+        {
+            idle = 0;
+            continue;
+        }
+        if (header->aborted.load(std::memory_order_acquire))
+            throw RuntimeError("Another distributed worker failed");
+        // More workers than cores is common on small machines, so do not spin for long
+        if (++idle > 64)
+            std::this_thread::yield();
+    }
+}
+
+void allreduce(Transport &transport, double *values, size_t count, AllreduceAlgorithm algorithm)
+{
+    if (transport.size() <= 1 || count == 0)
+        return;
+    if (algorithm == AllreduceAlgorithm::AUTO)
+        algorithm = count * sizeof(double) < TREE_BYTES ? AllreduceAlgorithm::TREE : AllreduceAlgorithm::RING;
+    if (algorithm == AllreduceAlgorithm::RING && count >= static_cast<size_t>(transport.size()))
+        ringAllreduce(transport, values, count);
+    else
+        treeAllreduce(transport, values, count);
+}
+
+int workerProcesses(const DistributedOptions &options)
+{
+    if (options.processes > 0)
+        return options.processes;
+    if (const char *environment = std::getenv("MLANG_PROCESSES"))
+    {
+        int processes = std::atoi(environment);
+        if (processes > 0)
+            return processes;
+    }
+    return 1;
+}
+
+void runWorkers(const DistributedOptions &options, const std::function<void(Transport &)> &body)
+{
+    int processes = workerProcesses(options);
+    std::unique_ptr<SocketTransport> sockets;
+    std::unique_ptr<SharedMemoryTransport> shared;
+    Transport *transport = nullptr;
+    if (options.transport == TransportKind::SOCKET)
+        transport = (sockets = std::make_unique<SocketTransport>(processes)).get();
+    else
+        transport = (shared = std::make_unique<SharedMemoryTransport>(processes)).get();
+    auto bind = [&](int rank)
+    { sockets ? sockets->bind(rank) : shared->bind(rank); };
+    if (processes == 1)
+    {
+        bind(0);
+        body(*transport);
+        return;
+    }
+
+    std::vector<int> cpus = allowedCPUs();
+    int threads = threadCount();
+    int share = std::max(1, threads / processes);
+    // Buffered output would otherwise be written again by every child
+    std::cout.flush();
+    std::fflush(nullptr);
+    // With SIGCHLD ignored the kernel reaps the workers itself and waitpid cannot see how they ended
+    struct sigaction childSignal;
+    sigaction(SIGCHLD, nullptr, &childSignal);
+    bool restoreChildSignal = childSignal.sa_handler == SIG_IGN;
+    if (restoreChildSignal)
+        signal(SIGCHLD, SIG_DFL);
+
+    std::vector<pid_t> children;
+    std::exception_ptr error;
+    pid_t parent = getpid();
+    for (int rank = 1; rank < processes && !error; ++rank)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            // A worker outlives a killed parent only to spin on rings nobody fills
+            if (prctl(PR_SET_PDEATHSIG, SIGKILL) != 0 || getppid() != parent)
+                _exit(1);
+            int status = 0;
+            try
+            {
+                resetThreadPoolAfterFork(share);
+                if (options.pin)
+                    pinWorker(cpus, rank, processes);
+                bind(rank);
+                body(*transport);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Distributed worker " << rank << ": " << e.what() << std::endl;
+                status = 1;
+            }
+            catch (...)
+            {
+                status = 1;
+            }
+            if (status != 0 && shared)
+                shared->abort();
+            _exit(status);
+        }
+        if (pid < 0)
+            error = std::make_exception_ptr(RuntimeError(std::string("Cannot start a worker process: ") + std::strerror(errno)));
+        else
+            children.push_back(pid);
+    }
+
+    // Reaps the workers as they exit. One that was killed or failed before it could call abort()
+    // must still stop the rest, which would otherwise wait on shared memory for it forever; with
+    // sockets its peers see the connection close. A waitpid that fails (ECHILD when the program
+    // ignores SIGCHLD) counts as a failed worker, as its fate is unknown. Blocking on one child at
+    // a time would miss another dying while the first waits for it, hence the polling.
+    std::vector<int> statuses(children.size(), 0);
+    std::vector<int> waitErrors(children.size(), 0);
+    auto failed = [&](size_t i)
+    { return waitErrors[i] != 0 || !WIFEXITED(statuses[i]) || WEXITSTATUS(statuses[i]) != 0; };
+    std::thread watcher([&]
+                        {
+        std::vector<bool> reaped(children.size(), false);
+        for (size_t remaining = children.size(); remaining > 0;)
+        {
+            for (size_t i = 0; i < children.size(); ++i)
+            {
+                if (reaped[i])
+                    continue;
+                pid_t pid = waitpid(children[i], &statuses[i], WNOHANG);
+                if (pid < 0 && errno != EINTR)
+                    waitErrors[i] = errno;
+                else if (pid != children[i])
+                    continue;
+                reaped[i] = true;
+                --remaining;
+                if (failed(i) && shared)
+                    shared->abort();
+            }
+            if (remaining > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } });
+
+    if (!error)
+    {
+        try
+        {
+            if (options.pin)
+                pinWorker(cpus, 0, processes);
+            setThreadCount(share);
+            bind(0);
+            body(*transport);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+    }
+    if (error)
+    {
+        // Wake the workers still waiting on this process: EOF on the sockets, the abort flag in shared memory
+        if (shared)
+            shared->abort();
+        sockets.reset();
+    }
+    if (options.pin)
+        pinWorker(cpus, 0, 1);
+    setThreadCount(threads);
+
+    watcher.join();
+    if (restoreChildSignal)
+        sigaction(SIGCHLD, &childSignal, nullptr);
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        // A worker's death is the cause; the error this process saw is only its peers giving up
+        if (waitErrors[i] == 0 && WIFSIGNALED(statuses[i]))
+            throw RuntimeError(describeExit(static_cast<int>(i) + 1, statuses[i], 0));
+    }
+    if (error)
+        std::rethrow_exception(error);
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        if (failed(i))
+            throw RuntimeError(describeExit(static_cast<int>(i) + 1, statuses[i], waitErrors[i]));
+    }
+}
+
+inline namespace MLANG_STORAGE
+{
+Vector linearRegressionTrain(const Matrix &data, const Vector &labels, double learningRate, int epochs,
+                             const DistributedOptions &options)
+{
+    if (data.rows != labels.size())
+        throw RuntimeError("Shape mismatch in linearRegressionTrain");
+    DistributedOptions group = options;
+    group.processes = static_cast<int>(std::min<size_t>(workerProcesses(options), std::max<size_t>(data.rows, 1)));
+    double scale = data.rows > 0 ? learningRate / data.rows : 0.0;
+
+    Vector weights(data.cols);
+    runWorkers(group, [&](Transport &transport)
+               {
+        size_t first = data.rows * transport.rank() / transport.size();
+        size_t last = data.rows * (transport.rank() + 1) / transport.size();
+        // Copied after pinning, so the shard's pages are first touched on the worker's own node
+        Matrix shard;
+        Vector shardLabels;
+        if (transport.size() > 1)
+        {
+            shard.rows = last - first;
+            shard.cols = data.cols;
+            shard.data.assign(data.data.begin() + first * data.cols, data.data.begin() + last * data.cols);
+            shardLabels.data.assign(labels.data.begin() + first, labels.data.begin() + last);
+        }
+        const Matrix &rows = transport.size() > 1 ? shard : data;
+        const Vector &rowLabels = transport.size() > 1 ? shardLabels : labels;
+
+        Vector local(data.cols), predictions, gradient;
+        std::vector<double> sum(data.cols);
+        for (int epoch = 0; epoch < epochs; ++epoch)
+        {
+            gemv(rows, local, predictions);
+            axpy(-1.0, rowLabels, predictions);
+            gemvTransposed(rows, predictions, gradient);
+            std::copy(gradient.data.begin(), gradient.data.end(), sum.begin());
+            allreduce(transport, sum.data(), sum.size(), group.algorithm);
+            for (size_t j = 0; j < local.size(); ++j)
+            {
+                local[j] = static_cast<Real>(local[j] - scale * sum[j]);
+            }
+        }
+        if (transport.rank() == 0)
+            weights = std::move(local); });
+    return weights;
+}
+}
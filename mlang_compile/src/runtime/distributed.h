@@ -0,0 +1,145 @@
+#ifndef RUNTIME_DISTRIBUTED_H
+#define RUNTIME_DISTRIBUTED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "runtime.h"
+
+// Data-parallel training across processes: each worker owns a shard of the rows, computes its
+// part of the gradient with the usual thread pool and the workers sum the parts with an
+// allreduce every step. Workers talk through a Transport, so the same training code runs over
+// shared memory or Unix sockets between local processes, and over any other byte stream
+// (e.g. TCP between machines) that implements the interface.
+
+// Point-to-point byte messages between the `size` processes of a group, numbered 0 ... size - 1
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+    // Sends sendBytes to process `to` while receiving receiveBytes from process `from`, and returns
+    // once both are done; -1 skips either side. Both move at once, so a ring of processes that all
+    // send to the right and receive from the left cannot deadlock on full buffers.
+    // Throws RuntimeError if a peer fails or goes away.
+    virtual void exchange(int to, const void *send, size_t sendBytes, int from, void *receive, size_t receiveBytes) = 0;
+};
+
+// A Transport over one connected stream socket per peer. Subclasses only set up the sockets:
+// socketpairs between forked processes here, connected TCP sockets for a transport across machines.
+class StreamTransport : public Transport
+{
+public:
+    ~StreamTransport() override;
+
+    int rank() const override { return self; }
+    int size() const override { return static_cast<int>(peers.size()); }
+    void exchange(int to, const void *send, size_t sendBytes, int from, void *receive, size_t receiveBytes) override;
+
+protected:
+    int self = 0;
+    // Socket to each peer, -1 for this process itself
+    std::vector<int> peers;
+};
+
+// Unix socketpairs between every two of `size` local processes. Create it before forking, then
+// call bind(rank) in each process, which closes the ends that belong to the others.
+class SocketTransport : public StreamTransport
+{
+public:
+    explicit SocketTransport(int size);
+    ~SocketTransport() override;
+
+    void bind(int rank);
+
+private:
+    // ends[i * size + j]: process i's end of its link to j
+    std::vector<int> ends;
+};
+
+// One single-producer, single-consumer ring buffer in a shared mapping for every ordered pair of
+// `size` local processes. Senders copy into the ring and receivers copy out, with no system call
+// on the way; a waiting side spins briefly, then yields. Create it before forking and call
+// bind(rank) in each process. A worker that fails calls abort(), which makes the others throw
+// instead of waiting for it forever; runWorkers calls it for a worker that was killed.
+class SharedMemoryTransport : public Transport
+{
+public:
+    explicit SharedMemoryTransport(int size, size_t ringBytes = size_t(256) << 10);
+    ~SharedMemoryTransport() override;
+    SharedMemoryTransport(const SharedMemoryTransport &) = delete;
+    SharedMemoryTransport &operator=(const SharedMemoryTransport &) = delete;
+
+    void bind(int rank) { self = rank; }
+    void abort();
+
+    int rank() const override { return self; }
+    int size() const override { return count; }
+    void exchange(int to, const void *send, size_t sendBytes, int from, void *receive, size_t receiveBytes) override;
+
+private:
+    struct Ring;
+    int self = 0;
+    int count = 0;
+    size_t ringBytes = 0;
+    size_t mappedBytes = 0;
+    void *mapping = nullptr;
+
+    Ring *ring(int from, int to) const;
+};
+
+enum class AllreduceAlgorithm
+{
+    // Tree below 64 KiB, where latency dominates, ring above
+    AUTO,
+    // Reduce-scatter then allgather around a ring: each process sends 2 (p - 1) / p of the data,
+    // whatever the number of processes
+    RING,
+    // Binomial tree reduction to process 0, then a broadcast down the same tree: log2 p steps
+    TREE
+};
+
+// Sums values elementwise across all processes of the group. Every element is added up once, in
+// an order that depends only on the group size, and the sum is copied to the others, so all
+// processes end with identical bits.
+void allreduce(Transport &transport, double *values, size_t count, AllreduceAlgorithm algorithm = AllreduceAlgorithm::AUTO);
+
+enum class TransportKind
+{
+    SHARED_MEMORY,
+    SOCKET
+};
+
+struct DistributedOptions
+{
+    // Worker processes including this one; 0 means $MLANG_PROCESSES, else 1
+    int processes = 0;
+    TransportKind transport = TransportKind::SHARED_MEMORY;
+    AllreduceAlgorithm algorithm = AllreduceAlgorithm::AUTO;
+    // Gives every worker its own contiguous share of the allowed CPUs, which keeps it and the
+    // shard it copies on one NUMA node on the usual numbering
+    bool pin = true;
+};
+
+// Worker processes the options ask for
+int workerProcesses(const DistributedOptions &options);
+
+// Forks processes - 1 workers and calls body(transport) in every process, this one as rank 0,
+// each with its share of threadCount() threads. Returns when all are done; throws RuntimeError if
+// any worker failed or was killed by a signal, and the workers die with this process. The children exit without running destructors or atexit handlers, so call
+// it from the main thread while no kernel or CSVStream is running.
+void runWorkers(const DistributedOptions &options, const std::function<void(Transport &)> &body);
+
+inline namespace MLANG_STORAGE
+{
+// Full-batch gradient descent with the rows split between worker processes; every step sums the
+// workers' gradients with allreduce. Equal to the single-process linearRegressionTrain up to
+// rounding. linearRegressionTrain(data, labels, ...) calls this when $MLANG_PROCESSES is above 1.
+Vector linearRegressionTrain(const Matrix &data, const Vector &labels, double learningRate, int epochs,
+                             const DistributedOptions &options);
+}
+
+#endif
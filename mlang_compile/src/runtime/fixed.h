@@ -0,0 +1,209 @@
+#ifndef RUNTIME_FIXED_H
+#define RUNTIME_FIXED_H
+
+#include <algorithm>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "runtime.h"
+
+// Vectors and matrices whose extents are part of the MLang type, Vector<Float, 3> and
+// Matrix<Float, 2, 3>. The elements live inline, so a fixed value is a plain stack
+// object the compiler can keep in registers, and the kernels below expand into
+// straight-line code with no loop and no allocation. Sums keep the lane layout of
+// the dynamic kernels, so in a double build a fixed and a dynamic computation give
+// the same bits.
+//
+// A dynamic Vector or Matrix converts to a fixed type after an extent check, and a
+// fixed value converts back wherever only a dynamic kernel applies.
+
+namespace fixed
+{
+// Calls f(std::integral_constant<size_t, 0>{}) ... f(std::integral_constant<size_t, N - 1>{}) in order
+template <typename F, size_t... I>
+inline void unroll(F &&f, std::index_sequence<I...>)
+{
+    (f(std::integral_constant<size_t, I>{}), ...);
+}
+
+template <size_t N, typename F>
+inline void unroll(F &&f)
+{
+    unroll(f, std::make_index_sequence<N>{});
+}
+
+template <size_t Begin, size_t End>
+inline double pairwise(const double *lanes)
+{
+    if constexpr (End - Begin == 1)
+        return lanes[Begin];
+    else
+        return pairwise<Begin, (Begin + End) / 2>(lanes) + pairwise<(Begin + End) / 2, End>(lanes);
+}
+
+// Sum of term(i) for i < N: full groups of Lanes terms go to one lane each, the tail
+// to lane 0, and the lanes are added pairwise (the order of dotKernel and reduceSum)
+template <size_t Lanes, size_t N, typename Term>
+inline double lanedSum(Term term)
+{
+    double lanes[Lanes] = {};
+    unroll<N>([&](auto i)
+              {
+        constexpr size_t index = decltype(i)::value;
+        lanes[index < N / Lanes * Lanes ? index % Lanes : 0] += term(index); });
+    return pairwise<0, Lanes>(lanes);
+}
+
+inline std::string typeName(size_t rows, size_t cols)
+{
+    return cols == 0 ? "Vector<Float, " + std::to_string(rows) + ">"
+                     : "Matrix<Float, " + std::to_string(rows) + ", " + std::to_string(cols) + ">";
+}
+}
+
+template <size_t N>
+class FixedVector
+{
+public:
+    static_assert(N > 0, "Vector extents are positive");
+    double data[N] = {};
+
+    FixedVector() = default;
+    FixedVector(std::initializer_list<double> values)
+    {
+        if (values.size() != N)
+            throw RuntimeError(std::to_string(values.size()) + " values given for " + fixed::typeName(N, 0));
+        std::copy(values.begin(), values.end(), data);
+    }
+    FixedVector(const Vector &values)
+    {
+        if (values.size() != N)
+            throw RuntimeError("Vector of length " + std::to_string(values.size()) + " used as " + fixed::typeName(N, 0));
+        std::copy(values.data.begin(), values.data.end(), data);
+    }
+    operator Vector() const
+    {
+        Vector values(N);
+        std::copy(data, data + N, values.data.begin());
+        return values;
+    }
+
+    static constexpr size_t size() { return N; }
+    double &operator[](size_t i) { return data[i]; }
+    double operator[](size_t i) const { return data[i]; }
+};
+
+// Row-major like Matrix; rows and cols are compile-time constants
+template <size_t R, size_t C>
+class FixedMatrix
+{
+public:
+    static_assert(R > 0 && C > 0, "Matrix extents are positive");
+    static constexpr size_t rows = R;
+    static constexpr size_t cols = C;
+    double data[R * C] = {};
+
+    FixedMatrix() = default;
+    FixedMatrix(const Matrix &values)
+    {
+        if (values.rows != R || values.cols != C)
+            throw RuntimeError("Matrix of " + std::to_string(values.rows) + "x" + std::to_string(values.cols) +
+                               " used as " + fixed::typeName(R, C));
+        std::copy(values.data.begin(), values.data.end(), data);
+    }
+    operator Matrix() const
+    {
+        Matrix values(R, C);
+        std::copy(data, data + R * C, values.data.begin());
+        return values;
+    }
+
+    double &at(size_t row, size_t col) { return data[row * C + col]; }
+    double at(size_t row, size_t col) const { return data[row * C + col]; }
+    const double *row(size_t row) const { return data + row * C; }
+};
+
+// Same lanes as dot() for vectors of up to one reduction block
+template <size_t N>
+double operator*(const FixedVector<N> &x, const FixedVector<N> &y)
+{
+    if constexpr (N > static_cast<size_t>(REDUCTION_BLOCK))
+        return reduceSum(0, static_cast<long long>(N), [&](long long i)
+                         { return x[i] * y[i]; });
+    else
+        return fixed::lanedSum<8, N>([&](size_t i)
+                                     { return x[i] * y[i]; });
+}
+
+// Each row is summed like gemv's rows
+template <size_t R, size_t C>
+FixedVector<R> operator*(const FixedMatrix<R, C> &a, const FixedVector<C> &x)
+{
+    FixedVector<R> y;
+    fixed::unroll<R>([&](auto i)
+                     {
+        const double *row = a.row(decltype(i)::value);
+        y[decltype(i)::value] = fixed::lanedSum<4, C>([&](size_t j)
+                                                      { return row[j] * x[j]; }); });
+    return y;
+}
+
+template <size_t R, size_t C>
+FixedMatrix<C, R> transpose(const FixedMatrix<R, C> &a)
+{
+    FixedMatrix<C, R> t;
+    fixed::unroll<R * C>([&](auto k)
+                         {
+        constexpr size_t index = decltype(k)::value;
+        t.at(index % C, index / C) = a.data[index]; });
+    return t;
+}
+
+template <size_t N>
+FixedVector<N> operator*(double alpha, const FixedVector<N> &x)
+{
+    FixedVector<N> y;
+    fixed::unroll<N>([&](auto i)
+                     { y[i] = alpha * x[i]; });
+    return y;
+}
+
+template <size_t N>
+FixedVector<N> operator*(const FixedVector<N> &x, double alpha)
+{
+    return alpha * x;
+}
+
+// Multiplies by the reciprocal, as the dynamic operator does
+template <size_t N>
+FixedVector<N> operator/(const FixedVector<N> &x, double alpha)
+{
+    return (1.0 / alpha) * x;
+}
+
+template <size_t N>
+FixedVector<N> operator+(const FixedVector<N> &x, const FixedVector<N> &y)
+{
+    FixedVector<N> z;
+    fixed::unroll<N>([&](auto i)
+                     { z[i] = x[i] + y[i]; });
+    return z;
+}
+
+template <size_t N>
+FixedVector<N> operator-(const FixedVector<N> &x, const FixedVector<N> &y)
+{
+    FixedVector<N> z;
+    fixed::unroll<N>([&](auto i)
+                     { z[i] = x[i] - y[i]; });
+    return z;
+}
+
+template <size_t N>
+FixedVector<N> operator-(const FixedVector<N> &x)
+{
+    return -1.0 * x;
+}
+
+#endif
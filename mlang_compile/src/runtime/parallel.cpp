@@ -0,0 +1,200 @@
+#include "parallel.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+namespace
+{
+// Set while a thread executes pool tasks so nested parallel calls run inline instead of deadlocking
+thread_local bool insidePool = false;
+}
+
+ThreadPool::ThreadPool(int threads)
+{
+    for (int i = 1; i < threads; ++i)
+    {
+        workers.emplace_back([this]()
+                             { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::drain(std::unique_lock<std::mutex> &lock)
+{
+    while (nextTask < taskCount)
+    {
+        size_t task = nextTask++;
+        const auto *body = current;
+        lock.unlock();
+        insidePool = true;
+        try
+        {
+            (*body)(task);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> guard(errorMutex);
+            if (!error)
+                error = std::current_exception();
+        }
+        insidePool = false;
+        lock.lock();
+        if (++finishedTasks == taskCount)
+            done.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t seen = generation;
+    while (true)
+    {
+        wake.wait(lock, [&]()
+                  { return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+        drain(lock);
+    }
+}
+
+void ThreadPool::run(size_t tasks, const std::function<void(size_t)> &task)
+{
+    if (tasks == 0)
+        return;
+    if (workers.empty() || tasks == 1 || insidePool)
+    {
+        for (size_t i = 0; i < tasks; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> serial(runMutex);
+    std::unique_lock<std::mutex> lock(mutex);
+    current = &task;
+    error = nullptr;
+    taskCount = tasks;
+    nextTask = 0;
+    finishedTasks = 0;
+    ++generation;
+    wake.notify_all();
+    drain(lock);
+    done.wait(lock, [&]()
+              { return finishedTasks == taskCount; });
+    current = nullptr;
+    taskCount = 0;
+    if (error)
+        std::rethrow_exception(error);
+}
+
+namespace
+{
+int configuredThreads = 0;
+std::unique_ptr<ThreadPool> pool;
+std::mutex poolMutex;
+}
+
+void setThreadCount(int threads)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    configuredThreads = threads;
+    pool.reset();
+}
+
+int threadCount()
+{
+    if (configuredThreads > 0)
+        return configuredThreads;
+    if (const char *environment = std::getenv("MLANG_THREADS"))
+    {
+        int threads = std::atoi(environment);
+        if (threads > 0)
+            return threads;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool &threadPool()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (!pool)
+        pool = std::make_unique<ThreadPool>(threadCount());
+    return *pool;
+}
+
+void resetThreadPoolAfterFork(int threads)
+{
+    // Destroying it would join threads that only exist in the parent
+    pool.release();
+    configuredThreads = threads;
+}
+
+void parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body, size_t grain)
+{
+    if (end <= begin)
+        return;
+
+    size_t items = end - begin;
+    ThreadPool &workers = threadPool();
+    size_t chunks = std::min<size_t>(workers.size(), (items + grain - 1) / std::max<size_t>(grain, 1));
+    if (chunks <= 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    size_t chunkSize = (items + chunks - 1) / chunks;
+    workers.run(chunks, [&](size_t chunk)
+                {
+        size_t chunkBegin = begin + chunk * chunkSize;
+        size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+        if (chunkBegin < chunkEnd)
+            body(chunkBegin, chunkEnd); });
+}
+
+RangePlan::RangePlan(long long begin, long long end, Schedule schedule, size_t grain)
+    : begin(begin), end(end)
+{
+    if (end <= begin)
+        return;
+
+    unsigned long long items = static_cast<unsigned long long>(end - begin);
+    unsigned long long minimum = std::max<size_t>(grain, 1);
+    unsigned long long threads = threadCount();
+    // Dynamic scheduling oversubscribes so that a slow chunk does not hold up a whole thread's share
+    unsigned long long wanted = schedule == Schedule::DYNAMIC ? threads * 8 : threads;
+    unsigned long long count = std::max<unsigned long long>(1, std::min(wanted, items / minimum));
+    chunkSize = static_cast<long long>((items + count - 1) / count);
+    chunkCount = static_cast<size_t>((items + chunkSize - 1) / chunkSize);
+}
+
+void RangePlan::run(const std::function<void(size_t, long long, long long)> &body) const
+{
+    if (chunkCount == 0)
+        return;
+    if (chunkCount == 1)
+    {
+        body(0, begin, end);
+        return;
+    }
+    // The pool hands out task numbers in order as threads become free, which is what dynamic scheduling needs
+    threadPool().run(chunkCount, [&](size_t chunk)
+                     {
+        long long chunkBegin = begin + static_cast<long long>(chunk) * chunkSize;
+        body(chunk, chunkBegin, std::min(end, chunkBegin + chunkSize)); });
+}
@@ -0,0 +1,99 @@
+#ifndef RUNTIME_PARALLEL_H
+#define RUNTIME_PARALLEL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that execute one batch of tasks at a time
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Calls task(i) for i in [0, tasks), the calling thread takes part, returns when all are done.
+    // The first exception thrown by a task is rethrown here.
+    void run(size_t tasks, const std::function<void(size_t)> &task);
+    // Other callables are referenced rather than copied into the std::function, so a batch does not allocate
+    template <typename Task>
+    void run(size_t tasks, const Task &task)
+    {
+        run(tasks, std::function<void(size_t)>(std::cref(task)));
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    const std::function<void(size_t)> *current = nullptr;
+    size_t taskCount = 0;
+    size_t nextTask = 0;
+    size_t finishedTasks = 0;
+    size_t generation = 0;
+    bool stopping = false;
+
+    void workerLoop();
+    void drain(std::unique_lock<std::mutex> &lock);
+};
+
+// Number of threads used by runtime kernels; 0 selects $MLANG_THREADS, else std::thread::hardware_concurrency()
+void setThreadCount(int threads);
+int threadCount();
+ThreadPool &threadPool();
+// In a child after fork(), where the inherited pool's workers do not exist: abandons the pool
+// instead of joining it, and later kernels start a new one of `threads`
+void resetThreadPoolAfterFork(int threads);
+
+// Splits [begin, end) into contiguous chunks of at least `grain` items and runs body(chunkBegin, chunkEnd) in parallel
+void parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body, size_t grain = 1024);
+template <typename Body>
+void parallelFor(size_t begin, size_t end, const Body &body, size_t grain = 1024)
+{
+    parallelFor(begin, end, std::function<void(size_t, size_t)>(std::cref(body)), grain);
+}
+
+// Chunking policy of a parallel MLang for loop (mlangc --schedule)
+enum class Schedule
+{
+    // One contiguous chunk per thread, for loops whose iterations cost the same
+    STATIC,
+    // Several small chunks per thread claimed as threads become idle, for irregular bodies
+    DYNAMIC
+};
+
+// Iteration space [begin, end) of one parallelized loop. Chunks are numbered in
+// iteration order, so reductions that keep one partial per chunk and combine them
+// by chunk number get the same result on every run and thread count.
+class RangePlan
+{
+public:
+    RangePlan(long long begin, long long end, Schedule schedule, size_t grain = 1);
+
+    size_t chunks() const { return chunkCount; }
+    // Calls body(chunk, chunkBegin, chunkEnd) for every chunk on the thread pool
+    void run(const std::function<void(size_t, long long, long long)> &body) const;
+    template <typename Body>
+    void run(const Body &body) const
+    {
+        run(std::function<void(size_t, long long, long long)>(std::cref(body)));
+    }
+
+private:
+    long long begin;
+    long long end;
+    long long chunkSize = 0;
+    size_t chunkCount = 0;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include "pool.h"
+#include "profile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+
+namespace
+{
+const size_t ALIGNMENT = 64;
+const size_t HUGE_PAGE = size_t(2) << 20;
+const size_t SLAB_BYTES = size_t(4) << 20;
+// Classes up to 2^MAX_POWER bytes are pooled; larger requests are mapped and unmapped directly
+const unsigned MAX_POWER = 40;
+const size_t CLASS_COUNT = 4 + (MAX_POWER - 8) * 4;
+// Bytes of small blocks one thread keeps before handing freed blocks to the shared cache
+const size_t THREAD_CACHE_BYTES = size_t(8) << 20;
+
+// 64, 128, 192, 256, then 2^p + k 2^(p - 2) for k = 1 ... 4
+constexpr size_t classIndex(size_t bytes)
+{
+    if (bytes <= 256)
+        return bytes <= ALIGNMENT ? 0 : (bytes - 1) / ALIGNMENT;
+    unsigned p = 63 - __builtin_clzll(bytes - 1);
+    return 4 + (p - 8) * 4 + (bytes - 1 - (size_t(1) << p)) / (size_t(1) << (p - 2));
+}
+
+constexpr size_t classSize(size_t index)
+{
+    if (index < 4)
+        return (index + 1) * ALIGNMENT;
+    unsigned p = 8 + (index - 4) / 4;
+    return (size_t(1) << p) + ((index - 4) % 4 + 1) * (size_t(1) << (p - 2));
+}
+
+// Classes below SLAB_CLASSES are carved from slabs and cached per thread
+const size_t SLAB_CLASSES = classIndex(size_t(512) << 10) + 1;
+
+size_t blockSize(size_t bytes, size_t index)
+{
+    return index < CLASS_COUNT ? classSize(index) : (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+}
+
+// Maps size bytes; from a huge page on, the block starts on a huge-page boundary and asks for THP
+void *mapBlock(size_t size)
+{
+    bool huge = size >= HUGE_PAGE;
+    size_t length = huge ? size + HUGE_PAGE : size;
+    void *mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+        throw std::bad_alloc();
+    char *block = static_cast<char *>(mapped);
+    if (huge)
+    {
+        char *aligned = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(block) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1));
+        if (aligned > block)
+            munmap(block, aligned - block);
+        if (block + length > aligned + size)
+            munmap(aligned + size, block + length - (aligned + size));
+        block = aligned;
+#ifdef MADV_HUGEPAGE
+        madvise(block, size, MADV_HUGEPAGE);
+#endif
+    }
+    return block;
+}
+
+struct SharedCache
+{
+    std::mutex mutex;
+    std::vector<void *> blocks[CLASS_COUNT];
+    // Uncarved end of the current slab
+    char *slab = nullptr;
+    size_t slabLeft = 0;
+    // Bytes of mapped blocks held in blocks, at most cacheLimit; slab blocks are always kept
+    size_t cachedBytes = 0;
+    size_t cacheLimit = size_t(1024) << 20;
+    bool enabled = true;
+
+    std::atomic<uint64_t> liveBytes{0};
+    std::atomic<uint64_t> peakBytes{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> hits{0};
+
+    // Takes size bytes from the current slab; the tail of a used-up slab is split into
+    // blocks of smaller classes rather than dropped. Called with mutex held.
+    void *carve(size_t size)
+    {
+        if (slabLeft < size)
+        {
+            while (slabLeft >= ALIGNMENT)
+            {
+                size_t index = classIndex(slabLeft);
+                if (classSize(index) > slabLeft)
+                    --index;
+                blocks[index].push_back(slab);
+                slab += classSize(index);
+                slabLeft -= classSize(index);
+            }
+            slab = static_cast<char *>(mapBlock(SLAB_BYTES));
+            slabLeft = SLAB_BYTES;
+        }
+        void *block = slab;
+        slab += size;
+        slabLeft -= size;
+        return block;
+    }
+};
+
+SharedCache &shared()
+{
+    // Never destroyed: static Vectors may free their buffers after this file's destructors ran
+    static SharedCache *cache = []
+    {
+        SharedCache *cache = new SharedCache;
+        if (const char *environment = std::getenv("MLANG_POOL"))
+            cache->enabled = std::strcmp(environment, "off") != 0;
+        if (const char *environment = std::getenv("MLANG_POOL_CACHE"))
+            cache->cacheLimit = static_cast<size_t>(std::strtoull(environment, nullptr, 10)) << 20;
+        return cache;
+    }();
+    return *cache;
+}
+
+// Small blocks freed by this thread; they go back to the shared cache when the thread exits
+struct ThreadCache
+{
+    std::vector<void *> blocks[SLAB_CLASSES];
+    size_t bytes = 0;
+
+    ~ThreadCache();
+};
+
+// Set once the thread's cache is destroyed, so buffers freed later in thread exit bypass it
+thread_local bool threadCacheGone = false;
+
+ThreadCache *threadCache()
+{
+    if (threadCacheGone)
+        return nullptr;
+    thread_local ThreadCache cache;
+    return &cache;
+}
+
+ThreadCache::~ThreadCache()
+{
+    SharedCache &pool = shared();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    for (size_t index = 0; index < SLAB_CLASSES; ++index)
+    {
+        pool.blocks[index].insert(pool.blocks[index].end(), blocks[index].begin(), blocks[index].end());
+    }
+    threadCacheGone = true;
+}
+
+void record(SharedCache &pool, size_t size, bool hit)
+{
+    uint64_t live = pool.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = pool.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !pool.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+    pool.allocations.fetch_add(1, std::memory_order_relaxed);
+    if (hit)
+        pool.hits.fetch_add(1, std::memory_order_relaxed);
+}
+
+void appendCounters(std::vector<ProfileCounter> &counters)
+{
+    PoolStats stats = poolStats();
+    counters.push_back({"pool.live_bytes", stats.liveBytes});
+    counters.push_back({"pool.peak_bytes", stats.peakBytes});
+    counters.push_back({"pool.allocations", stats.allocations});
+    counters.push_back({"pool.hits", stats.hits});
+}
+
+const bool countersRegistered = (addProfileCounters(appendCounters), true);
+}
+
+void *poolAllocate(size_t bytes)
+{
+    SharedCache &pool = shared();
+    bytes = std::max<size_t>(bytes, 1);
+    size_t index = classIndex(bytes);
+    size_t size = blockSize(bytes, index);
+    void *block = nullptr;
+    bool hit = false;
+
+    if (!pool.enabled)
+        block = ::operator new(size, std::align_val_t(ALIGNMENT));
+    else if (index < CLASS_COUNT)
+    {
+        ThreadCache *cache = index < SLAB_CLASSES ? threadCache() : nullptr;
+        if (cache && !cache->blocks[index].empty())
+        {
+            block = cache->blocks[index].back();
+            cache->blocks[index].pop_back();
+            cache->bytes -= size;
+            hit = true;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (!pool.blocks[index].empty())
+            {
+                block = pool.blocks[index].back();
+                pool.blocks[index].pop_back();
+                if (index >= SLAB_CLASSES)
+                    pool.cachedBytes -= size;
+                hit = true;
+            }
+            else if (index < SLAB_CLASSES)
+                block = pool.carve(size);
+        }
+    }
+    if (!block)
+        block = mapBlock(size);
+
+    record(pool, size, hit);
+    return block;
+}
+
+void poolFree(void *pointer, size_t bytes)
+{
+    if (!pointer)
+        return;
+    SharedCache &pool = shared();
+    bytes = std::max<size_t>(bytes, 1);
+    size_t index = classIndex(bytes);
+    size_t size = blockSize(bytes, index);
+    pool.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+
+    if (!pool.enabled)
+    {
+        ::operator delete(pointer, std::align_val_t(ALIGNMENT));
+        return;
+    }
+    if (index < SLAB_CLASSES)
+    {
+        ThreadCache *cache = threadCache();
+        if (cache && cache->bytes + size <= THREAD_CACHE_BYTES)
+        {
+            cache->blocks[index].push_back(pointer);
+            cache->bytes += size;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.blocks[index].push_back(pointer);
+        return;
+    }
+    if (index < CLASS_COUNT)
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (pool.cachedBytes + size <= pool.cacheLimit)
+        {
+            pool.blocks[index].push_back(pointer);
+            pool.cachedBytes += size;
+            return;
+        }
+    }
+    munmap(pointer, size);
+}
+
+PoolStats poolStats()
+{
+    SharedCache &pool = shared();
+    PoolStats stats;
+    stats.liveBytes = pool.liveBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = pool.peakBytes.load(std::memory_order_relaxed);
+    stats.allocations = pool.allocations.load(std::memory_order_relaxed);
+    stats.hits = pool.hits.load(std::memory_order_relaxed);
+    return stats;
+}
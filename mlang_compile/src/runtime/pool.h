@@ -0,0 +1,62 @@
+#ifndef RUNTIME_POOL_H
+#define RUNTIME_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Size-class pool behind Vector and Matrix storage. A training loop frees and
+// reallocates buffers of the same few sizes every epoch; served from malloc, each
+// multi-megabyte buffer is a fresh mmap, munmap and a round of page faults.
+//
+// Requests are rounded up to a class: multiples of 64 bytes up to 256, then four
+// classes per power of two. Every block is 64-byte aligned. Classes up to 512 KiB are
+// carved from 4 MiB slabs; larger ones are mapped one by one, 2 MiB-aligned from 2 MiB
+// on. Slabs and large blocks are marked MADV_HUGEPAGE. A freed block goes to a cache
+// of the freeing thread (small classes) or to a shared cache, and the next request
+// of its class takes it back without touching the kernel.
+//
+// $MLANG_POOL_CACHE caps the bytes of large blocks kept for reuse (MiB, default 1024);
+// $MLANG_POOL=off sends every request to aligned operator new, e.g. for sanitizers.
+
+struct PoolStats
+{
+    // Bytes of the size classes handed out and not yet freed, and their maximum
+    uint64_t liveBytes = 0;
+    uint64_t peakBytes = 0;
+    uint64_t allocations = 0;
+    // Allocations served from a cache rather than from new memory
+    uint64_t hits = 0;
+
+    double hitRate() const { return allocations > 0 ? static_cast<double>(hits) / allocations : 0.0; }
+};
+
+void *poolAllocate(size_t bytes);
+// bytes must be the size passed to poolAllocate
+void poolFree(void *pointer, size_t bytes);
+PoolStats poolStats();
+
+// Standard allocator over the pool; all instances are interchangeable
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(poolAllocate(n * sizeof(T))); }
+    void deallocate(T *pointer, size_t n) { poolFree(pointer, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
+
+template <typename T>
+using PoolVector = std::vector<T, PoolAllocator<T>>;
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef RUNTIME_PRECISION_H
+#define RUNTIME_PRECISION_H
+
+// Element type of Vector and Matrix storage. Building a program and the runtime with
+// -DMLANG_FLOAT32 stores arrays as float, halving their memory and bandwidth and
+// doubling the SIMD width of the kernels (mlangc --float32 emits code that requires it).
+// Dot products, matrix products and sums still accumulate in double unless
+// -DMLANG_ACCUMULATE_FLOAT32 is also given (mlangc --accumulate float32).
+#ifdef MLANG_FLOAT32
+using Real = float;
+#define MLANG_STORAGE float32
+#else
+using Real = double;
+#define MLANG_STORAGE float64
+#endif
+
+#if defined(MLANG_FLOAT32) && defined(MLANG_ACCUMULATE_FLOAT32)
+using Accumulator = float;
+#else
+using Accumulator = double;
+#endif
+
+#endif
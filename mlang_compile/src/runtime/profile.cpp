@@ -0,0 +1,287 @@
+#include "profile.h"
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+const char MAGIC[] = "MLPF";
+const uint32_t VERSION = 2;
+// Profiles without counters, as written by the Python prelude
+const uint32_t REGIONS_ONLY_VERSION = 1;
+
+template <typename T>
+void writeLittleEndian(std::string &out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out += static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff);
+    }
+}
+
+template <typename T>
+T readLittleEndian(const std::string &in, size_t &pos)
+{
+    if (in.size() - pos < sizeof(T))
+    {
+        throw std::runtime_error("Truncated profile");
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in[pos++])) << (8 * i);
+    }
+    return static_cast<T>(value);
+}
+}
+
+// Live counters of one region; instrumented code holds a pointer, so hot paths never touch the registry
+struct RegionCounters
+{
+    RegionKind kind = RegionKind::FUNCTION;
+    uint32_t line = 0;
+    std::string name;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> iterations{0};
+    std::atomic<uint64_t> nanoseconds{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+namespace
+{
+std::atomic<bool> enabled{false};
+std::mutex registryMutex;
+// A deque keeps the counters' addresses stable while more regions are registered
+std::deque<RegionCounters> registry;
+std::string outputPath;
+thread_local RegionCounters *currentRegion = nullptr;
+
+std::vector<void (*)(std::vector<ProfileCounter> &)> &counterSources()
+{
+    static std::vector<void (*)(std::vector<ProfileCounter> &)> sources;
+    return sources;
+}
+}
+
+const ProfileRegion *Profile::find(RegionKind kind, const std::string &name, uint32_t line) const
+{
+    const ProfileRegion *byName = nullptr;
+    for (const auto &region : regions)
+    {
+        if (region.kind != kind || region.name != name)
+            continue;
+        if (region.line == line)
+            return &region;
+        // Edits above the region move it; fall back to the name alone
+        byName = byName ? byName : &region;
+    }
+    return byName;
+}
+
+const ProfileCounter *Profile::counter(const std::string &name) const
+{
+    for (const auto &counter : counters)
+    {
+        if (counter.name == name)
+            return &counter;
+    }
+    return nullptr;
+}
+
+uint64_t Profile::totalNanoseconds() const
+{
+    // Times are inclusive, so the outermost function (normally main) bounds the run
+    uint64_t total = 0;
+    for (const auto &region : regions)
+    {
+        if (region.kind == RegionKind::FUNCTION && region.nanoseconds > total)
+            total = region.nanoseconds;
+    }
+    return total;
+}
+
+bool Profile::writeToFile(const std::string &path) const
+{
+    std::string out(MAGIC, 4);
+    writeLittleEndian<uint32_t>(out, VERSION);
+    writeLittleEndian<uint32_t>(out, static_cast<uint32_t>(regions.size()));
+    for (const auto &region : regions)
+    {
+        writeLittleEndian<uint8_t>(out, static_cast<uint8_t>(region.kind));
+        writeLittleEndian<uint32_t>(out, region.line);
+        writeLittleEndian<uint16_t>(out, static_cast<uint16_t>(region.name.size()));
+        out.append(region.name, 0, static_cast<uint16_t>(region.name.size()));
+        writeLittleEndian<uint64_t>(out, region.count);
+        writeLittleEndian<uint64_t>(out, region.iterations);
+        writeLittleEndian<uint64_t>(out, region.nanoseconds);
+        writeLittleEndian<uint64_t>(out, region.bytes);
+    }
+    writeLittleEndian<uint32_t>(out, static_cast<uint32_t>(counters.size()));
+    for (const auto &counter : counters)
+    {
+        writeLittleEndian<uint16_t>(out, static_cast<uint16_t>(counter.name.size()));
+        out.append(counter.name, 0, static_cast<uint16_t>(counter.name.size()));
+        writeLittleEndian<uint64_t>(out, counter.value);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    file.write(out.data(), out.size());
+    return static_cast<bool>(file);
+}
+
+Profile Profile::readFromFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Error opening profile: " + path);
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    std::string in = buffer.str();
+
+    if (in.compare(0, 4, MAGIC) != 0)
+    {
+        throw std::runtime_error("Not an MLang profile: " + path);
+    }
+    size_t pos = 4;
+    uint32_t version = readLittleEndian<uint32_t>(in, pos);
+    if (version != VERSION && version != REGIONS_ONLY_VERSION)
+    {
+        throw std::runtime_error("Unsupported profile version: " + path);
+    }
+
+    Profile profile;
+    uint32_t count = readLittleEndian<uint32_t>(in, pos);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ProfileRegion region;
+        region.kind = static_cast<RegionKind>(readLittleEndian<uint8_t>(in, pos));
+        region.line = readLittleEndian<uint32_t>(in, pos);
+        uint16_t nameLength = readLittleEndian<uint16_t>(in, pos);
+        if (in.size() - pos < nameLength)
+        {
+            throw std::runtime_error("Truncated profile");
+        }
+        region.name = in.substr(pos, nameLength);
+        pos += nameLength;
+        region.count = readLittleEndian<uint64_t>(in, pos);
+        region.iterations = readLittleEndian<uint64_t>(in, pos);
+        region.nanoseconds = readLittleEndian<uint64_t>(in, pos);
+        region.bytes = readLittleEndian<uint64_t>(in, pos);
+        profile.regions.push_back(region);
+    }
+    if (version == REGIONS_ONLY_VERSION)
+        return profile;
+
+    uint32_t counterCount = readLittleEndian<uint32_t>(in, pos);
+    for (uint32_t i = 0; i < counterCount; ++i)
+    {
+        ProfileCounter counter;
+        uint16_t nameLength = readLittleEndian<uint16_t>(in, pos);
+        if (in.size() - pos < nameLength)
+        {
+            throw std::runtime_error("Truncated profile");
+        }
+        counter.name = in.substr(pos, nameLength);
+        pos += nameLength;
+        counter.value = readLittleEndian<uint64_t>(in, pos);
+        profile.counters.push_back(counter);
+    }
+    return profile;
+}
+
+void enableProfiling(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    outputPath = path;
+    if (!enabled.exchange(true))
+    {
+        std::atexit(writeProfile);
+    }
+}
+
+bool profilingEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+RegionCounters *profileRegion(RegionKind kind, const std::string &name, uint32_t line)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.emplace_back();
+    RegionCounters &region = registry.back();
+    region.kind = kind;
+    region.line = line;
+    region.name = name;
+    return &region;
+}
+
+void profileBytes(uint64_t bytes)
+{
+    if (!profilingEnabled() || currentRegion == nullptr)
+        return;
+    currentRegion->bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void addProfileCounters(void (*source)(std::vector<ProfileCounter> &counters))
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    counterSources().push_back(source);
+}
+
+void writeProfile()
+{
+    Profile profile;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        path = outputPath;
+        for (const auto &counters : registry)
+        {
+            ProfileRegion region;
+            region.kind = counters.kind;
+            region.line = counters.line;
+            region.name = counters.name;
+            region.count = counters.count.load();
+            region.iterations = counters.iterations.load();
+            region.nanoseconds = counters.nanoseconds.load();
+            region.bytes = counters.bytes.load();
+            profile.regions.push_back(region);
+        }
+        for (auto source : counterSources())
+        {
+            source(profile.counters);
+        }
+    }
+    if (!path.empty())
+    {
+        profile.writeToFile(path);
+    }
+}
+
+ProfileScope::ProfileScope(RegionCounters *region, uint64_t iterations)
+    : region(region), parent(currentRegion), active(profilingEnabled())
+{
+    if (!active)
+        return;
+    region->count.fetch_add(1, std::memory_order_relaxed);
+    region->iterations.fetch_add(iterations, std::memory_order_relaxed);
+    currentRegion = region;
+    start = std::chrono::steady_clock::now();
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (!active)
+        return;
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    region->nanoseconds.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+    currentRegion = parent;
+}
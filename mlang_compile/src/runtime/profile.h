@@ -0,0 +1,92 @@
+#ifndef RUNTIME_PROFILE_H
+#define RUNTIME_PROFILE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Profile of an instrumented MLang program (mlangc --instrument). Both the Python
+// prelude and the native runtime write the same little-endian file:
+//   "MLPF" u32 version u32 region-count
+//   region-count x (u8 kind, u32 source-line, u16 name-length, name,
+//                   u64 count, u64 iterations, u64 nanoseconds, u64 bytes)
+// Version 2 (native runtime) appends process-wide counters such as the pool allocator's:
+//   u32 counter-count, counter-count x (u16 name-length, name, u64 value)
+// A FUNCTION region counts calls, a LOOP region counts loop entries and the
+// iterations they scheduled. Time is inclusive of nested regions.
+
+enum class RegionKind : uint8_t
+{
+    FUNCTION = 0,
+    LOOP = 1
+};
+
+struct ProfileRegion
+{
+    RegionKind kind = RegionKind::FUNCTION;
+    uint32_t line = 0;
+    // Function name, or "function/loopVariable" for loops
+    std::string name;
+    uint64_t count = 0;
+    uint64_t iterations = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t bytes = 0;
+};
+
+struct ProfileCounter
+{
+    std::string name;
+    uint64_t value = 0;
+};
+
+class Profile
+{
+public:
+    std::vector<ProfileRegion> regions;
+    std::vector<ProfileCounter> counters;
+
+    // Returns nullptr if the region was not recorded
+    const ProfileRegion *find(RegionKind kind, const std::string &name, uint32_t line) const;
+    // Returns nullptr if the counter was not recorded
+    const ProfileCounter *counter(const std::string &name) const;
+    uint64_t totalNanoseconds() const;
+
+    bool writeToFile(const std::string &path) const;
+    // Throws std::runtime_error if the file is missing or not a profile
+    static Profile readFromFile(const std::string &path);
+};
+
+struct RegionCounters;
+
+// Process-wide recorder used by native instrumented code. Until enableProfiling()
+// is called every counter update is a single branch.
+void enableProfiling(const std::string &path);
+bool profilingEnabled();
+// Registers a region once (typically from a function-local static); the counters live until exit
+RegionCounters *profileRegion(RegionKind kind, const std::string &name, uint32_t line);
+// Adds bytes read and written by a Vector/Matrix kernel to the innermost active region
+void profileBytes(uint64_t bytes);
+// Registers a function that appends its counters each time the profile is written; safe from static initializers
+void addProfileCounters(void (*source)(std::vector<ProfileCounter> &counters));
+// Writes the collected profile to the path given to enableProfiling()
+void writeProfile();
+
+// Times one function call or loop execution, making it the innermost region meanwhile
+class ProfileScope
+{
+public:
+    ProfileScope(RegionCounters *region, uint64_t iterations = 0);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    RegionCounters *region;
+    RegionCounters *parent;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
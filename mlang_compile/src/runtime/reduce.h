@@ -0,0 +1,88 @@
+#ifndef RUNTIME_REDUCE_H
+#define RUNTIME_REDUCE_H
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+// Reductions of term(i) over i in [begin, end), the kernels behind vectorized MLang
+// reduction loops. Each leaf block of REDUCTION_BLOCK terms is folded into eight
+// independent lanes, which the compiler keeps in SIMD registers, and leaves are
+// combined pairwise. Sums therefore have O(log n) rounding error growth instead of
+// O(n), and the order of operations depends only on the range, not on the caller.
+
+const long long REDUCTION_BLOCK = 256;
+
+namespace reduction
+{
+template <typename T, typename Term, typename Combine>
+T leaf(long long begin, long long end, Term &term, T identity, Combine combine)
+{
+    T lanes[8] = {identity, identity, identity, identity, identity, identity, identity, identity};
+    long long i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            lanes[lane] = combine(lanes[lane], term(i + lane));
+        }
+    }
+    for (; i < end; ++i)
+    {
+        lanes[0] = combine(lanes[0], term(i));
+    }
+    return combine(combine(combine(lanes[0], lanes[1]), combine(lanes[2], lanes[3])),
+                   combine(combine(lanes[4], lanes[5]), combine(lanes[6], lanes[7])));
+}
+
+template <typename T, typename Term, typename Combine>
+T tree(long long begin, long long end, Term &term, T identity, Combine combine)
+{
+    if (end - begin <= REDUCTION_BLOCK)
+        return leaf(begin, end, term, identity, combine);
+    // Split on a block boundary so that every leaf but the last is full
+    long long blocks = (end - begin + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+    long long middle = begin + (blocks / 2) * REDUCTION_BLOCK;
+    return combine(tree(begin, middle, term, identity, combine), tree(middle, end, term, identity, combine));
+}
+
+template <typename Term>
+using Value = std::decay_t<decltype(std::declval<Term &>()(0LL))>;
+}
+
+template <typename Term>
+reduction::Value<Term> reduceSum(long long begin, long long end, Term term)
+{
+    using T = reduction::Value<Term>;
+    return reduction::tree<T>(begin, end, term, T(0), [](T a, T b)
+                              { return a + b; });
+}
+
+template <typename Term>
+reduction::Value<Term> reduceProduct(long long begin, long long end, Term term)
+{
+    using T = reduction::Value<Term>;
+    return reduction::tree<T>(begin, end, term, T(1), [](T a, T b)
+                              { return a * b; });
+}
+
+// An empty range yields the identity, +inf (or the largest integer) for min and its negation for max
+template <typename Term>
+reduction::Value<Term> reduceMin(long long begin, long long end, Term term)
+{
+    using T = reduction::Value<Term>;
+    T identity = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+    return reduction::tree<T>(begin, end, term, identity, [](T a, T b)
+                              { return std::min(a, b); });
+}
+
+template <typename Term>
+reduction::Value<Term> reduceMax(long long begin, long long end, Term term)
+{
+    using T = reduction::Value<Term>;
+    T identity = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+    return reduction::tree<T>(begin, end, term, identity, [](T a, T b)
+                              { return std::max(a, b); });
+}
+
+#endif
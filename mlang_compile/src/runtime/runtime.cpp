@@ -0,0 +1,1542 @@
+#include "runtime.h"
+#include "distributed.h"
+#include "profile.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+inline namespace MLANG_STORAGE
+{
+namespace
+{
+// Row-block size for matrix kernels; big enough to amortize scheduling, small enough to balance load
+const size_t rowGrain = 64;
+// Sparse rows hold a few dozen nonzeros, so blocks need many more of them
+const size_t sparseRowGrain = 1024;
+
+Accumulator dotKernel(const Real *x, const Real *y, size_t n)
+{
+    Accumulator s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        s0 += static_cast<Accumulator>(x[i]) * y[i];
+        s1 += static_cast<Accumulator>(x[i + 1]) * y[i + 1];
+        s2 += static_cast<Accumulator>(x[i + 2]) * y[i + 2];
+        s3 += static_cast<Accumulator>(x[i + 3]) * y[i + 3];
+    }
+    for (; i < n; ++i)
+    {
+        s0 += static_cast<Accumulator>(x[i]) * y[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+void checkShape(bool ok, const std::string &kernel)
+{
+    if (!ok)
+        throw RuntimeError("Shape mismatch in " + kernel);
+}
+
+// Adds rows [begin, end) of A B to out, one row of B's width per row of A, summing in Out
+template <typename Out>
+void gemmRows(const Matrix &a, const Matrix &b, size_t begin, size_t end, Out *out)
+{
+    const size_t depthBlock = 256;
+    for (size_t kk = 0; kk < a.cols; kk += depthBlock)
+    {
+        size_t kEnd = std::min(a.cols, kk + depthBlock);
+        for (size_t i = begin; i < end; ++i)
+        {
+            Out *outRow = out + (i - begin) * b.cols;
+            const Real *left = a.row(i);
+            for (size_t k = kk; k < kEnd; ++k)
+            {
+                Out scale = left[k];
+                const Real *right = b.row(k);
+                for (size_t j = 0; j < b.cols; ++j)
+                {
+                    outRow[j] += scale * right[j];
+                }
+            }
+        }
+    }
+}
+}
+
+void gemv(const Matrix &a, const Vector &x, Vector &y)
+{
+    checkShape(a.cols == x.size(), "gemv");
+    profileBytes((a.data.size() + x.size() + a.rows) * sizeof(Real));
+    y.data.resize(a.rows);
+    parallelFor(0, a.rows, [&](size_t begin, size_t end)
+                {
+        for (size_t i = begin; i < end; ++i)
+        {
+            y[i] = dotKernel(a.row(i), x.data.data(), a.cols);
+        } }, rowGrain);
+}
+
+void gemvTransposed(const Matrix &a, const Vector &x, Vector &y)
+{
+    checkShape(a.rows == x.size(), "gemvTransposed");
+    profileBytes((a.data.size() + x.size() + a.cols) * sizeof(Real));
+    ThreadPool &workers = threadPool();
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(workers.size(), a.rows / rowGrain));
+    size_t chunkSize = (a.rows + chunks - 1) / chunks;
+
+    // Each chunk accumulates its rows into a private partial sum, the partials are then reduced by column.
+    // The partials are kept per calling thread, so repeated calls of the same shape do not allocate.
+    thread_local std::vector<std::vector<Accumulator>> partials;
+    partials.resize(chunks);
+    for (auto &partial : partials)
+    {
+        partial.assign(a.cols, 0);
+    }
+    workers.run(chunks, [&](size_t chunk)
+                {
+        Accumulator *partial = partials[chunk].data();
+        size_t end = std::min(a.rows, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i)
+        {
+            const Real *row = a.row(i);
+            Accumulator xi = x[i];
+            for (size_t j = 0; j < a.cols; ++j)
+            {
+                partial[j] += row[j] * xi;
+            }
+        } });
+
+    y.data.resize(a.cols);
+    parallelFor(0, a.cols, [&](size_t begin, size_t end)
+                {
+        for (size_t j = begin; j < end; ++j)
+        {
+            Accumulator total = 0;
+            for (const auto &partial : partials)
+            {
+                total += partial[j];
+            }
+            y[j] = static_cast<Real>(total);
+        } });
+}
+
+void gemm(const Matrix &a, const Matrix &b, Matrix &c)
+{
+    checkShape(a.cols == b.rows, "gemm");
+    profileBytes((a.data.size() + b.data.size() + a.rows * b.cols) * sizeof(Real));
+    c.rows = a.rows;
+    c.cols = b.cols;
+    c.data.assign(a.rows * b.cols, 0);
+    c.stats.reset();
+
+    parallelFor(0, a.rows, [&](size_t begin, size_t end)
+                {
+        if constexpr (std::is_same<Accumulator, Real>::value)
+        {
+            gemmRows(a, b, begin, end, c.row(begin));
+        }
+        else
+        {
+            // Wider accumulators: sum the rows in a scratch block and round once
+            std::vector<Accumulator> rows((end - begin) * b.cols, 0);
+            gemmRows(a, b, begin, end, rows.data());
+            std::copy(rows.begin(), rows.end(), c.row(begin));
+        } }, 16);
+}
+
+void axpy(double alpha, const Vector &x, Vector &y)
+{
+    checkShape(x.size() == y.size(), "axpy");
+    profileBytes(3 * x.size() * sizeof(Real));
+    parallelFor(0, x.size(), [&](size_t begin, size_t end)
+                {
+        for (size_t i = begin; i < end; ++i)
+        {
+            y[i] += alpha * x[i];
+        } }, 1 << 15);
+}
+
+void scale(double alpha, const Vector &x, Vector &y)
+{
+    profileBytes(2 * x.size() * sizeof(Real));
+    y.data.resize(x.size());
+    parallelFor(0, x.size(), [&](size_t begin, size_t end)
+                {
+        for (size_t i = begin; i < end; ++i)
+        {
+            y[i] = alpha * x[i];
+        } }, 1 << 15);
+}
+
+void add(const Vector &x, const Vector &y, Vector &z)
+{
+    checkShape(x.size() == y.size(), "add");
+    profileBytes(3 * x.size() * sizeof(Real));
+    z.data.resize(x.size());
+    parallelFor(0, x.size(), [&](size_t begin, size_t end)
+                {
+        for (size_t i = begin; i < end; ++i)
+        {
+            z[i] = x[i] + y[i];
+        } }, 1 << 15);
+}
+
+void subtract(const Vector &x, const Vector &y, Vector &z)
+{
+    checkShape(x.size() == y.size(), "subtract");
+    profileBytes(3 * x.size() * sizeof(Real));
+    z.data.resize(x.size());
+    parallelFor(0, x.size(), [&](size_t begin, size_t end)
+                {
+        for (size_t i = begin; i < end; ++i)
+        {
+            z[i] = x[i] - y[i];
+        } }, 1 << 15);
+}
+
+void spmv(const SparseMatrix &a, const Vector &x, Vector &y)
+{
+    checkShape(a.cols == x.size(), "spmv");
+    profileBytes(a.nonzeros() * (sizeof(Real) + sizeof(uint32_t)) + a.rowStart.size() * sizeof(size_t) +
+                 (x.size() + a.rows) * sizeof(Real));
+    y.data.resize(a.rows);
+    parallelFor(0, a.rows, [&](size_t begin, size_t end)
+                {
+        const uint32_t *columns = a.columns.data();
+        const Real *values = a.values.data();
+        for (size_t i = begin; i < end; ++i)
+        {
+            Accumulator total = 0;
+            for (size_t k = a.rowStart[i]; k < a.rowStart[i + 1]; ++k)
+            {
+                total += static_cast<Accumulator>(values[k]) * x[columns[k]];
+            }
+            y[i] = static_cast<Real>(total);
+        } }, sparseRowGrain);
+}
+
+void spmvTransposed(const SparseMatrix &a, const Vector &x, Vector &y)
+{
+    checkShape(a.rows == x.size(), "spmvTransposed");
+    profileBytes(a.nonzeros() * (sizeof(Real) + sizeof(uint32_t)) + a.rowStart.size() * sizeof(size_t) +
+                 (x.size() + a.cols) * sizeof(Real));
+    ThreadPool &workers = threadPool();
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(workers.size(), a.rows / sparseRowGrain));
+    size_t chunkSize = (a.rows + chunks - 1) / chunks;
+
+    thread_local std::vector<std::vector<Accumulator>> partials;
+    partials.resize(chunks);
+    for (auto &partial : partials)
+    {
+        partial.assign(a.cols, 0);
+    }
+    workers.run(chunks, [&](size_t chunk)
+                {
+        Accumulator *partial = partials[chunk].data();
+        const uint32_t *columns = a.columns.data();
+        const Real *values = a.values.data();
+        size_t end = std::min(a.rows, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i)
+        {
+            Accumulator xi = x[i];
+            for (size_t k = a.rowStart[i]; k < a.rowStart[i + 1]; ++k)
+            {
+                partial[columns[k]] += values[k] * xi;
+            }
+        } });
+
+    y.data.resize(a.cols);
+    parallelFor(0, a.cols, [&](size_t begin, size_t end)
+                {
+        for (size_t j = begin; j < end; ++j)
+        {
+            Accumulator total = 0;
+            for (const auto &partial : partials)
+            {
+                total += partial[j];
+            }
+            y[j] = static_cast<Real>(total);
+        } });
+}
+
+double dot(const Vector &x, const Vector &y)
+{
+    checkShape(x.size() == y.size(), "dot");
+    profileBytes(2 * x.size() * sizeof(Real));
+    const Real *xs = x.data.data();
+    const Real *ys = y.data.data();
+    return reduceSum(0, static_cast<long long>(x.size()), [xs, ys](long long i)
+                     { return static_cast<Accumulator>(xs[i]) * ys[i]; });
+}
+
+double sum(const Vector &x)
+{
+    profileBytes(x.size() * sizeof(Real));
+    const Real *xs = x.data.data();
+    return reduceSum(0, static_cast<long long>(x.size()), [xs](long long i)
+                     { return static_cast<Accumulator>(xs[i]); });
+}
+
+double minimum(double a, double b)
+{
+    return std::min(a, b);
+}
+
+double maximum(double a, double b)
+{
+    return std::max(a, b);
+}
+
+TransposedMatrix::operator Matrix() const
+{
+    Matrix result(matrix.cols, matrix.rows);
+    for (size_t i = 0; i < matrix.rows; ++i)
+    {
+        for (size_t j = 0; j < matrix.cols; ++j)
+        {
+            result.at(j, i) = matrix.at(i, j);
+        }
+    }
+    return result;
+}
+
+SparseMatrix SparseMatrix::transposed() const
+{
+    if (rows > UINT32_MAX)
+        throw RuntimeError("Cannot transpose a sparse matrix with more than 2^32 - 1 rows");
+    // Counting sort by column: count each column, turn the counts into row starts, then place the entries
+    SparseMatrix t(cols, rows);
+    for (uint32_t column : columns)
+    {
+        ++t.rowStart[column + 1];
+    }
+    for (size_t j = 0; j < cols; ++j)
+    {
+        t.rowStart[j + 1] += t.rowStart[j];
+    }
+    t.columns.resize(nonzeros());
+    t.values.resize(nonzeros());
+    std::vector<size_t> next(t.rowStart.begin(), t.rowStart.end() - 1);
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t k = rowStart[i]; k < rowStart[i + 1]; ++k)
+        {
+            size_t slot = next[columns[k]]++;
+            t.columns[slot] = static_cast<uint32_t>(i);
+            t.values[slot] = values[k];
+        }
+    }
+    return t;
+}
+
+TransposedSparseMatrix::operator SparseMatrix() const
+{
+    return matrix.transposed();
+}
+
+Vector operator*(const Matrix &a, const Vector &x)
+{
+    Vector y;
+    gemv(a, x, y);
+    return y;
+}
+
+Vector operator*(const TransposedMatrix &a, const Vector &x)
+{
+    Vector y;
+    gemvTransposed(a.matrix, x, y);
+    return y;
+}
+
+Matrix operator*(const Matrix &a, const Matrix &b)
+{
+    Matrix c;
+    gemm(a, b, c);
+    return c;
+}
+
+double operator*(const Vector &x, const Vector &y)
+{
+    return dot(x, y);
+}
+
+Vector operator*(double alpha, const Vector &x)
+{
+    Vector y(x.size());
+    axpy(alpha, x, y);
+    return y;
+}
+
+Vector operator*(const Vector &x, double alpha)
+{
+    return alpha * x;
+}
+
+Vector operator/(const Vector &x, double alpha)
+{
+    return (1.0 / alpha) * x;
+}
+
+Vector operator+(const Vector &x, const Vector &y)
+{
+    Vector z = y;
+    axpy(1.0, x, z);
+    return z;
+}
+
+Vector operator-(const Vector &x, const Vector &y)
+{
+    Vector z = x;
+    axpy(-1.0, y, z);
+    return z;
+}
+
+Vector operator-(const Vector &x)
+{
+    return -1.0 * x;
+}
+
+TransposedMatrix transpose(const Matrix &a)
+{
+    return TransposedMatrix(a);
+}
+
+Vector operator*(const SparseMatrix &a, const Vector &x)
+{
+    Vector y;
+    spmv(a, x, y);
+    return y;
+}
+
+Vector operator*(const TransposedSparseMatrix &a, const Vector &x)
+{
+    Vector y;
+    spmvTransposed(a.matrix, x, y);
+    return y;
+}
+
+TransposedSparseMatrix transpose(const SparseMatrix &a)
+{
+    return TransposedSparseMatrix(a);
+}
+
+namespace
+{
+// Shortest text that reads back as the same value, with ".0" on whole numbers like Python's repr
+template <typename T>
+std::string formatNumber(T value)
+{
+    char buffer[64];
+    double magnitude = std::fabs(value);
+    bool fixed = magnitude == 0.0 || (magnitude >= 1e-4 && magnitude < 1e16);
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                                fixed ? std::chars_format::fixed : std::chars_format::scientific);
+    std::string text(buffer, result.ptr);
+    if (text.find_first_of(".eni") == std::string::npos)
+        text += ".0";
+    return text;
+}
+}
+
+void print(double value)
+{
+    std::cout << formatNumber(value) << std::endl;
+}
+
+void print(long long value)
+{
+    std::cout << value << std::endl;
+}
+
+void print(const std::string &value)
+{
+    std::cout << value << std::endl;
+}
+
+void print(const Vector &value)
+{
+    std::cout << '[';
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        std::cout << (i > 0 ? ", " : "") << formatNumber(value[i]);
+    }
+    std::cout << ']' << std::endl;
+}
+
+void print(const Matrix &value)
+{
+    for (size_t i = 0; i < value.rows; ++i)
+    {
+        std::cout << (i == 0 ? "[[" : " [");
+        for (size_t j = 0; j < value.cols; ++j)
+        {
+            std::cout << (j > 0 ? ", " : "") << formatNumber(value.at(i, j));
+        }
+        std::cout << (i + 1 == value.rows ? "]]" : "]") << '\n';
+    }
+    if (value.rows == 0)
+        std::cout << "[]\n";
+    std::cout.flush();
+}
+
+void print(const SparseMatrix &value)
+{
+    for (size_t i = 0; i < value.rows; ++i)
+    {
+        std::cout << (i == 0 ? "[[" : " [");
+        size_t k = value.rowStart[i];
+        for (size_t j = 0; j < value.cols; ++j)
+        {
+            Real element = k < value.rowStart[i + 1] && value.columns[k] == j ? value.values[k++] : 0;
+            std::cout << (j > 0 ? ", " : "") << formatNumber(element);
+        }
+        std::cout << (i + 1 == value.rows ? "]]" : "]") << '\n';
+    }
+    if (value.rows == 0)
+        std::cout << "[]\n";
+    std::cout.flush();
+}
+
+namespace
+{
+std::string readFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw RuntimeError("Error opening file: " + path);
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+bool isNumberStart(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+}
+
+// Calls field(index, value) for each comma separated number of [begin, end); returns the number of fields
+template <typename Field>
+size_t parseFields(const char *begin, const char *end, Field field)
+{
+    size_t fields = 0;
+    const char *p = begin;
+    while (p < end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        if (p < end && *p == '+')
+            ++p;
+        Real value = 0;
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc())
+            throw RuntimeError("Invalid number in CSV row: " + std::string(begin, end));
+        field(fields, value);
+        ++fields;
+        p = result.ptr;
+        while (p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        if (p < end && *p == ',')
+            ++p;
+        else if (p < end)
+            throw RuntimeError("Unexpected character in CSV row: " + std::string(begin, end));
+    }
+    return fields;
+}
+
+size_t parseRow(const char *begin, const char *end, Real *out, size_t capacity)
+{
+    return parseFields(begin, end, [&](size_t index, Real value)
+                       {
+        if (index < capacity)
+            out[index] = value; });
+}
+
+const char *lineEnd(const char *p, const char *end)
+{
+    const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+const char *nextLine(const char *p, const char *end)
+{
+    const char *e = lineEnd(p, end);
+    return e < end ? e + 1 : end;
+}
+
+const char *trimLine(const char *begin, const char *end)
+{
+    while (end > begin && (end[-1] == '\r' || end[-1] == ' '))
+        --end;
+    return end;
+}
+
+// Skips blank leading lines and, unless the data is libsvm, a header line and the blank lines after it
+const char *firstDataLine(const char *begin, const char *end, bool libsvm)
+{
+    auto skipBlank = [&]
+    {
+        while (begin < end && (*begin == '\n' || *begin == '\r'))
+            ++begin;
+    };
+    skipBlank();
+    if (!libsvm && begin < end && !isNumberStart(*begin))
+    {
+        begin = nextLine(begin, end);
+        skipBlank();
+    }
+    return begin;
+}
+
+// libsvm lines carry index:value pairs, CSV lines do not
+bool isLibsvm(const char *begin, const char *end)
+{
+    while (begin < end && (*begin == '\n' || *begin == '\r'))
+        ++begin;
+    return begin < end && std::memchr(begin, ':', lineEnd(begin, end) - begin) != nullptr;
+}
+
+// Splits [begin, end) into about one chunk per MiB, cut at line starts; chunk c is [starts[c], starts[c + 1])
+std::vector<const char *> splitLines(const char *begin, const char *end)
+{
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(threadPool().size() * 4, (end - begin) / (1 << 20)));
+    std::vector<const char *> starts(chunks + 1, end);
+    starts[0] = begin;
+    for (size_t c = 1; c < chunks; ++c)
+    {
+        const char *guess = begin + (end - begin) * c / chunks;
+        starts[c] = std::max(starts[c - 1], nextLine(guess, end));
+    }
+    return starts;
+}
+
+// Rows of one chunk of a sparse file, concatenated with the other chunks once all are parsed
+struct SparseChunk
+{
+    std::vector<size_t> rowLengths;
+    std::vector<uint32_t> columns;
+    std::vector<Real> values;
+    // One past the largest column index seen
+    size_t cols = 0;
+};
+
+bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// "label index:value index:value ...": indices are 1-based; zeros and qid:n pairs are dropped
+void parseLibsvmRow(const char *begin, const char *end, SparseChunk &chunk)
+{
+    const char *p = begin;
+    while (p < end && !isBlank(*p))
+        ++p;
+    size_t first = chunk.columns.size();
+    bool sorted = true;
+    while (p < end)
+    {
+        while (p < end && isBlank(*p))
+            ++p;
+        if (p == end)
+            break;
+        if (end - p > 4 && std::strncmp(p, "qid:", 4) == 0)
+        {
+            while (p < end && !isBlank(*p))
+                ++p;
+            continue;
+        }
+        unsigned long long index = 0;
+        auto parsed = std::from_chars(p, end, index);
+        if (parsed.ec != std::errc() || parsed.ptr == end || *parsed.ptr != ':' || index == 0 || index > UINT32_MAX)
+            throw RuntimeError("Invalid index in libsvm row: " + std::string(begin, end));
+        p = parsed.ptr + 1;
+        if (p < end && *p == '+')
+            ++p;
+        Real value = 0;
+        auto number = std::from_chars(p, end, value);
+        if (number.ec != std::errc() || (number.ptr < end && !isBlank(*number.ptr)))
+            throw RuntimeError("Invalid number in libsvm row: " + std::string(begin, end));
+        p = number.ptr;
+        if (value == 0)
+            continue;
+        uint32_t column = static_cast<uint32_t>(index - 1);
+        if (chunk.columns.size() > first && column <= chunk.columns.back())
+            sorted = false;
+        chunk.columns.push_back(column);
+        chunk.values.push_back(value);
+        chunk.cols = std::max<size_t>(chunk.cols, index);
+    }
+
+    if (!sorted)
+    {
+        std::vector<std::pair<uint32_t, Real>> entries;
+        for (size_t k = first; k < chunk.columns.size(); ++k)
+        {
+            entries.emplace_back(chunk.columns[k], chunk.values[k]);
+        }
+        std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b)
+                  { return a.first < b.first; });
+        for (size_t k = 0; k < entries.size(); ++k)
+        {
+            if (k > 0 && entries[k].first == entries[k - 1].first)
+                throw RuntimeError("Duplicate index " + std::to_string(entries[k].first + 1) + " in libsvm row: " + std::string(begin, end));
+            chunk.columns[first + k] = entries[k].first;
+            chunk.values[first + k] = entries[k].second;
+        }
+    }
+    chunk.rowLengths.push_back(chunk.columns.size() - first);
+}
+}
+
+ColumnStats::ColumnStats(size_t cols)
+    : mean(cols, 0.0), m2(cols, 0.0), min(cols, std::numeric_limits<double>::infinity()),
+      max(cols, -std::numeric_limits<double>::infinity())
+{
+}
+
+void ColumnStats::add(const Real *row)
+{
+    ++count;
+    double weight = 1.0 / static_cast<double>(count);
+    for (size_t j = 0; j < mean.size(); ++j)
+    {
+        double x = row[j];
+        double delta = x - mean[j];
+        mean[j] += delta * weight;
+        m2[j] += delta * (x - mean[j]);
+        min[j] = std::min(min[j], x);
+        max[j] = std::max(max[j], x);
+    }
+}
+
+void ColumnStats::merge(const ColumnStats &other)
+{
+    if (other.count == 0)
+        return;
+    if (count == 0)
+    {
+        *this = other;
+        return;
+    }
+    double share = static_cast<double>(other.count) / static_cast<double>(count + other.count);
+    for (size_t j = 0; j < mean.size(); ++j)
+    {
+        double delta = other.mean[j] - mean[j];
+        mean[j] += delta * share;
+        m2[j] += other.m2[j] + delta * delta * static_cast<double>(count) * share;
+        min[j] = std::min(min[j], other.min[j]);
+        max[j] = std::max(max[j], other.max[j]);
+    }
+    count += other.count;
+}
+
+Matrix loadCSV(const std::string &path, bool withStats)
+{
+    std::string text = readFile(path);
+    const char *begin = text.data();
+    const char *end = begin + text.size();
+
+    begin = firstDataLine(begin, end, false);
+    if (begin >= end)
+        return Matrix();
+
+    const char *firstEnd = trimLine(begin, lineEnd(begin, end));
+    size_t cols = std::count(begin, firstEnd, ',') + 1;
+
+    // Split the text into chunks on line boundaries and count the rows of each chunk in parallel
+    std::vector<const char *> starts = splitLines(begin, end);
+    size_t chunks = starts.size() - 1;
+    std::vector<size_t> rowCounts(chunks, 0);
+    threadPool().run(chunks, [&](size_t c)
+                     {
+        for (const char *p = starts[c]; p < starts[c + 1];)
+        {
+            const char *e = lineEnd(p, starts[c + 1]);
+            if (trimLine(p, e) > p)
+                ++rowCounts[c];
+            p = nextLine(p, starts[c + 1]);
+        } });
+
+    std::vector<size_t> firstRow(chunks, 0);
+    size_t rows = 0;
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        firstRow[c] = rows;
+        rows += rowCounts[c];
+    }
+
+    Matrix matrix(rows, cols);
+    std::vector<ColumnStats> parts(withStats ? chunks : 0, ColumnStats(cols));
+    threadPool().run(chunks, [&](size_t c)
+                     {
+        size_t row = firstRow[c];
+        for (const char *p = starts[c]; p < starts[c + 1];)
+        {
+            const char *e = lineEnd(p, starts[c + 1]);
+            const char *trimmed = trimLine(p, e);
+            if (trimmed > p)
+            {
+                size_t fields = parseRow(p, trimmed, matrix.row(row), cols);
+                if (fields != cols)
+                    throw RuntimeError("Row " + std::to_string(row + 1) + " of " + path + " has " +
+                                       std::to_string(fields) + " columns, expected " + std::to_string(cols));
+                if (withStats)
+                    parts[c].add(matrix.row(row));
+                ++row;
+            }
+            p = nextLine(p, starts[c + 1]);
+        } });
+    if (withStats)
+    {
+        // Merged in chunk order, so the stats do not depend on which thread finished first
+        auto stats = std::make_shared<ColumnStats>(cols);
+        for (const auto &part : parts)
+        {
+            stats->merge(part);
+        }
+        matrix.stats = std::move(stats);
+    }
+    return matrix;
+}
+
+ColumnStats columnStats(const Matrix &data)
+{
+    if (data.stats && data.stats->mean.size() == data.cols)
+        return *data.stats;
+    ThreadPool &workers = threadPool();
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(workers.size(), data.rows / rowGrain));
+    size_t chunkSize = (data.rows + chunks - 1) / chunks;
+    std::vector<ColumnStats> parts(chunks, ColumnStats(data.cols));
+    profileBytes(data.data.size() * sizeof(Real));
+    workers.run(chunks, [&](size_t chunk)
+                {
+        size_t end = std::min(data.rows, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i)
+        {
+            parts[chunk].add(data.row(i));
+        } });
+    ColumnStats stats(data.cols);
+    for (const auto &part : parts)
+    {
+        stats.merge(part);
+    }
+    return stats;
+}
+
+void normalize(Matrix &data)
+{
+    ColumnStats stats = columnStats(data);
+    std::vector<Accumulator> shift(data.cols);
+    std::vector<Accumulator> factor(data.cols);
+    for (size_t j = 0; j < data.cols; ++j)
+    {
+        double deviation = std::sqrt(stats.variance(j));
+        shift[j] = static_cast<Accumulator>(stats.mean[j]);
+        factor[j] = static_cast<Accumulator>(deviation > 0 ? 1.0 / deviation : 1.0);
+    }
+    profileBytes(2 * data.data.size() * sizeof(Real));
+    parallelFor(0, data.rows, [&](size_t begin, size_t end)
+                {
+        for (size_t i = begin; i < end; ++i)
+        {
+            Real *row = data.row(i);
+            for (size_t j = 0; j < data.cols; ++j)
+            {
+                row[j] = static_cast<Real>((row[j] - shift[j]) * factor[j]);
+            }
+        } }, rowGrain);
+    data.stats.reset();
+}
+
+Vector loadLabels(const std::string &path)
+{
+    std::string text = readFile(path);
+    const char *end = text.data() + text.size();
+    if (isLibsvm(text.data(), end))
+    {
+        PoolVector<Real> labels;
+        for (const char *p = firstDataLine(text.data(), end, true); p < end; p = nextLine(p, end))
+        {
+            const char *e = trimLine(p, lineEnd(p, end));
+            if (e == p)
+                continue;
+            Real label = 0;
+            auto parsed = std::from_chars(p + (*p == '+'), e, label);
+            if (parsed.ec != std::errc())
+                throw RuntimeError("Invalid label in libsvm row: " + std::string(p, e));
+            labels.push_back(label);
+        }
+        Vector result;
+        result.data = std::move(labels);
+        return result;
+    }
+
+    Matrix table = loadCSV(path);
+    Vector labels(table.rows);
+    for (size_t i = 0; i < table.rows; ++i)
+    {
+        labels[i] = table.at(i, 0);
+    }
+    return labels;
+}
+
+SparseMatrix loadSparse(const std::string &path)
+{
+    std::string text = readFile(path);
+    const char *end = text.data() + text.size();
+    bool libsvm = isLibsvm(text.data(), end);
+    const char *begin = firstDataLine(text.data(), end, libsvm);
+    if (begin >= end)
+        return SparseMatrix();
+    size_t csvCols = libsvm ? 0 : std::count(begin, trimLine(begin, lineEnd(begin, end)), ',') + 1;
+    if (csvCols > UINT32_MAX)
+        throw RuntimeError("Too many columns for a sparse matrix in " + path);
+
+    // Each chunk parses its rows into private arrays; no dense row is ever built
+    std::vector<const char *> starts = splitLines(begin, end);
+    size_t chunks = starts.size() - 1;
+    std::vector<SparseChunk> parts(chunks);
+    threadPool().run(chunks, [&](size_t c)
+                     {
+        SparseChunk &part = parts[c];
+        for (const char *p = starts[c]; p < starts[c + 1]; p = nextLine(p, starts[c + 1]))
+        {
+            const char *trimmed = trimLine(p, lineEnd(p, starts[c + 1]));
+            if (trimmed == p)
+                continue;
+            if (libsvm)
+            {
+                parseLibsvmRow(p, trimmed, part);
+                continue;
+            }
+            size_t first = part.columns.size();
+            size_t fields = parseFields(p, trimmed, [&](size_t field, Real value)
+                                        {
+                if (value != 0 && field < csvCols)
+                {
+                    part.columns.push_back(static_cast<uint32_t>(field));
+                    part.values.push_back(value);
+                } });
+            if (fields != csvCols)
+                throw RuntimeError("A row of " + path + " has " + std::to_string(fields) + " columns, expected " +
+                                   std::to_string(csvCols));
+            part.rowLengths.push_back(part.columns.size() - first);
+        } });
+
+    // Row starts come from the row lengths in file order; the entries are then copied chunk by chunk in parallel
+    SparseMatrix matrix;
+    matrix.cols = csvCols;
+    std::vector<size_t> firstEntry(chunks + 1, 0);
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        matrix.rows += parts[c].rowLengths.size();
+        matrix.cols = std::max(matrix.cols, parts[c].cols);
+        firstEntry[c + 1] = firstEntry[c] + parts[c].columns.size();
+    }
+    matrix.rowStart.assign(matrix.rows + 1, 0);
+    size_t row = 0;
+    for (const auto &part : parts)
+    {
+        for (size_t length : part.rowLengths)
+        {
+            matrix.rowStart[row + 1] = matrix.rowStart[row] + length;
+            ++row;
+        }
+    }
+    matrix.columns.resize(firstEntry[chunks]);
+    matrix.values.resize(firstEntry[chunks]);
+    threadPool().run(chunks, [&](size_t c)
+                     {
+        std::copy(parts[c].columns.begin(), parts[c].columns.end(), matrix.columns.begin() + firstEntry[c]);
+        std::copy(parts[c].values.begin(), parts[c].values.end(), matrix.values.begin() + firstEntry[c]);
+        std::vector<uint32_t>().swap(parts[c].columns);
+        std::vector<Real>().swap(parts[c].values); });
+    return matrix;
+}
+
+struct CSVStream::State
+{
+    std::string path;
+    size_t blockBytes = 0;
+    size_t cols = 0;
+    std::mutex mutex;
+    std::condition_variable changed;
+    // Text cut at line ends, waiting for a parser; the reader stops at rawLimit pieces
+    std::deque<std::pair<size_t, std::string>> raw;
+    size_t rawLimit = 0;
+    // One slot per piece handed out, empty until parsed
+    std::vector<std::unique_ptr<RowBlock>> blocks;
+    // Blocks [0, published) are parsed and numbered
+    size_t published = 0;
+    size_t publishedRows = 0;
+    bool readDone = false;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::thread reader;
+    std::vector<std::thread> parsers;
+
+    void fail(std::exception_ptr exception)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+            error = exception;
+        stopping = true;
+        changed.notify_all();
+    }
+
+    void read()
+    {
+        try
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open())
+                throw RuntimeError("Error opening file: " + path);
+            std::string carry;
+            bool first = true;
+            for (size_t index = 0;;)
+            {
+                std::string piece = std::move(carry);
+                size_t kept = piece.size();
+                piece.resize(kept + blockBytes);
+                file.read(&piece[kept], static_cast<std::streamsize>(blockBytes));
+                piece.resize(kept + static_cast<size_t>(file.gcount()));
+                bool last = !file;
+                if (!last)
+                {
+                    // The partial last line moves to the next piece
+                    size_t cut = piece.rfind('\n');
+                    carry = cut == std::string::npos ? std::move(piece) : piece.substr(cut + 1);
+                    if (cut == std::string::npos)
+                        continue;
+                    piece.resize(cut + 1);
+                }
+                if (first)
+                {
+                    const char *begin = firstDataLine(piece.data(), piece.data() + piece.size(), false);
+                    piece.erase(0, begin - piece.data());
+                    const char *line = piece.data();
+                    const char *end = line + piece.size();
+                    cols = piece.empty() ? 0 : std::count(line, trimLine(line, lineEnd(line, end)), ',') + 1;
+                    first = piece.empty() && !last;
+                }
+
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]
+                             { return raw.size() < rawLimit || stopping; });
+                if (stopping)
+                    return;
+                raw.emplace_back(index++, std::move(piece));
+                blocks.emplace_back();
+                changed.notify_all();
+                if (last)
+                    break;
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        readDone = true;
+        changed.notify_all();
+    }
+
+    void parse()
+    {
+        try
+        {
+            for (;;)
+            {
+                std::pair<size_t, std::string> piece;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]
+                                 { return !raw.empty() || readDone || stopping; });
+                    if (stopping || raw.empty())
+                        return;
+                    piece = std::move(raw.front());
+                    raw.pop_front();
+                    changed.notify_all();
+                }
+
+                const char *begin = piece.second.data();
+                const char *end = begin + piece.second.size();
+                size_t rows = 0;
+                for (const char *p = begin; p < end; p = nextLine(p, end))
+                {
+                    if (trimLine(p, lineEnd(p, end)) > p)
+                        ++rows;
+                }
+                auto block = std::make_unique<RowBlock>();
+                block->rows = Matrix(rows, cols);
+                size_t row = 0;
+                for (const char *p = begin; p < end; p = nextLine(p, end))
+                {
+                    const char *trimmed = trimLine(p, lineEnd(p, end));
+                    if (trimmed == p)
+                        continue;
+                    size_t fields = parseRow(p, trimmed, block->rows.row(row), cols);
+                    if (fields != cols)
+                        throw RuntimeError("A row of " + path + " has " + std::to_string(fields) + " columns, expected " +
+                                           std::to_string(cols));
+                    ++row;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                blocks[piece.first] = std::move(block);
+                // Blocks are numbered in file order once every block before them is done
+                while (published < blocks.size() && blocks[published])
+                {
+                    blocks[published]->firstRow = publishedRows;
+                    publishedRows += blocks[published]->rows.rows;
+                    ++published;
+                }
+                changed.notify_all();
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    }
+};
+
+CSVStream::CSVStream(const std::string &path, size_t blockBytes) : state(std::make_unique<State>())
+{
+    state->path = path;
+    state->blockBytes = std::max<size_t>(blockBytes, 1);
+    // Parsing is the slower stage on a warm cache; a few parsers keep up with the reader
+    size_t parsers = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+    state->rawLimit = 2 * parsers;
+    state->reader = std::thread([this]
+                                { state->read(); });
+    for (size_t i = 0; i < parsers; ++i)
+    {
+        state->parsers.emplace_back([this]
+                                    { state->parse(); });
+    }
+}
+
+CSVStream::~CSVStream()
+{
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->stopping = true;
+        state->changed.notify_all();
+    }
+    state->reader.join();
+    for (auto &parser : state->parsers)
+    {
+        parser.join();
+    }
+}
+
+const RowBlock *CSVStream::block(size_t i)
+{
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->changed.wait(lock, [&]
+                        { return i < state->published || state->error ||
+                                 (state->readDone && state->published == state->blocks.size()); });
+    if (state->error)
+        std::rethrow_exception(state->error);
+    return i < state->published ? state->blocks[i].get() : nullptr;
+}
+
+Matrix CSVStream::collect()
+{
+    size_t count = 0;
+    while (block(count))
+    {
+        ++count;
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    Matrix matrix(state->publishedRows, state->cols);
+    threadPool().run(count, [&](size_t i)
+                     {
+        RowBlock &part = *state->blocks[i];
+        std::copy(part.rows.data.begin(), part.rows.data.end(), matrix.row(part.firstRow));
+        part.rows = Matrix(); });
+    return matrix;
+}
+
+namespace
+{
+void descend(const Matrix &data, const Vector &labels, double learningRate, int epochs, Vector &weights)
+{
+    Vector predictions(data.rows);
+    Vector gradient(data.cols);
+    double scale = data.rows > 0 ? 1.0 / data.rows : 0.0;
+
+    for (int epoch = 0; epoch < epochs; ++epoch)
+    {
+        gemv(data, weights, predictions);
+        axpy(-1.0, labels, predictions); // predictions now holds the error
+        gemvTransposed(data, predictions, gradient);
+        axpy(-learningRate * scale, gradient, weights);
+    }
+}
+}
+
+Vector linearRegressionTrain(const Matrix &data, const Vector &labels, double learningRate, int epochs)
+{
+    checkShape(data.rows == labels.size(), "linearRegressionTrain");
+    DistributedOptions distributed;
+    if (workerProcesses(distributed) > 1 && data.rows > 1)
+        return linearRegressionTrain(data, labels, learningRate, epochs, distributed);
+    Vector weights(data.cols);
+    descend(data, labels, learningRate, epochs, weights);
+    return weights;
+}
+
+Vector linearRegressionTrain(CSVStream &data, const Vector &labels, double learningRate, int epochs)
+{
+    // First epoch: each block adds its rows' share of Aᵀ (A w - y) as soon as it is parsed
+    Vector weights, gradient, predictions, blockLabels, blockGradient;
+    for (size_t i = 0; epochs > 0; ++i)
+    {
+        const RowBlock *block = data.block(i);
+        if (!block)
+            break;
+        const Matrix &rows = block->rows;
+        checkShape(block->firstRow + rows.rows <= labels.size(), "linearRegressionTrain");
+        if (rows.rows == 0)
+            continue;
+        if (weights.size() == 0)
+        {
+            weights = Vector(rows.cols);
+            gradient = Vector(rows.cols);
+        }
+        blockLabels.data.assign(labels.data.begin() + block->firstRow, labels.data.begin() + block->firstRow + rows.rows);
+        gemv(rows, weights, predictions);
+        axpy(-1.0, blockLabels, predictions);
+        gemvTransposed(rows, predictions, blockGradient);
+        axpy(1.0, blockGradient, gradient);
+    }
+
+    Matrix matrix = data.collect();
+    checkShape(matrix.rows == labels.size(), "linearRegressionTrain");
+    if (epochs <= 0 || weights.size() != matrix.cols)
+        return linearRegressionTrain(matrix, labels, learningRate, epochs);
+    axpy(-learningRate * (matrix.rows > 0 ? 1.0 / matrix.rows : 0.0), gradient, weights);
+    descend(matrix, labels, learningRate, epochs - 1, weights);
+    return weights;
+}
+
+size_t parseCSVRow(const char *begin, const char *end, Real *out, size_t capacity)
+{
+    return parseRow(begin, trimLine(begin, end), out, capacity);
+}
+
+namespace
+{
+const char MODEL_MAGIC[] = "MLMD";
+const uint32_t MODEL_VERSION = 1;
+const size_t MODEL_HEADER_BYTES = 64;
+
+template <typename T>
+void storeLittleEndian(char *out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out[i] = static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff);
+    }
+}
+
+template <typename T>
+T loadLittleEndian(const char *in)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (8 * i);
+    }
+    return static_cast<T>(value);
+}
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw RuntimeError("Error opening file: " + path);
+        struct stat status;
+        if (fstat(fd, &status) == 0 && status.st_size > 0)
+        {
+            bytes = static_cast<size_t>(status.st_size);
+            void *mapped = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : static_cast<const char *>(mapped);
+        }
+        close(fd);
+        if (!data && bytes > 0)
+            throw RuntimeError("Cannot map " + path);
+    }
+    ~MappedFile()
+    {
+        if (data)
+            munmap(const_cast<char *>(data), bytes);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data = nullptr;
+    size_t bytes = 0;
+};
+
+template <typename Stored>
+void convertWeights(const char *payload, Vector &weights)
+{
+    const Stored *stored = reinterpret_cast<const Stored *>(payload);
+    std::copy(stored, stored + weights.size(), weights.data.begin());
+}
+}
+
+void saveModel(const Vector &weights, const std::string &path)
+{
+    // The payload is the host's IEEE layout; every target the runtime builds for is little-endian
+    char header[MODEL_HEADER_BYTES] = {};
+    std::memcpy(header, MODEL_MAGIC, 4);
+    storeLittleEndian<uint32_t>(header + 4, MODEL_VERSION);
+    storeLittleEndian<uint32_t>(header + 8, sizeof(Real));
+    storeLittleEndian<uint64_t>(header + 16, weights.size());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw RuntimeError("Error opening file: " + path);
+    file.write(header, sizeof(header));
+    file.write(reinterpret_cast<const char *>(weights.data.data()), weights.size() * sizeof(Real));
+    if (!file)
+        throw RuntimeError("Error writing model: " + path);
+}
+
+Vector loadModel(const std::string &path)
+{
+    MappedFile file(path);
+    if (file.bytes < MODEL_HEADER_BYTES || std::memcmp(file.data, MODEL_MAGIC, 4) != 0)
+        throw RuntimeError("Not an MLang model: " + path);
+    if (loadLittleEndian<uint32_t>(file.data + 4) != MODEL_VERSION)
+        throw RuntimeError("Unsupported model version: " + path);
+    uint32_t elementBytes = loadLittleEndian<uint32_t>(file.data + 8);
+    uint64_t count = loadLittleEndian<uint64_t>(file.data + 16);
+    if ((elementBytes != sizeof(float) && elementBytes != sizeof(double)) ||
+        count > (file.bytes - MODEL_HEADER_BYTES) / elementBytes)
+        throw RuntimeError("Truncated model: " + path);
+
+    Vector weights(count);
+    const char *payload = file.data + MODEL_HEADER_BYTES;
+    if (elementBytes == sizeof(float))
+        convertWeights<float>(payload, weights);
+    else
+        convertWeights<double>(payload, weights);
+    return weights;
+}
+
+uint64_t shuffleSeed()
+{
+    if (const char *environment = std::getenv("MLANG_SEED"))
+        return std::strtoull(environment, nullptr, 10);
+    return 0x4d4c616e67;
+}
+
+namespace
+{
+// Row access shared by the dense and sparse SGD loops
+struct DenseRows
+{
+    const Matrix &matrix;
+
+    size_t rows() const { return matrix.rows; }
+    size_t cols() const { return matrix.cols; }
+    double entriesPerRow() const { return static_cast<double>(matrix.cols); }
+    // Calls f(column, value) for the stored entries of row i with first <= column < last
+    template <typename F>
+    void forEach(size_t i, size_t first, size_t last, F f) const
+    {
+        const Real *row = matrix.row(i);
+        for (size_t j = first; j < last; ++j)
+        {
+            f(j, row[j]);
+        }
+    }
+};
+
+struct SparseRows
+{
+    const SparseMatrix &matrix;
+
+    size_t rows() const { return matrix.rows; }
+    size_t cols() const { return matrix.cols; }
+    double entriesPerRow() const { return matrix.rows > 0 ? static_cast<double>(matrix.nonzeros()) / matrix.rows : 0.0; }
+    template <typename F>
+    void forEach(size_t i, size_t first, size_t last, F f) const
+    {
+        auto begin = matrix.columns.begin() + matrix.rowStart[i];
+        auto end = matrix.columns.begin() + matrix.rowStart[i + 1];
+        if (first > 0)
+            begin = std::lower_bound(begin, end, static_cast<uint32_t>(first));
+        for (auto column = begin; column < end && *column < last; ++column)
+        {
+            f(*column, matrix.values[column - matrix.columns.begin()]);
+        }
+    }
+};
+
+// Grain that cuts [0, items) into pieces of at least 2^15 units, given the work of the whole range
+size_t grainFor(size_t items, double work)
+{
+    const double minimumWork = 1 << 15;
+    return std::max<size_t>(1, static_cast<size_t>(items * minimumWork / std::max(work, 1.0)));
+}
+
+void checkTraining(size_t rows, const Vector &labels, long long batchSize, const char *name)
+{
+    checkShape(rows == labels.size(), name);
+    if (batchSize < 1)
+        throw RuntimeError(std::string(name) + ": batch size must be positive, got " + std::to_string(batchSize));
+}
+
+template <typename Rows>
+Vector sgd(const Rows &data, const Vector &labels, double learningRate, long long epochs, long long batchSize)
+{
+    checkTraining(data.rows(), labels, batchSize, "sgdTrain");
+    size_t rows = data.rows(), cols = data.cols();
+    Vector weights(cols);
+    std::vector<size_t> order(rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 random(shuffleSeed());
+    std::vector<Accumulator> errors;
+
+    for (long long epoch = 0; epoch < epochs; ++epoch)
+    {
+        std::shuffle(order.begin(), order.end(), random);
+        for (size_t start = 0; start < rows; start += batchSize)
+        {
+            size_t count = std::min<size_t>(batchSize, rows - start);
+            const size_t *batch = order.data() + start;
+            double work = count * data.entriesPerRow();
+            errors.resize(count);
+            parallelFor(0, count, [&](size_t begin, size_t end)
+                        {
+                for (size_t k = begin; k < end; ++k)
+                {
+                    Accumulator prediction = 0;
+                    data.forEach(batch[k], 0, cols, [&](size_t j, Real x)
+                                 { prediction += x * weights[j]; });
+                    errors[k] = prediction - labels[batch[k]];
+                } }, grainFor(count, work));
+
+            // Every weight sums its rows in batch order, whichever thread owns it
+            double step = learningRate / count;
+            parallelFor(0, cols, [&](size_t first, size_t last)
+                        {
+                for (size_t k = 0; k < count; ++k)
+                {
+                    double scaled = step * errors[k];
+                    data.forEach(batch[k], first, last, [&](size_t j, Real x)
+                                 { weights[j] -= scaled * x; });
+                } }, grainFor(cols, work));
+        }
+    }
+    return weights;
+}
+
+template <typename Rows>
+Vector hogwild(const Rows &data, const Vector &labels, double learningRate, long long epochs, long long batchSize)
+{
+    checkTraining(data.rows(), labels, batchSize, "hogwildTrain");
+    size_t rows = data.rows(), cols = data.cols();
+    // Relaxed atomics compile to plain loads and stores; concurrent updates of a weight may overwrite each other
+    std::unique_ptr<std::atomic<Real>[]> weights(new std::atomic<Real>[cols]);
+    for (size_t j = 0; j < cols; ++j)
+    {
+        weights[j].store(0, std::memory_order_relaxed);
+    }
+    std::vector<size_t> order(rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 random(shuffleSeed());
+    ThreadPool &workers = threadPool();
+    size_t batches = (rows + batchSize - 1) / batchSize;
+    size_t threads = std::min<size_t>(workers.size(), std::max<size_t>(batches, 1));
+
+    for (long long epoch = 0; epoch < epochs; ++epoch)
+    {
+        std::shuffle(order.begin(), order.end(), random);
+        workers.run(threads, [&](size_t thread)
+                    {
+            size_t begin = rows * thread / threads, end = rows * (thread + 1) / threads;
+            std::vector<Accumulator> errors;
+            for (size_t start = begin; start < end; start += batchSize)
+            {
+                size_t count = std::min<size_t>(batchSize, end - start);
+                const size_t *batch = order.data() + start;
+                errors.resize(count);
+                for (size_t k = 0; k < count; ++k)
+                {
+                    Accumulator prediction = 0;
+                    data.forEach(batch[k], 0, cols, [&](size_t j, Real x)
+                                 { prediction += x * weights[j].load(std::memory_order_relaxed); });
+                    errors[k] = prediction - labels[batch[k]];
+                }
+                double step = learningRate / count;
+                for (size_t k = 0; k < count; ++k)
+                {
+                    double scaled = step * errors[k];
+                    data.forEach(batch[k], 0, cols, [&](size_t j, Real x)
+                                 { weights[j].store(weights[j].load(std::memory_order_relaxed) - scaled * x, std::memory_order_relaxed); });
+                }
+            } });
+    }
+
+    Vector result(cols);
+    for (size_t j = 0; j < cols; ++j)
+    {
+        result[j] = weights[j].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+}
+
+Vector sgdTrain(const Matrix &data, const Vector &labels, double learningRate, long long epochs, long long batchSize)
+{
+    return sgd(DenseRows{data}, labels, learningRate, epochs, batchSize);
+}
+
+Vector sgdTrain(const SparseMatrix &data, const Vector &labels, double learningRate, long long epochs, long long batchSize)
+{
+    return sgd(SparseRows{data}, labels, learningRate, epochs, batchSize);
+}
+
+Vector hogwildTrain(const Matrix &data, const Vector &labels, double learningRate, long long epochs, long long batchSize)
+{
+    return hogwild(DenseRows{data}, labels, learningRate, epochs, batchSize);
+}
+
+Vector hogwildTrain(const SparseMatrix &data, const Vector &labels, double learningRate, long long epochs, long long batchSize)
+{
+    return hogwild(SparseRows{data}, labels, learningRate, epochs, batchSize);
+}
+
+double predict(const Vector &sample, const Vector &weights)
+{
+    return dot(sample, weights);
+}
+}
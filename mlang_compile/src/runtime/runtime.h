@@ -0,0 +1,264 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "parallel.h"
+#include "pool.h"
+#include "precision.h"
+#include "reduce.h"
+
+// Native runtime for MLang programs: dense Vector/Matrix and sparse CSR storage and the kernels behind the ML built-ins
+
+class RuntimeError : public std::runtime_error
+{
+public:
+    RuntimeError(const std::string &message) : std::runtime_error(message) {}
+};
+
+// Everything below lives in a namespace named after the storage precision, so objects
+// built with and without -DMLANG_FLOAT32 fail to link together instead of misreading memory
+inline namespace MLANG_STORAGE
+{
+// Vector and Matrix elements come from the size-class pool in pool.h
+class Vector
+{
+public:
+    PoolVector<Real> data;
+
+    Vector() = default;
+    explicit Vector(size_t size, Real value = 0) : data(size, value) {}
+    Vector(std::initializer_list<Real> values) : data(values) {}
+
+    size_t size() const { return data.size(); }
+    Real &operator[](size_t i) { return data[i]; }
+    Real operator[](size_t i) const { return data[i]; }
+};
+
+struct ColumnStats;
+
+// Row-major dense matrix; a Dataset is a Matrix with one sample per row
+class Matrix
+{
+public:
+    size_t rows = 0;
+    size_t cols = 0;
+    PoolVector<Real> data;
+    // Statistics of the current elements when loadCSV gathered them while parsing; kernels
+    // that overwrite the elements in place drop them
+    std::shared_ptr<const ColumnStats> stats;
+
+    Matrix() = default;
+    Matrix(size_t rows, size_t cols, Real value = 0) : rows(rows), cols(cols), data(rows * cols, value) {}
+
+    Real &at(size_t row, size_t col) { return data[row * cols + col]; }
+    Real at(size_t row, size_t col) const { return data[row * cols + col]; }
+    const Real *row(size_t row) const { return data.data() + row * cols; }
+    Real *row(size_t row) { return data.data() + row * cols; }
+};
+
+// Aᵀ without copying A; multiplying it by a Vector runs gemvTransposed
+class TransposedMatrix
+{
+public:
+    const Matrix &matrix;
+
+    explicit TransposedMatrix(const Matrix &matrix) : matrix(matrix) {}
+    // Materializes the transpose when it is stored or used as a plain Matrix
+    operator Matrix() const;
+};
+
+// Compressed sparse row matrix for one-hot and bag-of-words features (SparseMatrix and
+// SparseDataset in MLang). Row i holds values[rowStart[i]] ... values[rowStart[i + 1] - 1]
+// at increasing column indices; 32-bit indices halve the index traffic of the kernels.
+class SparseMatrix
+{
+public:
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<size_t> rowStart = std::vector<size_t>(1, 0);
+    std::vector<uint32_t> columns;
+    std::vector<Real> values;
+
+    SparseMatrix() = default;
+    SparseMatrix(size_t rows, size_t cols) : rows(rows), cols(cols), rowStart(rows + 1, 0) {}
+
+    size_t nonzeros() const { return values.size(); }
+    // CSR storage of Aᵀ, which is the CSC storage of A
+    SparseMatrix transposed() const;
+};
+
+// Aᵀ without copying A; multiplying it by a Vector runs spmvTransposed
+class TransposedSparseMatrix
+{
+public:
+    const SparseMatrix &matrix;
+
+    explicit TransposedSparseMatrix(const SparseMatrix &matrix) : matrix(matrix) {}
+    operator SparseMatrix() const;
+};
+
+// Destination-passing kernels: the result overwrites the last argument, which is only
+// reallocated when its size changes, so a buffer reused across loop iterations costs
+// one allocation in total. They give the same bits as the value-returning operators.
+
+// y = A x
+void gemv(const Matrix &a, const Vector &x, Vector &y);
+// y = Aᵀ x
+void gemvTransposed(const Matrix &a, const Vector &x, Vector &y);
+// C = A B
+void gemm(const Matrix &a, const Matrix &b, Matrix &c);
+// y = A x and y = Aᵀ x for sparse A. spmv splits the rows across threads; spmvTransposed
+// scatters row chunks into private partials and reduces them by column, like gemvTransposed.
+void spmv(const SparseMatrix &a, const Vector &x, Vector &y);
+void spmvTransposed(const SparseMatrix &a, const Vector &x, Vector &y);
+// y = alpha x + y
+void axpy(double alpha, const Vector &x, Vector &y);
+// y = alpha x
+void scale(double alpha, const Vector &x, Vector &y);
+// z = x + y and z = x - y; z may be x or y
+void add(const Vector &x, const Vector &y, Vector &z);
+void subtract(const Vector &x, const Vector &y, Vector &z);
+// Tree-ordered in Accumulator precision, see reduce.h
+double dot(const Vector &x, const Vector &y);
+double sum(const Vector &x);
+// MLang min() and max() on two scalars
+double minimum(double a, double b);
+double maximum(double a, double b);
+
+// Value-returning forms of the kernels used by natively compiled MLang expressions
+Vector operator*(const Matrix &a, const Vector &x);
+Vector operator*(const TransposedMatrix &a, const Vector &x);
+Matrix operator*(const Matrix &a, const Matrix &b);
+double operator*(const Vector &x, const Vector &y);
+Vector operator*(double alpha, const Vector &x);
+Vector operator*(const Vector &x, double alpha);
+Vector operator/(const Vector &x, double alpha);
+Vector operator+(const Vector &x, const Vector &y);
+Vector operator-(const Vector &x, const Vector &y);
+Vector operator-(const Vector &x);
+TransposedMatrix transpose(const Matrix &a);
+Vector operator*(const SparseMatrix &a, const Vector &x);
+Vector operator*(const TransposedSparseMatrix &a, const Vector &x);
+TransposedSparseMatrix transpose(const SparseMatrix &a);
+
+// MLang print(): one value per line, vectors as [a, b, c]
+void print(double value);
+void print(long long value);
+void print(const std::string &value);
+void print(const Vector &value);
+void print(const Matrix &value);
+// Printed like the dense Matrix with the same elements
+void print(const SparseMatrix &value);
+// Integer literals are int; route them to the long long overload instead of an ambiguous conversion
+template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+void print(T value)
+{
+    print(static_cast<long long>(value));
+}
+
+// Per-column count, mean, variance, min and max from Welford accumulators, kept in double.
+// Summaries of disjoint row ranges merge exactly (Chan et al.), so threads can summarize
+// their own rows and combine the results.
+struct ColumnStats
+{
+    size_t count = 0;
+    std::vector<double> mean;
+    // Sum of squared deviations from the mean
+    std::vector<double> m2;
+    std::vector<double> min;
+    std::vector<double> max;
+
+    explicit ColumnStats(size_t cols = 0);
+    void add(const Real *row);
+    void merge(const ColumnStats &other);
+    // Population variance
+    double variance(size_t col) const { return count > 0 ? m2[col] / count : 0.0; }
+};
+
+// Reads a comma separated numeric file; a non-numeric first line is treated as a header.
+// With withStats, every parser thread also summarizes its rows while they are in cache and
+// the merged ColumnStats are attached to the result, at no extra pass over the data.
+Matrix loadCSV(const std::string &path, bool withStats = false);
+// The attached stats if present, else one parallel pass over the rows
+ColumnStats columnStats(const Matrix &data);
+// Standardizes every column in place to (x - mean) / standard deviation in one fused parallel
+// pass (MLang data.normalize()); a constant column becomes 0. A Matrix loaded with stats is
+// not read an extra time to summarize it.
+void normalize(Matrix &data);
+// Reads one label per line (or the first column of a CSV, or the label of each libsvm line)
+Vector loadLabels(const std::string &path);
+// Rows firstRow ... firstRow + rows.rows - 1 of a streamed CSV file
+struct RowBlock
+{
+    size_t firstRow = 0;
+    Matrix rows;
+};
+
+// Reads a CSV file in the background, like loadCSV: a reader thread pulls blockBytes at a
+// time and cuts them at line ends, parser threads turn the pieces into row blocks. Callers
+// take the blocks in file order as each one completes, so compute on the first rows overlaps
+// the I/O and parsing of the rest. Errors of the background threads are rethrown by block().
+class CSVStream
+{
+public:
+    explicit CSVStream(const std::string &path, size_t blockBytes = 4 << 20);
+    ~CSVStream();
+    CSVStream(const CSVStream &) = delete;
+    CSVStream &operator=(const CSVStream &) = delete;
+
+    // Waits for block i; nullptr once i is past the last block. Blocks stay valid until collect().
+    const RowBlock *block(size_t i);
+    // Waits for the whole file and moves its rows into one Matrix, releasing the blocks
+    Matrix collect();
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+// Builds CSR directly from a libsvm file ("label index:value ...", 1-based indices; the label
+// is skipped, see loadLabels) or from a CSV file whose zeros are dropped while parsing
+SparseMatrix loadSparse(const std::string &path);
+
+// Parses one CSV line into out, storing at most capacity values; returns the number of fields
+size_t parseCSVRow(const char *begin, const char *end, Real *out, size_t capacity);
+
+// Trained weights on disk (MLang save_model and load_model). A 64-byte header,
+//   "MLMD" u32 version, u32 element-bytes (4 or 8), u32 reserved, u64 count, zero padding
+// (little-endian), is followed by the raw float or double weights, so the payload is 64-byte
+// aligned and a reader can mmap the file and use it in place. loadModel maps the file and
+// converts the weights if they were saved at the other precision.
+void saveModel(const Vector &weights, const std::string &path);
+Vector loadModel(const std::string &path);
+
+// Full-batch gradient descent for least squares, starting from zero weights; with $MLANG_PROCESSES
+// above 1 the rows are split between that many worker processes (distributed.h)
+Vector linearRegressionTrain(const Matrix &data, const Vector &labels, double learningRate, int epochs);
+// The same descent on a file that is still loading: the first epoch runs block by block as rows
+// arrive, later epochs on the collected Matrix. Equal to loading first up to rounding.
+Vector linearRegressionTrain(CSVStream &data, const Vector &labels, double learningRate, int epochs);
+// Mini-batch stochastic gradient descent for least squares from zero weights (MLang sgd_train;
+// batchSize 1 is plain SGD). Each epoch walks a freshly shuffled permutation of the row indices,
+// so rows are never copied. Within a batch the errors of row shards are computed in parallel,
+// then each thread applies the update to its own range of weights in batch order, so the result
+// does not depend on the thread count.
+Vector sgdTrain(const Matrix &data, const Vector &labels, double learningRate, long long epochs, long long batchSize);
+Vector sgdTrain(const SparseMatrix &data, const Vector &labels, double learningRate, long long epochs, long long batchSize);
+// Hogwild: every thread runs the batches of its own share of the shuffled rows and updates the
+// shared weights with relaxed atomic loads and stores, without locks (MLang hogwild_train).
+// Scales with threads, best on sparse rows that seldom share weights; results vary run to run.
+Vector hogwildTrain(const Matrix &data, const Vector &labels, double learningRate, long long epochs, long long batchSize);
+Vector hogwildTrain(const SparseMatrix &data, const Vector &labels, double learningRate, long long epochs, long long batchSize);
+// Seed of the row shuffles: $MLANG_SEED, else a fixed value so that runs repeat
+uint64_t shuffleSeed();
+double predict(const Vector &sample, const Vector &weights);
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+#include "server.h"
+
+namespace
+{
+PredictionServer *server = nullptr;
+
+void stopServer(int)
+{
+    if (server)
+        server->stop();
+}
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <model_file> [--socket PATH] [--batch N] [--max-latency-us N] [--threads N]"
+                  << std::endl;
+        return 1;
+    }
+
+    ServerOptions options;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--socket")
+            options.socketPath = value;
+        else if (option == "--batch")
+            options.batchSize = std::stoul(value);
+        else if (option == "--max-latency-us")
+            options.maxLatency = std::chrono::microseconds(std::stoll(value));
+        else if (option == "--threads")
+            setThreadCount(std::stoi(value));
+        else
+        {
+            std::cerr << "Unknown option: " << option << " " << value << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        PredictionServer prediction(loadModel(argv[1]), options);
+        server = &prediction;
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        prediction.run();
+        server = nullptr;
+
+        const ServerStats &stats = prediction.stats();
+        std::cerr << "Served " << stats.rows << " rows in " << stats.batches << " batches";
+        if (stats.errors > 0)
+            std::cerr << ", " << stats.errors << " malformed";
+        std::cerr << std::endl;
+    }
+    catch (const RuntimeError &e)
+    {
+        std::cerr << "Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
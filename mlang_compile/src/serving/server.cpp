@@ -0,0 +1,285 @@
+#include "server.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+// Writes all of text, retrying short writes; a peer that went away just loses its answers
+void writeAll(int fd, const std::string &text, bool socket)
+{
+    size_t written = 0;
+    while (written < text.size())
+    {
+        ssize_t n = socket ? send(fd, text.data() + written, text.size() - written, MSG_NOSIGNAL)
+                           : write(fd, text.data() + written, text.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        written += static_cast<size_t>(n);
+    }
+}
+
+void appendNumber(std::string &out, double value)
+{
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+    out += '\n';
+}
+}
+
+PredictionServer::PredictionServer(const Vector &weights, const ServerOptions &options)
+    : weights(weights), options(options), batch(options.batchSize, weights.size())
+{
+    this->options.batchSize = std::max<size_t>(options.batchSize, 1);
+    rows.reserve(this->options.batchSize);
+    int wake[2];
+    if (pipe(wake) != 0)
+        throw RuntimeError("Cannot create the server's wake-up pipe");
+    wakeRead = wake[0];
+    wakeWrite = wake[1];
+}
+
+PredictionServer::~PredictionServer()
+{
+    for (auto &entry : connections)
+    {
+        if (entry.second.in != STDIN_FILENO)
+            ::close(entry.second.in);
+    }
+    if (listener >= 0)
+    {
+        ::close(listener);
+        unlink(options.socketPath.c_str());
+    }
+    ::close(wakeRead);
+    ::close(wakeWrite);
+}
+
+void PredictionServer::stop()
+{
+    char byte = 0;
+    ssize_t ignored = write(wakeWrite, &byte, 1);
+    (void)ignored;
+}
+
+void PredictionServer::listen()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options.socketPath.size() >= sizeof(address.sun_path))
+        throw RuntimeError("Socket path too long: " + options.socketPath);
+    std::strcpy(address.sun_path, options.socketPath.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        throw RuntimeError("Cannot create socket: " + std::string(std::strerror(errno)));
+    // A socket file left by an earlier server would make bind fail
+    unlink(options.socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, 64) != 0)
+        throw RuntimeError("Cannot listen on " + options.socketPath + ": " + std::strerror(errno));
+}
+
+void PredictionServer::accept()
+{
+    int client = ::accept(listener, nullptr, nullptr);
+    if (client < 0)
+        return;
+    Connection &connection = connections[nextConnection++];
+    connection.in = client;
+    connection.out = client;
+}
+
+bool PredictionServer::receive(uint64_t id)
+{
+    Connection &connection = connections[id];
+    char buffer[1 << 16];
+    ssize_t n = read(connection.in, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+        return true;
+    if (n <= 0)
+    {
+        // A last line without a newline still counts
+        if (!connection.input.empty())
+            addRow(id, connection.input.data(), connection.input.data() + connection.input.size());
+        connection.input.clear();
+        connection.ended = true;
+        return connection.pending > 0;
+    }
+
+    connection.input.append(buffer, static_cast<size_t>(n));
+    const char *begin = connection.input.data();
+    const char *end = begin + connection.input.size();
+    const char *line = begin;
+    for (const char *newline; (newline = static_cast<const char *>(std::memchr(line, '\n', end - line)));)
+    {
+        addRow(id, line, newline);
+        line = newline + 1;
+    }
+    // addRow may flush, which does not touch input, so line is still valid here
+    connection.input.erase(0, line - begin);
+    return true;
+}
+
+void PredictionServer::addRow(uint64_t id, const char *begin, const char *end)
+{
+    while (end > begin && (end[-1] == '\r' || end[-1] == ' '))
+        --end;
+    if (end == begin)
+        return;
+
+    size_t row = rows.size();
+    if (row == 0)
+        deadline = std::chrono::steady_clock::now() + options.maxLatency;
+    batch.rows = row + 1;
+    batch.data.resize(batch.rows * batch.cols);
+    PendingRow pending{id, ""};
+    try
+    {
+        size_t fields = parseCSVRow(begin, end, batch.row(row), batch.cols);
+        if (fields != batch.cols)
+            pending.error = "expected " + std::to_string(batch.cols) + " features, got " + std::to_string(fields);
+    }
+    catch (const RuntimeError &e)
+    {
+        pending.error = e.what();
+    }
+    if (!pending.error.empty())
+        std::fill(batch.row(row), batch.row(row) + batch.cols, Real(0));
+    rows.push_back(std::move(pending));
+    ++connections[id].pending;
+    if (rows.size() >= options.batchSize)
+        flush();
+}
+
+void PredictionServer::flush()
+{
+    if (rows.empty())
+        return;
+    gemv(batch, weights, predictions);
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        auto connection = connections.find(rows[i].connection);
+        if (connection == connections.end())
+            continue;
+        if (rows[i].error.empty())
+            appendNumber(connection->second.output, predictions[i]);
+        else
+            connection->second.output += "error: " + rows[i].error + "\n";
+        --connection->second.pending;
+    }
+    counters.rows += rows.size();
+    counters.batches += 1;
+    counters.errors += std::count_if(rows.begin(), rows.end(), [](const PendingRow &row)
+                                     { return !row.error.empty(); });
+    rows.clear();
+    batch.rows = 0;
+    batch.data.clear();
+
+    std::vector<uint64_t> finished;
+    for (auto &entry : connections)
+    {
+        Connection &connection = entry.second;
+        if (!connection.output.empty())
+        {
+            writeAll(connection.out, connection.output, listener >= 0);
+            connection.output.clear();
+        }
+        if (connection.ended && connection.pending == 0)
+            finished.push_back(entry.first);
+    }
+    for (uint64_t id : finished)
+    {
+        close(id);
+    }
+}
+
+void PredictionServer::close(uint64_t id)
+{
+    auto connection = connections.find(id);
+    if (connection == connections.end())
+        return;
+    if (connection->second.in != STDIN_FILENO)
+        ::close(connection->second.in);
+    connections.erase(connection);
+}
+
+void PredictionServer::run()
+{
+    bool serveStdin = options.socketPath.empty();
+    if (serveStdin)
+    {
+        Connection &connection = connections[nextConnection++];
+        connection.in = STDIN_FILENO;
+        connection.out = STDOUT_FILENO;
+    }
+    else
+        listen();
+
+    std::vector<pollfd> polled;
+    std::vector<uint64_t> polledIds;
+    for (;;)
+    {
+        if (serveStdin && connections.empty())
+            return;
+
+        polled.assign({{wakeRead, POLLIN, 0}});
+        polledIds.assign({0});
+        if (listener >= 0)
+        {
+            polled.push_back({listener, POLLIN, 0});
+            polledIds.push_back(0);
+        }
+        for (auto &entry : connections)
+        {
+            if (!entry.second.ended)
+            {
+                polled.push_back({entry.second.in, POLLIN, 0});
+                polledIds.push_back(entry.first);
+            }
+        }
+
+        // Sleep until input arrives or the oldest row of the batch has waited maxLatency
+        int ready = 0;
+        if (!rows.empty())
+        {
+            auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+            timespec wait{static_cast<time_t>(std::max<long long>(left.count(), 0) / 1000000),
+                          static_cast<long>(std::max<long long>(left.count(), 0) % 1000000 * 1000)};
+            ready = ppoll(polled.data(), polled.size(), &wait, nullptr);
+        }
+        else
+            ready = ppoll(polled.data(), polled.size(), nullptr, nullptr);
+        if (ready < 0 && errno != EINTR)
+            throw RuntimeError("poll failed: " + std::string(std::strerror(errno)));
+
+        if (ready > 0 && (polled[0].revents & POLLIN))
+        {
+            flush();
+            return;
+        }
+        if (ready > 0)
+        {
+            for (size_t i = 1; i < polled.size(); ++i)
+            {
+                if (!(polled[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                    continue;
+                if (polled[i].fd == listener)
+                    accept();
+                else if (!receive(polledIds[i]))
+                    close(polledIds[i]);
+            }
+        }
+        // Nothing more can join the batch once stdin has ended
+        bool inputEnded = serveStdin && !connections.empty() && connections.begin()->second.ended;
+        if (!rows.empty() && (inputEnded || std::chrono::steady_clock::now() >= deadline))
+            flush();
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef SERVING_SERVER_H
+#define SERVING_SERVER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "../runtime/runtime.h"
+
+// Batched prediction for a saved linear model (mlang_serve). Clients send one feature row
+// per line, comma-separated as in a CSV file, and get one line back per row, in order:
+// the prediction, or "error: ..." for a malformed row. Rows from every client are collected
+// into one batch until it holds batchSize rows or its oldest row has waited maxLatency, and
+// the batch is evaluated with a single gemv.
+
+struct ServerOptions
+{
+    // Unix socket to listen on; empty serves stdin and answers on stdout
+    std::string socketPath;
+    size_t batchSize = 256;
+    std::chrono::microseconds maxLatency{1000};
+};
+
+struct ServerStats
+{
+    uint64_t rows = 0;
+    uint64_t batches = 0;
+    uint64_t errors = 0;
+};
+
+class PredictionServer
+{
+public:
+    PredictionServer(const Vector &weights, const ServerOptions &options);
+    ~PredictionServer();
+    PredictionServer(const PredictionServer &) = delete;
+    PredictionServer &operator=(const PredictionServer &) = delete;
+
+    // Serves until stdin ends or, on a socket, until stop(). Throws RuntimeError if the socket cannot be opened.
+    void run();
+    // Async-signal-safe, so a SIGINT handler can call it
+    void stop();
+    const ServerStats &stats() const { return counters; }
+
+private:
+    struct Connection
+    {
+        int in = -1;
+        int out = -1;
+        std::string input;
+        std::string output;
+        // Rows of the current batch still to be answered
+        size_t pending = 0;
+        bool ended = false;
+    };
+    // One row of the batch; the connection may close before it is answered
+    struct PendingRow
+    {
+        uint64_t connection;
+        std::string error;
+    };
+
+    Vector weights;
+    ServerOptions options;
+    ServerStats counters;
+    int listener = -1;
+    int wakeRead = -1;
+    int wakeWrite = -1;
+    uint64_t nextConnection = 0;
+    std::map<uint64_t, Connection> connections;
+
+    Matrix batch;
+    std::vector<PendingRow> rows;
+    Vector predictions;
+    std::chrono::steady_clock::time_point deadline;
+
+    void listen();
+    void accept();
+    // Reads what is available; false once the connection has ended and is answered
+    bool receive(uint64_t id);
+    void addRow(uint64_t id, const char *begin, const char *end);
+    void flush();
+    void close(uint64_t id);
+};
+
+#endif
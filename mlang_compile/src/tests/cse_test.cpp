@@ -0,0 +1,77 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../lexical-analysis/lexer/lexer.h"
+#include "../ast/ast-generation/ast.h"
+#include "../code-generation/codegen.h"
+#include "../code-generation/cse.h"
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cerr << "FAIL: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Lexes, parses and reads back source the way code generation does, then runs CSE
+IRNode *eliminate(const std::string &source, size_t &replaced)
+{
+    Diagnostics diagnostics;
+    std::vector<Token> tokens = Lexer(source, "cse_test.mlang", diagnostics).tokenize();
+    std::unique_ptr<ProgramNode> program = parseTokens(tokens);
+    std::ostringstream dump;
+    std::streambuf *coutbuf = std::cout.rdbuf(dump.rdbuf());
+    program->print();
+    std::cout.rdbuf(coutbuf);
+    std::istringstream input(dump.str());
+    IRNode *root = parseASTFromStream(input);
+    replaced = eliminateCommonSubexpressions(root);
+    return root;
+}
+
+size_t temporaries(IRNode *root)
+{
+    size_t count = 0;
+    visitTree(root, [&](IRNode *node)
+              { count += node->type == "VARIABLE_DECLARATION" && !node->children.empty() &&
+                         node->children[0]->value.compare(0, 4, "_cse") == 0; });
+    return count;
+}
+}
+
+int main()
+{
+    // a * w repeats only inside a * w + b, which h already holds: the second statement reads h,
+    // and no temporary is left for the a * w that went with the replaced node
+    size_t replaced = 0;
+    IRNode *root = eliminate("fn f(a: Dataset, w: Vector<Float>, b: Vector<Float>) -> Vector<Float> {\n"
+                             "   h: Vector<Float> = a * w + b;\n"
+                             "   x: Vector<Float> = (a * w + b) * 2.0;\n"
+                             "   return x;\n"
+                             "}\n",
+                             replaced);
+    check(replaced == 1, "one replacement of a * w + b, got " + std::to_string(replaced));
+    check(temporaries(root) == 0, "no _cse temporary for a subexpression of a replaced expression");
+    delete root;
+
+    // A product repeated inside two different sums still gets its temporary
+    root = eliminate("fn g(a: Dataset, w: Vector<Float>, b: Vector<Float>) -> Vector<Float> {\n"
+                     "   x: Vector<Float> = (a * w + b) * 2.0;\n"
+                     "   y: Vector<Float> = (a * w - b) * 3.0;\n"
+                     "   return x + y;\n"
+                     "}\n",
+                     replaced);
+    check(temporaries(root) == 1, "one _cse temporary for a * w");
+    delete root;
+
+    if (failures == 0)
+        std::cout << "cse_test: ok" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../runtime/distributed.h"
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cerr << "FAIL: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const char *name(TransportKind transport)
+{
+    return transport == TransportKind::SOCKET ? "socket" : "shared memory";
+}
+
+DistributedOptions group(TransportKind transport, int processes)
+{
+    DistributedOptions options;
+    options.processes = processes;
+    options.transport = transport;
+    options.pin = false;
+    return options;
+}
+
+// Every process contributes its rank + 1 to each element, so each sum is p (p + 1) / 2
+void checkSums(TransportKind transport, AllreduceAlgorithm algorithm, size_t count)
+{
+    const int processes = 4;
+    DistributedOptions options = group(transport, processes);
+    options.algorithm = algorithm;
+    std::string message;
+    try
+    {
+        runWorkers(options, [&](Transport &peers)
+                   {
+            std::vector<double> values(count, peers.rank() + 1.0);
+            allreduce(peers, values.data(), values.size(), algorithm);
+            for (double value : values)
+            {
+                if (value != processes * (processes + 1) / 2)
+                    throw RuntimeError("wrong sum " + std::to_string(value));
+            } });
+    }
+    catch (const RuntimeError &e)
+    {
+        message = e.what();
+    }
+    check(message.empty(), std::string("allreduce over ") + name(transport) + ": " + message);
+}
+
+// Rank 1 dies from SIGKILL in the middle of the exchanges; without detection the others wait for
+// its data forever and alarm() ends the test
+void checkKilledWorker(TransportKind transport)
+{
+    std::string message;
+    try
+    {
+        runWorkers(group(transport, 3), [](Transport &peers)
+                   {
+            std::vector<double> values(1024, 1.0);
+            for (int step = 0; step < 100; ++step)
+            {
+                if (peers.rank() == 1 && step == 3)
+                    raise(SIGKILL);
+                allreduce(peers, values.data(), values.size());
+            } });
+    }
+    catch (const RuntimeError &e)
+    {
+        message = e.what();
+    }
+    check(message.find("killed by signal") != std::string::npos,
+          std::string("a killed worker fails the group over ") + name(transport) + ", got: " + message);
+}
+
+// A worker that throws stops the others, and the error names it
+void checkFailedWorker(TransportKind transport)
+{
+    std::string message;
+    try
+    {
+        runWorkers(group(transport, 3), [](Transport &peers)
+                   {
+            std::vector<double> values(16, 1.0);
+            if (peers.rank() == 2)
+                throw RuntimeError("expected failure");
+            allreduce(peers, values.data(), values.size()); });
+    }
+    catch (const RuntimeError &e)
+    {
+        message = e.what();
+    }
+    check(!message.empty(), std::string("a failed worker fails the group over ") + name(transport));
+}
+// A program that ignores SIGCHLD still learns how its workers ended, and does not wait forever
+// for workers the kernel already reaped
+void checkIgnoredChildSignal()
+{
+    void (*previous)(int) = signal(SIGCHLD, SIG_IGN);
+    checkSums(TransportKind::SHARED_MEMORY, AllreduceAlgorithm::TREE, 7);
+    checkKilledWorker(TransportKind::SHARED_MEMORY);
+    check(signal(SIGCHLD, previous) == SIG_IGN, "runWorkers restores SIGCHLD");
+}
+}
+
+int main()
+{
+    alarm(60);
+    for (TransportKind transport : {TransportKind::SHARED_MEMORY, TransportKind::SOCKET})
+    {
+        checkSums(transport, AllreduceAlgorithm::RING, 100003);
+        checkSums(transport, AllreduceAlgorithm::TREE, 7);
+        checkKilledWorker(transport);
+        checkFailedWorker(transport);
+    }
+    checkIgnoredChildSignal();
+
+    if (failures == 0)
+        std::cout << "distributed_test: ok" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
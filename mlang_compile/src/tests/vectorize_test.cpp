@@ -0,0 +1,72 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../lexical-analysis/lexer/lexer.h"
+#include "../ast/ast-generation/ast.h"
+#include "../code-generation/codegen.h"
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cerr << "FAIL: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Lexes, parses and reads back source the way code generation does, then generates Python
+std::string generate(const std::string &source)
+{
+    Diagnostics diagnostics;
+    std::vector<Token> tokens = Lexer(source, "vectorize_test.mlang", diagnostics).tokenize();
+    std::unique_ptr<ProgramNode> program = parseTokens(tokens);
+    std::ostringstream dump;
+    std::streambuf *coutbuf = std::cout.rdbuf(dump.rdbuf());
+    program->print();
+    std::cout.rdbuf(coutbuf);
+    std::istringstream input(dump.str());
+    IRNode *root = parseASTFromStream(input);
+    ASTPythonGenerator generator;
+    std::string python = generator.generateProgram(root);
+    delete root;
+    return python;
+}
+
+bool contains(const std::string &text, const std::string &part)
+{
+    return text.find(part) != std::string::npos;
+}
+}
+
+int main()
+{
+    // t holds x[i] from before the store to x[i], so the vectorized t must be a copy of the slice:
+    // a view would see the zeros and leave y all zero
+    std::string python = generate("fn shift(x: Vector<Float>, y: Vector<Float>) {\n"
+                                  "   for i in 0 to 32 {\n"
+                                  "      t: Float = x[i];\n"
+                                  "      x[i] = 0.0;\n"
+                                  "      y[i] = t;\n"
+                                  "   }\n"
+                                  "}\n");
+    check(contains(python, "x[0:32] = "), "the loop is vectorized:\n" + python);
+    check(contains(python, "t = np.array(x[0:32])"), "a slice of a stored array is copied:\n" + python);
+
+    // Arrays the loop only reads are still viewed
+    python = generate("fn scale(x: Vector<Float>, y: Vector<Float>) {\n"
+                      "   for i in 0 to 32 {\n"
+                      "      t: Float = x[i];\n"
+                      "      y[i] = t * 2.0;\n"
+                      "   }\n"
+                      "}\n");
+    check(contains(python, "t = np.asarray(x[0:32])"), "a slice of a read-only array is a view:\n" + python);
+
+    if (failures == 0)
+        std::cout << "vectorize_test: ok" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
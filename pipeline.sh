@@ -16,12 +16,13 @@ LEXER_SRC="$BASE_DIR/mlang_compile/src/lexical-analysis/lexer"
 ERRORS_SRC="$BASE_DIR/mlang_compile/src/lexical-analysis/errors"
 AST_SRC="$BASE_DIR/mlang_compile/src/ast/ast-generation"
 CODEGEN_SRC="$BASE_DIR/mlang_compile/src/code-generation"
+RUNTIME_SRC="$BASE_DIR/mlang_compile/src/runtime"
 INPUT_DIR="$BASE_DIR/input"
 OUTPUT_DIR="$BASE_DIR/mlang_syntax/code-generation"
 
 # Compile lexer
 echo "Compiling Lexer..."
-g++ "$LEXER_SRC/main.cpp" "$ERRORS_SRC/errors.cpp" "$LEXER_SRC/lexer.cpp" -o "$BASE_DIR/lexer_program"
+g++ -pthread "$LEXER_SRC/main.cpp" "$ERRORS_SRC/errors.cpp" "$ERRORS_SRC/diagnostics.cpp" "$LEXER_SRC/lexer.cpp" -o "$BASE_DIR/lexer_program"
 
 # Run lexer
 echo "Running Lexer..."
@@ -29,19 +30,23 @@ echo "Running Lexer..."
 
 # Compile AST
 echo "Compiling AST..."
-g++ "$AST_SRC/ast.cpp" -o "$BASE_DIR/ast_program"
+g++ -pthread "$AST_SRC/main.cpp" "$AST_SRC/ast.cpp" "$LEXER_SRC/lexer.cpp" "$ERRORS_SRC/errors.cpp" "$ERRORS_SRC/diagnostics.cpp" -o "$BASE_DIR/ast_program"
 
 # Run AST generation
 echo "Running AST generation..."
-"$BASE_DIR/ast_program" "$OUTPUT_DIR/lexer-output/output.txt" "$OUTPUT_DIR/ast-output/output.txt"
+# The text dump is for reading; code generation takes the binary AST
+"$BASE_DIR/ast_program" "$OUTPUT_DIR/lexer-output/output.txt" "$OUTPUT_DIR/ast-output/output.txt" --source-name "$INPUT_DIR/$INPUT_FILE" \
+    --binary "$OUTPUT_DIR/ast-output/output.mlast"
 
 # Compile Code Generation
 echo "Compiling Code Generation..."
-g++ "$CODEGEN_SRC/main.cpp" -o "$BASE_DIR/codegen_program"
+g++ "$CODEGEN_SRC/main.cpp" "$CODEGEN_SRC/codegen.cpp" "$CODEGEN_SRC/cppgen.cpp" "$CODEGEN_SRC/ir.cpp" "$CODEGEN_SRC/types.cpp" \
+    "$CODEGEN_SRC/builtins.cpp" "$CODEGEN_SRC/analysis.cpp" "$CODEGEN_SRC/inliner.cpp" "$CODEGEN_SRC/cse.cpp" "$CODEGEN_SRC/deadcode.cpp" "$CODEGEN_SRC/sourcemap.cpp" "$RUNTIME_SRC/profile.cpp" "$ERRORS_SRC/diagnostics.cpp" \
+    -o "$BASE_DIR/codegen_program"
 
 # Run Code Generation
 echo "Running Code Generation..."
-"$BASE_DIR/codegen_program" "$OUTPUT_DIR/ast-output/output.txt" "$OUTPUT_DIR/final-output/final_python_output.txt"
+"$BASE_DIR/codegen_program" "$OUTPUT_DIR/ast-output/output.mlast" "$OUTPUT_DIR/final-output/final_python_output.txt" --source-name "$INPUT_DIR/$INPUT_FILE"
 
 # Print final output
 echo "Pipeline completed successfully. Final output:"
@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# Ensure the script stops on errors
+set -e
+
+# Usage: ./test.sh [test ...]   (default: every test in mlang_compile/src/tests)
+BASE_DIR=$(pwd)
+SRC="$BASE_DIR/mlang_compile/src"
+TEST_SRC="$SRC/tests"
+BUILD_DIR="$BASE_DIR/test_build"
+mkdir -p "$BUILD_DIR"
+
+FRONT_END=("$SRC/lexical-analysis/lexer/lexer.cpp" "$SRC/lexical-analysis/errors/errors.cpp" "$SRC/lexical-analysis/errors/diagnostics.cpp"
+    "$SRC/ast/ast-generation/ast.cpp")
+CODE_GENERATION=("$SRC/code-generation/codegen.cpp" "$SRC/code-generation/sourcemap.cpp" "$SRC/code-generation/ir.cpp"
+    "$SRC/code-generation/types.cpp" "$SRC/code-generation/builtins.cpp" "$SRC/code-generation/analysis.cpp"
+    "$SRC/code-generation/inliner.cpp" "$SRC/code-generation/cse.cpp" "$SRC/code-generation/deadcode.cpp" "$SRC/runtime/profile.cpp")
+RUNTIME=("$SRC/runtime/runtime.cpp" "$SRC/runtime/distributed.cpp" "$SRC/runtime/parallel.cpp" "$SRC/runtime/pool.cpp"
+    "$SRC/runtime/profile.cpp")
+
+TESTS=("$@")
+if [ ${#TESTS[@]} -eq 0 ]; then
+    TESTS=(cse_test vectorize_test distributed_test)
+fi
+
+for TEST in "${TESTS[@]}"; do
+    echo "Compiling $TEST..."
+    case "$TEST" in
+    cse_test)
+        g++ -std=c++17 -O2 -pthread "$TEST_SRC/cse_test.cpp" "${FRONT_END[@]}" "${CODE_GENERATION[@]}" -o "$BUILD_DIR/$TEST"
+        ;;
+    vectorize_test)
+        g++ -std=c++17 -O2 -pthread "$TEST_SRC/vectorize_test.cpp" "${FRONT_END[@]}" "${CODE_GENERATION[@]}" -o "$BUILD_DIR/$TEST"
+        ;;
+    distributed_test)
+        g++ -std=c++17 -O2 -pthread "$TEST_SRC/distributed_test.cpp" "${RUNTIME[@]}" -o "$BUILD_DIR/$TEST"
+        ;;
+    *)
+        echo "Unknown test: $TEST"
+        exit 1
+        ;;
+    esac
+    "$BUILD_DIR/$TEST"
+done
+
+echo "All tests passed."